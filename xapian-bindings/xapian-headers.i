@@ -1,7 +1,7 @@
 %{
 /* xapian-headers.i: Getting SWIG to parse Xapian's C++ headers.
  *
- * Copyright 2004-2024 Olly Betts
+ * Copyright 2004-2026 Olly Betts
  * Copyright 2014 Assem Chelli
  *
  * This program is free software; you can redistribute it and/or
@@ -186,6 +186,10 @@ CONSTANT(int, Xapian, DB_BACKEND_HONEY);
 CONSTANT(int, Xapian, DB_BACKEND_INMEMORY);
 CONSTANT(int, Xapian, DB_BACKEND_STUB);
 CONSTANT(int, Xapian, DB_RETRY_LOCK);
+CONSTANT(int, Xapian, DB_BULK_LOAD);
+CONSTANT(int, Xapian, DB_COMPRESS_LZ4);
+CONSTANT(int, Xapian, DB_COMPRESS_ZSTD);
+CONSTANT(int, Xapian, DB_CACHE_DOCLENGTHS);
 CONSTANT(int, Xapian, DBCHECK_SHORT_TREE);
 CONSTANT(int, Xapian, DBCHECK_FULL_TREE);
 CONSTANT(int, Xapian, DBCHECK_SHOW_FREELIST);
@@ -194,6 +198,11 @@ CONSTANT(int, Xapian, DBCHECK_FIX);
 CONSTANT(int, Xapian, DBCOMPACT_MULTIPASS);
 CONSTANT(int, Xapian, DBCOMPACT_NO_RENUMBER);
 CONSTANT(int, Xapian, DBCOMPACT_SINGLE_FILE);
+CONSTANT(int, Xapian, DBCOMPACT_BLOCK_POSTINGS);
+CONSTANT(int, Xapian, DBCOMPACT_BLOOM_FILTERS);
+CONSTANT(int, Xapian, DBCOMPACT_BLOCK_POSITIONS);
+CONSTANT(int, Xapian, DBCOMPACT_VALUE_COLUMNS);
+CONSTANT(int, Xapian, DBCOMPACT_IMPACTS);
 CONSTANT(int, Xapian, DOC_ASSUME_VALID);
 %include <xapian/constants.h>
 
@@ -447,6 +456,9 @@ STANDARD_IGNORES(Xapian, WritableDatabase)
     }
 }
 
+STANDARD_IGNORES(Xapian, HoneyBuilder)
+%include <xapian/honeybuilder.h>
+
 #if defined SWIGCSHARP || defined SWIGJAVA
 
 /* C# and Java don't allow functions outside a class so we can't use SWIG's
@@ -474,6 +486,13 @@ class Remote {
                                           unsigned connect_timeout = 10000,
                                           int flags = 0);
 
+    static Database open_replicas(const std::string &replicas,
+                                  unsigned timeout = 10000,
+                                  unsigned connect_timeout = 10000,
+                                  unsigned hedge_percentile = 95);
+
+    static void set_connection_pool_size(unsigned max_idle);
+
     static Database open(const std::string &program,
                          const std::string &args,
                          unsigned timeout = 10000);
@@ -490,6 +509,8 @@ class Remote {
 
 %rename("remote_open") Xapian::Remote::open;
 %rename("remote_open_writable") Xapian::Remote::open_writable;
+%rename("remote_open_replicas") Xapian::Remote::open_replicas;
+%rename("remote_set_connection_pool_size") Xapian::Remote::set_connection_pool_size;
 
 %include <xapian/dbfactory.h>
 
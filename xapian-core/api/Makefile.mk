@@ -31,6 +31,7 @@ lib_src +=\
 	api/enquire.cc\
 	api/error.cc\
 	api/expanddecider.cc\
+	api/honeybuilder.cc\
 	api/keymaker.cc\
 	api/matchspy.cc\
 	api/mset.cc\
@@ -25,7 +25,10 @@
 
 #include <algorithm>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <cerrno>
@@ -45,6 +48,7 @@
 #include "filetests.h"
 #include "fileutils.h"
 #include "io_utils.h"
+#include "parallel.h"
 #include "stringutils.h"
 #include "str.h"
 
@@ -79,9 +83,104 @@ class CmpByFirstUsed {
     }
 };
 
+/** Wrapper which serialises calls to a Compactor object.
+ *
+ *  Used when compacting with multiple threads, so that subclasses of
+ *  Compactor don't need to be thread-safe.
+ */
+class SerialisingCompactor : public Xapian::Compactor {
+    Xapian::Compactor& compactor;
+
+    ParallelMutex mutex;
+
+  public:
+    explicit SerialisingCompactor(Xapian::Compactor& compactor_)
+        : compactor(compactor_) {
+        set_threads(compactor.get_threads());
+    }
+
+    void set_status(const string& table, const string& status) override {
+        lock_guard<ParallelMutex> lock(mutex);
+        compactor.set_status(table, status);
+    }
+
+    string resolve_duplicate_metadata(const string& key,
+                                      size_t num_tags,
+                                      const string tags[]) override {
+        lock_guard<ParallelMutex> lock(mutex);
+        return compactor.resolve_duplicate_metadata(key, num_tags, tags);
+    }
+};
+
+/** Thread counts set by Compactor::set_threads().
+ *
+ *  These are kept here rather than in a data member so that the layout of
+ *  Compactor (which user code subclasses) is unchanged.  Compactor objects
+ *  which aren't listed use one thread.  Compactor's copy constructor and
+ *  assignment operator copy the entry.
+ */
+class CompactorThreads {
+    ParallelMutex mutex;
+
+    unordered_map<const Xapian::Compactor*, unsigned> threads;
+
+  public:
+    void set(const Xapian::Compactor* compactor, unsigned n) {
+        lock_guard<ParallelMutex> lock(mutex);
+        if (n == 1) {
+            threads.erase(compactor);
+        } else {
+            threads[compactor] = n;
+        }
+    }
+
+    unsigned get(const Xapian::Compactor* compactor) {
+        lock_guard<ParallelMutex> lock(mutex);
+        auto i = threads.find(compactor);
+        return i == threads.end() ? 1 : i->second;
+    }
+};
+
+static CompactorThreads&
+compactor_threads()
+{
+    // Function-local so it's usable from the constructors of static Compactor
+    // objects, and deliberately never destroyed so it's still usable from
+    // their destructors whatever order static objects get destroyed in.
+    static CompactorThreads* instance = new CompactorThreads;
+    return *instance;
+}
+
 namespace Xapian {
 
-Compactor::~Compactor() { }
+Compactor::Compactor(const Compactor& o)
+{
+    set_threads(o.get_threads());
+}
+
+Compactor&
+Compactor::operator=(const Compactor& o)
+{
+    set_threads(o.get_threads());
+    return *this;
+}
+
+Compactor::~Compactor()
+{
+    compactor_threads().set(this, 1);
+}
+
+void
+Compactor::set_threads(unsigned threads_)
+{
+    compactor_threads().set(this, threads_);
+}
+
+unsigned
+Compactor::get_threads() const
+{
+    return compactor_threads().get(this);
+}
 
 void
 Compactor::set_status(const string & table, const string & status)
@@ -339,6 +438,12 @@ Database::compact_(const string_view* output_ptr, int fd, unsigned flags,
         }
     }
 
+    unique_ptr<SerialisingCompactor> serialising_compactor;
+    if (compactor && compactor->get_threads() != 1) {
+        serialising_compactor.reset(new SerialisingCompactor(*compactor));
+        compactor = serialising_compactor.get();
+    }
+
 #if defined XAPIAN_HAS_GLASS_BACKEND || defined XAPIAN_HAS_HONEY_BACKEND
     Xapian::Compactor::compaction_level compaction =
         static_cast<Xapian::Compactor::compaction_level>(flags & (Xapian::Compactor::STANDARD|Xapian::Compactor::FULL|Xapian::Compactor::FULLER));
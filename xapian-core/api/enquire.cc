@@ -1,7 +1,7 @@
 /** @file
  * @brief Xapian::Enquire class
  */
-/* Copyright (C) 2009,2017,2024 Olly Betts
+/* Copyright (C) 2009,2017,2024,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -28,6 +28,7 @@
 #include "matcher/matcher.h"
 #include "msetinternal.h"
 #include "omassert.h"
+#include "realtime.h"
 #include "vectortermlist.h"
 #include "weight/weightinternal.h"
 #include "xapian/database.h"
@@ -196,6 +197,13 @@ Enquire::set_time_limit(double time_limit)
     internal->time_limit = time_limit;
 }
 
+void
+Enquire::set_remote_partial_results(bool partial, double deadline)
+{
+    internal->partial_results = partial;
+    internal->partial_deadline = deadline;
+}
+
 MSet
 Enquire::get_mset(doccount first,
                   doccount maxitems,
@@ -266,6 +274,12 @@ Enquire::Internal::get_mset(doccount first,
         return mset;
     }
 
+    // The deadline for remote shards covers the whole of the match.
+    double partial_end_time = 0.0;
+    if (partial_results) {
+        partial_end_time = RealTime::end_time(partial_deadline);
+    }
+
     if (percent_threshold && (sort_by == VAL || sort_by == VAL_REL)) {
         throw Xapian::UnimplementedError("Use of a percentage cutoff while "
                                          "sorting primary by value isn't "
@@ -325,7 +339,9 @@ Enquire::Internal::get_mset(doccount first,
                                sort_by,
                                sort_val_reverse,
                                time_limit,
-                               matchspies);
+                               matchspies,
+                               partial_results,
+                               partial_end_time);
 
     if (first_orig != first) {
         mset.internal->set_first(first_orig);
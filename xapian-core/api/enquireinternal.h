@@ -1,7 +1,7 @@
 /** @file
  * @brief Xapian::Enquire internals
  */
-/* Copyright 2017,2024 Olly Betts
+/* Copyright 2017,2024,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -79,6 +79,10 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 
     double time_limit = 0.0;
 
+    bool partial_results = false;
+
+    double partial_deadline = 0.0;
+
     enum { EXPAND_PROB, EXPAND_BO1 } eweight = EXPAND_PROB;
 
     double expand_k = 1.0;
@@ -113,6 +117,10 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
     void request_document(docid did) const {
         db.internal->request_document(did);
     }
+
+    void request_documents(const std::vector<docid>& dids) const {
+        db.internal->request_documents(dids);
+    }
 };
 
 }
@@ -0,0 +1,363 @@
+/** @file
+ * @brief Build a honey database directly from documents.
+ */
+/* Copyright (C) 2026 Olly Betts
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <xapian/honeybuilder.h>
+
+#include <xapian/compactor.h>
+#include <xapian/constants.h>
+#include <xapian/database.h>
+#include <xapian/document.h>
+#include <xapian/error.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "safesysstat.h"
+#include "safeunistd.h"
+
+#include "filetests.h"
+#include "fileutils.h"
+#include "omassert.h"
+#include "parseint.h"
+#include "str.h"
+
+using namespace std;
+
+/** Maximum number of runs of the same level before we merge them.
+ *
+ *  This limits the number of databases (and so files) which need to be open
+ *  at once when merging.
+ */
+static constexpr size_t MERGE_FANIN = 32;
+
+class Xapian::HoneyBuilder::Internal : public Xapian::Internal::intrusive_base {
+    /// A sorted run, stored as a honey database.
+    struct Run {
+        /// Path of the database.
+        string path;
+
+        /** The level of this run.
+         *
+         *  A run written from a batch of documents is level 0, and merging
+         *  runs of level N produces a run of level N + 1.
+         */
+        unsigned level;
+    };
+
+    /// The path of the honey database to create.
+    string path;
+
+    /// Xapian::DBCOMPACT_* flags for the honey database.
+    int flags;
+
+    /// Number of documents to buffer before writing a run.
+    Xapian::doccount batch_size;
+
+    /// The directory the runs are stored in.
+    string tmpdir;
+
+    /// Used to give each run a unique name.
+    unsigned run_counter = 0;
+
+    /// The completed runs, oldest first.
+    vector<Run> runs;
+
+    /** The batch currently being built, if any.
+     *
+     *  This is a glass database, which is converted to a honey run when the
+     *  batch is complete.
+     */
+    Xapian::WritableDatabase current;
+
+    /// The path of the glass database holding the current batch.
+    string current_path;
+
+    /// Has current been opened?
+    bool have_current = false;
+
+    /// Number of documents in the current batch.
+    Xapian::doccount current_size = 0;
+
+    /// The last docid used.
+    Xapian::docid last_docid = 0;
+
+    /// User metadata to store in the honey database.
+    map<string, string, less<>> metadata;
+
+    /// Has finish() been called?
+    bool finished = false;
+
+    /// Return a new unique path for a run.
+    string run_path() {
+        return tmpdir + "/" + str(run_counter++);
+    }
+
+    /// Open the current batch if it isn't already open.
+    void open_current() {
+        if (finished) {
+            throw Xapian::InvalidOperationError("HoneyBuilder::finish() "
+                                                "already called");
+        }
+        if (have_current) return;
+        if (mkdir(tmpdir.c_str(), 0755) < 0 && errno != EEXIST) {
+            throw Xapian::DatabaseCreateError("Cannot create directory '" +
+                                              tmpdir + "'", errno);
+        }
+        current_path = run_path();
+        current = Xapian::WritableDatabase(current_path,
+                                           Xapian::DB_CREATE |
+                                           Xapian::DB_BACKEND_GLASS |
+                                           Xapian::DB_NO_SYNC);
+        have_current = true;
+        current_size = 0;
+    }
+
+    /** Convert the current batch (if open) to a run, and merge runs if
+     *  necessary.
+     */
+    void close_current() {
+        if (!have_current) return;
+        current.commit();
+        current.close();
+        current = Xapian::WritableDatabase();
+        have_current = false;
+
+        runs.push_back(Run{run_path(), 0});
+        {
+            Xapian::Database batch(current_path);
+            batch.compact(runs.back().path, Xapian::DB_BACKEND_HONEY);
+        }
+        removedir(current_path);
+
+        // Merge runs of the same level until we have fewer than MERGE_FANIN
+        // of the latest level.
+        while (runs.size() >= MERGE_FANIN) {
+            size_t first = runs.size() - MERGE_FANIN;
+            unsigned level = runs[first].level;
+            if (runs.back().level != level) break;
+            Xapian::Database db;
+            for (size_t i = first; i != runs.size(); ++i) {
+                db.add_database(Xapian::Database(runs[i].path));
+            }
+            Run run{run_path(), level + 1};
+            // Merging renumbers the documents in each run to follow on from
+            // those in the previous run, which is what we want since each
+            // run numbers its documents from 1.
+            db.compact(run.path, Xapian::DB_BACKEND_HONEY);
+            db.close();
+            for (size_t i = first; i != runs.size(); ++i) {
+                removedir(runs[i].path);
+            }
+            runs.resize(first);
+            runs.push_back(std::move(run));
+        }
+    }
+
+  public:
+    Internal(string_view path_, int flags_, Xapian::doccount batch_size_)
+        : path(path_), flags(flags_), batch_size(batch_size_)
+    {
+        if (batch_size == 0) {
+            const char* p = getenv("XAPIAN_FLUSH_THRESHOLD");
+            if (p && *p) {
+                if (!parse_unsigned(p, batch_size)) {
+                    throw Xapian::InvalidArgumentError("XAPIAN_FLUSH_THRESHOLD "
+                                                       "must be a "
+                                                       "non-negative "
+                                                       "integer");
+                }
+            }
+            if (batch_size == 0)
+                batch_size = 10000;
+        }
+        tmpdir = path;
+        tmpdir += ".tmp";
+    }
+
+    ~Internal() {
+        try {
+            discard();
+        } catch (...) {
+            // Ignore any exceptions, since we may be being called due to an
+            // exception anyway.
+        }
+    }
+
+    /// Remove the runs and the temporary directory.
+    void discard() {
+        if (have_current) {
+            current.close();
+            current = Xapian::WritableDatabase();
+            have_current = false;
+            removedir(current_path);
+        }
+        for (auto& run : runs) {
+            removedir(run.path);
+        }
+        runs.clear();
+        if (dir_exists(tmpdir)) removedir(tmpdir);
+    }
+
+    Xapian::docid add_document(const Xapian::Document& doc) {
+        if (current_size == batch_size) close_current();
+        open_current();
+        (void)current.add_document(doc);
+        ++current_size;
+        return ++last_docid;
+    }
+
+    void set_metadata(string_view key, string_view value) {
+        if (finished) {
+            throw Xapian::InvalidOperationError("HoneyBuilder::finish() "
+                                                "already called");
+        }
+        if (key.empty()) {
+            throw Xapian::InvalidArgumentError("Empty metadata keys are "
+                                               "invalid");
+        }
+        if (value.empty()) {
+            auto i = metadata.find(key);
+            if (i != metadata.end()) metadata.erase(i);
+        } else {
+            metadata.insert_or_assign(string(key), string(value));
+        }
+    }
+
+    void add_spelling(string_view word, Xapian::termcount freqinc) {
+        open_current();
+        current.add_spelling(word, freqinc);
+    }
+
+    void add_synonym(string_view term, string_view synonym) {
+        open_current();
+        current.add_synonym(term, synonym);
+    }
+
+    void finish(Xapian::Compactor* compactor) {
+        if (finished) {
+            throw Xapian::InvalidOperationError("HoneyBuilder::finish() "
+                                                "already called");
+        }
+        if (!metadata.empty() || runs.empty()) {
+            // Store the metadata in the latest batch - it isn't in any other
+            // run so there won't be any duplicates to resolve.  We also need
+            // a run to merge from if nothing has been added.
+            open_current();
+            for (auto& i : metadata) {
+                current.set_metadata(i.first, i.second);
+            }
+        }
+        close_current();
+        finished = true;
+
+        Xapian::Database db;
+        for (auto& run : runs) {
+            db.add_database(Xapian::Database(run.path));
+        }
+        int compact_flags = flags | Xapian::DB_BACKEND_HONEY;
+        if (compactor) {
+            db.compact(path, compact_flags, 0, *compactor);
+        } else {
+            db.compact(path, compact_flags);
+        }
+        db.close();
+        discard();
+    }
+
+    string get_description() const {
+        string desc = "HoneyBuilder(";
+        desc += path;
+        desc += ", ";
+        desc += str(last_docid);
+        desc += " documents)";
+        return desc;
+    }
+};
+
+namespace Xapian {
+
+HoneyBuilder::HoneyBuilder(const HoneyBuilder&) = default;
+
+HoneyBuilder&
+HoneyBuilder::operator=(const HoneyBuilder&) = default;
+
+HoneyBuilder::HoneyBuilder(HoneyBuilder&&) = default;
+
+HoneyBuilder&
+HoneyBuilder::operator=(HoneyBuilder&&) = default;
+
+HoneyBuilder::HoneyBuilder(string_view path,
+                           int flags,
+                           Xapian::doccount batch_size)
+    : internal(new HoneyBuilder::Internal(path, flags, batch_size))
+{
+}
+
+HoneyBuilder::~HoneyBuilder() { }
+
+Xapian::docid
+HoneyBuilder::add_document(const Xapian::Document& doc)
+{
+    return internal->add_document(doc);
+}
+
+void
+HoneyBuilder::set_metadata(string_view key, string_view value)
+{
+    internal->set_metadata(key, value);
+}
+
+void
+HoneyBuilder::add_spelling(string_view word, Xapian::termcount freqinc)
+{
+    internal->add_spelling(word, freqinc);
+}
+
+void
+HoneyBuilder::add_synonym(string_view term, string_view synonym)
+{
+    internal->add_synonym(term, synonym);
+}
+
+void
+HoneyBuilder::finish()
+{
+    internal->finish(NULL);
+}
+
+void
+HoneyBuilder::finish(Xapian::Compactor& compactor)
+{
+    internal->finish(&compactor);
+}
+
+string
+HoneyBuilder::get_description() const
+{
+    return internal->get_description();
+}
+
+}
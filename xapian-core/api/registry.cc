@@ -1,7 +1,7 @@
 /** @file
  * @brief Class for looking up user subclasses during unserialisation.
  */
-/* Copyright (C) 2006,2007,2008,2009,2010,2016,2024 Olly Betts
+/* Copyright (C) 2006,2007,2008,2009,2010,2016,2024,2026 Olly Betts
  * Copyright (C) 2006,2007,2009 Lemur Consulting Ltd
  *
  * This program is free software; you can redistribute it and/or
@@ -211,6 +211,8 @@ Registry::Internal::add_defaults()
     wtschemes[weighting_scheme->name()] = weighting_scheme;
     weighting_scheme = new Xapian::DiceWeight;
     wtschemes[weighting_scheme->name()] = weighting_scheme;
+    weighting_scheme = new Xapian::ImpactWeight;
+    wtschemes[weighting_scheme->name()] = weighting_scheme;
 
     Xapian::PostingSource * source;
     source = new Xapian::ValueWeightPostingSource(0);
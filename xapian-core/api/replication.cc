@@ -2,7 +2,7 @@
  * @brief Replication support for Xapian databases.
  */
 /* Copyright (C) 2008 Lemur Consulting Ltd
- * Copyright (C) 2008,2009,2010,2011,2012,2013,2014,2015,2016,2017 Olly Betts
+ * Copyright (C) 2008,2009,2010,2011,2012,2013,2014,2015,2016,2017,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -73,11 +73,13 @@ DatabaseMaster::write_changesets_to_fd(int fd,
     LOGCALL_VOID(REPLICA, "DatabaseMaster::write_changesets_to_fd", fd | start_revision | info);
     if (info != NULL)
         info->clear();
+    RemoteConnection conn(-1, fd);
+    if (compression != Compression::CODEC_MAX_)
+        conn.set_compression(compression);
     Database db;
     try {
         db = Database(path);
     } catch (const Xapian::DatabaseError & e) {
-        RemoteConnection conn(-1, fd);
         conn.send_message(REPL_REPLY_FAIL,
                           "Can't open database: " + e.get_msg(),
                           0.0);
@@ -106,7 +108,7 @@ DatabaseMaster::write_changesets_to_fd(int fd,
         revision.assign(ptr, end - ptr);
     }
 
-    db.internal->write_changesets_to_fd(fd, revision, need_whole_db, info);
+    db.internal->write_changesets_to_fd(conn, revision, need_whole_db, info);
 }
 
 string
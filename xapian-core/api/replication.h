@@ -2,7 +2,7 @@
  * @brief Replication support for Xapian databases.
  */
 /* Copyright 2008 Lemur Consulting Ltd
- * Copyright 2008,2011,2015,2016 Olly Betts
+ * Copyright 2008,2011,2015,2016,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -24,6 +24,8 @@
 
 #include "xapian/visibility.h"
 
+#include "compression_stream.h"
+
 #include <string>
 
 namespace Xapian {
@@ -57,6 +59,9 @@ class XAPIAN_VISIBILITY_DEFAULT DatabaseMaster {
     /// The path to the master database.
     std::string path;
 
+    /// Codec to compress with, or CODEC_MAX_ to not compress.
+    Compression::codec compression = Compression::CODEC_MAX_;
+
   public:
     /** Create a new DatabaseMaster for the database at the specified path.
      *
@@ -65,6 +70,16 @@ class XAPIAN_VISIBILITY_DEFAULT DatabaseMaster {
      */
     explicit DatabaseMaster(const std::string & path_) : path(path_) {}
 
+    /** Compress the changesets written.
+     *
+     *  Larger messages and files are compressed using @a codec where that
+     *  makes them smaller, and files are sent with a checksum.  The replica
+     *  must support @a codec.
+     *
+     *  @param codec  The codec to compress with.
+     */
+    void set_compression(Compression::codec codec) { compression = codec; }
+
     /** Write a set of changesets for upgrading the database to a file.
      *
      *  The changesets will be such that, if they are applied in order to a
@@ -6,6 +6,7 @@ noinst_HEADERS +=\
 	backends/databasehelpers.h\
 	backends/databaseinternal.h\
 	backends/databasereplicator.h\
+	backends/doclencache.h\
 	backends/documentinternal.h\
 	backends/empty_database.h\
 	backends/flint_lock.h\
@@ -1,7 +1,7 @@
 /** @file
  * @brief Helper functions for database handling
  */
-/* Copyright 2002-2024 Olly Betts
+/* Copyright 2002-2026 Olly Betts
  * Copyright 2008 Lemur Consulting Ltd
  *
  * This program is free software; you can redistribute it and/or
@@ -75,7 +75,8 @@ template<typename A1,
          typename A3,
          typename A4,
          typename A5,
-         typename A6>
+         typename A6,
+         typename A7>
 void
 read_stub_file(std::string_view file,
                A1 action_auto,
@@ -83,7 +84,8 @@ read_stub_file(std::string_view file,
                A3 action_honey,
                A4 action_remote_prog,
                A5 action_remote_tcp,
-               A6 action_inmemory)
+               A6 action_remote_replicas,
+               A7 action_inmemory)
 {
     // A stub database is a text file with one or more lines of this format:
     // <dbtype> <serialised db object>
@@ -154,6 +156,12 @@ read_stub_file(std::string_view file,
                                    std::string_view(line).substr(space + 1));
                 continue;
             }
+            if (line.find(' ') != std::string::npos) {
+                // Group of tcp replicas.
+                // FIXME: timeouts
+                action_remote_replicas(std::string_view(line));
+                continue;
+            }
             std::string::size_type colon = line.rfind(':');
             if (colon != std::string::npos) {
                 // tcp
@@ -177,6 +185,7 @@ read_stub_file(std::string_view file,
 #else
             (void)action_remote_prog;
             (void)action_remote_tcp;
+            (void)action_remote_replicas;
             throw Xapian::FeatureUnavailableError("Remote backend disabled");
 #endif
         }
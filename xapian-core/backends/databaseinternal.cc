@@ -1,7 +1,7 @@
 /** @file
  * @brief Virtual base class for Database internals
  */
-/* Copyright 2003-2024 Olly Betts
+/* Copyright 2003-2026 Olly Betts
  * Copyright 2008 Lemur Consulting Ltd
  *
  * This program is free software; you can redistribute it and/or
@@ -36,6 +36,7 @@
 #include <memory>
 #include <string>
 #include <string_view>
+#include <vector>
 
 using namespace std;
 using Xapian::Internal::intrusive_ptr;
@@ -60,6 +61,11 @@ Database::Internal::keep_alive()
     // No-op except for remote databases.
 }
 
+void
+Database::Internal::cache_doclengths()
+{
+}
+
 void
 Database::Internal::readahead_for_query(const Xapian::Query &) const
 {
@@ -386,8 +392,16 @@ Database::Internal::request_document(Xapian::docid) const
 }
 
 void
-Database::Internal::write_changesets_to_fd(int, string_view, bool,
-                                           ReplicationInfo*)
+Database::Internal::request_documents(const vector<Xapian::docid>& dids) const
+{
+    for (auto did : dids) {
+        request_document(did);
+    }
+}
+
+void
+Database::Internal::write_changesets_to_fd(RemoteConnection&, string_view,
+                                           bool, ReplicationInfo*)
 {
     throw Xapian::UnimplementedError("This backend doesn't provide changesets");
 }
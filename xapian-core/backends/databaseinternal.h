@@ -1,7 +1,7 @@
 /** @file
  * @brief Virtual base class for Database internals
  */
-/* Copyright 2004-2024 Olly Betts
+/* Copyright 2004-2026 Olly Betts
  * Copyright 2007,2008 Lemur Consulting Ltd
  *
  * This program is free software; you can redistribute it and/or
@@ -35,12 +35,14 @@
 
 #include <string>
 #include <string_view>
+#include <vector>
 
 typedef Xapian::TermIterator::Internal TermList;
 typedef Xapian::PositionIterator::Internal PositionList;
 typedef Xapian::ValueIterator::Internal ValueList;
 
 class LeafPostList;
+class RemoteConnection;
 
 namespace Xapian {
 namespace Internal {
@@ -129,6 +131,15 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 
     virtual void keep_alive();
 
+    /** Cache document lengths in memory.
+     *
+     *  Used to implement Xapian::DB_CACHE_DOCLENGTHS.  Backends which support
+     *  this should read all the document lengths when one is first needed.
+     *
+     *  The default implementation does nothing.
+     */
+    virtual void cache_doclengths();
+
     virtual void readahead_for_query(const Query& query) const;
 
     virtual doccount get_doccount() const = 0;
@@ -413,9 +424,8 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
      *  This tells the database that we're going to want a particular
      *  document soon.  It's just a hint which the backend may ignore,
      *  but for glass it issues a preread hint on the file with the
-     *  document data in, and for the remote backend it might cause
-     *  the document to be fetched asynchronously (this isn't currently
-     *  implemented though).
+     *  document data in, and for the remote backend it causes the
+     *  document to be fetched asynchronously.
      *
      *  It can be called for multiple documents in turn, and a common usage
      *  pattern would be to iterate over an MSet and request the documents,
@@ -425,12 +435,21 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
      */
     virtual void request_document(docid did) const;
 
-    /** Write a set of changesets to a file descriptor.
+    /** Request several documents.
+     *
+     *  Like request_document() but for a batch of documents, which allows
+     *  the remote backend to fetch them all with a single message.
+     *
+     *  The default implementation calls request_document() for each docid.
+     */
+    virtual void request_documents(const std::vector<docid>& dids) const;
+
+    /** Write a set of changesets to a connection.
      *
      *  This call may reopen the database, leaving it pointing to a more
      *  recent version of the database.
      */
-    virtual void write_changesets_to_fd(int fd,
+    virtual void write_changesets_to_fd(RemoteConnection& conn,
                                         std::string_view start_revision,
                                         bool need_whole_db,
                                         ReplicationInfo* info);
@@ -1,7 +1,7 @@
 /** @file
  * @brief Check the consistency of a database or table.
  */
-/* Copyright 2007-2024 Olly Betts
+/* Copyright 2007-2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -442,6 +442,10 @@ check_stub(const string& stub_path, int opts, std::ostream* out)
                        auto msg = "Remote database checking not implemented";
                        throw Xapian::UnimplementedError(msg);
                    },
+                   [](string_view) {
+                       auto msg = "Remote database checking not implemented";
+                       throw Xapian::UnimplementedError(msg);
+                   },
                    []() {
                        auto msg = "InMemory database checking not implemented";
                        throw Xapian::UnimplementedError(msg);
@@ -1,7 +1,7 @@
 /** @file
  * @brief Database factories for non-remote databases.
  */
-/* Copyright 2002-2024 Olly Betts
+/* Copyright 2002-2026 Olly Betts
  * Copyright 2008 Lemur Consulting Ltd
  *
  * This program is free software; you can redistribute it and/or
@@ -94,6 +94,13 @@ open_stub(Database& db, string_view file)
 #else
                        (void)host;
                        (void)port;
+#endif
+                   },
+                   [&db](string_view replicas) {
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+                       db.add_database(Remote::open_replicas(replicas));
+#else
+                       (void)replicas;
 #endif
                    },
                    [&db]() {
@@ -144,6 +151,11 @@ open_stub(WritableDatabase& db, string_view file, int flags)
                        (void)port;
 #endif
                    },
+                   [](string_view) {
+                       auto msg = "Remote replica groups don't support "
+                                  "writing";
+                       throw Xapian::DatabaseOpeningError(msg);
+                   },
                    [&db]() {
                        db.add_database(WritableDatabase(""sv,
                                                         DB_BACKEND_INMEMORY));
@@ -154,33 +166,32 @@ open_stub(WritableDatabase& db, string_view file, int flags)
     }
 }
 
-Database::Database(string_view path, int flags)
-    : Database()
+/// Open the database at @a path into @a db.
+static void
+open_database(Database& db, string_view path, int flags)
 {
-    LOGCALL_CTOR(API, "Database", path|flags);
-
     int type = flags & DB_BACKEND_MASK_;
     switch (type) {
         case DB_BACKEND_GLASS:
 #ifdef XAPIAN_HAS_GLASS_BACKEND
-            internal = new GlassDatabase(path);
+            db.internal = new GlassDatabase(path);
             return;
 #else
             throw FeatureUnavailableError("Glass backend disabled");
 #endif
         case DB_BACKEND_HONEY:
 #ifdef XAPIAN_HAS_HONEY_BACKEND
-            internal = new HoneyDatabase(path);
+            db.internal = new HoneyDatabase(path);
             return;
 #else
             throw FeatureUnavailableError("Honey backend disabled");
 #endif
         case DB_BACKEND_STUB:
-            open_stub(*this, path);
+            open_stub(db, path);
             return;
         case DB_BACKEND_INMEMORY:
 #ifdef XAPIAN_HAS_INMEMORY_BACKEND
-            internal = new InMemoryDatabase();
+            db.internal = new InMemoryDatabase();
             return;
 #else
             throw FeatureUnavailableError("Inmemory backend disabled");
@@ -208,7 +219,7 @@ Database::Database(string_view path, int flags)
             case BACKEND_GLASS:
 #ifdef XAPIAN_HAS_GLASS_BACKEND
                 // Single file glass format.
-                internal = new GlassDatabase(fd);
+                db.internal = new GlassDatabase(fd);
                 return;
 #else
                 throw FeatureUnavailableError("Glass backend disabled");
@@ -216,14 +227,14 @@ Database::Database(string_view path, int flags)
             case BACKEND_HONEY:
 #ifdef XAPIAN_HAS_HONEY_BACKEND
                 // Single file honey format.
-                internal = new HoneyDatabase(fd);
+                db.internal = new HoneyDatabase(fd);
                 return;
 #else
                 throw FeatureUnavailableError("Honey backend disabled");
 #endif
         }
 
-        open_stub(*this, path);
+        open_stub(db, path);
         return;
     }
 
@@ -235,7 +246,7 @@ Database::Database(string_view path, int flags)
 #ifdef XAPIAN_HAS_GLASS_BACKEND
     filename += "/iamglass";
     if (file_exists(filename)) {
-        internal = new GlassDatabase(path);
+        db.internal = new GlassDatabase(path);
         return;
     }
 #endif
@@ -244,7 +255,7 @@ Database::Database(string_view path, int flags)
     filename.resize(path.size());
     filename += "/iamhoney";
     if (file_exists(filename)) {
-        internal = new HoneyDatabase(path);
+        db.internal = new HoneyDatabase(path);
         return;
     }
 #endif
@@ -253,7 +264,7 @@ Database::Database(string_view path, int flags)
     filename.resize(path.size());
     filename += "/XAPIANDB";
     if (usual(file_exists(filename))) {
-        open_stub(*this, filename);
+        open_stub(db, filename);
         return;
     }
 
@@ -285,6 +296,15 @@ Database::Database(string_view path, int flags)
     throw DatabaseNotFoundError("Couldn't detect type of database");
 }
 
+Database::Database(string_view path, int flags)
+    : Database()
+{
+    LOGCALL_CTOR(API, "Database", path|flags);
+
+    open_database(*this, path, flags);
+    if (flags & DB_CACHE_DOCLENGTHS) internal->cache_doclengths();
+}
+
 /** Helper factory function.
  *
  *  This allows us to initialise Database::internal via the constructor's
@@ -330,6 +350,8 @@ Database::Database(int fd, int flags)
     : internal(database_factory(fd, flags))
 {
     LOGCALL_CTOR(API, "Database", fd|flags);
+
+    if (flags & DB_CACHE_DOCLENGTHS) internal->cache_doclengths();
 }
 
 #if defined XAPIAN_HAS_GLASS_BACKEND
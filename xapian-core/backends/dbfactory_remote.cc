@@ -1,7 +1,7 @@
 /** @file
  * @brief Database factories for remote databases.
  */
-/* Copyright (C) 2006,2007,2008,2010,2011,2014,2024 Olly Betts
+/* Copyright (C) 2006,2007,2008,2010,2011,2014,2024,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -24,8 +24,10 @@
 
 #include "debuglog.h"
 #include "net/progclient.h"
+#include "net/remotereplicas.h"
 #include "net/remotetcpclient.h"
 
+#include <memory>
 #include <string_view>
 
 using namespace std;
@@ -37,8 +39,8 @@ Remote::open(string_view host, unsigned int port, unsigned timeout_,
              unsigned connect_timeout)
 {
     LOGCALL_STATIC(API, Database, "Remote::open", host | port | timeout_ | connect_timeout);
-    RETURN(Database(new RemoteTcpClient(host, port, timeout_ * 1e-3,
-                                        connect_timeout * 1e-3, false, 0)));
+    RETURN(Database(RemoteTcpClient::open(host, port, timeout_ * 1e-3,
+                                          connect_timeout * 1e-3)));
 }
 
 WritableDatabase
@@ -52,6 +54,24 @@ Remote::open_writable(string_view host, unsigned int port,
                                                 flags)));
 }
 
+Database
+Remote::open_replicas(string_view replicas, unsigned timeout_,
+                      unsigned connect_timeout, unsigned hedge_percentile)
+{
+    LOGCALL_STATIC(API, Database, "Remote::open_replicas", replicas | timeout_ | connect_timeout | hedge_percentile);
+    unique_ptr<RemoteReplicas> group(new RemoteReplicas(replicas,
+                                                        hedge_percentile,
+                                                        connect_timeout * 1e-3));
+    RETURN(Database(new RemoteTcpClient(std::move(group), timeout_ * 1e-3)));
+}
+
+void
+Remote::set_connection_pool_size(unsigned max_idle)
+{
+    LOGCALL_STATIC_VOID(API, "Remote::set_connection_pool_size", max_idle);
+    RemoteTcpClient::set_pool_size(max_idle);
+}
+
 Database
 Remote::open(string_view program, string_view args,
              unsigned timeout_)
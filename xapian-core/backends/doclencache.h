@@ -0,0 +1,128 @@
+/** @file
+ * @brief In-memory array of document lengths
+ */
+/* Copyright (C) 2026 Olly Betts
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef XAPIAN_INCLUDED_DOCLENCACHE_H
+#define XAPIAN_INCLUDED_DOCLENCACHE_H
+
+#include "xapian/types.h"
+
+#include "omassert.h"
+
+#include <cstdint>
+#include <vector>
+
+/** In-memory array of document lengths.
+ *
+ *  Used to implement Xapian::DB_CACHE_DOCLENGTHS.  The lengths are stored
+ *  exactly, using 1, 2 or 4 bytes per document id depending on the upper
+ *  bound on the document length.  The largest value for the width is used
+ *  to mark document ids which aren't in use.
+ */
+class DoclenCache {
+    /// Number of bytes per entry (1, 2 or 4).
+    unsigned width;
+
+    /// Entries if width is 1.
+    std::vector<uint8_t> data8;
+
+    /// Entries if width is 2.
+    std::vector<uint16_t> data16;
+
+    /// Entries if width is 4.
+    std::vector<uint32_t> data32;
+
+  public:
+    /** Check if a cache can be used.
+     *
+     *  @param doclen_ub  Upper bound on the document lengths.
+     */
+    static bool usable(Xapian::termcount doclen_ub) {
+        // We need a value to mark unused document ids.
+        return doclen_ub < 0xffffffff;
+    }
+
+    /** Constructor.
+     *
+     *  All document ids are initially marked as not in use.
+     *
+     *  @param last_did   The highest document id which may be set.
+     *  @param doclen_ub  Upper bound on the document lengths, which
+     *                    usable() must have returned true for.
+     */
+    DoclenCache(Xapian::docid last_did, Xapian::termcount doclen_ub) {
+        Assert(usable(doclen_ub));
+        if (doclen_ub < 0xff) {
+            width = 1;
+            data8.resize(last_did, 0xff);
+        } else if (doclen_ub < 0xffff) {
+            width = 2;
+            data16.resize(last_did, 0xffff);
+        } else {
+            width = 4;
+            data32.resize(last_did, 0xffffffff);
+        }
+    }
+
+    /// Set the length of document @a did.
+    void set(Xapian::docid did, Xapian::termcount doclen) {
+        Assert(did != 0);
+        size_t i = did - 1;
+        switch (width) {
+            case 1:
+                AssertRel(doclen, <, 0xff);
+                data8[i] = uint8_t(doclen);
+                break;
+            case 2:
+                AssertRel(doclen, <, 0xffff);
+                data16[i] = uint16_t(doclen);
+                break;
+            default:
+                AssertRel(doclen, <, 0xffffffff);
+                data32[i] = uint32_t(doclen);
+                break;
+        }
+    }
+
+    /** Get the length of document @a did.
+     *
+     *  @return false if @a did isn't in use.
+     */
+    bool get(Xapian::docid did, Xapian::termcount& doclen) const {
+        Assert(did != 0);
+        size_t i = did - 1;
+        switch (width) {
+            case 1:
+                if (i >= data8.size() || data8[i] == 0xff) return false;
+                doclen = data8[i];
+                return true;
+            case 2:
+                if (i >= data16.size() || data16[i] == 0xffff) return false;
+                doclen = data16[i];
+                return true;
+            default:
+                if (i >= data32.size() || data32[i] == 0xffffffff)
+                    return false;
+                doclen = data32[i];
+                return true;
+        }
+    }
+};
+
+#endif // XAPIAN_INCLUDED_DOCLENCACHE_H
@@ -1,7 +1,7 @@
 /** @file
  * @brief Empty database internals
  */
-/* Copyright (C) 2017,2024 Olly Betts
+/* Copyright (C) 2017,2024,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -244,7 +244,7 @@ EmptyDatabase::open_metadata_keylist(string_view) const
 }
 
 void
-EmptyDatabase::write_changesets_to_fd(int,
+EmptyDatabase::write_changesets_to_fd(RemoteConnection&,
                                       std::string_view,
                                       bool,
                                       Xapian::ReplicationInfo*)
@@ -1,7 +1,7 @@
 /** @file
  * @brief Empty database internals
  */
-/* Copyright 2017,2024 Olly Betts
+/* Copyright 2017,2024,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -98,7 +98,7 @@ class EmptyDatabase : public Xapian::Database::Internal {
 
     TermList* open_metadata_keylist(std::string_view prefix) const;
 
-    void write_changesets_to_fd(int fd,
+    void write_changesets_to_fd(RemoteConnection& conn,
                                 std::string_view start_revision,
                                 bool need_whole_db,
                                 Xapian::ReplicationInfo* info);
@@ -5,6 +5,7 @@ if BUILD_BACKEND_GLASS
 noinst_HEADERS +=\
 	backends/glass/glass_alldocspostlist.h\
 	backends/glass/glass_alltermslist.h\
+	backends/glass/glass_bulkload.h\
 	backends/glass/glass_changes.h\
 	backends/glass/glass_check.h\
 	backends/glass/glass_cursor.h\
@@ -34,6 +35,7 @@ noinst_HEADERS +=\
 lib_src +=\
 	backends/glass/glass_alldocspostlist.cc\
 	backends/glass/glass_alltermslist.cc\
+	backends/glass/glass_bulkload.cc\
 	backends/glass/glass_changes.cc\
 	backends/glass/glass_check.cc\
 	backends/glass/glass_compact.cc\
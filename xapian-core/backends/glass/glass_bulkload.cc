@@ -0,0 +1,566 @@
+/** @file
+ * @brief Buffer changes for bulk loading as sorted runs on disk.
+ */
+/* Copyright (C) 2026 Olly Betts
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "glass_bulkload.h"
+
+#include "glass_inverter.h"
+#include "glass_positionlist.h"
+#include "glass_postlist.h"
+
+#include "io_utils.h"
+#include "omassert.h"
+#include "pack.h"
+#include "parallel.h"
+#include "safedirent.h"
+#include "str.h"
+#include "stringutils.h"
+#include "xapian/error.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/** Merge runs when there are this many of the same level.
+ *
+ *  Each run being merged needs a file descriptor and a read buffer.
+ */
+static constexpr size_t MERGE_FANIN = 32;
+
+/// How much to read from a run at once.
+static constexpr size_t READ_SIZE = 65536;
+
+/// Write buffered data to a run once it reaches this size.
+static constexpr size_t WRITE_SIZE = 65536;
+
+/// How many document lengths to pass to the postlist table at once.
+static constexpr size_t DOCLEN_BATCH = 10000;
+
+namespace {
+
+/** Write changes to a run.
+ *
+ *  Each record is stored prefixed by its length.  The records in each section
+ *  must be passed in ascending key order.
+ */
+class RunWriter : public Glass::ChangesSink {
+    int fd;
+
+    off_t* section;
+
+    /// The section we're currently writing.
+    unsigned cur = 0;
+
+    /// Offset in the file to write the buffered data at.
+    off_t offset = 0;
+
+    std::string buf;
+
+    /// The last docid written in the doclength section.
+    Xapian::docid last_did = 0;
+
+    std::string rec;
+
+    void flush_buf() {
+        io_pwrite(fd, buf.data(), buf.size(), offset);
+        offset += buf.size();
+        buf.resize(0);
+    }
+
+    void add_record() {
+        pack_uint(buf, rec.size());
+        buf += rec;
+        if (buf.size() >= WRITE_SIZE) flush_buf();
+    }
+
+    /// Start section @a s, recording where any sections skipped over end.
+    void start_section(unsigned s) {
+        AssertRel(s, >=, cur);
+        while (cur < s) {
+            section[++cur] = offset + buf.size();
+        }
+    }
+
+  public:
+    RunWriter(int fd_, off_t* section_) : fd(fd_), section(section_) {
+        section[0] = 0;
+    }
+
+    void doclength(Xapian::docid did, Xapian::termcount doclen) {
+        start_section(0);
+        AssertRel(did, >, last_did);
+        rec.resize(0);
+        pack_uint(rec, did - last_did);
+        pack_uint(rec, doclen);
+        add_record();
+        last_did = did;
+    }
+
+    void postlist(const std::string& term,
+                  const Inverter::PostingChanges& changes) {
+        start_section(1);
+        rec.resize(0);
+        pack_string(rec, term);
+        pack_uint(rec, changes.get_tfdelta());
+        pack_uint(rec, changes.get_cfdelta());
+        const auto& pl_changes = changes.get_changes();
+        // Iterate first as that removes any superseded entries.
+        auto i = pl_changes.begin();
+        pack_uint(rec, pl_changes.size());
+        Xapian::docid prev_did = 0;
+        for ( ; i != pl_changes.end(); ++i) {
+            pack_uint(rec, i->first - prev_did);
+            pack_uint(rec, i->second);
+            prev_did = i->first;
+        }
+        add_record();
+    }
+
+    void positionlists(const std::string& term,
+                       const DocidChanges<std::string>& changes) {
+        start_section(2);
+        rec.resize(0);
+        pack_string(rec, term);
+        auto i = changes.begin();
+        pack_uint(rec, changes.size());
+        Xapian::docid prev_did = 0;
+        for ( ; i != changes.end(); ++i) {
+            pack_uint(rec, i->first - prev_did);
+            pack_string(rec, i->second);
+            prev_did = i->first;
+        }
+        add_record();
+    }
+
+    /// Write any buffered data and record the section offsets.
+    void finish() {
+        start_section(3);
+        flush_buf();
+    }
+};
+
+/// Read the records from one section of a run.
+class RunReader {
+    int fd;
+
+    /// Offset of the next data to read from the file.
+    off_t pos;
+
+    /// Offset of the end of the section.
+    off_t end;
+
+    std::string buf;
+
+    size_t buf_pos = 0;
+
+    /// Try to ensure at least @a n bytes are buffered.
+    void fill(size_t n) {
+        size_t avail = buf.size() - buf_pos;
+        if (avail >= n) return;
+        buf.erase(0, buf_pos);
+        buf_pos = 0;
+        size_t want = min(max(n - avail, READ_SIZE), size_t(end - pos));
+        if (want == 0) return;
+        buf.resize(avail + want);
+        io_pread(fd, &buf[avail], want, pos, want);
+        pos += want;
+    }
+
+    [[noreturn]]
+    static void corrupt() {
+        throw Xapian::DatabaseCorruptError("Bulk load temporary file "
+                                           "corrupt");
+    }
+
+  public:
+    RunReader(int fd_, off_t start, off_t end_)
+        : fd(fd_), pos(start), end(end_) { }
+
+    /// Read the next record into @a rec, returning false at the end.
+    bool next(std::string& rec) {
+        if (buf_pos == buf.size() && pos == end) return false;
+        // Enough for any encoded length.
+        fill(10);
+        const char* p = buf.data() + buf_pos;
+        size_t len;
+        if (!unpack_uint(&p, buf.data() + buf.size(), &len)) corrupt();
+        buf_pos = p - buf.data();
+        fill(len);
+        if (buf.size() - buf_pos < len) corrupt();
+        rec.assign(buf, buf_pos, len);
+        buf_pos += len;
+        return true;
+    }
+};
+
+/// Position in one run during a merge.
+template<typename K>
+struct Cursor {
+    RunReader reader;
+
+    std::string rec;
+
+    /// Position of the data after the key in @a rec.
+    const char* p;
+
+    const char* end;
+
+    K key;
+
+    Cursor(int fd, off_t start, off_t end_) : reader(fd, start, end_) { }
+};
+
+static void
+read_key(const char** p, const char* end, Xapian::docid& did)
+{
+    if (!unpack_uint(p, end, &did)) unpack_throw_serialisation_error(*p);
+}
+
+static void
+read_key(const char** p, const char* end, std::string& term)
+{
+    if (!unpack_string(p, end, term)) unpack_throw_serialisation_error(*p);
+}
+
+/** Merge one section of a set of runs.
+ *
+ *  @a emit is called with each key in ascending order, and the cursors for
+ *  the runs containing that key in ascending run order (so changes from later
+ *  cursors should override those from earlier ones).
+ *
+ *  If @a delta_keys is true then each key in a run is stored as the
+ *  difference from the previous one.
+ */
+template<typename K, typename F>
+static void
+merge_section(std::vector<Cursor<K>>& cursors, bool delta_keys, F emit)
+{
+    auto advance = [&](Cursor<K>& c) {
+        if (!c.reader.next(c.rec)) return false;
+        c.p = c.rec.data();
+        c.end = c.p + c.rec.size();
+        if (delta_keys) {
+            K prev = c.key;
+            read_key(&c.p, c.end, c.key);
+            c.key += prev;
+        } else {
+            read_key(&c.p, c.end, c.key);
+        }
+        return true;
+    };
+
+    // The heap is a max-heap so the comparison is reversed to get the
+    // smallest key (and the earliest run for equal keys) at the top.
+    auto cmp = [&](size_t a, size_t b) {
+        if (cursors[a].key != cursors[b].key)
+            return cursors[b].key < cursors[a].key;
+        return b < a;
+    };
+    std::vector<size_t> heap;
+    for (size_t i = 0; i != cursors.size(); ++i) {
+        if (advance(cursors[i])) heap.push_back(i);
+    }
+    make_heap(heap.begin(), heap.end(), cmp);
+
+    std::vector<Cursor<K>*> group;
+    std::vector<size_t> group_idx;
+    while (!heap.empty()) {
+        group.clear();
+        group_idx.clear();
+        do {
+            pop_heap(heap.begin(), heap.end(), cmp);
+            group_idx.push_back(heap.back());
+            group.push_back(&cursors[heap.back()]);
+            heap.pop_back();
+        } while (!heap.empty() &&
+                 cursors[heap.front()].key == group[0]->key);
+        emit(group[0]->key, group);
+        for (size_t i : group_idx) {
+            if (advance(cursors[i])) {
+                heap.push_back(i);
+                push_heap(heap.begin(), heap.end(), cmp);
+            }
+        }
+    }
+}
+
+/// Write changes to the postlist and position tables.
+class TableSink : public Glass::ChangesSink {
+    GlassPostListTable& postlist_table;
+
+    GlassPositionListTable& position_table;
+
+    DocidChanges<Xapian::termcount> doclens;
+
+  public:
+    TableSink(GlassPostListTable& postlist_table_,
+              GlassPositionListTable& position_table_)
+        : postlist_table(postlist_table_), position_table(position_table_) { }
+
+    void flush_doclens() {
+        if (doclens.empty()) return;
+        postlist_table.merge_doclen_changes(doclens);
+        doclens.clear();
+    }
+
+    void doclength(Xapian::docid did, Xapian::termcount doclen) {
+        doclens.set(did, doclen);
+        if (doclens.size() >= DOCLEN_BATCH) flush_doclens();
+    }
+
+    void postlist(const std::string& term,
+                  const Inverter::PostingChanges& changes) {
+        // The document lengths are stored under the empty term, so they sort
+        // first.
+        flush_doclens();
+        postlist_table.merge_changes(term, changes);
+    }
+
+    void positionlists(const std::string& term,
+                       const DocidChanges<std::string>& changes) {
+        for (auto&& i : changes) {
+            if (i.second.empty()) {
+                position_table.delete_positionlist(i.first, term);
+            } else {
+                position_table.set_positionlist(i.first, term, i.second);
+            }
+        }
+    }
+};
+
+}
+
+GlassBulkLoader::Run
+GlassBulkLoader::create_run(unsigned level)
+{
+    Run run;
+    run.path = dir;
+    run.path += "/bulk";
+    run.path += str(run_counter++);
+    run.path += ".tmp";
+    run.fd = io_open_block_wr(run.path, true);
+    if (run.fd < 0) {
+        string msg = "Couldn't create temporary file for bulk load: ";
+        msg += run.path;
+        throw Xapian::DatabaseError(msg, errno);
+    }
+    run.level = level;
+    return run;
+}
+
+static void
+discard_run(int fd, const std::string& path)
+{
+    (void)::close(fd);
+    (void)io_unlink(path);
+}
+
+void
+GlassBulkLoader::merge(size_t first, size_t first_section,
+                       size_t end_section, Glass::ChangesSink& sink)
+{
+    for (size_t s = first_section; s != end_section; ++s) {
+        if (s == 0) {
+            vector<Cursor<Xapian::docid>> cursors;
+            for (size_t i = first; i != runs.size(); ++i) {
+                const Run& run = runs[i];
+                cursors.emplace_back(run.fd, run.section[0], run.section[1]);
+                cursors.back().key = 0;
+            }
+            merge_section(cursors, true, [&](Xapian::docid did, auto& group) {
+                // The most recent change for a docid wins.
+                auto c = group.back();
+                Xapian::termcount doclen;
+                if (!unpack_uint(&c->p, c->end, &doclen))
+                    unpack_throw_serialisation_error(c->p);
+                sink.doclength(did, doclen);
+            });
+            continue;
+        }
+
+        vector<Cursor<string>> cursors;
+        for (size_t i = first; i != runs.size(); ++i) {
+            const Run& run = runs[i];
+            cursors.emplace_back(run.fd, run.section[s], run.section[s + 1]);
+        }
+        if (s == 1) {
+            merge_section(cursors, false, [&](const string& term, auto& group) {
+                Inverter::PostingChanges changes;
+                for (auto c : group) {
+                    Xapian::termcount tf, cf;
+                    size_t n;
+                    if (!unpack_uint(&c->p, c->end, &tf) ||
+                        !unpack_uint(&c->p, c->end, &cf) ||
+                        !unpack_uint(&c->p, c->end, &n)) {
+                        unpack_throw_serialisation_error(c->p);
+                    }
+                    changes.add_deltas(tf, cf);
+                    Xapian::docid did = 0;
+                    while (n--) {
+                        Xapian::docid delta;
+                        Xapian::termcount wdf;
+                        if (!unpack_uint(&c->p, c->end, &delta) ||
+                            !unpack_uint(&c->p, c->end, &wdf)) {
+                            unpack_throw_serialisation_error(c->p);
+                        }
+                        did += delta;
+                        changes.set_wdf(did, wdf);
+                    }
+                }
+                sink.postlist(term, changes);
+            });
+        } else {
+            merge_section(cursors, false, [&](const string& term, auto& group) {
+                DocidChanges<string> changes;
+                string data;
+                for (auto c : group) {
+                    size_t n;
+                    if (!unpack_uint(&c->p, c->end, &n))
+                        unpack_throw_serialisation_error(c->p);
+                    Xapian::docid did = 0;
+                    while (n--) {
+                        Xapian::docid delta;
+                        if (!unpack_uint(&c->p, c->end, &delta) ||
+                            !unpack_string(&c->p, c->end, data)) {
+                            unpack_throw_serialisation_error(c->p);
+                        }
+                        did += delta;
+                        changes.set(did, std::move(data));
+                    }
+                }
+                sink.positionlists(term, changes);
+            });
+        }
+    }
+}
+
+void
+GlassBulkLoader::merge_to_run(size_t first)
+{
+    Run run = create_run(runs[first].level + 1);
+    try {
+        RunWriter writer(run.fd, run.section);
+        merge(first, 0, 3, writer);
+        writer.finish();
+    } catch (...) {
+        discard_run(run.fd, run.path);
+        throw;
+    }
+    for (size_t i = first; i != runs.size(); ++i) {
+        discard_run(runs[i].fd, runs[i].path);
+    }
+    runs.resize(first);
+    runs.push_back(std::move(run));
+}
+
+void
+GlassBulkLoader::spill(Inverter& inverter)
+{
+    Run run = create_run(0);
+    try {
+        RunWriter writer(run.fd, run.section);
+        inverter.flush_to(writer);
+        writer.finish();
+    } catch (...) {
+        discard_run(run.fd, run.path);
+        throw;
+    }
+    runs.push_back(std::move(run));
+
+    // Merge runs of the same level until we have fewer than MERGE_FANIN of
+    // each level.
+    while (runs.size() >= MERGE_FANIN) {
+        size_t first = runs.size() - MERGE_FANIN;
+        if (runs[first].level != runs.back().level) break;
+        merge_to_run(first);
+    }
+}
+
+void
+GlassBulkLoader::merge_into(GlassPostListTable& postlist_table,
+                            GlassPositionListTable& position_table,
+                            unsigned max_threads)
+{
+    bool postlist_empty = false, position_empty = false;
+    try {
+        // If the tables are empty then there's nothing to interleave the
+        // new entries with, so we can fill the blocks fully as we're adding
+        // in key order.
+        postlist_empty = (postlist_table.get_entry_count() == 0);
+        position_empty = (position_table.get_entry_count() == 0);
+        if (postlist_empty) postlist_table.set_full_compaction(true);
+        if (position_empty) position_table.set_full_compaction(true);
+
+        TableSink sink(postlist_table, position_table);
+        // The doclength and postlist sections go to the postlist table and
+        // the position section to the position table, so these can be merged
+        // in parallel.
+        run_parallel({
+                [&]() {
+                    merge(0, 0, 2, sink);
+                    sink.flush_doclens();
+                },
+                [&]() { merge(0, 2, 3, sink); }
+            }, max_threads);
+    } catch (...) {
+        if (postlist_empty) postlist_table.set_full_compaction(false);
+        if (position_empty) position_table.set_full_compaction(false);
+        clear();
+        throw;
+    }
+    if (postlist_empty) postlist_table.set_full_compaction(false);
+    if (position_empty) position_table.set_full_compaction(false);
+    clear();
+}
+
+void
+GlassBulkLoader::clear()
+{
+    for (auto&& run : runs) {
+        discard_run(run.fd, run.path);
+    }
+    runs.clear();
+}
+
+void
+GlassBulkLoader::remove_stale_runs(const string& dir_)
+{
+    DIR* d = opendir(dir_.c_str());
+    if (!d) return;
+    while (struct dirent* entry = readdir(d)) {
+        string_view name = entry->d_name;
+        // Only remove files named like those create_run() makes.
+        if (!startswith(name, "bulk") || !endswith(name, ".tmp")) continue;
+        string_view digits = name.substr(4, name.size() - 8);
+        if (digits.empty() ||
+            digits.find_first_not_of("0123456789") != string_view::npos) {
+            continue;
+        }
+        string path = dir_;
+        path += '/';
+        path += name;
+        (void)io_unlink(path);
+    }
+    closedir(d);
+}
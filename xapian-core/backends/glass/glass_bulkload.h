@@ -0,0 +1,129 @@
+/** @file
+ * @brief Buffer changes for bulk loading as sorted runs on disk.
+ */
+/* Copyright (C) 2026 Olly Betts
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef XAPIAN_INCLUDED_GLASS_BULKLOAD_H
+#define XAPIAN_INCLUDED_GLASS_BULKLOAD_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "safeunistd.h" // For off_t.
+
+class GlassPostListTable;
+class GlassPositionListTable;
+class Inverter;
+
+namespace Glass {
+class ChangesSink;
+}
+
+/** Buffer changes for bulk loading as sorted runs on disk.
+ *
+ *  When bulk loading, rather than merging the Inverter's buffered changes
+ *  into the postlist and position tables each time the flush threshold is
+ *  reached, we write them to a temporary file as a sorted "run".  When the
+ *  changes are committed, the runs are merged and the result is written to
+ *  the tables in key order, so the B-tree blocks get filled sequentially.
+ *
+ *  To limit the number of files open at once, when there are MERGE_FANIN
+ *  runs of the same level they are merged into a single run of the next
+ *  level up.
+ */
+class GlassBulkLoader {
+    /// A sorted run on disk.
+    struct Run {
+        /// File descriptor.
+        int fd;
+
+        /// Path of the temporary file.
+        std::string path;
+
+        /** Offsets of the doclength, postlist and position sections.
+         *
+         *  The final entry is the offset of the end of the run.
+         */
+        off_t section[4];
+
+        /** The level of this run.
+         *
+         *  A run written from the Inverter is level 0, and merging runs of
+         *  level N produces a run of level N + 1.
+         */
+        unsigned level;
+    };
+
+    /// The directory to create temporary files in.
+    std::string dir;
+
+    /// Used to give each temporary file a unique name.
+    unsigned run_counter = 0;
+
+    /// The runs, oldest first.
+    std::vector<Run> runs;
+
+    /// Open a new temporary file for a run.
+    Run create_run(unsigned level);
+
+    /** Merge runs from @a first onwards, passing the results to @a sink.
+     *
+     *  Only sections @a first_section to @a end_section - 1 are merged
+     *  (0: document lengths, 1: postlists, 2: positions).
+     */
+    void merge(size_t first, size_t first_section, size_t end_section,
+               Glass::ChangesSink& sink);
+
+    /// Merge runs from @a first onwards into a single new run.
+    void merge_to_run(size_t first);
+
+  public:
+    explicit GlassBulkLoader(std::string_view dir_) : dir(dir_) { }
+
+    ~GlassBulkLoader() { clear(); }
+
+    /// Are there any runs?
+    bool empty() const { return runs.empty(); }
+
+    /// Write the changes buffered by @a inverter as a new run.
+    void spill(Inverter& inverter);
+
+    /** Merge all the runs into the tables.
+     *
+     *  The runs are discarded afterwards (even if an exception is thrown).
+     *
+     *  @param max_threads  Maximum number of threads to use (the two tables
+     *                      can be updated in parallel).
+     */
+    void merge_into(GlassPostListTable& postlist_table,
+                    GlassPositionListTable& position_table,
+                    unsigned max_threads);
+
+    /// Discard all the runs.
+    void clear();
+
+    /** Remove any run files left in @a dir_.
+     *
+     *  These can be left behind if a process bulk loading is killed.  Must
+     *  only be called while holding the database's write lock.
+     */
+    static void remove_stale_runs(const std::string& dir_);
+};
+
+#endif // XAPIAN_INCLUDED_GLASS_BULKLOAD_H
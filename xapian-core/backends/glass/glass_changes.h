@@ -57,6 +57,9 @@ class GlassChanges {
                          glass_revision_number_t rev,
                          int flags);
 
+    /// Are we currently writing a changeset?
+    bool is_active() const { return changes_fd >= 0; }
+
     void write_block(const char * p, size_t len);
 
     void write_block(const std::string & s) {
@@ -26,6 +26,7 @@
 #include "xapian/types.h"
 
 #include <algorithm>
+#include <functional>
 #include <iterator>
 #include <memory>
 #include <queue>
@@ -41,6 +42,7 @@
 #include "filetests.h"
 #include "internaltypes.h"
 #include "pack.h"
+#include "parallel.h"
 #include "backends/valuestats.h"
 
 #include "../byte_length_strings.h"
@@ -597,7 +599,8 @@ static void
 multimerge_postlists(Xapian::Compactor * compactor,
                      GlassTable * out, const char * tmpdir,
                      vector<const GlassTable *> tmp,
-                     vector<Xapian::docid> off)
+                     vector<Xapian::docid> off,
+                     unsigned threads)
 {
     unsigned int c = 0;
     while (tmp.size() > 3) {
@@ -605,6 +608,8 @@ multimerge_postlists(Xapian::Compactor * compactor,
         tmpout.reserve(tmp.size() / 2);
         vector<Xapian::docid> newoff;
         newoff.resize(tmp.size() / 2);
+        // The merges in each pass are independent, so can be run in parallel.
+        vector<function<void()>> tasks;
         for (unsigned int i = 0, j; i < tmp.size(); i = j) {
             j = i + 2;
             if (j == tmp.size() - 1) ++j;
@@ -617,30 +622,33 @@ multimerge_postlists(Xapian::Compactor * compactor,
             dest += '.';
 
             GlassTable * tmptab = new GlassTable("postlist", dest, false);
+            tmpout.push_back(tmptab);
 
-            // Use maximum blocksize for temporary tables.  And don't compress
-            // entries in temporary tables, even if the final table would do
-            // so.  Any already compressed entries will get copied in
-            // compressed form.
-            RootInfo root_info;
-            root_info.init(65536, 0);
-            const int flags = Xapian::DB_DANGEROUS|Xapian::DB_NO_SYNC;
-            tmptab->create_and_open(flags, root_info);
-
-            merge_postlists(compactor, tmptab, off.begin() + i,
-                            tmp.begin() + i, tmp.begin() + j);
-            if (c > 0) {
-                for (unsigned int k = i; k < j; ++k) {
-                    unlink(tmp[k]->get_path().c_str());
-                    delete tmp[k];
-                    tmp[k] = NULL;
+            tasks.emplace_back([&, i, j, tmptab]() {
+                // Use maximum blocksize for temporary tables.  And don't
+                // compress entries in temporary tables, even if the final
+                // table would do so.  Any already compressed entries will get
+                // copied in compressed form.
+                RootInfo root_info;
+                root_info.init(65536, 0);
+                const int flags = Xapian::DB_DANGEROUS|Xapian::DB_NO_SYNC;
+                tmptab->create_and_open(flags, root_info);
+
+                merge_postlists(compactor, tmptab, off.begin() + i,
+                                tmp.begin() + i, tmp.begin() + j);
+                if (c > 0) {
+                    for (unsigned int k = i; k < j; ++k) {
+                        unlink(tmp[k]->get_path().c_str());
+                        delete tmp[k];
+                        tmp[k] = NULL;
+                    }
                 }
-            }
-            tmpout.push_back(tmptab);
-            tmptab->flush_db();
-            tmptab->commit(1, &root_info);
-            AssertRel(root_info.get_blocksize(),==,65536);
+                tmptab->flush_db();
+                tmptab->commit(1, &root_info);
+                AssertRel(root_info.get_blocksize(),==,65536);
+            });
         }
+        run_parallel(tasks, threads);
         swap(tmp, tmpout);
         swap(off, newoff);
         ++c;
@@ -859,6 +867,17 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
     for (size_t i = 0; i != sources.size(); ++i) {
         auto db = static_cast<const GlassDatabase*>(sources[i]);
         version_file_out->merge_stats(db->version_file);
+        // Compressed tags get copied as they are, so if an input table uses
+        // a codec other than zlib, use it for the output table too.  That
+        // way the output is marked as needing a format version which
+        // understands that codec.
+        for (unsigned t = 0; t != Glass::MAX_; ++t) {
+            auto type = Glass::table_type(t);
+            auto c = db->version_file.get_root(type).get_compression();
+            if (c != Compression::ZLIB) {
+                version_file_out->root_to_set(type)->set_compression(c);
+            }
+        }
     }
 
     string fl_serialised;
@@ -868,8 +887,16 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
         fl.pack(fl_serialised);
     }
 
-    vector<GlassTable *> tabs;
-    tabs.reserve(tables_end - tables);
+    unsigned threads = compactor ? compactor->get_threads() : 1;
+    if (single_file) {
+        // The tables are written one after another to the same file.
+        threads = 1;
+    }
+
+    // The merge for each table is done by a separate task, and the tables
+    // are independent so the tasks can be run in parallel.
+    vector<function<void()>> tasks;
+    vector<unique_ptr<GlassTable>> tabs(tables_end - tables);
     file_size_type prev_size = block_size;
     for (const table_list * t = tables; t < tables_end; ++t) {
         // The postlist table requires an N-way merge, adjusting the
@@ -977,114 +1004,120 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
             continue;
         }
 
-        GlassTable * out;
-        if (single_file) {
-            out = new GlassTable(t->name, fd, version_file_out->get_offset(),
-                                 false, false);
-        } else {
-            out = new GlassTable(t->name, dest, false, t->lazy);
-        }
-        tabs.push_back(out);
         RootInfo * root_info = version_file_out->root_to_set(t->type);
-        if (single_file) {
-            root_info->set_free_list(fl_serialised);
-            out->open(FLAGS, version_file_out->get_root(t->type), version_file_out->get_revision());
-        } else {
-            out->create_and_open(FLAGS, *root_info);
-        }
+        tasks.emplace_back([&, t, dest, inputs, in_size, bad_stat,
+                            single_file_in, root_info]() mutable {
+            GlassTable * out;
+            if (single_file) {
+                out = new GlassTable(t->name, fd,
+                                     version_file_out->get_offset(),
+                                     false, false);
+            } else {
+                out = new GlassTable(t->name, dest, false, t->lazy);
+            }
+            tabs[t - tables].reset(out);
+            if (single_file) {
+                root_info->set_free_list(fl_serialised);
+                out->open(FLAGS, version_file_out->get_root(t->type), version_file_out->get_revision());
+            } else {
+                out->create_and_open(FLAGS, *root_info);
+            }
 
-        out->set_full_compaction(compaction != compactor->STANDARD);
+            out->set_full_compaction(compaction != compactor->STANDARD);
 
-        switch (t->type) {
-            case Glass::POSTLIST: {
-                if (multipass && inputs.size() > 3) {
-                    multimerge_postlists(compactor, out, destdir,
-                                         inputs, offset);
-                } else {
-                    merge_postlists(compactor, out, offset.begin(),
-                                    inputs.begin(), inputs.end());
+            switch (t->type) {
+                case Glass::POSTLIST: {
+                    if (multipass && inputs.size() > 3) {
+                        multimerge_postlists(compactor, out, destdir,
+                                             inputs, offset, threads);
+                    } else {
+                        merge_postlists(compactor, out, offset.begin(),
+                                        inputs.begin(), inputs.end());
+                    }
+                    break;
                 }
-                break;
+                case Glass::SPELLING:
+                    merge_spellings(out, inputs.begin(), inputs.end());
+                    break;
+                case Glass::SYNONYM:
+                    merge_synonyms(out, inputs.begin(), inputs.end());
+                    break;
+                case Glass::POSITION:
+                    merge_positions(out, inputs, offset);
+                    break;
+                default:
+                    // DocData, Termlist
+                    merge_docid_keyed(out, inputs, offset);
+                    break;
             }
-            case Glass::SPELLING:
-                merge_spellings(out, inputs.begin(), inputs.end());
-                break;
-            case Glass::SYNONYM:
-                merge_synonyms(out, inputs.begin(), inputs.end());
-                break;
-            case Glass::POSITION:
-                merge_positions(out, inputs, offset);
-                break;
-            default:
-                // DocData, Termlist
-                merge_docid_keyed(out, inputs, offset);
-                break;
-        }
-
-        if (out->is_modified()) {
-            // Commit as revision 1.
-            out->flush_db();
-            out->commit(1, root_info);
-            out->sync();
-        }
-        if (single_file) fl_serialised = root_info->get_free_list();
 
-        file_size_type out_size = 0;
-        if (!bad_stat && !single_file_in) {
-            file_size_type db_size;
-            if (single_file) {
-                db_size = file_size(fd);
-            } else {
-                db_size = file_size(dest + GLASS_TABLE_EXTENSION);
+            if (out->is_modified()) {
+                // Commit as revision 1.
+                out->flush_db();
+                out->commit(1, root_info);
+                out->sync();
             }
-            if (errno == 0) {
+            if (single_file) fl_serialised = root_info->get_free_list();
+
+            file_size_type out_size = 0;
+            if (!bad_stat && !single_file_in) {
+                file_size_type db_size;
                 if (single_file) {
-                    auto old_prev_size = max(prev_size,
-                                             file_size_type(block_size));
-                    prev_size = db_size;
-                    db_size = max(db_size, file_size_type(block_size));
-                    db_size -= old_prev_size;
+                    db_size = file_size(fd);
+                } else {
+                    db_size = file_size(dest + GLASS_TABLE_EXTENSION);
+                }
+                if (errno == 0) {
+                    if (single_file) {
+                        auto old_prev_size = max(prev_size,
+                                                 file_size_type(block_size));
+                        prev_size = db_size;
+                        db_size = max(db_size, file_size_type(block_size));
+                        db_size -= old_prev_size;
+                    }
+                    out_size = db_size / 1024;
+                } else {
+                    bad_stat = (errno != ENOENT);
                 }
-                out_size = db_size / 1024;
-            } else {
-                bad_stat = (errno != ENOENT);
             }
-        }
-        if (bad_stat) {
-            if (compactor)
-                compactor->set_status(t->name, "Done (couldn't stat all the DB files)");
-        } else if (single_file_in) {
-            if (compactor)
-                compactor->set_status(t->name, "Done (table sizes unknown for single file DB input)");
-        } else {
-            string status;
-            if (out_size == in_size) {
-                status = "Size unchanged (";
+            if (bad_stat) {
+                if (compactor)
+                    compactor->set_status(t->name, "Done (couldn't stat all the DB files)");
+            } else if (single_file_in) {
+                if (compactor)
+                    compactor->set_status(t->name, "Done (table sizes unknown for single file DB input)");
             } else {
-                off_t delta;
-                if (out_size < in_size) {
-                    delta = in_size - out_size;
-                    status = "Reduced by ";
+                string status;
+                if (out_size == in_size) {
+                    status = "Size unchanged (";
                 } else {
-                    delta = out_size - in_size;
-                    status = "INCREASED by ";
-                }
-                if (in_size) {
-                    status += str(100 * delta / in_size);
-                    status += "% ";
+                    off_t delta;
+                    if (out_size < in_size) {
+                        delta = in_size - out_size;
+                        status = "Reduced by ";
+                    } else {
+                        delta = out_size - in_size;
+                        status = "INCREASED by ";
+                    }
+                    if (in_size) {
+                        status += str(100 * delta / in_size);
+                        status += "% ";
+                    }
+                    status += str(delta);
+                    status += "K (";
+                    status += str(in_size);
+                    status += "K -> ";
                 }
-                status += str(delta);
-                status += "K (";
-                status += str(in_size);
-                status += "K -> ";
+                status += str(out_size);
+                status += "K)";
+                if (compactor)
+                    compactor->set_status(t->name, status);
             }
-            status += str(out_size);
-            status += "K)";
-            if (compactor)
-                compactor->set_status(t->name, status);
-        }
+        });
     }
 
+    run_parallel(tasks, threads);
+
     // If compacting to a single file output and all the tables are empty, pad
     // the output so that it isn't mistaken for a stub database when we try to
     // open it.  For this it needs to be a multiple of 2KB in size.
@@ -1108,14 +1141,12 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
     }
     version_file_out->set_last_docid(last_docid);
     string tmpfile = version_file_out->write(1, FLAGS);
-    for (unsigned j = 0; j != tabs.size(); ++j) {
-        tabs[j]->sync();
+    for (auto&& tab : tabs) {
+        if (tab) tab->sync();
     }
     // Commit with revision 1.
     version_file_out->sync(tmpfile, 1, FLAGS);
-    for (unsigned j = 0; j != tabs.size(); ++j) {
-        delete tabs[j];
-    }
+    tabs.clear();
 
     if (!single_file) lock.release();
 }
@@ -4,7 +4,7 @@
 /* Copyright 1999,2000,2001 BrightStation PLC
  * Copyright 2001 Hein Ragas
  * Copyright 2002 Ananova Ltd
- * Copyright 2002-2024 Olly Betts
+ * Copyright 2002-2026 Olly Betts
  * Copyright 2006,2008 Lemur Consulting Ltd
  * Copyright 2009 Richard Boulton
  * Copyright 2009 Kan-Ru Chen
@@ -53,6 +53,7 @@
 #include "filetests.h"
 #include "io_utils.h"
 #include "pack.h"
+#include "parallel.h"
 #include "parseint.h"
 #include "net/remoteconnection.h"
 #include "api/replication.h"
@@ -68,8 +69,10 @@
 #include <algorithm>
 #include <cerrno>
 #include <cstdlib>
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 using namespace std;
 using namespace Xapian;
@@ -91,6 +94,36 @@ using Xapian::Internal::intrusive_ptr;
 // byte in the term).
 #define MAX_SAFE_TERM_LENGTH 245
 
+/// Determine the codec to compress tags with from the DB_COMPRESS_* flags.
+static Compression::codec
+compression_from_flags(int flags)
+{
+    Compression::codec compression;
+    const char* name;
+    switch (flags & Xapian::DB_COMPRESS_MASK_) {
+        case 0:
+            return Compression::ZLIB;
+        case Xapian::DB_COMPRESS_LZ4:
+            compression = Compression::LZ4;
+            name = "LZ4";
+            break;
+        case Xapian::DB_COMPRESS_ZSTD:
+            compression = Compression::ZSTD;
+            name = "Zstandard";
+            break;
+        default:
+            throw Xapian::InvalidArgumentError("DB_COMPRESS_LZ4 and "
+                                               "DB_COMPRESS_ZSTD are mutually "
+                                               "exclusive");
+    }
+    if (!Compression::codec_available(compression)) {
+        string msg = name;
+        msg += " compression support not enabled";
+        throw Xapian::FeatureUnavailableError(msg);
+    }
+    return compression;
+}
+
 /* This opens the tables, determining the current and next revision numbers,
  * and stores handles to the tables.
  */
@@ -131,6 +164,9 @@ GlassDatabase::GlassDatabase(string_view glass_dir, int flags,
 
     int action = flags & Xapian::DB_ACTION_MASK_;
     if (action != Xapian::DB_OPEN && !database_exists()) {
+        // Check the flags before we create anything.
+        auto compression = compression_from_flags(flags);
+
         // Create the directory for the database, if it doesn't exist
         // already.
         if (mkdir(db_dir.c_str(), 0755) < 0) {
@@ -143,7 +179,7 @@ GlassDatabase::GlassDatabase(string_view glass_dir, int flags,
 
         get_database_write_lock(flags, true);
 
-        create_and_open_tables(flags, block_size);
+        create_and_open_tables(flags, block_size, compression);
         return;
     }
 
@@ -156,7 +192,8 @@ GlassDatabase::GlassDatabase(string_view glass_dir, int flags,
     get_database_write_lock(flags, false);
     // if we're overwriting, pretend the db doesn't exist
     if (action == Xapian::DB_CREATE_OR_OVERWRITE) {
-        create_and_open_tables(flags, block_size);
+        create_and_open_tables(flags, block_size,
+                               compression_from_flags(flags));
         return;
     }
 
@@ -196,14 +233,15 @@ GlassDatabase::database_exists() {
 }
 
 void
-GlassDatabase::create_and_open_tables(int flags, unsigned int block_size)
+GlassDatabase::create_and_open_tables(int flags, unsigned int block_size,
+                                      Compression::codec compression)
 {
-    LOGCALL_VOID(DB, "GlassDatabase::create_and_open_tables", flags|block_size);
+    LOGCALL_VOID(DB, "GlassDatabase::create_and_open_tables", flags|block_size|int(compression));
     // The caller is expected to create the database directory if it doesn't
     // already exist.
 
     GlassVersion &v = version_file;
-    v.create(block_size);
+    v.create(block_size, compression);
 
     glass_revision_number_t rev = v.get_revision();
     const string& tmpfile = v.write(rev, flags);
@@ -259,6 +297,9 @@ GlassDatabase::open_tables(int flags)
 
     value_manager.reset();
 
+    // Any cached document lengths are for the old revision.
+    doclen_cache.reset();
+
     if (!readonly) {
         changes.set_oldest_changeset(version_file.get_oldest_changeset());
         glass_revision_number_t revision = version_file.get_revision();
@@ -340,30 +381,57 @@ GlassDatabase::set_revision_number(int flags, glass_revision_number_t new_revisi
         throw Xapian::DatabaseError(m);
     }
 
+    // This updates the postlist and termlist tables so has to happen first.
     value_manager.merge_changes();
 
-    postlist_table.flush_db();
-    position_table.flush_db();
-    termlist_table.flush_db();
-    synonym_table.flush_db();
-    version_file.set_spelling_wordfreq_upper_bound(spelling_table.flush_db());
-    docdata_table.flush_db();
-
-    postlist_table.commit(new_revision, version_file.root_to_set(Glass::POSTLIST));
-    position_table.commit(new_revision, version_file.root_to_set(Glass::POSITION));
-    termlist_table.commit(new_revision, version_file.root_to_set(Glass::TERMLIST));
-    synonym_table.commit(new_revision, version_file.root_to_set(Glass::SYNONYM));
-    spelling_table.commit(new_revision, version_file.root_to_set(Glass::SPELLING));
-    docdata_table.commit(new_revision, version_file.root_to_set(Glass::DOCDATA));
+    Xapian::termcount spelling_wfub = 0;
+    int sync_errno[Glass::MAX_] = {};
+    auto commit_table = [&](GlassTable& table, Glass::table_type type) {
+        table.commit(new_revision, version_file.root_to_set(type));
+        if (!table.sync()) sync_errno[type] = errno ? errno : EIO;
+    };
+
+    // The tables are in separate files so can be flushed, committed and
+    // synced in parallel.  The version file is written once they're all done
+    // and is what makes the new revision visible.
+    vector<function<void()>> tasks = {
+        [&]() {
+            postlist_table.flush_db();
+            commit_table(postlist_table, Glass::POSTLIST);
+        },
+        [&]() {
+            position_table.flush_db();
+            commit_table(position_table, Glass::POSITION);
+        },
+        [&]() {
+            termlist_table.flush_db();
+            commit_table(termlist_table, Glass::TERMLIST);
+        },
+        [&]() {
+            synonym_table.flush_db();
+            commit_table(synonym_table, Glass::SYNONYM);
+        },
+        [&]() {
+            spelling_wfub = spelling_table.flush_db();
+            commit_table(spelling_table, Glass::SPELLING);
+        },
+        [&]() {
+            docdata_table.flush_db();
+            commit_table(docdata_table, Glass::DOCDATA);
+        }
+    };
+    // This is I/O bound so use a thread per table regardless of the number
+    // of CPUs.
+    run_parallel(tasks, can_write_tables_in_parallel() ? tasks.size() : 1);
+    version_file.set_spelling_wordfreq_upper_bound(spelling_wfub);
+
+    for (int saved_errno : sync_errno) {
+        if (saved_errno)
+            throw Xapian::DatabaseError("Commit failed", saved_errno);
+    }
 
     const string & tmpfile = version_file.write(new_revision, flags);
-    if (!postlist_table.sync() ||
-        !position_table.sync() ||
-        !termlist_table.sync() ||
-        !synonym_table.sync() ||
-        !spelling_table.sync() ||
-        !docdata_table.sync() ||
-        !version_file.sync(tmpfile, new_revision, flags)) {
+    if (!version_file.sync(tmpfile, new_revision, flags)) {
         int saved_errno = errno;
         (void)unlink(tmpfile.c_str());
         throw Xapian::DatabaseError("Commit failed", saved_errno);
@@ -401,6 +469,7 @@ void
 GlassDatabase::close()
 {
     LOGCALL_VOID(DB, "GlassDatabase::close", NO_ARGS);
+    doclen_cache.reset();
     postlist_table.close(true);
     position_table.close(true);
     termlist_table.close(true);
@@ -472,12 +541,12 @@ GlassDatabase::send_whole_database(RemoteConnection & conn, double end_time)
 }
 
 void
-GlassDatabase::write_changesets_to_fd(int fd,
+GlassDatabase::write_changesets_to_fd(RemoteConnection& conn,
                                       string_view revision,
                                       bool need_whole_db,
                                       ReplicationInfo * info)
 {
-    LOGCALL_VOID(DB, "GlassDatabase::write_changesets_to_fd", fd | revision | need_whole_db | info);
+    LOGCALL_VOID(DB, "GlassDatabase::write_changesets_to_fd", conn | revision | need_whole_db | info);
 #ifdef XAPIAN_HAS_REMOTE_BACKEND
     int whole_db_copies_left = MAX_DB_COPIES_PER_CONVERSATION;
     glass_revision_number_t start_rev_num = 0;
@@ -491,8 +560,6 @@ GlassDatabase::write_changesets_to_fd(int fd,
         need_whole_db = true;
     }
 
-    RemoteConnection conn(-1, fd, string());
-
     // While the starting revision number is less than the latest revision
     // number, look for a changeset, and write it.
     //
@@ -595,7 +662,7 @@ GlassDatabase::write_changesets_to_fd(int fd,
     }
     conn.send_message(REPL_REPLY_END_OF_CHANGES, {}, 0.0);
 #else
-    (void)fd;
+    (void)conn;
     (void)revision;
     (void)need_whole_db;
     (void)info;
@@ -726,10 +793,40 @@ GlassDatabase::get_doclength(Xapian::docid did) const
 {
     LOGCALL(DB, Xapian::termcount, "GlassDatabase::get_doclength", did);
     Assert(did != 0);
+    if (cache_doclens && (doclen_cache || load_doclen_cache())) {
+        Xapian::termcount doclen;
+        if (doclen_cache->get(did, doclen)) RETURN(doclen);
+        // Not in use, so let the postlist table report that.
+    }
     intrusive_ptr<const GlassDatabase> ptrtothis(this);
     RETURN(postlist_table.get_doclength(did, ptrtothis));
 }
 
+void
+GlassDatabase::cache_doclengths()
+{
+    LOGCALL_VOID(DB, "GlassDatabase::cache_doclengths", NO_ARGS);
+    // The document lengths of a writable database can change.
+    if (readonly) cache_doclens = true;
+}
+
+bool
+GlassDatabase::load_doclen_cache() const
+{
+    LOGCALL(DB, bool, "GlassDatabase::load_doclen_cache", NO_ARGS);
+    Xapian::termcount doclen_ub = version_file.get_doclength_upper_bound();
+    if (!DoclenCache::usable(doclen_ub)) RETURN(false);
+    unique_ptr<DoclenCache> cache(
+        new DoclenCache(version_file.get_last_docid(), doclen_ub));
+    intrusive_ptr<const GlassDatabase> ptrtothis(this);
+    GlassPostList pl(ptrtothis, {}, false);
+    while (pl.next(0.0), !pl.at_end()) {
+        cache->set(pl.get_docid(), pl.get_wdf());
+    }
+    doclen_cache = std::move(cache);
+    RETURN(true);
+}
+
 Xapian::termcount
 GlassDatabase::get_unique_terms(Xapian::docid did) const
 {
@@ -1084,6 +1181,14 @@ GlassWritableDatabase::GlassWritableDatabase(string_view dir, int flags,
     }
     if (flush_threshold == 0)
         flush_threshold = 10000;
+
+    // We hold the write lock, so any run files are left from a process
+    // which was bulk loading and didn't finish.
+    GlassBulkLoader::remove_stale_runs(db_dir);
+
+    if (flags & Xapian::DB_BULK_LOAD) {
+        bulk_loader.reset(new GlassBulkLoader(dir));
+    }
 }
 
 GlassWritableDatabase::~GlassWritableDatabase()
@@ -1097,7 +1202,8 @@ GlassWritableDatabase::commit()
 {
     if (transaction_active())
         throw Xapian::InvalidOperationError("Can't commit during a transaction");
-    if (change_count) flush_postlist_changes();
+    if (change_count || (bulk_loader && !bulk_loader->empty()))
+        flush_postlist_changes();
     apply();
 }
 
@@ -1107,7 +1213,24 @@ GlassWritableDatabase::check_flush_threshold()
     // FIXME: this should be done by checking memory usage, not the number of
     // changes.  We could also look at the amount of data the inverter object
     // currently holds.
-    if (++change_count >= flush_threshold) {
+    ++change_count;
+    if (bulk_loader) {
+        // When bulk loading we write the buffered changes out as a sorted run
+        // and leave merging them into the tables until commit() is called.
+        if (change_count % flush_threshold == 0) {
+            try {
+                bulk_loader->spill(inverter);
+            } catch (...) {
+                try {
+                    GlassWritableDatabase::cancel();
+                } catch (...) {
+                }
+                throw;
+            }
+        }
+        return;
+    }
+    if (change_count >= flush_threshold) {
         flush_postlist_changes();
         if (!transaction_active()) apply();
     }
@@ -1118,8 +1241,16 @@ GlassWritableDatabase::flush_postlist_changes()
 {
     try {
         version_file.set_oldest_changeset(changes.get_oldest_changeset());
-        inverter.flush(postlist_table);
-        inverter.flush_pos_lists(position_table);
+        if (bulk_loader && !bulk_loader->empty()) {
+            merge_bulk_runs();
+        } else {
+            // The buffered postlist and position changes are independent and
+            // go to different tables, so we can merge them in parallel.
+            run_parallel({
+                    [&]() { inverter.flush(postlist_table); },
+                    [&]() { inverter.flush_pos_lists(position_table); }
+                }, can_write_tables_in_parallel() ? 2 : 1);
+        }
 
         change_count = 0;
     } catch (...) {
@@ -1131,6 +1262,29 @@ GlassWritableDatabase::flush_postlist_changes()
     }
 }
 
+void
+GlassWritableDatabase::merge_bulk_runs()
+{
+    if (!bulk_loader || bulk_loader->empty()) return;
+    // Write out the buffered changes as a final run so the merge sees all
+    // the changes in the order they were made.
+    bulk_loader->spill(inverter);
+    bulk_loader->merge_into(postlist_table, position_table,
+                            can_write_tables_in_parallel() ? 2 : 1);
+}
+
+void
+GlassWritableDatabase::check_no_bulk_runs() const
+{
+    if (bulk_loader && !bulk_loader->empty()) {
+        throw Xapian::InvalidOperationError("Can't read postings, positions "
+                                            "or document lengths while "
+                                            "bulk loading after the flush "
+                                            "threshold is reached - call "
+                                            "commit() first");
+    }
+}
+
 void
 GlassWritableDatabase::close()
 {
@@ -1219,6 +1373,18 @@ GlassWritableDatabase::delete_document(Xapian::docid did)
     LOGCALL_VOID(DB, "GlassWritableDatabase::delete_document", did);
     Assert(did != 0);
 
+    try {
+        merge_bulk_runs();
+    } catch (...) {
+        // The runs are discarded even if the merge fails part way through,
+        // so the tables can't be left to be committed.
+        try {
+            GlassWritableDatabase::cancel();
+        } catch (...) {
+        }
+        throw;
+    }
+
     if (!termlist_table.is_open())
         throw_termlist_table_close_exception();
 
@@ -1290,6 +1456,9 @@ GlassWritableDatabase::replace_document(Xapian::docid did,
             return;
         }
 
+        // We need to compare with the existing postings and positions.
+        merge_bulk_runs();
+
         if (!termlist_table.is_open()) {
             // We can replace an *unused* docid <= last_docid too.
             intrusive_ptr<const GlassDatabase> ptrtothis(this);
@@ -1454,6 +1623,7 @@ Xapian::termcount
 GlassWritableDatabase::get_doclength(Xapian::docid did) const
 {
     LOGCALL(DB, Xapian::termcount, "GlassWritableDatabase::get_doclength", did);
+    check_no_bulk_runs();
     Xapian::termcount doclen;
     if (inverter.get_doclength(did, doclen))
         RETURN(doclen);
@@ -1470,6 +1640,7 @@ GlassWritableDatabase::get_unique_terms(Xapian::docid did) const
     // get_unique_terms() really ought to only count terms with wdf > 0, but
     // that's expensive to calculate on demand, so for now let's just ensure
     // unique_terms <= doclen.
+    check_no_bulk_runs();
     Xapian::termcount doclen;
     if (inverter.get_doclength(did, doclen)) {
         intrusive_ptr<const GlassDatabase> ptrtothis(this);
@@ -1486,6 +1657,7 @@ GlassWritableDatabase::get_freqs(string_view term,
 {
     LOGCALL_VOID(DB, "GlassWritableDatabase::get_freqs", term | termfreq_ptr | collfreq_ptr);
     Assert(!term.empty());
+    check_no_bulk_runs();
     GlassDatabase::get_freqs(term, termfreq_ptr, collfreq_ptr);
     Xapian::termcount tf_delta, cf_delta;
     if (inverter.get_deltas(term, tf_delta, cf_delta)) {
@@ -1541,6 +1713,7 @@ GlassWritableDatabase::term_exists(string_view term) const
 bool
 GlassWritableDatabase::has_positions() const
 {
+    check_no_bulk_runs();
     return inverter.has_positions(position_table);
 }
 
@@ -1558,6 +1731,7 @@ GlassWritableDatabase::open_leaf_post_list(string_view term,
     LOGCALL(DB, LeafPostList *, "GlassWritableDatabase::open_leaf_post_list", term | need_read_pos);
     (void)need_read_pos;
     intrusive_ptr<const GlassWritableDatabase> ptrtothis(this);
+    check_no_bulk_runs();
 
     if (term.empty()) {
         Assert(!need_read_pos);
@@ -1601,6 +1775,7 @@ GlassWritableDatabase::read_position_list(GlassRePositionList* pos_list,
                                           string_view term) const
 {
     Assert(did != 0);
+    check_no_bulk_runs();
     string data;
     if (inverter.get_positionlist(did, term, data)) {
         pos_list->assign_data(std::move(data));
@@ -1614,6 +1789,7 @@ GlassWritableDatabase::positionlist_count(Xapian::docid did,
                                           string_view term) const
 {
     Assert(did != 0);
+    check_no_bulk_runs();
     string data;
     if (inverter.get_positionlist(did, term, data)) {
         if (data.empty())
@@ -1628,6 +1804,7 @@ GlassWritableDatabase::open_position_list(Xapian::docid did,
                                           string_view term) const
 {
     Assert(did != 0);
+    check_no_bulk_runs();
     string data;
     if (inverter.get_positionlist(did, term, data)) {
         if (data.empty()) return nullptr;
@@ -1640,6 +1817,7 @@ TermList *
 GlassWritableDatabase::open_allterms(string_view prefix) const
 {
     LOGCALL(DB, TermList*, "GlassWritableDatabase::open_allterms", prefix);
+    check_no_bulk_runs();
     if (change_count) {
         // There are changes, and terms may have been added or removed, and so
         // we need to flush changes for terms with the specified prefix (but
@@ -1661,6 +1839,7 @@ GlassWritableDatabase::cancel()
 {
     GlassDatabase::cancel();
     inverter.clear();
+    if (bulk_loader) bulk_loader->clear();
     value_stats.clear();
     change_count = 0;
 }
@@ -1739,6 +1918,7 @@ bool
 GlassWritableDatabase::has_uncommitted_changes() const
 {
     return change_count > 0 ||
+           (bulk_loader && !bulk_loader->empty()) ||
            postlist_table.is_modified() ||
            position_table.is_modified() ||
            termlist_table.is_modified() ||
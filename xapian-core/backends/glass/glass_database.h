@@ -3,7 +3,7 @@
  */
 /* Copyright 1999,2000,2001 BrightStation PLC
  * Copyright 2002 Ananova Ltd
- * Copyright 2002-2024 Olly Betts
+ * Copyright 2002-2026 Olly Betts
  * Copyright 2008 Lemur Consulting Ltd
  *
  * This program is free software; you can redistribute it and/or
@@ -26,6 +26,8 @@
 
 #include "backends/backends.h"
 #include "backends/databaseinternal.h"
+#include "backends/doclencache.h"
+#include "glass_bulkload.h"
 #include "glass_changes.h"
 #include "glass_docdata.h"
 #include "glass_inverter.h"
@@ -44,6 +46,7 @@
 #include "xapian/constants.h"
 
 #include <map>
+#include <memory>
 #include <string_view>
 
 class GlassTermList;
@@ -116,6 +119,21 @@ class GlassDatabase : public Xapian::Database::Internal {
     /// Replication changesets.
     GlassChanges changes;
 
+    /// Should document lengths be cached in memory?
+    bool cache_doclens = false;
+
+    /** Document lengths cached in memory.
+     *
+     *  NULL until first needed (and always NULL unless cache_doclens is true).
+     */
+    mutable std::unique_ptr<DoclenCache> doclen_cache;
+
+    /** Read all the document lengths into doclen_cache.
+     *
+     *  @return false if they can't be cached.
+     */
+    bool load_doclen_cache() const;
+
     /** Return true if a database exists at the path specified for this
      *  database.
      */
@@ -123,8 +141,11 @@ class GlassDatabase : public Xapian::Database::Internal {
 
     /** Create new tables, and open them.
      *  Any existing tables will be removed first.
+     *
+     *  @param compression  Codec to compress tags with.
      */
-    void create_and_open_tables(int flags, unsigned int blocksize);
+    void create_and_open_tables(int flags, unsigned int blocksize,
+                                Compression::codec compression);
 
     /** Open all tables at most recent revision.
      *
@@ -166,6 +187,15 @@ class GlassDatabase : public Xapian::Database::Internal {
      */
     void set_revision_number(int flags, glass_revision_number_t new_revision);
 
+    /** Can we write to the tables from different threads at once?
+     *
+     *  Each table has its own file, so this is OK unless we're generating
+     *  a changeset, which all the tables write modified blocks to.
+     */
+    bool can_write_tables_in_parallel() const {
+        return !changes.is_active() && !single_file();
+    }
+
     /** Re-open tables to recover from an overwritten condition,
      *  or just get most up-to-date version.
      */
@@ -246,6 +276,7 @@ class GlassDatabase : public Xapian::Database::Internal {
     Xapian::docid get_lastdocid() const;
     Xapian::totallength get_total_length() const;
     Xapian::termcount get_doclength(Xapian::docid did) const;
+    void cache_doclengths();
     Xapian::termcount get_unique_terms(Xapian::docid did) const;
     Xapian::termcount get_wdfdocmax(Xapian::docid did) const;
     void get_freqs(std::string_view term,
@@ -288,7 +319,7 @@ class GlassDatabase : public Xapian::Database::Internal {
 
     string get_metadata(std::string_view key) const;
     TermList* open_metadata_keylist(std::string_view prefix) const;
-    void write_changesets_to_fd(int fd,
+    void write_changesets_to_fd(RemoteConnection& conn,
                                 std::string_view start_revision,
                                 bool need_whole_db,
                                 Xapian::ReplicationInfo * info);
@@ -351,6 +382,12 @@ class GlassWritableDatabase : public GlassDatabase {
     /// If change_count reaches this threshold we automatically flush.
     Xapian::doccount flush_threshold;
 
+    /** Sorted runs of changes if Xapian::DB_BULK_LOAD was specified.
+     *
+     *  NULL if Xapian::DB_BULK_LOAD wasn't specified.
+     */
+    std::unique_ptr<GlassBulkLoader> bulk_loader;
+
     /** A pointer to the last document which was returned by
      *  open_document(), or NULL if there is no such valid document.  This
      *  is used purely for comparing with a supplied document to help with
@@ -372,6 +409,22 @@ class GlassWritableDatabase : public GlassDatabase {
     /// Flush any unflushed postlist changes, but don't commit them.
     void flush_postlist_changes();
 
+    /** Merge any bulk load runs into the tables.
+     *
+     *  Any changes buffered in the inverter are included.  Called before
+     *  deleting or replacing an existing document, which needs to read the
+     *  current postlist and position data.
+     */
+    void merge_bulk_runs();
+
+    /** Throw InvalidOperationError if there are bulk load runs.
+     *
+     *  Called by operations which read postlist, position or document length
+     *  data.  Merging the runs to support these would defeat the point of
+     *  bulk loading, so we don't allow them until the changes are committed.
+     */
+    void check_no_bulk_runs() const;
+
     /// Close all the tables permanently.
     void close();
 
@@ -26,9 +26,11 @@
 #include "glass_positionlist.h"
 
 #include "api/termlist.h"
+#include "stringutils.h"
 
-#include <map>
+#include <algorithm>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -46,13 +48,12 @@ Inverter::store_positions(const GlassPositionListTable& position_table,
         // positions we don't know if we then have them or not.
         has_positions_cache = s.empty() ? -1 : 1;
 
-        auto i = pos_changes.find(term);
+        auto i = pos_changes.find(term_lookup_key(term));
         if (i != pos_changes.end()) {
-            map<Xapian::docid, string>& m = i->second;
-            auto j = m.find(did);
-            if (j != m.end()) {
+            string* p = i->second.find(did);
+            if (p) {
                 // Update existing entry.
-                swap(j->second, s);
+                swap(*p, s);
                 return;
             }
         }
@@ -106,8 +107,11 @@ Inverter::set_positionlist(Xapian::docid did,
                            string_view s)
 {
     has_positions_cache = s.empty() ? -1 : 1;
-    pos_changes.insert(make_pair(term, map<Xapian::docid, string>()))
-        .first->second[did] = s;
+    auto i = pos_changes.find(term_lookup_key(term));
+    if (i == pos_changes.end()) {
+        i = pos_changes.emplace(term, DocidChanges<string>()).first;
+    }
+    i->second.set(did, string(s));
 }
 
 void
@@ -122,14 +126,13 @@ Inverter::get_positionlist(Xapian::docid did,
                            string_view term,
                            string& s) const
 {
-    auto i = pos_changes.find(term);
+    auto i = pos_changes.find(term_lookup_key(term));
     if (i == pos_changes.end())
         return false;
-    const map<Xapian::docid, string>& m = i->second;
-    auto j = m.find(did);
-    if (j == m.end())
+    const string* p = i->second.find(did);
+    if (!p)
         return false;
-    s = j->second;
+    s = *p;
     return true;
 }
 
@@ -141,7 +144,7 @@ Inverter::has_positions(const GlassPositionListTable& position_table) const
         // efficient?  E.g. how many sets and deletes we had in total perhaps.
         glass_tablesize_t changes = 0;
         for (const auto& i : pos_changes) {
-            const map<Xapian::docid, string>& m = i.second;
+            const DocidChanges<string>& m = i.second;
             for (const auto& j : m) {
                 const string& s = j.second;
                 if (!s.empty())
@@ -163,24 +166,43 @@ Inverter::flush_doclengths(GlassPostListTable& table)
     doclen_changes.clear();
 }
 
+template<typename F>
+void
+Inverter::for_each_post_list(F f)
+{
+    // Process terms in sorted order so that we update the postlist table in
+    // key order, which is much friendlier to the B-tree.
+    vector<decltype(postlist_changes)::iterator> terms;
+    terms.reserve(postlist_changes.size());
+    for (auto i = postlist_changes.begin(); i != postlist_changes.end(); ++i) {
+        terms.push_back(i);
+    }
+    sort(terms.begin(), terms.end(),
+         [](const auto& a, const auto& b) { return a->first < b->first; });
+    for (auto&& i : terms) {
+        f(i);
+    }
+}
+
 void
 Inverter::flush_post_list(GlassPostListTable& table, string_view term)
 {
-    auto i = postlist_changes.find(term);
+    auto i = postlist_changes.find(term_lookup_key(term));
     if (i == postlist_changes.end()) return;
 
     // Flush buffered changes for just this term's postlist.
     table.merge_changes(term, i->second);
+    if (postlist_terms_valid) postlist_terms.erase(i->first);
     postlist_changes.erase(i);
 }
 
 void
 Inverter::flush_all_post_lists(GlassPostListTable& table)
 {
-    for (auto&& i : postlist_changes) {
-        table.merge_changes(i.first, i.second);
-    }
-    postlist_changes.clear();
+    for_each_post_list([&](auto i) {
+        table.merge_changes(i->first, i->second);
+    });
+    clear_post_lists();
 }
 
 void
@@ -189,29 +211,21 @@ Inverter::flush_post_lists(GlassPostListTable& table, string_view pfx)
     if (pfx.empty())
         return flush_all_post_lists(table);
 
-    auto begin = postlist_changes.lower_bound(pfx);
-    decltype(begin) end;
-    string pfxinc{pfx};
-    while (true) {
-        if (pfxinc.back() != '\xff') {
-            ++pfxinc.back();
-            end = postlist_changes.lower_bound(pfxinc);
-            break;
-        }
-        pfxinc.resize(pfxinc.size() - 1);
-        if (pfxinc.empty()) {
-            end = postlist_changes.end();
-            break;
+    if (!postlist_terms_valid) {
+        for (auto&& i : postlist_changes) {
+            postlist_terms.insert(i.first);
         }
+        postlist_terms_valid = true;
     }
 
-    for (auto i = begin; i != end; ++i) {
+    auto t = postlist_terms.lower_bound(pfx);
+    while (t != postlist_terms.end() && startswith(*t, pfx)) {
+        auto i = postlist_changes.find(term_lookup_key(*t));
+        Assert(i != postlist_changes.end());
         table.merge_changes(i->first, i->second);
+        t = postlist_terms.erase(t);
+        postlist_changes.erase(i);
     }
-
-    // Erase all the entries in one go, as that's:
-    //  O(log(postlist_changes.size()) + O(number of elements removed)
-    postlist_changes.erase(begin, end);
 }
 
 void
@@ -221,13 +235,30 @@ Inverter::flush(GlassPostListTable& table)
     flush_all_post_lists(table);
 }
 
+template<typename F>
+void
+Inverter::for_each_pos_list(F f) const
+{
+    // Process terms in sorted order so that we update the position table in
+    // key order.
+    vector<decltype(pos_changes)::const_iterator> terms;
+    terms.reserve(pos_changes.size());
+    for (auto i = pos_changes.cbegin(); i != pos_changes.cend(); ++i) {
+        terms.push_back(i);
+    }
+    sort(terms.begin(), terms.end(),
+         [](const auto& a, const auto& b) { return a->first < b->first; });
+    for (auto&& i : terms) {
+        f(i);
+    }
+}
+
 void
 Inverter::flush_pos_lists(GlassPositionListTable& table)
 {
-    for (auto i : pos_changes) {
-        const string& term = i.first;
-        const map<Xapian::docid, string>& m = i.second;
-        for (auto j : m) {
+    for_each_pos_list([&](auto i) {
+        const string& term = i->first;
+        for (const auto& j : i->second) {
             Xapian::docid did = j.first;
             const string& s = j.second;
             if (!s.empty())
@@ -235,7 +266,27 @@ Inverter::flush_pos_lists(GlassPositionListTable& table)
             else
                 table.delete_positionlist(did, term);
         }
+    });
+    pos_changes.clear();
+    has_positions_cache = -1;
+}
+
+void
+Inverter::flush_to(Glass::ChangesSink& sink)
+{
+    for (auto&& i : doclen_changes) {
+        sink.doclength(i.first, i.second);
     }
+    doclen_changes.clear();
+
+    for_each_post_list([&](auto i) {
+        sink.postlist(i->first, i->second);
+    });
+    clear_post_lists();
+
+    for_each_pos_list([&](auto i) {
+        sink.positionlists(i->first, i->second);
+    });
     pos_changes.clear();
     has_positions_cache = -1;
 }
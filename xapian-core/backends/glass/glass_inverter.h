@@ -1,7 +1,7 @@
 /** @file
  * @brief Inverter class which "inverts the file".
  */
-/* Copyright (C) 2009,2010,2013,2014,2023,2024 Olly Betts
+/* Copyright (C) 2009,2010,2013,2014,2023,2024,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -25,9 +25,13 @@
 
 #include "api/smallvector.h"
 
-#include <map>
+#include <algorithm>
+#include <functional>
+#include <set>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "negate_unsigned.h"
@@ -38,17 +42,160 @@
 class GlassPostListTable;
 class GlassPositionListTable;
 
+namespace Glass {
+class ChangesSink;
+}
+
 namespace Xapian {
 class TermIterator;
 }
 
+/** Hash function for std::string keys which also accepts std::string_view.
+ *
+ *  Together with std::equal_to<> this allows lookups in a std::unordered_map
+ *  with a std::string_view key without constructing a std::string (when the
+ *  C++ library supports that).
+ */
+struct TransparentStringHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view s) const {
+        return std::hash<std::string_view>{}(s);
+    }
+};
+
+/** Hash table keyed by term supporting lookup by std::string_view. */
+template<typename T>
+using TermHashMap = std::unordered_map<std::string, T,
+                                       TransparentStringHash,
+                                       std::equal_to<>>;
+
+/** Convert a term to the type needed to look it up in a TermHashMap. */
+#ifdef __cpp_lib_generic_unordered_lookup // C++20
+inline std::string_view
+term_lookup_key(std::string_view term)
+{
+    return term;
+}
+#else
+inline std::string
+term_lookup_key(std::string_view term)
+{
+    return std::string(term);
+}
+#endif
+
 /** Magic wdf value used for a deleted posting. */
 const Xapian::termcount DELETED_POSTING = Xapian::termcount(-1);
 
+/** Buffered changes for a set of documents.
+ *
+ *  Changes are appended to a vector in the order they are made, which avoids
+ *  the allocation per entry which std::map would need.  The vector is only
+ *  sorted by docid (keeping the most recent change for each docid) when it
+ *  needs to be read - when documents are added in docid order (the common case
+ *  when indexing) it will already be sorted, so this is cheap.
+ */
+template<typename T>
+class DocidChanges {
+    typedef std::pair<Xapian::docid, T> entry;
+
+    /// The changes, which are only sorted up to @a sorted.
+    mutable std::vector<entry> changes;
+
+    /** Number of entries at the start of @a changes which are sorted.
+     *
+     *  These entries also have unique docids.
+     */
+    mutable size_t sorted = 0;
+
+    /// Sort and remove superseded entries, if required.
+    void normalise() const {
+        if (sorted == changes.size()) return;
+
+        auto cmp = [](const entry& a, const entry& b) {
+            return a.first < b.first;
+        };
+        auto mid = changes.begin() + sorted;
+        // Sort the unsorted tail, preserving order of changes for a docid
+        // so the most recent one is last, then merge with the sorted head.
+        std::stable_sort(mid, changes.end(), cmp);
+        std::inplace_merge(changes.begin(), mid, changes.end(), cmp);
+
+        // Keep only the most recent change for each docid.
+        auto out = changes.begin();
+        for (auto i = changes.begin() + 1; i != changes.end(); ++i) {
+            if (i->first != out->first) ++out;
+            if (out != i) *out = std::move(*i);
+        }
+        changes.erase(out + 1, changes.end());
+        sorted = changes.size();
+    }
+
+  public:
+    typedef typename std::vector<entry>::const_iterator const_iterator;
+
+    /// Record value @a v for document @a did.
+    void set(Xapian::docid did, T v) {
+        if (!changes.empty()) {
+            Xapian::docid last = changes.back().first;
+            if (did == last) {
+                changes.back().second = std::move(v);
+                return;
+            }
+            if (did < last) {
+                changes.emplace_back(did, std::move(v));
+                return;
+            }
+        }
+        bool in_order = (sorted == changes.size());
+        changes.emplace_back(did, std::move(v));
+        if (in_order) sorted = changes.size();
+    }
+
+    /// Find the change for document @a did, or return NULL if there isn't one.
+    const T* find(Xapian::docid did) const {
+        normalise();
+        auto i = std::lower_bound(changes.begin(), changes.end(), did,
+                                  [](const entry& e, Xapian::docid d) {
+                                      return e.first < d;
+                                  });
+        if (i == changes.end() || i->first != did) return NULL;
+        return &i->second;
+    }
+
+    /// Find the change for document @a did, or return NULL if there isn't one.
+    T* find(Xapian::docid did) {
+        return const_cast<T*>(std::as_const(*this).find(did));
+    }
+
+    /// Iterate changes in ascending docid order.
+    const_iterator begin() const {
+        normalise();
+        return changes.begin();
+    }
+
+    const_iterator end() const { return changes.end(); }
+
+    bool empty() const { return changes.empty(); }
+
+    /** Number of changes stored.
+     *
+     *  This may include superseded changes.
+     */
+    size_t size() const { return changes.size(); }
+
+    void clear() {
+        changes.clear();
+        sorted = 0;
+    }
+};
+
 /** Class which "inverts the file". */
 class Inverter {
     friend class GlassPostListTable;
 
+  public:
     /// Class for storing the changes in frequencies for a term.
     class PostingChanges {
         friend class GlassPostListTable;
@@ -66,14 +213,17 @@ class Inverter {
         Xapian::termcount cf_delta;
 
         /// Changes to this term's postlist.
-        std::map<Xapian::docid, Xapian::termcount> pl_changes;
+        DocidChanges<Xapian::termcount> pl_changes;
 
       public:
+        /// Constructor for no changes.
+        PostingChanges() : tf_delta(0), cf_delta(0) { }
+
         /// Constructor for an added posting.
         PostingChanges(Xapian::docid did, Xapian::termcount wdf)
             : tf_delta(1), cf_delta(wdf)
         {
-            pl_changes.insert(std::make_pair(did, wdf));
+            pl_changes.set(did, wdf);
         }
 
         /// Constructor for a removed posting.
@@ -81,7 +231,7 @@ class Inverter {
             : tf_delta(UNSIGNED_OVERFLOW_OK(-1)),
               cf_delta(negate_unsigned(wdf))
         {
-            pl_changes.insert(std::make_pair(did, DELETED_POSTING));
+            pl_changes.set(did, DELETED_POSTING);
         }
 
         /// Constructor for an updated posting.
@@ -90,7 +240,7 @@ class Inverter {
             : tf_delta(0),
               cf_delta(UNSIGNED_OVERFLOW_OK(new_wdf - old_wdf))
         {
-            pl_changes.insert(std::make_pair(did, new_wdf));
+            pl_changes.set(did, new_wdf);
         }
 
         /// Add a posting.
@@ -99,7 +249,7 @@ class Inverter {
             UNSIGNED_OVERFLOW_OK(++tf_delta);
             UNSIGNED_OVERFLOW_OK(cf_delta += wdf);
             // Add did to term's postlist
-            pl_changes[did] = wdf;
+            pl_changes.set(did, wdf);
         }
 
         /// Remove a posting.
@@ -108,14 +258,32 @@ class Inverter {
             UNSIGNED_OVERFLOW_OK(--tf_delta);
             UNSIGNED_OVERFLOW_OK(cf_delta -= wdf);
             // Remove did from term's postlist.
-            pl_changes[did] = DELETED_POSTING;
+            pl_changes.set(did, DELETED_POSTING);
         }
 
         /// Update a posting.
         void update_posting(Xapian::docid did, Xapian::termcount old_wdf,
                             Xapian::termcount new_wdf) {
             UNSIGNED_OVERFLOW_OK(cf_delta += new_wdf - old_wdf);
-            pl_changes[did] = new_wdf;
+            pl_changes.set(did, new_wdf);
+        }
+
+        /** Combine with frequency deltas from a later set of changes.
+         *
+         *  The postlist changes need to be combined separately using
+         *  set_wdf().
+         */
+        void add_deltas(Xapian::termcount tf, Xapian::termcount cf) {
+            UNSIGNED_OVERFLOW_OK(tf_delta += tf);
+            UNSIGNED_OVERFLOW_OK(cf_delta += cf);
+        }
+
+        /** Set the wdf of a posting without adjusting the deltas.
+         *
+         *  Use DELETED_POSTING as @a wdf for a removed posting.
+         */
+        void set_wdf(Xapian::docid did, Xapian::termcount wdf) {
+            pl_changes.set(did, wdf);
         }
 
         /// Get the term frequency delta.
@@ -123,10 +291,46 @@ class Inverter {
 
         /// Get the collection frequency delta.
         Xapian::termcount get_cfdelta() const { return cf_delta; }
+
+        /// Get the changes to this term's postlist.
+        const DocidChanges<Xapian::termcount>& get_changes() const {
+            return pl_changes;
+        }
     };
 
-    /// Buffered changes to postlists.
-    std::map<std::string, PostingChanges, std::less<>> postlist_changes;
+  private:
+
+    /** Buffered changes to postlists.
+     *
+     *  We use a hash table here since we look up a term for every posting
+     *  added, and only need to iterate in term order when flushing.
+     */
+    TermHashMap<PostingChanges> postlist_changes;
+
+    /** The terms in postlist_changes in ascending order.
+     *
+     *  This is only built when changes for a term prefix are first flushed
+     *  (which open_allterms() with a prefix needs), and then kept up to date
+     *  until all the changes are flushed, so that flushing a prefix only
+     *  needs to look at the terms with that prefix.  The entries refer to
+     *  the keys in postlist_changes.
+     */
+    std::set<std::string_view> postlist_terms;
+
+    /// Is postlist_terms being maintained?
+    bool postlist_terms_valid = false;
+
+    /// Note that @a term has been added to postlist_changes.
+    void added_post_list(std::string_view term) {
+        if (postlist_terms_valid) postlist_terms.insert(term);
+    }
+
+    /// Clear postlist_changes.
+    void clear_post_lists() {
+        postlist_changes.clear();
+        postlist_terms.clear();
+        postlist_terms_valid = false;
+    }
 
     /** Cached answer to Inverter::has_positions().
      *
@@ -137,9 +341,15 @@ class Inverter {
     mutable int has_positions_cache = -1;
 
     /// Buffered changes to positional data.
-    std::map<std::string,
-             std::map<Xapian::docid, std::string>,
-             std::less<>> pos_changes;
+    TermHashMap<DocidChanges<std::string>> pos_changes;
+
+    /// Call @a f on postlist_changes entries in ascending term order.
+    template<typename F>
+    void for_each_post_list(F f);
+
+    /// Call @a f on pos_changes entries in ascending term order.
+    template<typename F>
+    void for_each_pos_list(F f) const;
 
     void store_positions(const GlassPositionListTable& position_table,
                          Xapian::docid did,
@@ -153,15 +363,15 @@ class Inverter {
 
   public:
     /// Buffered changes to document lengths.
-    std::map<Xapian::docid, Xapian::termcount> doclen_changes;
+    DocidChanges<Xapian::termcount> doclen_changes;
 
   public:
     void add_posting(Xapian::docid did, const std::string& term,
                      Xapian::doccount wdf) {
         auto i = postlist_changes.find(term);
         if (i == postlist_changes.end()) {
-            postlist_changes.insert(
-                std::make_pair(term, PostingChanges(did, wdf)));
+            auto j = postlist_changes.emplace(term, PostingChanges(did, wdf));
+            added_post_list(j.first->first);
         } else {
             i->second.add_posting(did, wdf);
         }
@@ -171,8 +381,9 @@ class Inverter {
                         Xapian::doccount wdf) {
         auto i = postlist_changes.find(term);
         if (i == postlist_changes.end()) {
-            postlist_changes.insert(
-                std::make_pair(term, PostingChanges(did, wdf, false)));
+            auto j = postlist_changes.emplace(term,
+                                             PostingChanges(did, wdf, false));
+            added_post_list(j.first->first);
         } else {
             i->second.remove_posting(did, wdf);
         }
@@ -183,8 +394,10 @@ class Inverter {
                         Xapian::termcount new_wdf) {
         auto i = postlist_changes.find(term);
         if (i == postlist_changes.end()) {
-            postlist_changes.insert(
-                std::make_pair(term, PostingChanges(did, old_wdf, new_wdf)));
+            auto j = postlist_changes.emplace(term,
+                                              PostingChanges(did, old_wdf,
+                                                             new_wdf));
+            added_post_list(j.first->first);
         } else {
             i->second.update_posting(did, old_wdf, new_wdf);
         }
@@ -207,32 +420,33 @@ class Inverter {
 
     void clear() {
         doclen_changes.clear();
-        postlist_changes.clear();
+        clear_post_lists();
         pos_changes.clear();
         has_positions_cache = -1;
     }
 
     void set_doclength(Xapian::docid did, Xapian::termcount doclen, bool add) {
         if (add) {
-            Assert(doclen_changes.find(did) == doclen_changes.end() ||
-                   doclen_changes[did] == DELETED_POSTING);
+            AssertEq(doclen_changes.find(did) ? *doclen_changes.find(did)
+                                              : DELETED_POSTING,
+                     DELETED_POSTING);
         }
-        doclen_changes[did] = doclen;
+        doclen_changes.set(did, doclen);
     }
 
     void delete_doclength(Xapian::docid did) {
-        Assert(doclen_changes.find(did) == doclen_changes.end() ||
-               doclen_changes[did] != DELETED_POSTING);
-        doclen_changes[did] = DELETED_POSTING;
+        AssertRel(doclen_changes.find(did) ? *doclen_changes.find(did) : 0,
+                  !=, DELETED_POSTING);
+        doclen_changes.set(did, DELETED_POSTING);
     }
 
     bool get_doclength(Xapian::docid did, Xapian::termcount& doclen) const {
-        auto i = doclen_changes.find(did);
-        if (i == doclen_changes.end())
+        const Xapian::termcount* p = doclen_changes.find(did);
+        if (!p)
             return false;
-        if (rare(i->second == DELETED_POSTING))
+        if (rare(*p == DELETED_POSTING))
             throw Xapian::DocNotFoundError("Document not found: " + str(did));
-        doclen = i->second;
+        doclen = *p;
         return true;
     }
 
@@ -254,10 +468,18 @@ class Inverter {
     /// Flush position changes.
     void flush_pos_lists(GlassPositionListTable& table);
 
+    /** Pass all buffered changes to @a sink and then clear them.
+     *
+     *  The document lengths are passed first in ascending docid order, then
+     *  the postlist changes in ascending term order, then the position
+     *  changes in ascending term order.
+     */
+    void flush_to(Glass::ChangesSink& sink);
+
     bool get_deltas(std::string_view term,
                     Xapian::termcount& tf_delta,
                     Xapian::termcount& cf_delta) const {
-        auto i = postlist_changes.find(term);
+        auto i = postlist_changes.find(term_lookup_key(term));
         if (i == postlist_changes.end()) {
             return false;
         }
@@ -267,4 +489,31 @@ class Inverter {
     }
 };
 
+namespace Glass {
+
+/// Interface for receiving the buffered changes from an Inverter.
+class ChangesSink {
+  public:
+    virtual ~ChangesSink() { }
+
+    /** Change the length of document @a did.
+     *
+     *  @a doclen is DELETED_POSTING if the document was deleted.
+     */
+    virtual void doclength(Xapian::docid did, Xapian::termcount doclen) = 0;
+
+    /// Change the postlist of @a term.
+    virtual void postlist(const std::string& term,
+                          const Inverter::PostingChanges& changes) = 0;
+
+    /** Change position lists for @a term.
+     *
+     *  An empty position list means to delete the position list.
+     */
+    virtual void positionlists(const std::string& term,
+                               const DocidChanges<std::string>& changes) = 0;
+};
+
+}
+
 #endif // XAPIAN_INCLUDED_GLASS_INVERTER_H
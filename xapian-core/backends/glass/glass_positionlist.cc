@@ -1,7 +1,7 @@
 /** @file
  * @brief A position list in a glass database.
  */
-/* Copyright (C) 2004,2005,2006,2008,2009,2010,2013,2017,2019 Olly Betts
+/* Copyright (C) 2004,2005,2006,2008,2009,2010,2013,2017,2019,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -28,6 +28,7 @@
 #include "debuglog.h"
 #include "pack.h"
 
+#include <algorithm>
 #include <string>
 
 using namespace std;
@@ -97,6 +98,8 @@ GlassBasePositionList::set_data(string_view data)
     LOGCALL_VOID(DB, "GlassBasePositionList::set_data", data);
 
     have_started = false;
+    positions.clear();
+    current = 0;
 
     if (data.empty()) {
         // There's no positional information for this term.
@@ -123,7 +126,6 @@ GlassBasePositionList::set_data(string_view data)
     rd.init(pos, end);
     Xapian::termpos pos_first = rd.decode(pos_last);
     Xapian::termpos pos_size = rd.decode(pos_last - pos_first) + 2;
-    rd.decode_interpolative(0, pos_size - 1, pos_first, pos_last);
     size = pos_size;
     last = pos_last;
     current_pos = pos_first;
@@ -151,6 +153,18 @@ GlassBasePositionList::get_position() const
     RETURN(current_pos);
 }
 
+void
+GlassBasePositionList::decode()
+{
+    LOGCALL_VOID(DB, "GlassBasePositionList::decode", NO_ARGS);
+    AssertRel(size, >, 1);
+    AssertEq(current, 0);
+    positions.resize(size);
+    positions[0] = current_pos;
+    positions[size - 1] = last;
+    rd.decode_interpolative(positions.data(), 0, size - 1);
+}
+
 bool
 GlassBasePositionList::next()
 {
@@ -162,7 +176,8 @@ GlassBasePositionList::next()
     if (current_pos == last) {
         return false;
     }
-    current_pos = rd.decode_interpolative_next();
+    if (positions.empty()) decode();
+    current_pos = positions[++current];
     return true;
 }
 
@@ -178,12 +193,15 @@ GlassBasePositionList::skip_to(Xapian::termpos termpos)
         }
         return false;
     }
-    while (current_pos < termpos) {
-        if (current_pos == last) {
-            return false;
-        }
-        current_pos = rd.decode_interpolative_next();
+    if (current_pos >= termpos) {
+        return true;
     }
+    if (positions.empty()) decode();
+    // termpos < last so we know this will find an entry.
+    auto i = lower_bound(positions.begin() + current + 1, positions.end(),
+                         termpos);
+    current = i - positions.begin();
+    current_pos = *i;
     return true;
 }
 
@@ -1,7 +1,7 @@
 /** @file
  * @brief A position list in a glass database.
  */
-/* Copyright (C) 2005-2024 Olly Betts
+/* Copyright (C) 2005-2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -30,6 +30,8 @@
 #include "backends/positionlist.h"
 
 #include <string>
+#include <string_view>
+#include <vector>
 
 /** Base-class for a position list in a glass database. */
 class GlassBasePositionList : public PositionList {
@@ -43,6 +45,17 @@ class GlassBasePositionList : public PositionList {
     /// Interpolative decoder.
     BitReader rd;
 
+    /** The decoded entries.
+     *
+     *  We only decode these when we first need to move past the first entry,
+     *  since we're often only interested in the size or first or last entry.
+     *  If we've not decoded them yet, this is empty.
+     */
+    std::vector<Xapian::termpos> positions;
+
+    /// Index of the current entry.
+    Xapian::termcount current;
+
     /// Current entry.
     Xapian::termpos current_pos;
 
@@ -55,6 +68,9 @@ class GlassBasePositionList : public PositionList {
     /// Have we started iterating yet?
     bool have_started;
 
+    /// Decode all the entries into positions.
+    void decode();
+
     /** Set positional data and start to decode it.
      *
      *  @param data     The positional data.  Must stay valid
@@ -1145,9 +1145,9 @@ GlassPostListTable::get_chunk(string_view term,
 }
 
 void
-GlassPostListTable::merge_doclen_changes(const map<Xapian::docid, Xapian::termcount> & doclens)
+GlassPostListTable::merge_doclen_changes(const DocidChanges<Xapian::termcount>& doclens)
 {
-    LOGCALL_VOID(DB, "GlassPostListTable::merge_doclen_changes", doclens);
+    LOGCALL_VOID(DB, "GlassPostListTable::merge_doclen_changes", doclens.size());
 
     // The cursor in the doclen_pl will no longer be valid, so reset it.
     doclen_pl.reset(0);
@@ -1163,8 +1163,7 @@ GlassPostListTable::merge_doclen_changes(const map<Xapian::docid, Xapian::termco
         add(current_key, "\0\0\0\x31\0"s);
     }
 
-    map<Xapian::docid, Xapian::termcount>::const_iterator j;
-    j = doclens.begin();
+    auto j = doclens.begin();
     Assert(j != doclens.end()); // This case is caught above.
 
     Xapian::docid max_did;
@@ -1275,8 +1274,7 @@ GlassPostListTable::merge_changes(string_view term,
             add(current_key, tag);
         }
     }
-    map<Xapian::docid, Xapian::termcount>::const_iterator j;
-    j = changes.pl_changes.begin();
+    auto j = changes.pl_changes.begin();
     Assert(j != changes.pl_changes.end()); // This case is caught above.
 
     Xapian::docid max_did;
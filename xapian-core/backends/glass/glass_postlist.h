@@ -246,8 +246,7 @@ class GlassPostListTable : public GlassTable {
                        const Inverter::PostingChanges& changes);
 
     /// Merge document length changes.
-    void merge_doclen_changes(const std::map<Xapian::docid,
-                                        Xapian::termcount>& doclens);
+    void merge_doclen_changes(const DocidChanges<Xapian::termcount>& doclens);
 
     Xapian::docid get_chunk(std::string_view term,
                             Xapian::docid did, bool adding,
@@ -1295,7 +1295,7 @@ GlassTable::add(string_view key, string_view tag, bool already_compressed)
             GlassTable::throw_database_closed();
         }
         RootInfo root_info;
-        root_info.init(block_size, compress_min);
+        root_info.init(block_size, compress_min, comp_stream.get_codec());
         do_open_to_write(&root_info);
     }
 
@@ -1603,6 +1603,7 @@ GlassTable::basic_open(const RootInfo * root_info, glass_revision_number_t rev)
     }
 
     compress_min = root_info->get_compress_min();
+    comp_stream.set_codec(root_info->get_compression());
 
     /* kt holds constructed items as well as keys */
     kt = LeafItem_wr(zeroed_new(block_size));
@@ -1806,6 +1807,7 @@ GlassTable::create_and_open(int flags_, const RootInfo & root_info)
         close();
         (void)io_unlink(name + GLASS_TABLE_EXTENSION);
         compress_min = root_info.get_compress_min();
+        comp_stream.set_codec(root_info.get_compression());
     } else {
         // FIXME: it would be good to arrange that this works such that there's
         // always a valid table in place if you run create_and_open() on an
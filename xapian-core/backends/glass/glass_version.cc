@@ -51,6 +51,15 @@ using namespace std;
 
 /// Glass format version (date of change):
 #define GLASS_FORMAT_VERSION DATE_TO_VERSION(2016,03,14)
+
+/** Glass format version used if any table compresses with a codec other than
+ *  zlib.
+ *
+ *  We only write this version when we need to, so that databases which don't
+ *  use this feature can still be read by older Xapian versions.
+ */
+#define GLASS_FORMAT_VERSION_CODEC DATE_TO_VERSION(2026,10,19)
+// 2026,10,19 2.1.0 compression codec in version file (if not all zlib)
 // 2016,03,14 1.3.5 compress_min in version file; partly eliminate component_of
 // 2015,12,24 1.3.4 2 bytes "components_of" per item eliminated, and much more
 // 2014,11,21 1.3.2 Brass renamed to Glass
@@ -133,7 +142,8 @@ GlassVersion::read()
     version = static_cast<unsigned char>(buf[GLASS_VERSION_MAGIC_LEN]);
     version <<= 8;
     version |= static_cast<unsigned char>(buf[GLASS_VERSION_MAGIC_LEN + 1]);
-    if (version != GLASS_FORMAT_VERSION) {
+    if (version != GLASS_FORMAT_VERSION &&
+        version != GLASS_FORMAT_VERSION_CODEC) {
         string msg;
         if (!single_file()) {
             msg = db_dir;
@@ -147,6 +157,10 @@ GlassVersion::read()
         msg += str(VERSION_TO_YEAR(GLASS_FORMAT_VERSION) * 10000 +
                    VERSION_TO_MONTH(GLASS_FORMAT_VERSION) * 100 +
                    VERSION_TO_DAY(GLASS_FORMAT_VERSION));
+        msg += " and ";
+        msg += str(VERSION_TO_YEAR(GLASS_FORMAT_VERSION_CODEC) * 10000 +
+                   VERSION_TO_MONTH(GLASS_FORMAT_VERSION_CODEC) * 100 +
+                   VERSION_TO_DAY(GLASS_FORMAT_VERSION_CODEC));
         throw Xapian::DatabaseVersionError(msg);
     }
 
@@ -157,8 +171,9 @@ GlassVersion::read()
     if (!unpack_uint(&p, end, &rev))
         throw Xapian::DatabaseCorruptError("Rev file failed to decode revision");
 
+    bool with_codec = (version == GLASS_FORMAT_VERSION_CODEC);
     for (unsigned table_no = 0; table_no < Glass::MAX_; ++table_no) {
-        if (!root[table_no].unserialise(&p, end)) {
+        if (!root[table_no].unserialise(&p, end, with_codec)) {
             throw Xapian::DatabaseCorruptError("Rev file root_info missing");
         }
         old_root[table_no] = root[table_no];
@@ -273,13 +288,27 @@ GlassVersion::write(glass_revision_number_t new_rev, int flags)
 {
     LOGCALL(DB, const string, "GlassVersion::write", new_rev|flags);
 
+    bool with_codec = false;
+    for (unsigned table_no = 0; table_no < Glass::MAX_; ++table_no) {
+        if (root[table_no].get_compression() != Compression::ZLIB) {
+            with_codec = true;
+            break;
+        }
+    }
+
     string s(GLASS_VERSION_MAGIC, GLASS_VERSION_MAGIC_AND_VERSION_LEN);
+    if (with_codec) {
+        s[GLASS_VERSION_MAGIC_LEN] =
+            char((GLASS_FORMAT_VERSION_CODEC >> 8) & 0xff);
+        s[GLASS_VERSION_MAGIC_LEN + 1] =
+            char(GLASS_FORMAT_VERSION_CODEC & 0xff);
+    }
     s.append(uuid.data(), uuid.BINARY_SIZE);
 
     pack_uint(s, new_rev);
 
     for (unsigned table_no = 0; table_no < Glass::MAX_; ++table_no) {
-        root[table_no].serialise(s);
+        root[table_no].serialise(s, with_codec);
     }
 
     // Serialise database statistics.
@@ -414,19 +443,23 @@ static const uint4 compress_min_tab[] = {
 };
 
 void
-GlassVersion::create(unsigned blocksize)
+GlassVersion::create(unsigned blocksize, Compression::codec compression)
 {
     AssertRel(blocksize,>=,GLASS_MIN_BLOCKSIZE);
     uuid.generate();
     for (unsigned table_no = 0; table_no < Glass::MAX_; ++table_no) {
-        root[table_no].init(blocksize, compress_min_tab[table_no]);
+        uint4 compress_min = compress_min_tab[table_no];
+        // The codec only matters for tables which get compressed.
+        root[table_no].init(blocksize, compress_min,
+                            compress_min ? compression : Compression::ZLIB);
     }
 }
 
 namespace Glass {
 
 void
-RootInfo::init(unsigned blocksize_, uint4 compress_min_)
+RootInfo::init(unsigned blocksize_, uint4 compress_min_,
+               Compression::codec compression_)
 {
     AssertRel(blocksize_,>=,GLASS_MIN_BLOCKSIZE);
     root = 0;
@@ -436,11 +469,12 @@ RootInfo::init(unsigned blocksize_, uint4 compress_min_)
     sequential = true;
     blocksize = blocksize_;
     compress_min = compress_min_;
+    compression = compression_;
     fl_serialised.resize(0);
 }
 
 void
-RootInfo::serialise(string &s) const
+RootInfo::serialise(string &s, bool with_codec) const
 {
     pack_uint(s, root);
     unsigned val = level << 2;
@@ -450,19 +484,25 @@ RootInfo::serialise(string &s) const
     pack_uint(s, num_entries);
     pack_uint(s, blocksize >> 11);
     pack_uint(s, compress_min);
+    if (with_codec) pack_uint(s, unsigned(compression));
     pack_string(s, fl_serialised);
 }
 
 bool
-RootInfo::unserialise(const char ** p, const char * end)
+RootInfo::unserialise(const char ** p, const char * end, bool with_codec)
 {
     unsigned val, b;
+    unsigned c = Compression::ZLIB;
     if (!unpack_uint(p, end, &root) ||
         !unpack_uint(p, end, &val) ||
         !unpack_uint(p, end, &num_entries) ||
         !unpack_uint(p, end, &b) ||
         !unpack_uint(p, end, &compress_min) ||
+        (with_codec && !unpack_uint(p, end, &c)) ||
         !unpack_string(p, end, fl_serialised)) return false;
+    if (rare(c >= Compression::CODEC_MAX_))
+        throw Xapian::DatabaseCorruptError("Unknown compression codec");
+    compression = Compression::codec(c);
     auto level_ = val >> 2;
     if (rare(level_ >= GLASS_BTREE_CURSOR_LEVELS))
         throw Xapian::DatabaseCorruptError("Impossibly deep Btree");
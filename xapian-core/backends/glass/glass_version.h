@@ -32,6 +32,7 @@
 #include <string>
 
 #include "backends/uuids.h"
+#include "compression_stream.h"
 #include "internaltypes.h"
 #include "min_non_zero.h"
 #include "xapian/types.h"
@@ -47,14 +48,26 @@ class RootInfo {
     unsigned blocksize;
     /// Should be >= 4 or 0 for no compression.
     uint4 compress_min;
+    /// Codec to compress tags with.
+    Compression::codec compression;
     std::string fl_serialised;
 
   public:
-    void init(unsigned blocksize_, uint4 compress_min_);
+    void init(unsigned blocksize_, uint4 compress_min_,
+              Compression::codec compression_ = Compression::ZLIB);
 
-    void serialise(std::string &s) const;
+    /** Serialise.
+     *
+     *  @param with_codec  Include the compression codec (only supported by
+     *                     the newer format version).
+     */
+    void serialise(std::string &s, bool with_codec) const;
 
-    bool unserialise(const char ** p, const char * end);
+    /** Unserialise.
+     *
+     *  @param with_codec  Whether the compression codec is present.
+     */
+    bool unserialise(const char ** p, const char * end, bool with_codec);
 
     glass_block_t get_root() const { return root; }
     int get_level() const { return int(level); }
@@ -67,6 +80,7 @@ class RootInfo {
         return blocksize;
     }
     uint4 get_compress_min() const { return compress_min; }
+    Compression::codec get_compression() const { return compression; }
     const std::string & get_free_list() const { return fl_serialised; }
 
     void set_level(int level_) { level = unsigned(level_); }
@@ -80,6 +94,7 @@ class RootInfo {
         blocksize = b;
     }
     void set_free_list(const std::string & s) { fl_serialised = s; }
+    void set_compression(Compression::codec c) { compression = c; }
 };
 
 }
@@ -169,7 +184,8 @@ class GlassVersion {
     ~GlassVersion();
 
     /** Create the version file. */
-    void create(unsigned blocksize);
+    void create(unsigned blocksize,
+                Compression::codec compression = Compression::ZLIB);
 
     void set_changes(GlassChanges * changes_) { changes = changes_; }
 
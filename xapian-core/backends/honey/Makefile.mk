@@ -5,6 +5,7 @@ if BUILD_BACKEND_HONEY
 noinst_HEADERS +=\
 	backends/honey/honey_alldocspostlist.h\
 	backends/honey/honey_alltermslist.h\
+	backends/honey/honey_bloom.h\
 	backends/honey/honey_check.h\
 	backends/honey/honey_cursor.h\
 	backends/honey/honey_database.h\
@@ -0,0 +1,159 @@
+/** @file
+ * @brief Bloom filter over the keys in a honey table
+ */
+/* Copyright (C) 2026 Olly Betts
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef XAPIAN_INCLUDED_HONEY_BLOOM_H
+#define XAPIAN_INCLUDED_HONEY_BLOOM_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "pack.h"
+
+namespace Honey {
+
+/** Bloom filter over the keys in a table.
+ *
+ *  This allows us to answer most lookups for keys which aren't present
+ *  without reading from the table.  We use about 10 bits per key and 7 hash
+ *  functions, which gives a false positive rate of a little under 1%.
+ *
+ *  The serialised form is a byte giving the number of hash functions, then
+ *  the length in bytes of the bit array packed with pack_uint(), then the bit
+ *  array itself.  The hash function must not change as it's part of the
+ *  on-disk format.
+ */
+class BloomFilter {
+    /// Number of hash functions, or 0 if there's no filter.
+    unsigned num_hashes = 0;
+
+    /// The bit array.
+    std::string bits;
+
+    /// Number of bits in the filter to use per key.
+    static constexpr unsigned BITS_PER_KEY = 10;
+
+    /// Number of hash functions to use when building a filter.
+    static constexpr unsigned NUM_HASHES = 7;
+
+    /** Hash @a key.
+     *
+     *  This is 64-bit FNV-1a with the finalisation step from MurmurHash3
+     *  added, since we derive the bit positions from both halves of the
+     *  result.
+     */
+    static std::uint64_t hash(std::string_view key) {
+        std::uint64_t h = 0xcbf29ce484222325ULL;
+        for (unsigned char ch : key) {
+            h ^= ch;
+            h *= 0x100000001b3ULL;
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    /** Call @a f with each of the @a k bit positions for hash @a h.
+     *
+     *  Uses double hashing to derive the positions from two 32-bit hashes.
+     *  Stops and returns false if @a f returns false.
+     */
+    template<typename F>
+    static bool for_each_bit(std::uint64_t h, unsigned k, std::uint64_t nbits,
+                             F f) {
+        std::uint64_t h1 = h & 0xffffffff;
+        std::uint64_t h2 = (h >> 32) | 1;
+        for (unsigned i = 0; i != k; ++i) {
+            if (!f((h1 + i * h2) % nbits)) return false;
+        }
+        return true;
+    }
+
+  public:
+    /// Is there a filter?
+    bool empty() const { return num_hashes == 0; }
+
+    /// Size of the bit array in bytes.
+    size_t size() const { return bits.size(); }
+
+    /** Might @a key be present?
+     *
+     *  If there's no filter then this always returns true.
+     */
+    bool may_contain(std::string_view key) const {
+        if (num_hashes == 0) return true;
+        auto nbits = std::uint64_t(bits.size()) * 8;
+        return for_each_bit(hash(key), num_hashes, nbits,
+                            [&](std::uint64_t b) {
+                                unsigned char byte = bits[b >> 3];
+                                return ((byte >> (b & 7)) & 1) != 0;
+                            });
+    }
+
+    /** Start building an empty filter sized for @a num_keys keys.
+     *
+     *  Keys are added to the bit array as they're added, so the size has to
+     *  be picked up front.  If more keys than this are added the filter
+     *  still works, but the false positive rate will be higher.
+     */
+    void init(std::uint64_t num_keys) {
+        // Use at least 64 bits so a table with few keys still gets a filter
+        // with a sensible false positive rate.
+        auto nbits = std::max(num_keys * BITS_PER_KEY, std::uint64_t(64));
+        bits.assign(size_t(nbits / 8), '\0');
+        num_hashes = NUM_HASHES;
+    }
+
+    /// Add @a key when building a filter.
+    void add(std::string_view key) {
+        auto nbits = std::uint64_t(bits.size()) * 8;
+        for_each_bit(hash(key), num_hashes, nbits,
+                     [&](std::uint64_t b) {
+                         bits[b >> 3] |= char(1 << (b & 7));
+                         return true;
+                     });
+    }
+
+    /// Append the serialised filter to @a out.
+    void serialise(std::string& out) const {
+        out += char(num_hashes);
+        pack_uint(out, bits.size());
+        out += bits;
+    }
+
+    /** Set the filter from its serialised parts.
+     *
+     *  @param k      The number of hash functions.
+     *  @param bits_  The bit array.
+     */
+    void assign(unsigned k, std::string&& bits_) {
+        num_hashes = bits_.empty() ? 0 : k;
+        bits = std::move(bits_);
+    }
+};
+
+}
+
+#endif // XAPIAN_INCLUDED_HONEY_BLOOM_H
@@ -26,7 +26,9 @@
 #include "xapian/types.h"
 
 #include <algorithm>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <type_traits>
 
@@ -37,6 +39,7 @@
 #include "honey_cursor.h"
 #include "honey_database.h"
 #include "honey_defs.h"
+#include "honey_positionlist.h"
 #include "honey_postlist_encodings.h"
 #include "honey_table.h"
 #include "honey_values.h"
@@ -45,6 +48,7 @@
 #include "internaltypes.h"
 #include "overflow.h"
 #include "pack.h"
+#include "parallel.h"
 #include "stringutils.h"
 #include "backends/valuestats.h"
 #include "wordaccess.h"
@@ -308,8 +312,6 @@ class PostlistCursor<const GlassTable&> : private GlassCursor {
 
     glass_tablesize_t value_chunk_count = 0;
 
-    Xapian::valueno slot;
-
   public:
     string key, tag;
     Xapian::docid firstdid;
@@ -318,6 +320,10 @@ class PostlistCursor<const GlassTable&> : private GlassCursor {
     Xapian::termcount first_wdf;
     Xapian::termcount wdf_max;
     bool have_wdfs;
+    /// The slot for the current value stats or value chunk entry.
+    Xapian::valueno slot;
+    /// Glass value chunks are converted to VALUE_CHUNK_STREAM encoding.
+    bool value_columns = false;
 
     PostlistCursor(const GlassTable* in, Xapian::docid offset_)
         : GlassCursor(in), offset(offset_), firstdid(0)
@@ -402,6 +408,7 @@ start_value_chunk:
             }
 
             key = Honey::make_valuechunk_key(slot, last_did);
+            chunk_lastdid = last_did;
 
             // Add the docid delta across the chunk to the start of the tag.
             string newtag;
@@ -592,6 +599,9 @@ template<>
 class PostlistCursor<const HoneyTable&> : private HoneyCursor {
     Xapian::docid offset;
 
+    /// Are postings in the input block encoded?
+    bool blocks;
+
   public:
     string key, tag;
     Xapian::docid firstdid;
@@ -601,10 +611,23 @@ class PostlistCursor<const HoneyTable&> : private HoneyCursor {
     Xapian::termcount first_wdf;
     Xapian::termcount wdf_max;
     bool have_wdfs;
+    /// The slot for the current value chunk entry.
+    Xapian::valueno slot;
+    /// Do value chunks in the input start with a byte giving their encoding?
+    bool value_columns;
 
     PostlistCursor(const HoneyTable* in, Xapian::docid offset_)
-        : HoneyCursor(in), offset(offset_), firstdid(0)
+        : HoneyCursor(in), offset(offset_),
+          blocks(in->get_format_flags() & Honey::FORMAT_BLOCK_POSTINGS),
+          firstdid(0),
+          value_columns(in->get_format_flags() & Honey::FORMAT_VALUE_COLUMNS)
     {
+        if (in->get_format_flags() & Honey::FORMAT_IMPACTS) {
+            // The wdfs needed to calculate the impacts have been discarded.
+            throw Xapian::InvalidOperationError("Can't compact a honey "
+                                                "database which stores "
+                                                "impacts");
+        }
         rewind();
     }
 
@@ -623,7 +646,6 @@ class PostlistCursor<const HoneyTable&> : private HoneyCursor {
                 const char* p = key.data();
                 const char* end = p + key.length();
                 p += 2;
-                Xapian::valueno slot;
                 if (p[-1] != char(Honey::KEY_VALUE_CHUNK_HI)) {
                     slot = p[-1] - Honey::KEY_VALUE_CHUNK;
                 } else {
@@ -633,7 +655,8 @@ class PostlistCursor<const HoneyTable&> : private HoneyCursor {
                 Xapian::docid did;
                 if (!unpack_uint_preserving_sort(&p, end, &did))
                     throw Xapian::DatabaseCorruptError("bad value key");
-                key = Honey::make_valuechunk_key(slot, did + offset);
+                chunk_lastdid = did + offset;
+                key = Honey::make_valuechunk_key(slot, chunk_lastdid);
                 return true;
             }
             case Honey::KEY_DOCLEN_CHUNK: {
@@ -744,6 +767,13 @@ class PostlistCursor<const HoneyTable&> : private HoneyCursor {
             }
             tag.erase(0, d - tag.data());
         }
+        if (blocks && !tag.empty()) {
+            // Convert to the unblocked encoding for merging.
+            string postings;
+            Honey::decode_postings_blocks(tag.data(), tag.data() + tag.size(),
+                                          have_wdfs, postings);
+            swap(tag, postings);
+        }
         UNSIGNED_OVERFLOW_OK(firstdid += offset);
         UNSIGNED_OVERFLOW_OK(chunk_lastdid += offset);
         return true;
@@ -769,12 +799,147 @@ class PostlistCursorGt {
     }
 };
 
+/** Convert the postings in @a tag after @a header_len bytes to blocks.
+ *
+ *  Used when writing a postlist table with Honey::FORMAT_BLOCK_POSTINGS set.
+ */
+static void
+encode_chunk_blocks(string& tag, size_t header_len, bool have_wdfs)
+{
+    string result(tag, 0, header_len);
+    Honey::encode_postings_blocks(tag.data() + header_len,
+                                  tag.data() + tag.size(),
+                                  have_wdfs, result);
+    swap(tag, result);
+}
+
+/** Calculates quantised impacts for Xapian::DBCOMPACT_IMPACTS.
+ *
+ *  The impact of a posting is the part of the weight which BM25Weight gives
+ *  it with the default parameters that depends on the wdf and document
+ *  length.  This is always less than 1, so it's scaled by 255 and rounded to
+ *  the nearest integer.  Honey doesn't allow a term to have both zero and
+ *  non-zero wdfs, so an impact which would round to 0 is stored as 1.
+ *
+ *  The term weight isn't included - ImpactWeight calculates it from the
+ *  statistics for the whole search, so impacts from shards compacted
+ *  separately can be combined.
+ */
+class ImpactCalculator {
+    /// BM25Weight's default parameters.
+    static constexpr double K1 = 1.0;
+    static constexpr double B = 0.5;
+    static constexpr double MIN_NORMLEN = 0.5;
+
+    /// The doclen chunks from the output database, in docid order.
+    vector<pair<Xapian::docid, string>> doclen_chunks;
+
+    Xapian::doccount doccount = 0;
+
+    Xapian::totallength total_length = 0;
+
+    /// Multiplier to convert a document length to a normalised length.
+    double len_factor = 0;
+
+    /// Return the length of document @a did.
+    Xapian::termcount get_doclength(Xapian::docid did) const {
+        auto it = lower_bound(doclen_chunks.begin(), doclen_chunks.end(), did,
+                              [](const pair<Xapian::docid, string>& chunk,
+                                 Xapian::docid d) {
+                                  return chunk.first < d;
+                              });
+        if (it != doclen_chunks.end()) {
+            const string& tag = it->second;
+            size_t width = tag[0] / 8;
+            Xapian::docid distance_from_last = it->first - did;
+            if (distance_from_last < (tag.size() - 1) / width) {
+                auto q = reinterpret_cast<const unsigned char*>(tag.data()) +
+                         tag.size() - width * (distance_from_last + 1);
+                Xapian::termcount doclen;
+                switch (width) {
+                    case 1:
+                        doclen = *q;
+                        if (doclen != 0xff) return doclen;
+                        break;
+                    case 2:
+                        doclen = unaligned_read2(q);
+                        if (doclen != 0xffff) return doclen;
+                        break;
+                    case 3:
+                        doclen = unaligned_read4(q - 1) & 0xffffff;
+                        if (doclen != 0xffffff) return doclen;
+                        break;
+                    default:
+                        doclen = unaligned_read4(q);
+                        if (doclen != 0xffffffff) return doclen;
+                        break;
+                }
+            }
+        }
+        throw Xapian::DatabaseCorruptError("Posting for document with no "
+                                           "document length");
+    }
+
+  public:
+    /** Add a doclen chunk.
+     *
+     *  Chunks must be added in ascending docid order.
+     */
+    void add_doclen_chunk(Xapian::docid chunk_lastdid, const string& tag) {
+        size_t width = tag[0] / 8;
+        auto p = reinterpret_cast<const unsigned char*>(tag.data()) + 1;
+        auto end = p + (tag.size() - 1);
+        Xapian::termcount unused = 0xffffffff >> (32 - 8 * width);
+        while (p != end) {
+            Xapian::termcount doclen;
+            switch (width) {
+                case 1:
+                    doclen = *p;
+                    break;
+                case 2:
+                    doclen = unaligned_read2(p);
+                    break;
+                case 3:
+                    doclen = unaligned_read4(p - 1) & 0xffffff;
+                    break;
+                default:
+                    doclen = unaligned_read4(p);
+                    break;
+            }
+            if (doclen != unused) {
+                ++doccount;
+                total_length += doclen;
+            }
+            p += width;
+        }
+        doclen_chunks.emplace_back(chunk_lastdid, tag);
+    }
+
+    /// Finish setting up once all the doclen chunks have been added.
+    void finalise() {
+        if (total_length) len_factor = double(doccount) / total_length;
+    }
+
+    /// Return the impact for a posting.
+    Xapian::termcount get_impact(Xapian::docid did,
+                                 Xapian::termcount wdf) const {
+        double normlen = max(get_doclength(did) * len_factor, MIN_NORMLEN);
+        double wdf_double = wdf;
+        double w = wdf_double / (K1 * (normlen * B + (1 - B)) + wdf_double);
+        auto impact = Xapian::termcount(w * 255 + 0.5);
+        return min(max(impact, Xapian::termcount(1)), Xapian::termcount(255));
+    }
+};
+
 // U : vector<HoneyTable*>::const_iterator
 template<typename T, typename U> void
 merge_postlists(Xapian::Compactor* compactor,
                 T* out, vector<Xapian::docid>::const_iterator offset,
                 U b, U e)
 {
+    bool blocks = (out->get_format_flags() & Honey::FORMAT_BLOCK_POSTINGS);
+    bool impacts = (out->get_format_flags() & Honey::FORMAT_IMPACTS);
+    ImpactCalculator impact_calc;
     typedef decltype(**b) table_type; // E.g. HoneyTable
     typedef PostlistCursor<table_type> cursor_type;
     typedef PostlistCursorGt<cursor_type> gt_type;
@@ -916,11 +1081,29 @@ merge_postlists(Xapian::Compactor* compactor,
     }
 
     // Merge valuestream chunks.
+    bool value_columns = (out->get_format_flags() &
+                          Honey::FORMAT_VALUE_COLUMNS);
+    Honey::ValueChunkWriter value_writer(*out, value_columns);
     while (!pq.empty()) {
         cursor_type* cur = pq.top();
         const string& key = cur->key;
         if (key_type(key) != Honey::KEY_VALUE_CHUNK) break;
-        out->add(key, cur->tag);
+        if (!value_columns && !cur->value_columns) {
+            // The chunk is already in the output encoding.
+            value_writer.flush();
+            out->add(key, cur->tag);
+        } else {
+            // Rechunk so we can pick the best encoding for each chunk.
+            const string& tag = cur->tag;
+            Honey::ValueChunkReader reader(tag.data(), tag.size(),
+                                           cur->chunk_lastdid,
+                                           cur->value_columns);
+            while (!reader.at_end()) {
+                value_writer.append(cur->slot, reader.get_docid(),
+                                    reader.get_value());
+                reader.next();
+            }
+        }
         pq.pop();
         if (cur->next()) {
             pq.push(cur);
@@ -928,6 +1111,7 @@ merge_postlists(Xapian::Compactor* compactor,
             delete cur;
         }
     }
+    value_writer.flush();
 
     // Merge doclen chunks.
     while (!pq.empty()) {
@@ -997,7 +1181,9 @@ merge_postlists(Xapian::Compactor* compactor,
             }
         }
         out->add(Honey::make_doclenchunk_key(chunk_lastdid), tag);
+        if (impacts) impact_calc.add_doclen_chunk(chunk_lastdid, tag);
     }
+    if (impacts) impact_calc.finalise();
 
     struct HoneyPostListChunk {
         Xapian::docid first, last;
@@ -1053,10 +1239,38 @@ merge_postlists(Xapian::Compactor* compactor,
             return data.size() * 2u;
         }
 
+        /// Append the postings in this chunk to @a postings.
+        void get_postings(vector<pair<Xapian::docid,
+                                      Xapian::termcount>>& postings) const {
+            postings.emplace_back(first, first_wdf);
+            if (data.empty()) {
+                if (tf == 2) postings.emplace_back(last, cf - first_wdf);
+                return;
+            }
+
+            // The wdf of the second and subsequent entries if not stored.
+            Xapian::termcount wdf = tf ? (cf - first_wdf) / (tf - 1)
+                                       : first_wdf;
+            Xapian::docid did = first;
+            const char* pos = data.data();
+            const char* pos_end = pos + data.size();
+            while (pos != pos_end) {
+                Xapian::docid delta;
+                if (!unpack_uint(&pos, pos_end, &delta))
+                    throw_database_corrupt("Decoding docid delta", pos);
+                did += delta + 1;
+                if (have_wdfs && !unpack_uint(&pos, pos_end, &wdf))
+                    throw_database_corrupt("Decoding wdf", pos);
+                postings.emplace_back(did, wdf);
+            }
+        }
+
         /// Append postings to tag, which should only contain the chunk header.
         void append_postings_to(string& tag, bool want_wdfs) {
             if (data.empty()) {
-                if (tf == 1) {
+                if (tf < 2) {
+                    // A single entry, or a continuation chunk with only the
+                    // entry in its header.
                     return;
                 }
                 AssertEq(tf, 2);
@@ -1111,6 +1325,10 @@ merge_postlists(Xapian::Compactor* compactor,
     };
     vector<HoneyPostListChunk> tags;
 
+    // Used when replacing wdfs with impacts.
+    vector<pair<Xapian::docid, Xapian::termcount>> postings;
+    vector<Xapian::termcount> impact_values;
+
     Xapian::termcount tf = 0, cf = 0; // Initialise to avoid warnings.
 
     while (true) {
@@ -1123,6 +1341,41 @@ merge_postlists(Xapian::Compactor* compactor,
             AssertEq(key_type(cur->key), Honey::KEY_POSTING_CHUNK);
         }
         if (cur == NULL || cur->key != last_key) {
+            if (impacts && cf != 0) {
+                // Replace the wdfs with impacts, rechunking as we go.  If cf
+                // is zero then all the wdfs are zero and so are the impacts.
+                postings.clear();
+                for (auto& chunk : tags) chunk.get_postings(postings);
+                AssertEq(postings.size(), tf);
+                impact_values.clear();
+                cf = 0;
+                for (auto& posting : postings) {
+                    auto impact = impact_calc.get_impact(posting.first,
+                                                         posting.second);
+                    impact_values.push_back(impact);
+                    cf += impact;
+                }
+                tags.clear();
+                size_t i = 0;
+                while (i != postings.size()) {
+                    Xapian::docid first = postings[i].first;
+                    Xapian::termcount first_impact = impact_values[i];
+                    Xapian::termcount impact_max = first_impact;
+                    Xapian::docid did = first;
+                    string data;
+                    while (++i != postings.size() &&
+                           data.size() < HONEY_POSTLIST_CHUNK_MAX / 2) {
+                        pack_uint(data, postings[i].first - did - 1);
+                        did = postings[i].first;
+                        pack_uint(data, impact_values[i]);
+                        impact_max = max(impact_max, impact_values[i]);
+                    }
+                    bool initial = tags.empty();
+                    tags.emplace_back(first, did, first_impact, impact_max,
+                                      initial ? tf : 0, initial ? cf : 0,
+                                      true, std::move(data));
+                }
+            }
             if (!tags.empty()) {
                 Xapian::termcount first_wdf = tags[0].first_wdf;
                 Xapian::docid chunk_lastdid = tags[0].last;
@@ -1187,11 +1440,15 @@ merge_postlists(Xapian::Compactor* compactor,
 
                 if (tf > 2) {
                     // If tf <= 2 there's no explicit posting data.
+                    size_t header_len = first_tag.size();
                     tags[0].append_postings_to(first_tag, have_wdfs);
                     for (size_t chunk = 1; chunk != j; ++chunk) {
                         tags[chunk].append_postings_to(first_tag, have_wdfs,
                                                        tags[chunk - 1].last);
                     }
+                    if (blocks) {
+                        encode_chunk_blocks(first_tag, header_len, have_wdfs);
+                    }
                 }
                 out->add(last_key, first_tag);
 
@@ -1228,11 +1485,15 @@ merge_postlists(Xapian::Compactor* compactor,
                                                              tag);
                         }
 
+                        size_t header_len = tag.size();
                         tags[i].append_postings_to(tag, have_wdfs);
                         while (++i != j) {
                             tags[i].append_postings_to(tag, have_wdfs,
                                                        tags[i - 1].last);
                         }
+                        if (blocks) {
+                            encode_chunk_blocks(tag, header_len, have_wdfs);
+                        }
 
                         out->add(pack_honey_postlist_key(term, last_did), tag);
                     }
@@ -1310,6 +1571,8 @@ merge_spellings(HoneyTable* out,
     priority_queue<cursor_type*, vector<cursor_type*>, gt_type> pq;
     for ( ; b != e; ++b) {
         auto in = *b;
+        // Skip tables which don't exist in this input.
+        if (in->empty()) continue;
         auto cursor = new cursor_type(in);
         if (cursor->next()) {
             pq.push(cursor);
@@ -1348,8 +1611,11 @@ merge_spellings(HoneyTable* out,
         // only efficiently move forwards.
         //
         // Note that the key ordering is the same for glass and honey, which
-        // makes translating during compaction simpler.
-        string key = cur->current_key;
+        // makes translating during compaction simpler - but we still need to
+        // compare the glass keys when checking for the same key in other
+        // inputs.
+        string glass_key = cur->current_key;
+        string key = glass_key;
         switch (key[0]) {
             case 'B':
                 key[0] = Honey::KEY_PREFIX_BOOKEND;
@@ -1376,7 +1642,7 @@ merge_spellings(HoneyTable* out,
             }
         }
 
-        if (pq.empty() || pq.top()->current_key > key) {
+        if (pq.empty() || pq.top()->current_key > glass_key) {
             // No merging to do for this key so just copy the tag value,
             // adjusting if necessary.  If we don't need to adjust it, just
             // copy the compressed value.
@@ -1442,7 +1708,7 @@ merge_spellings(HoneyTable* out,
                 cur->read_tag();
                 pqtag.push(new PrefixCompressedStringItor(cur->current_tag));
                 vec.push_back(cur);
-                if (pq.empty() || pq.top()->current_key != key) break;
+                if (pq.empty() || pq.top()->current_key != glass_key) break;
                 cur = pq.top();
                 pq.pop();
             }
@@ -1490,7 +1756,7 @@ merge_spellings(HoneyTable* out,
                 } else {
                     delete cur;
                 }
-                if (pq.empty() || pq.top()->current_key != key) break;
+                if (pq.empty() || pq.top()->current_key != glass_key) break;
                 cur = pq.top();
                 pq.pop();
             }
@@ -1512,6 +1778,8 @@ merge_spellings(HoneyTable* out,
     priority_queue<cursor_type*, vector<cursor_type*>, gt_type> pq;
     for ( ; b != e; ++b) {
         auto in = *b;
+        // Skip tables which don't exist in this input.
+        if (in->empty()) continue;
         auto cursor = new cursor_type(in);
         if (cursor->next()) {
             pq.push(cursor);
@@ -1627,6 +1895,8 @@ merge_synonyms(T* out, U b, U e)
     priority_queue<cursor_type*, vector<cursor_type*>, gt_type> pq;
     for ( ; b != e; ++b) {
         auto in = *b;
+        // Skip tables which don't exist in this input.
+        if (in->empty()) continue;
         auto cursor = new cursor_type(in);
         if (cursor->next()) {
             pq.push(cursor);
@@ -1708,7 +1978,8 @@ template<typename T, typename U> void
 multimerge_postlists(Xapian::Compactor* compactor,
                      T* out, const char* tmpdir,
                      const vector<U*>& in,
-                     vector<Xapian::docid> off)
+                     vector<Xapian::docid> off,
+                     unsigned threads)
 {
     if (in.size() <= 3) {
         merge_postlists(compactor, out, off.begin(), in.begin(), in.end());
@@ -1720,6 +1991,8 @@ multimerge_postlists(Xapian::Compactor* compactor,
     {
         vector<Xapian::docid> newoff;
         newoff.resize(in.size() / 2);
+        // The merges in each pass are independent, so can be run in parallel.
+        vector<function<void()>> tasks;
         for (unsigned int i = 0, j; i < in.size(); i = j) {
             j = i + 2;
             if (j == in.size() - 1) ++j;
@@ -1732,21 +2005,24 @@ multimerge_postlists(Xapian::Compactor* compactor,
             dest += '.';
 
             HoneyTable* tmptab = new HoneyTable("postlist", dest, false);
-
-            // Don't compress entries in temporary tables, even if the final
-            // table would do so.  Any already compressed entries will get
-            // copied in compressed form.
-            Honey::RootInfo root_info;
-            root_info.init(0);
-            const int flags = Xapian::DB_DANGEROUS|Xapian::DB_NO_SYNC;
-            tmptab->create_and_open(flags, root_info);
-
-            merge_postlists(compactor, tmptab, off.begin() + i,
-                            in.begin() + i, in.begin() + j);
             tmp.push_back(tmptab);
-            tmptab->flush_db();
-            tmptab->commit(1, &root_info);
-        }
+
+            tasks.emplace_back([&, i, j, tmptab]() {
+                // Don't compress entries in temporary tables, even if the
+                // final table would do so.  Any already compressed entries
+                // will get copied in compressed form.
+                Honey::RootInfo root_info;
+                root_info.init(0);
+                const int flags = Xapian::DB_DANGEROUS|Xapian::DB_NO_SYNC;
+                tmptab->create_and_open(flags, root_info);
+
+                merge_postlists(compactor, tmptab, off.begin() + i,
+                                in.begin() + i, in.begin() + j);
+                tmptab->flush_db();
+                tmptab->commit(1, &root_info);
+            });
+        }
+        run_parallel(tasks, threads);
         swap(off, newoff);
         ++c;
     }
@@ -1756,6 +2032,7 @@ multimerge_postlists(Xapian::Compactor* compactor,
         tmpout.reserve(tmp.size() / 2);
         vector<Xapian::docid> newoff;
         newoff.resize(tmp.size() / 2);
+        vector<function<void()>> tasks;
         for (unsigned int i = 0, j; i < tmp.size(); i = j) {
             j = i + 2;
             if (j == tmp.size() - 1) ++j;
@@ -1768,28 +2045,31 @@ multimerge_postlists(Xapian::Compactor* compactor,
             dest += '.';
 
             HoneyTable* tmptab = new HoneyTable("postlist", dest, false);
+            tmpout.push_back(tmptab);
 
-            // Don't compress entries in temporary tables, even if the final
-            // table would do so.  Any already compressed entries will get
-            // copied in compressed form.
-            Honey::RootInfo root_info;
-            root_info.init(0);
-            const int flags = Xapian::DB_DANGEROUS|Xapian::DB_NO_SYNC;
-            tmptab->create_and_open(flags, root_info);
-
-            merge_postlists(compactor, tmptab, off.begin() + i,
-                            tmp.begin() + i, tmp.begin() + j);
-            if (c > 0) {
-                for (unsigned int k = i; k < j; ++k) {
-                    // FIXME: unlink(tmp[k]->get_path().c_str());
-                    delete tmp[k];
-                    tmp[k] = NULL;
+            tasks.emplace_back([&, i, j, tmptab]() {
+                // Don't compress entries in temporary tables, even if the
+                // final table would do so.  Any already compressed entries
+                // will get copied in compressed form.
+                Honey::RootInfo root_info;
+                root_info.init(0);
+                const int flags = Xapian::DB_DANGEROUS|Xapian::DB_NO_SYNC;
+                tmptab->create_and_open(flags, root_info);
+
+                merge_postlists(compactor, tmptab, off.begin() + i,
+                                tmp.begin() + i, tmp.begin() + j);
+                if (c > 0) {
+                    for (unsigned int k = i; k < j; ++k) {
+                        // FIXME: unlink(tmp[k]->get_path().c_str());
+                        delete tmp[k];
+                        tmp[k] = NULL;
+                    }
                 }
-            }
-            tmpout.push_back(tmptab);
-            tmptab->flush_db();
-            tmptab->commit(1, &root_info);
+                tmptab->flush_db();
+                tmptab->commit(1, &root_info);
+            });
         }
+        run_parallel(tasks, threads);
         swap(tmp, tmpout);
         swap(off, newoff);
         ++c;
@@ -1814,6 +2094,8 @@ class PositionCursor<const GlassTable&> : private GlassCursor {
   public:
     string key;
     Xapian::docid firstdid;
+    /// Glass position lists use the same encoding as unblocked honey ones.
+    bool blocks = false;
 
     PositionCursor(const GlassTable* in, Xapian::docid offset_)
         : GlassCursor(in), offset(offset_), firstdid(0) {
@@ -1852,9 +2134,12 @@ class PositionCursor<const HoneyTable&> : private HoneyCursor {
   public:
     string key;
     Xapian::docid firstdid;
+    /// Are the position lists stored in blocks?
+    bool blocks;
 
     PositionCursor(const HoneyTable* in, Xapian::docid offset_)
-        : HoneyCursor(in), offset(offset_), firstdid(0) {
+        : HoneyCursor(in), offset(offset_), firstdid(0),
+          blocks(in->get_format_flags() & Honey::FORMAT_BLOCK_POSITIONS) {
         rewind();
     }
 
@@ -1911,10 +2196,25 @@ merge_positions(T* out, const vector<U*>& inputs,
         }
     }
 
+    bool blocks = (out->get_format_flags() & Honey::FORMAT_BLOCK_POSITIONS);
+    Xapian::VecCOW<Xapian::termpos> positions;
+    string tag;
     while (!pq.empty()) {
         cursor_type* cur = pq.top();
         pq.pop();
-        out->add(cur->key, cur->get_tag());
+        if (cur->blocks == blocks) {
+            out->add(cur->key, cur->get_tag());
+        } else {
+            // Convert between interpolative coding and blocks.
+            HoneyPositionList pl(string(cur->get_tag()), cur->blocks);
+            positions.clear();
+            while (pl.next()) {
+                positions.push_back(pl.get_position());
+            }
+            tag.resize(0);
+            HoneyPositionTable::encode(tag, positions, blocks);
+            out->add(cur->key, tag);
+        }
         if (cur->next()) {
             pq.push(cur);
         } else {
@@ -2202,6 +2502,38 @@ HoneyDatabase::compact(Xapian::Compactor* compactor,
 
     bool single_file = (flags & Xapian::DBCOMPACT_SINGLE_FILE);
     bool multipass = (flags & Xapian::DBCOMPACT_MULTIPASS);
+    bool block_postings = (flags & Xapian::DBCOMPACT_BLOCK_POSTINGS);
+    bool bloom_filters = (flags & Xapian::DBCOMPACT_BLOOM_FILTERS);
+    bool block_positions = (flags & Xapian::DBCOMPACT_BLOCK_POSITIONS);
+    bool value_columns = (flags & Xapian::DBCOMPACT_VALUE_COLUMNS);
+    bool impacts = (flags & Xapian::DBCOMPACT_IMPACTS);
+    // Compressed tags are copied as they are, so a table needs
+    // FORMAT_TAG_CODECS if any of the corresponding input tables might
+    // contain tags compressed with a codec other than zlib.
+    bool tag_codecs[Honey::MAX_] = { };
+    auto table_format_flags = [&](Honey::table_type type) {
+        unsigned format_flags = 0;
+        if (tag_codecs[type]) {
+            format_flags |= Honey::FORMAT_TAG_CODECS;
+        }
+        if (type == Honey::POSTLIST && block_postings) {
+            format_flags |= Honey::FORMAT_BLOCK_POSTINGS;
+        }
+        if (type == Honey::POSTLIST && value_columns) {
+            format_flags |= Honey::FORMAT_VALUE_COLUMNS;
+        }
+        if (type == Honey::POSTLIST && impacts) {
+            format_flags |= Honey::FORMAT_IMPACTS;
+        }
+        if ((type == Honey::POSTLIST || type == Honey::TERMLIST) &&
+            bloom_filters) {
+            format_flags |= Honey::FORMAT_BLOOM_FILTER;
+        }
+        if (type == Honey::POSITION && block_positions) {
+            format_flags |= Honey::FORMAT_BLOCK_POSITIONS;
+        }
+        return format_flags;
+    };
     if (single_file) {
         // FIXME: Support this combination - we need to put temporary files
         // somewhere.
@@ -2259,6 +2591,14 @@ HoneyDatabase::compact(Xapian::Compactor* compactor,
     // and off_t is 32 bit) or one of the totals overflowed.
     bool bad_totals = false;
     file_size_type in_total = 0, out_total = 0;
+    // Protects bad_totals and out_total, which are updated by the tasks.
+    ParallelMutex totals_mutex;
+
+    unsigned threads = compactor ? compactor->get_threads() : 1;
+    if (single_file) {
+        // The tables are written one after another to the same file.
+        threads = 1;
+    }
 
     version_file_out->create();
     for (size_t i = 0; i != sources.size(); ++i) {
@@ -2280,6 +2620,15 @@ HoneyDatabase::compact(Xapian::Compactor* compactor,
                                v_in.get_spelling_wordfreq_upper_bound(),
                                0,
                                0);
+            static_assert(unsigned(Glass::MAX_) == unsigned(Honey::MAX_),
+                          "Glass and honey have the same tables");
+            for (unsigned t = 0; t != Honey::MAX_; ++t) {
+                auto type = Glass::table_type(t);
+                if (v_in.get_root(type).get_compression() !=
+                    Compression::ZLIB) {
+                    tag_codecs[t] = true;
+                }
+            }
             source_single_file = db->single_file();
 #else
             Assert(false);
@@ -2287,6 +2636,13 @@ HoneyDatabase::compact(Xapian::Compactor* compactor,
         } else {
             auto db = static_cast<const HoneyDatabase*>(sources[i]);
             version_file_out->merge_stats(db->version_file);
+            for (unsigned t = 0; t != Honey::MAX_; ++t) {
+                auto type = Honey::table_type(t);
+                if (db->version_file.get_root(type).get_format_flags() &
+                    Honey::FORMAT_TAG_CODECS) {
+                    tag_codecs[t] = true;
+                }
+            }
             source_single_file = db->single_file();
         }
         if (source_single_file) {
@@ -2319,8 +2675,10 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
 #ifndef XAPIAN_HAS_GLASS_BACKEND
     throw Xapian::FeatureUnavailableError("Glass backend disabled");
 #else
-    vector<HoneyTable*> tabs;
-    tabs.reserve(std::end(tables) - std::begin(tables));
+    // The merge for each table is done by a separate task, and the tables
+    // are independent so the tasks can be run in parallel.
+    vector<function<void()>> tasks;
+    vector<unique_ptr<HoneyTable>> tabs(std::end(tables) - std::begin(tables));
     file_size_type prev_size = 0;
     for (const auto& t : tables) {
         // The postlist table requires an N-way merge, adjusting the
@@ -2432,134 +2790,159 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
             continue;
         }
 
-        HoneyTable* out;
-        off_t table_start_offset = -1;
-        if (single_file) {
-            if (&t == tables) {
-                // Start first table HONEY_VERSION_MAX_SIZE bytes in to allow
-                // space for version file.  It's tricky to exactly know the
-                // size of the version file beforehand.
-                table_start_offset = lseek(fd, HONEY_VERSION_MAX_SIZE, SEEK_CUR);
-                if (table_start_offset < 0)
-                    throw Xapian::DatabaseError("lseek() failed", errno);
-            } else {
-                table_start_offset = lseek(fd, 0, SEEK_CUR);
-            }
-            out = new HoneyTable(t.name, fd, version_file_out->get_offset(),
-                                 false, false);
-        } else {
-            out = new HoneyTable(t.name, dest, false, t.lazy);
-        }
-        tabs.push_back(out);
         Honey::RootInfo* root_info = version_file_out->root_to_set(t.type);
-        if (single_file) {
-            root_info->set_free_list(fl_serialised);
-            root_info->set_offset(table_start_offset);
-            out->open(FLAGS,
-                      version_file_out->get_root(t.type),
-                      version_file_out->get_revision());
-        } else {
-            out->create_and_open(FLAGS, *root_info);
-        }
-
-        switch (t.type) {
-            case Honey::POSTLIST: {
-                if (multipass && inputs.size() > 3) {
-                    multimerge_postlists(compactor, out, destdir,
-                                         inputs, offset);
+        root_info->set_format_flags(table_format_flags(t.type));
+        tasks.emplace_back([&, dest, inputs, in_size, bad_stat, single_file_in,
+                            root_info]() mutable {
+            HoneyTable* out;
+            off_t table_start_offset = -1;
+            if (single_file) {
+                if (&t == tables) {
+                    // Start first table HONEY_VERSION_MAX_SIZE bytes in to
+                    // allow space for version file.  It's tricky to exactly
+                    // know the size of the version file beforehand.
+                    table_start_offset = lseek(fd, HONEY_VERSION_MAX_SIZE,
+                                               SEEK_CUR);
+                    if (table_start_offset < 0)
+                        throw Xapian::DatabaseError("lseek() failed", errno);
                 } else {
-                    merge_postlists(compactor, out, offset.begin(),
-                                    inputs.begin(), inputs.end());
+                    table_start_offset = lseek(fd, 0, SEEK_CUR);
                 }
-                break;
-            }
-            case Honey::SPELLING:
-                merge_spellings(out, inputs.cbegin(), inputs.cend());
-                break;
-            case Honey::SYNONYM:
-                merge_synonyms(out, inputs.begin(), inputs.end());
-                break;
-            case Honey::POSITION:
-                merge_positions(out, inputs, offset);
-                break;
-            default: {
-                // DocData, Termlist
-                auto& v_out = version_file_out;
-                auto ut_lb = v_out->get_unique_terms_lower_bound();
-                auto ut_ub = v_out->get_unique_terms_upper_bound();
-                merge_docid_keyed(out, inputs, offset, ut_lb, ut_ub, t.type);
-                version_file_out->set_unique_terms_lower_bound(ut_lb);
-                version_file_out->set_unique_terms_upper_bound(ut_ub);
-                break;
+                out = new HoneyTable(t.name, fd,
+                                     version_file_out->get_offset(),
+                                     false, false);
+            } else {
+                out = new HoneyTable(t.name, dest, false, t.lazy);
             }
-        }
-
-        // Commit as revision 1.
-        out->flush_db();
-        out->commit(1, root_info);
-        out->sync();
-        if (single_file) fl_serialised = root_info->get_free_list();
-
-        file_size_type out_size = 0;
-        if (!bad_stat && !single_file_in) {
-            file_size_type db_size;
+            tabs[&t - tables].reset(out);
             if (single_file) {
-                db_size = file_size(fd);
+                root_info->set_free_list(fl_serialised);
+                root_info->set_offset(table_start_offset);
+                out->open(FLAGS,
+                          version_file_out->get_root(t.type),
+                          version_file_out->get_revision());
             } else {
-                db_size = file_size(dest + HONEY_TABLE_EXTENSION);
+                out->create_and_open(FLAGS, *root_info);
             }
-            if (errno == 0) {
+            // The output has roughly as many keys as the inputs have entries.
+            honey_tablesize_t num_keys = 0;
+            for (auto table : inputs) {
+                num_keys += table->get_entry_count();
+            }
+            out->size_filter(num_keys);
+
+            switch (t.type) {
+                case Honey::POSTLIST: {
+                    if (multipass && inputs.size() > 3) {
+                        multimerge_postlists(compactor, out, destdir,
+                                             inputs, offset, threads);
+                    } else {
+                        merge_postlists(compactor, out, offset.begin(),
+                                        inputs.begin(), inputs.end());
+                    }
+                    break;
+                }
+                case Honey::SPELLING:
+                    merge_spellings(out, inputs.cbegin(), inputs.cend());
+                    break;
+                case Honey::SYNONYM:
+                    merge_synonyms(out, inputs.begin(), inputs.end());
+                    break;
+                case Honey::POSITION:
+                    merge_positions(out, inputs, offset);
+                    break;
+                default: {
+                    // DocData, Termlist.  Only the termlist table is used to
+                    // calculate the unique term bounds.
+                    bool termlist = (t.type == Honey::TERMLIST);
+                    auto& v_out = version_file_out;
+                    Xapian::termcount ut_lb = 0, ut_ub = 0;
+                    if (termlist) {
+                        ut_lb = v_out->get_unique_terms_lower_bound();
+                        ut_ub = v_out->get_unique_terms_upper_bound();
+                    }
+                    merge_docid_keyed(out, inputs, offset, ut_lb, ut_ub,
+                                      t.type);
+                    if (termlist) {
+                        v_out->set_unique_terms_lower_bound(ut_lb);
+                        v_out->set_unique_terms_upper_bound(ut_ub);
+                    }
+                    break;
+                }
+            }
+
+            // Commit as revision 1.
+            out->flush_db();
+            out->commit(1, root_info);
+            out->sync();
+            if (single_file) fl_serialised = root_info->get_free_list();
+
+            file_size_type out_size = 0;
+            if (!bad_stat && !single_file_in) {
+                file_size_type db_size;
                 if (single_file) {
-                    auto old_prev_size = prev_size;
-                    prev_size = db_size;
-                    db_size -= old_prev_size;
+                    db_size = file_size(fd);
+                } else {
+                    db_size = file_size(dest + HONEY_TABLE_EXTENSION);
                 }
-                if (add_overflows(out_total, db_size, out_total)) {
-                    bad_totals = true;
+                if (errno == 0) {
+                    if (single_file) {
+                        auto old_prev_size = prev_size;
+                        prev_size = db_size;
+                        db_size -= old_prev_size;
+                    }
+                    lock_guard<ParallelMutex> totals_lock(totals_mutex);
+                    if (add_overflows(out_total, db_size, out_total)) {
+                        bad_totals = true;
+                    }
+                    out_size = db_size / 1024;
+                } else if (errno != ENOENT) {
+                    lock_guard<ParallelMutex> totals_lock(totals_mutex);
+                    bad_totals = bad_stat = true;
                 }
-                out_size = db_size / 1024;
-            } else if (errno != ENOENT) {
-                bad_totals = bad_stat = true;
             }
-        }
-        if (bad_stat) {
-            if (compactor)
-                compactor->set_status(t.name,
-                                      "Done (couldn't stat all the DB files)");
-        } else if (single_file_in) {
-            if (compactor)
-                compactor->set_status(t.name,
-                                      "Done (table sizes unknown for single "
-                                      "file DB input)");
-        } else {
-            string status;
-            if (out_size == in_size) {
-                status = "Size unchanged (";
+            if (bad_stat) {
+                if (compactor)
+                    compactor->set_status(t.name,
+                                          "Done (couldn't stat all the DB "
+                                          "files)");
+            } else if (single_file_in) {
+                if (compactor)
+                    compactor->set_status(t.name,
+                                          "Done (table sizes unknown for "
+                                          "single file DB input)");
             } else {
-                file_size_type delta;
-                if (out_size < in_size) {
-                    delta = in_size - out_size;
-                    status = "Reduced by ";
+                string status;
+                if (out_size == in_size) {
+                    status = "Size unchanged (";
                 } else {
-                    delta = out_size - in_size;
-                    status = "INCREASED by ";
-                }
-                if (in_size) {
-                    status += str(100 * delta / in_size);
-                    status += "% ";
+                    file_size_type delta;
+                    if (out_size < in_size) {
+                        delta = in_size - out_size;
+                        status = "Reduced by ";
+                    } else {
+                        delta = out_size - in_size;
+                        status = "INCREASED by ";
+                    }
+                    if (in_size) {
+                        status += str(100 * delta / in_size);
+                        status += "% ";
+                    }
+                    status += str(delta);
+                    status += "K (";
+                    status += str(in_size);
+                    status += "K -> ";
                 }
-                status += str(delta);
-                status += "K (";
-                status += str(in_size);
-                status += "K -> ";
+                status += str(out_size);
+                status += "K)";
+                if (compactor)
+                    compactor->set_status(t.name, status);
             }
-            status += str(out_size);
-            status += "K)";
-            if (compactor)
-                compactor->set_status(t.name, status);
-        }
+        });
     }
 
+    run_parallel(tasks, threads);
+
     // If compacting to a single file output and all the tables are empty, pad
     // the output so that it isn't mistaken for a stub database when we try to
     // open it.  For this it needs to at least HONEY_MIN_DB_SIZE in size.
@@ -2591,23 +2974,24 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
         if (version_file_size < 0) {
             throw Xapian::DatabaseError("lseek() failed", errno);
         }
+        version_file_size -= version_file_out->get_offset();
         if (version_file_size > HONEY_VERSION_MAX_SIZE) {
             throw Xapian::DatabaseError("Didn't allow enough space for "
                                         "version file data");
         }
     }
-    for (unsigned j = 0; j != tabs.size(); ++j) {
-        tabs[j]->sync();
+    for (auto&& tab : tabs) {
+        if (tab) tab->sync();
     }
     // Commit with revision 1.
     version_file_out->sync(tmpfile, 1, FLAGS);
-    for (unsigned j = 0; j != tabs.size(); ++j) {
-        delete tabs[j];
-    }
+    tabs.clear();
 #endif
 } else {
-    vector<HoneyTable*> tabs;
-    tabs.reserve(std::end(tables) - std::begin(tables));
+    // The merge for each table is done by a separate task, and the tables
+    // are independent so the tasks can be run in parallel.
+    vector<function<void()>> tasks;
+    vector<unique_ptr<HoneyTable>> tabs(std::end(tables) - std::begin(tables));
     file_size_type prev_size = HONEY_MIN_DB_SIZE;
     for (const auto& t : tables) {
         // The postlist table requires an N-way merge, adjusting the
@@ -2719,128 +3103,145 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
             continue;
         }
 
-        HoneyTable* out;
-        off_t table_start_offset = -1;
-        if (single_file) {
-            if (&t == tables) {
-                // Start first table HONEY_VERSION_MAX_SIZE bytes in to allow
-                // space for version file.  It's tricky to exactly know the
-                // size of the version file beforehand.
-                table_start_offset = lseek(fd, HONEY_VERSION_MAX_SIZE, SEEK_CUR);
-                if (table_start_offset < 0)
-                    throw Xapian::DatabaseError("lseek() failed", errno);
-            } else {
-                table_start_offset = lseek(fd, 0, SEEK_CUR);
-            }
-            out = new HoneyTable(t.name, fd, version_file_out->get_offset(),
-                                 false, false);
-        } else {
-            out = new HoneyTable(t.name, dest, false, t.lazy);
-        }
-        tabs.push_back(out);
         Honey::RootInfo* root_info = version_file_out->root_to_set(t.type);
-        if (single_file) {
-            root_info->set_free_list(fl_serialised);
-            root_info->set_offset(table_start_offset);
-            out->open(FLAGS,
-                      version_file_out->get_root(t.type),
-                      version_file_out->get_revision());
-        } else {
-            out->create_and_open(FLAGS, *root_info);
-        }
-
-        switch (t.type) {
-            case Honey::POSTLIST: {
-                if (multipass && inputs.size() > 3) {
-                    multimerge_postlists(compactor, out, destdir,
-                                         inputs, offset);
+        root_info->set_format_flags(table_format_flags(t.type));
+        tasks.emplace_back([&, dest, inputs, in_size, bad_stat, single_file_in,
+                            root_info]() mutable {
+            HoneyTable* out;
+            off_t table_start_offset = -1;
+            if (single_file) {
+                if (&t == tables) {
+                    // Start first table HONEY_VERSION_MAX_SIZE bytes in to
+                    // allow space for version file.  It's tricky to exactly
+                    // know the size of the version file beforehand.
+                    table_start_offset = lseek(fd, HONEY_VERSION_MAX_SIZE,
+                                               SEEK_CUR);
+                    if (table_start_offset < 0)
+                        throw Xapian::DatabaseError("lseek() failed", errno);
                 } else {
-                    merge_postlists(compactor, out, offset.begin(),
-                                    inputs.begin(), inputs.end());
+                    table_start_offset = lseek(fd, 0, SEEK_CUR);
                 }
-                break;
+                out = new HoneyTable(t.name, fd,
+                                     version_file_out->get_offset(),
+                                     false, false);
+            } else {
+                out = new HoneyTable(t.name, dest, false, t.lazy);
             }
-            case Honey::SPELLING:
-                merge_spellings(out, inputs.begin(), inputs.end());
-                break;
-            case Honey::SYNONYM:
-                merge_synonyms(out, inputs.begin(), inputs.end());
-                break;
-            case Honey::POSITION:
-                merge_positions(out, inputs, offset);
-                break;
-            default:
-                // DocData, Termlist
-                merge_docid_keyed(out, inputs, offset);
-                break;
-        }
-
-        // Commit as revision 1.
-        out->flush_db();
-        out->commit(1, root_info);
-        out->sync();
-        if (single_file) fl_serialised = root_info->get_free_list();
-
-        file_size_type out_size = 0;
-        if (!bad_stat && !single_file_in) {
-            file_size_type db_size;
+            tabs[&t - tables].reset(out);
             if (single_file) {
-                db_size = file_size(fd);
+                root_info->set_free_list(fl_serialised);
+                root_info->set_offset(table_start_offset);
+                out->open(FLAGS,
+                          version_file_out->get_root(t.type),
+                          version_file_out->get_revision());
             } else {
-                db_size = file_size(dest + HONEY_TABLE_EXTENSION);
+                out->create_and_open(FLAGS, *root_info);
             }
-            if (errno == 0) {
+            // The output has roughly as many keys as the inputs have entries.
+            honey_tablesize_t num_keys = 0;
+            for (auto table : inputs) {
+                num_keys += table->get_entry_count();
+            }
+            out->size_filter(num_keys);
+
+            switch (t.type) {
+                case Honey::POSTLIST: {
+                    if (multipass && inputs.size() > 3) {
+                        multimerge_postlists(compactor, out, destdir,
+                                             inputs, offset, threads);
+                    } else {
+                        merge_postlists(compactor, out, offset.begin(),
+                                        inputs.begin(), inputs.end());
+                    }
+                    break;
+                }
+                case Honey::SPELLING:
+                    merge_spellings(out, inputs.begin(), inputs.end());
+                    break;
+                case Honey::SYNONYM:
+                    merge_synonyms(out, inputs.begin(), inputs.end());
+                    break;
+                case Honey::POSITION:
+                    merge_positions(out, inputs, offset);
+                    break;
+                default:
+                    // DocData, Termlist
+                    merge_docid_keyed(out, inputs, offset);
+                    break;
+            }
+
+            // Commit as revision 1.
+            out->flush_db();
+            out->commit(1, root_info);
+            out->sync();
+            if (single_file) fl_serialised = root_info->get_free_list();
+
+            file_size_type out_size = 0;
+            if (!bad_stat && !single_file_in) {
+                file_size_type db_size;
                 if (single_file) {
-                    auto old_prev_size = prev_size;
-                    prev_size = db_size;
-                    db_size -= old_prev_size;
+                    db_size = file_size(fd);
+                } else {
+                    db_size = file_size(dest + HONEY_TABLE_EXTENSION);
                 }
-                if (add_overflows(out_total, db_size, out_total)) {
-                    bad_totals = true;
+                if (errno == 0) {
+                    if (single_file) {
+                        auto old_prev_size = prev_size;
+                        prev_size = db_size;
+                        db_size -= old_prev_size;
+                    }
+                    lock_guard<ParallelMutex> totals_lock(totals_mutex);
+                    if (add_overflows(out_total, db_size, out_total)) {
+                        bad_totals = true;
+                    }
+                    out_size = db_size / 1024;
+                } else if (errno != ENOENT) {
+                    lock_guard<ParallelMutex> totals_lock(totals_mutex);
+                    bad_totals = bad_stat = true;
                 }
-                out_size = db_size / 1024;
-            } else if (errno != ENOENT) {
-                bad_totals = bad_stat = true;
             }
-        }
-        if (bad_stat) {
-            if (compactor)
-                compactor->set_status(t.name,
-                                      "Done (couldn't stat all the DB files)");
-        } else if (single_file_in) {
-            if (compactor)
-                compactor->set_status(t.name,
-                                      "Done (table sizes unknown for single "
-                                      "file DB input)");
-        } else {
-            string status;
-            if (out_size == in_size) {
-                status = "Size unchanged (";
+            if (bad_stat) {
+                if (compactor)
+                    compactor->set_status(t.name,
+                                          "Done (couldn't stat all the DB "
+                                          "files)");
+            } else if (single_file_in) {
+                if (compactor)
+                    compactor->set_status(t.name,
+                                          "Done (table sizes unknown for "
+                                          "single file DB input)");
             } else {
-                file_size_type delta;
-                if (out_size < in_size) {
-                    delta = in_size - out_size;
-                    status = "Reduced by ";
+                string status;
+                if (out_size == in_size) {
+                    status = "Size unchanged (";
                 } else {
-                    delta = out_size - in_size;
-                    status = "INCREASED by ";
-                }
-                if (in_size) {
-                    status += str(100 * delta / in_size);
-                    status += "% ";
+                    file_size_type delta;
+                    if (out_size < in_size) {
+                        delta = in_size - out_size;
+                        status = "Reduced by ";
+                    } else {
+                        delta = out_size - in_size;
+                        status = "INCREASED by ";
+                    }
+                    if (in_size) {
+                        status += str(100 * delta / in_size);
+                        status += "% ";
+                    }
+                    status += str(delta);
+                    status += "K (";
+                    status += str(in_size);
+                    status += "K -> ";
                 }
-                status += str(delta);
-                status += "K (";
-                status += str(in_size);
-                status += "K -> ";
+                status += str(out_size);
+                status += "K)";
+                if (compactor)
+                    compactor->set_status(t.name, status);
             }
-            status += str(out_size);
-            status += "K)";
-            if (compactor)
-                compactor->set_status(t.name, status);
-        }
+        });
     }
 
+    run_parallel(tasks, threads);
+
     // If compacting to a single file output and all the tables are empty, pad
     // the output so that it isn't mistaken for a stub database when we try to
     // open it.  For this it needs to at least HONEY_MIN_DB_SIZE in size.
@@ -2867,14 +3268,12 @@ if (source_backend == Xapian::DB_BACKEND_GLASS) {
     }
     version_file_out->set_last_docid(last_docid);
     string tmpfile = version_file_out->write(1, FLAGS);
-    for (unsigned j = 0; j != tabs.size(); ++j) {
-        tabs[j]->sync();
+    for (auto&& tab : tabs) {
+        if (tab) tab->sync();
     }
     // Commit with revision 1.
     version_file_out->sync(tmpfile, 1, FLAGS);
-    for (unsigned j = 0; j != tabs.size(); ++j) {
-        delete tabs[j];
-    }
+    tabs.clear();
 }
 
     if (!single_file) lock.release();
@@ -1,7 +1,7 @@
 /** @file
  * @brief HoneyCursor class
  */
-/* Copyright (C) 2017,2018,2024 Olly Betts
+/* Copyright (C) 2017,2018,2024,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -69,10 +69,14 @@ HoneyCursor::do_next()
                                     errno);
     }
     size_t key_size = ch;
-    char buf[256];
-    store.read(buf, key_size);
     current_key.assign(last_key, 0, reuse);
-    current_key.append(buf, key_size);
+    if (const char* p = store.read_mapped(key_size)) {
+        current_key.append(p, key_size);
+    } else {
+        char buf[256];
+        store.read(buf, key_size);
+        current_key.append(buf, key_size);
+    }
     last_key = current_key;
 
 #ifdef DEBUGGING
@@ -131,8 +135,25 @@ HoneyCursor::read_tag(bool keep_compressed)
             HoneyTable::throw_database_closed();
         }
 
-        current_tag.resize(val_size);
-        store.read(&(current_tag[0]), val_size);
+        const char* p = store.read_mapped(val_size);
+        if (p && !keep_compressed && current_compressed) {
+            // Decompress straight from the mapped file.
+            comp_stream.decompress_start();
+            current_tag.resize(0);
+            if (!comp_stream.decompress_chunk(p, val_size, current_tag)) {
+                // Decompression didn't complete.
+                abort();
+            }
+            val_size = 0;
+            current_compressed = false;
+            return false;
+        }
+        if (p) {
+            current_tag.assign(p, val_size);
+        } else {
+            current_tag.resize(val_size);
+            store.read(&(current_tag[0]), val_size);
+        }
 #ifdef DEBUGGING
         {
             cerr << "read " << val_size << " bytes of value data ending @"
@@ -205,9 +226,13 @@ HoneyCursor::do_find(string_view key, bool greater_than)
         HoneyTable::throw_database_closed();
     }
 
+    // If we aren't using the index up front, we scan forwards until we've
+    // passed this offset before checking if a multi-level index can take us
+    // further forward.
+    off_t scan_limit = root;
     if (use_index) {
         store.rewind(root);
-        int index_type = store.read();
+        index_type = store.read();
         switch (index_type) {
             case EOF:
                 return false;
@@ -365,6 +390,11 @@ HoneyCursor::do_find(string_view key, bool greater_than)
 
                 break;
             }
+            case 0x03: {
+                off_t jump = SSTIndex::btree_find(store, key, last_key);
+                store.rewind(jump);
+                break;
+            }
             default: {
                 string m = "HoneyCursor: Unknown index type ";
                 m += str(index_type);
@@ -373,12 +403,32 @@ HoneyCursor::do_find(string_view key, bool greater_than)
         }
         is_at_end = false;
         val_size = 0;
+    } else if (index_type < 0 || index_type == 0x03) {
+        scan_limit = store.get_pos() + val_size + SSTIndex::INDEXBLOCK;
     }
 
     while (do_next()) {
         int cmp = current_key.compare(key);
         if (cmp == 0) return true;
         if (cmp > 0) break;
+        if (rare(store.get_pos() > scan_limit)) {
+            // The key we want isn't close, so see if the index can get us
+            // there faster.
+            off_t next_pos = store.get_pos() + val_size;
+            store.rewind(root);
+            index_type = store.read();
+            if (index_type == 0x03) {
+                string index_key;
+                off_t jump = SSTIndex::btree_find(store, key, index_key);
+                if (jump > next_pos) {
+                    next_pos = jump;
+                    swap(last_key, index_key);
+                }
+            }
+            store.rewind(next_pos);
+            val_size = 0;
+            scan_limit = root;
+        }
     }
     return false;
 }
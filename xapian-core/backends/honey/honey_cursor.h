@@ -53,6 +53,12 @@ class HoneyCursor {
     // File offset to start of table (zero except for single-file DB).
     off_t offset;
 
+    /** The type of the index, or -1 if we've not looked yet.
+     *
+     *  This is the first byte at offset root.
+     */
+    int index_type = -1;
+
     // Forward to next constructor form.
     explicit HoneyCursor(const HoneyTable* table)
         : store(table->store),
@@ -73,7 +79,8 @@ class HoneyCursor {
           is_at_end(o.is_at_end),
           last_key(o.last_key),
           root(o.root),
-          offset(o.offset)
+          offset(o.offset),
+          index_type(o.index_type)
     {
         store.set_pos(o.store.get_pos());
     }
@@ -1,7 +1,7 @@
 /** @file
  * @brief Honey backend database class
  */
-/* Copyright 2015,2017,2018,2022,2024 Olly Betts
+/* Copyright 2015,2017,2018,2022,2024,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -92,12 +92,17 @@ HoneyDatabase::HoneyDatabase(int fd, int flags)
 {
     version_file.read();
     auto rev = version_file.get_revision();
-    docdata_table.open(flags, version_file.get_root(Honey::DOCDATA), rev);
-    postlist_table.open(flags, version_file.get_root(Honey::POSTLIST), rev);
-    position_table.open(flags, version_file.get_root(Honey::POSITION), rev);
-    spelling_table.open(flags, version_file.get_root(Honey::SPELLING), rev);
-    synonym_table.open(flags, version_file.get_root(Honey::SYNONYM), rev);
-    termlist_table.open(flags, version_file.get_root(Honey::TERMLIST), rev);
+    // The tables share the file, so tell each where its data ends.
+    auto open_table = [&](HoneyTable& table, Honey::table_type type) {
+        table.open(flags, version_file.get_root(type), rev,
+                   version_file.get_table_end(type));
+    };
+    open_table(docdata_table, Honey::DOCDATA);
+    open_table(postlist_table, Honey::POSTLIST);
+    open_table(position_table, Honey::POSITION);
+    open_table(spelling_table, Honey::SPELLING);
+    open_table(synonym_table, Honey::SYNONYM);
+    open_table(termlist_table, Honey::TERMLIST);
 }
 
 HoneyDatabase::~HoneyDatabase()
@@ -134,7 +139,10 @@ Xapian::termcount
 HoneyDatabase::get_doclength(Xapian::docid did) const
 {
     Assert(did != 0);
-    if (usual(did <= version_file.get_last_docid())) {
+    if (cache_doclens && (doclen_cache || load_doclen_cache())) {
+        Xapian::termcount doclen;
+        if (doclen_cache->get(did, doclen)) return doclen;
+    } else if (usual(did <= version_file.get_last_docid())) {
         if (doclen_cursor == NULL) {
             doclen_cursor = get_postlist_cursor();
         } else {
@@ -160,6 +168,35 @@ HoneyDatabase::get_doclength(Xapian::docid did) const
     throw Xapian::DocNotFoundError(message);
 }
 
+void
+HoneyDatabase::cache_doclengths()
+{
+    cache_doclens = true;
+}
+
+bool
+HoneyDatabase::load_doclen_cache() const
+{
+    Xapian::termcount doclen_ub = version_file.get_doclength_upper_bound();
+    if (!DoclenCache::usable(doclen_ub)) return false;
+    unique_ptr<DoclenCache> cache(
+        new DoclenCache(version_file.get_last_docid(), doclen_ub));
+    unique_ptr<HoneyCursor> cursor(get_postlist_cursor());
+    // If there's no postlist table then there are no documents.
+    if (cursor) {
+        cursor->find_entry_ge(Honey::make_doclenchunk_key(1));
+        Honey::DocLenChunkReader reader;
+        while (!cursor->after_end() && reader.update(cursor.get())) {
+            do {
+                cache->set(reader.get_docid(), reader.get_doclength());
+            } while (reader.next());
+            cursor->next();
+        }
+    }
+    doclen_cache = std::move(cache);
+    return true;
+}
+
 Xapian::termcount
 HoneyDatabase::get_unique_terms(Xapian::docid did) const
 {
@@ -221,6 +258,11 @@ HoneyDatabase::get_doclength_upper_bound() const
 Xapian::termcount
 HoneyDatabase::get_wdf_upper_bound(string_view term) const
 {
+    if (postlist_table.get_format_flags() & Honey::FORMAT_IMPACTS) {
+        // The postings store impacts, which the bound in the version file
+        // doesn't apply to, but the bound stored for the term is exact.
+        return postlist_table.get_wdf_upper_bound(term);
+    }
     Xapian::termcount wdf_bound = version_file.get_wdf_upper_bound();
     // It's unlikely wdf is always 0, but when it is there's no need to do any
     // further work.
@@ -289,7 +331,9 @@ HoneyDatabase::open_leaf_post_list(string_view term, bool need_read_pos) const
 ValueList*
 HoneyDatabase::open_value_list(Xapian::valueno slot) const
 {
-    return new HoneyValueList(slot, this);
+    bool columns = (postlist_table.get_format_flags() &
+                    Honey::FORMAT_VALUE_COLUMNS);
+    return new HoneyValueList(slot, columns, this);
 }
 
 TermList*
@@ -465,6 +509,7 @@ HoneyDatabase::close()
     spelling_table.close(true);
     synonym_table.close(true);
     termlist_table.close(true);
+    doclen_cache.reset();
 }
 
 void
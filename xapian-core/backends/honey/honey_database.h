@@ -1,7 +1,7 @@
 /** @file
  * @brief Database using honey backend
  */
-/* Copyright 2004,2006,2007,2008,2009,2011,2014,2015,2016,2017,2024 Olly Betts
+/* Copyright 2004,2006,2007,2008,2009,2011,2014,2015,2016,2017,2024,2026 Olly Betts
  * Copyright 2007,2008 Lemur Consulting Ltd
  *
  * This program is free software; you can redistribute it and/or
@@ -23,6 +23,7 @@
 #define XAPIAN_INCLUDED_HONEY_DATABASE_H
 
 #include "backends/databaseinternal.h"
+#include "backends/doclencache.h"
 
 #include "honey_alldocspostlist.h"
 #include "honey_docdata.h"
@@ -83,6 +84,21 @@ class HoneyDatabase : public Xapian::Database::Internal {
 
     mutable HoneyCursor* doclen_cursor = NULL;
 
+    /// Should document lengths be cached in memory?
+    bool cache_doclens = false;
+
+    /** Document lengths cached in memory.
+     *
+     *  NULL until first needed (and always NULL unless cache_doclens is true).
+     */
+    mutable std::unique_ptr<DoclenCache> doclen_cache;
+
+    /** Read all the document lengths into doclen_cache.
+     *
+     *  @return false if they can't be cached.
+     */
+    bool load_doclen_cache() const;
+
     [[noreturn]]
     void throw_termlist_table_close_exception() const;
 
@@ -107,6 +123,8 @@ class HoneyDatabase : public Xapian::Database::Internal {
 
     Xapian::termcount get_doclength(Xapian::docid did) const;
 
+    void cache_doclengths();
+
     /** Get the number of unique terms in document.
      *
      *  @param did  The document id of the document to return this value for.
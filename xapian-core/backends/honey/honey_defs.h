@@ -1,7 +1,7 @@
 /** @file
  * @brief Definitions, types, etc for use inside honey.
  */
-/* Copyright (C) 2010,2014,2015,2017,2018 Olly Betts
+/* Copyright (C) 2010,2014,2015,2017,2018,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -92,6 +92,47 @@ enum {
 
 #define KEY_DOCLEN_PREFIX "\0\xf7"
 
+/// Flags recorded for each table which affect how its data is encoded.
+enum {
+    /** Postings are stored in blocks.
+     *
+     *  Only used for the postlist table.  See HONEY_POSTING_BLOCK_SIZE.
+     */
+    FORMAT_BLOCK_POSTINGS = 1,
+
+    /** A Bloom filter over the table's keys follows the index.
+     *
+     *  See Honey::BloomFilter.
+     */
+    FORMAT_BLOOM_FILTER = 2,
+
+    /** Positions are stored in blocks.
+     *
+     *  Only used for the position table.  See HONEY_POSITION_BLOCK_SIZE.
+     */
+    FORMAT_BLOCK_POSITIONS = 4,
+
+    /** Value chunks start with a byte giving their encoding.
+     *
+     *  Only used for the postlist table.  See Honey::VALUE_CHUNK_STREAM.
+     */
+    FORMAT_VALUE_COLUMNS = 8,
+
+    /** Postings store a quantised impact instead of the wdf.
+     *
+     *  Only used for the postlist table.  See Xapian::DBCOMPACT_IMPACTS.
+     */
+    FORMAT_IMPACTS = 16,
+
+    /** Compressed tags may use a codec other than zlib.
+     *
+     *  Set when compaction copies compressed tags from a glass table which
+     *  uses LZ4 or Zstandard (see Compression::codec).  Versions which don't
+     *  know this flag can't decompress such tags so reject the database.
+     */
+    FORMAT_TAG_CODECS = 32
+};
+
 static_assert(((KEY_VALUE_CHUNK_HI - KEY_VALUE_CHUNK) & 0x07) == 0,
               "No wasted values");
 
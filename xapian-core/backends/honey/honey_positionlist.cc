@@ -1,7 +1,7 @@
 /** @file
  * @brief A position list in a honey database.
  */
-/* Copyright (C) 2004,2005,2006,2008,2009,2010,2013,2017,2019 Olly Betts
+/* Copyright (C) 2004,2005,2006,2008,2009,2010,2013,2017,2019,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -22,6 +22,7 @@
 
 #include "honey_positionlist.h"
 
+#include <xapian/error.h>
 #include <xapian/types.h>
 
 #include "bitstream.h"
@@ -29,20 +30,67 @@
 #include "honey_cursor.h"
 #include "pack.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <string>
 
 using namespace std;
 
+/// Encode position list @a vec in blocks.
+static void
+encode_blocks(string& s, const Xapian::VecCOW<Xapian::termpos>& vec)
+{
+    pack_uint(s, vec.size() - 2);
+    // The entry before the first is taken to be -1.
+    Xapian::termpos prev = Xapian::termpos(-1);
+    for (size_t b = 0; b < vec.size(); b += HONEY_POSITION_BLOCK_SIZE) {
+        size_t n = min(vec.size() - b, size_t(HONEY_POSITION_BLOCK_SIZE));
+        Xapian::termpos block_last = vec[b + n - 1];
+        pack_uint(s, block_last - prev - 1);
+
+        Xapian::termpos max_diff = 0;
+        for (size_t i = b; i != b + n; ++i) {
+            max_diff = max(max_diff, vec[i] - (i ? vec[i - 1] : prev) - 1);
+        }
+        if (max_diff > 0xffffffff) {
+            throw Xapian::DatabaseError("Block encoded positions need "
+                                        "position gaps < 2**32");
+        }
+        unsigned width = 0;
+        while (uint64_t(max_diff) >> width) ++width;
+        s += char(width);
+
+        uint64_t acc = 0;
+        unsigned n_bits = 0;
+        for (size_t i = b; i != b + n; ++i) {
+            acc |= uint64_t(vec[i] - prev - 1) << n_bits;
+            n_bits += width;
+            while (n_bits >= 8) {
+                s += char(acc);
+                acc >>= 8;
+                n_bits -= 8;
+            }
+            prev = vec[i];
+        }
+        if (n_bits) s += char(acc);
+    }
+}
+
 void
-HoneyPositionTable::pack(string& s,
-                         const Xapian::VecCOW<Xapian::termpos>& vec) const
+HoneyPositionTable::encode(string& s,
+                           const Xapian::VecCOW<Xapian::termpos>& vec,
+                           bool blocks)
 {
-    LOGCALL_VOID(DB, "HoneyPositionTable::pack", s | vec);
+    LOGCALL_STATIC_VOID(DB, "HoneyPositionTable::encode", s | vec | blocks);
     Assert(!vec.empty());
 
     pack_uint(s, vec.back());
 
     if (vec.size() > 1) {
+        if (blocks) {
+            encode_blocks(s, vec);
+            return;
+        }
         BitWriter wr(s);
         wr.encode(vec[0], vec.back());
         wr.encode(vec.size() - 2, vec.back() - vec[0]);
@@ -73,6 +121,14 @@ HoneyPositionTable::positionlist_count(Xapian::docid did,
         RETURN(1);
     }
 
+    if (blocks()) {
+        Xapian::termcount pos_size;
+        if (!unpack_uint(&pos, end, &pos_size)) {
+            throw Xapian::DatabaseCorruptError("Position list data corrupt");
+        }
+        RETURN(pos_size + 2);
+    }
+
     // Skip the header we just read.
     BitReader rd(pos, end);
     Xapian::termpos pos_first = rd.decode(pos_last);
@@ -88,6 +144,8 @@ HoneyBasePositionList::set_data(const string& data)
     LOGCALL_VOID(DB, "HoneyBasePositionList::set_data", data);
 
     have_started = false;
+    positions.clear();
+    current = 0;
 
     if (data.empty()) {
         // There's no positional information for this term.
@@ -111,10 +169,33 @@ HoneyBasePositionList::set_data(const string& data)
         return;
     }
 
+    if (blocks) {
+        Xapian::termcount pos_size;
+        if (!unpack_uint(&pos, end, &pos_size) ||
+            pos_size > Xapian::termcount(-3)) {
+            throw Xapian::DatabaseCorruptError("Position list data corrupt");
+        }
+        size = pos_size + 2;
+        last = pos_last;
+        block_ptr = pos;
+        block_end = end;
+        block_remaining = size;
+        block_prev = Xapian::termpos(-1);
+        // Just read the first entry for now.
+        unsigned width;
+        (void)read_block_header(pos, width);
+        uint64_t first_diff = 0;
+        for (unsigned i = 0; i < width; i += 8) {
+            first_diff |= uint64_t(static_cast<unsigned char>(*pos++)) << i;
+        }
+        first_diff &= (uint64_t(1) << width) - 1;
+        current_pos = Xapian::termpos(first_diff);
+        return;
+    }
+
     rd.init(pos, end);
     Xapian::termpos pos_first = rd.decode(pos_last);
     Xapian::termpos pos_size = rd.decode(pos_last - pos_first) + 2;
-    rd.decode_interpolative(0, pos_size - 1, pos_first, pos_last);
     size = pos_size;
     last = pos_last;
     current_pos = pos_first;
@@ -142,6 +223,71 @@ HoneyBasePositionList::get_position() const
     RETURN(current_pos);
 }
 
+Xapian::termpos
+HoneyBasePositionList::read_block_header(const char*& p,
+                                         unsigned& width) const
+{
+    p = block_ptr;
+    Xapian::termpos diff;
+    if (!unpack_uint(&p, block_end, &diff) || p == block_end) {
+        throw Xapian::DatabaseCorruptError("Position list data corrupt");
+    }
+    width = static_cast<unsigned char>(*p++);
+    Xapian::termcount n = min(block_remaining,
+                              Xapian::termcount(HONEY_POSITION_BLOCK_SIZE));
+    if (width > 32 ||
+        size_t(block_end - p) < (uint64_t(n) * width + 7) / 8) {
+        throw Xapian::DatabaseCorruptError("Position list data corrupt");
+    }
+    return block_prev + diff + 1;
+}
+
+void
+HoneyBasePositionList::decode_block()
+{
+    LOGCALL_VOID(DB, "HoneyBasePositionList::decode_block", NO_ARGS);
+    AssertRel(block_remaining, >, 0);
+    const char* p;
+    unsigned width;
+    Xapian::termpos block_last = read_block_header(p, width);
+    Xapian::termcount n = min(block_remaining,
+                              Xapian::termcount(HONEY_POSITION_BLOCK_SIZE));
+    positions.resize(n);
+    const uint64_t mask = (uint64_t(1) << width) - 1;
+    uint64_t acc = 0;
+    unsigned n_bits = 0;
+    Xapian::termpos pos = block_prev;
+    for (auto& entry : positions) {
+        while (n_bits < width) {
+            acc |= uint64_t(static_cast<unsigned char>(*p++)) << n_bits;
+            n_bits += 8;
+        }
+        pos += Xapian::termpos(acc & mask) + 1;
+        acc >>= width;
+        n_bits -= width;
+        entry = pos;
+    }
+    if (pos != block_last) {
+        throw Xapian::DatabaseCorruptError("Position list data corrupt");
+    }
+    block_ptr = p;
+    block_prev = block_last;
+    block_remaining -= n;
+    current = 0;
+}
+
+void
+HoneyBasePositionList::decode()
+{
+    LOGCALL_VOID(DB, "HoneyBasePositionList::decode", NO_ARGS);
+    AssertRel(size, >, 1);
+    AssertEq(current, 0);
+    positions.resize(size);
+    positions[0] = current_pos;
+    positions[size - 1] = last;
+    rd.decode_interpolative(positions.data(), 0, size - 1);
+}
+
 bool
 HoneyBasePositionList::next()
 {
@@ -153,7 +299,19 @@ HoneyBasePositionList::next()
     if (current_pos == last) {
         return false;
     }
-    current_pos = rd.decode_interpolative_next();
+    if (blocks) {
+        if (positions.empty()) {
+            // The first block always has at least two entries.
+            decode_block();
+        } else if (current + 1 == positions.size()) {
+            decode_block();
+            current_pos = positions[0];
+            return true;
+        }
+    } else if (positions.empty()) {
+        decode();
+    }
+    current_pos = positions[++current];
     return true;
 }
 
@@ -169,18 +327,44 @@ HoneyBasePositionList::skip_to(Xapian::termpos termpos)
         }
         return false;
     }
-    while (current_pos < termpos) {
-        if (current_pos == last) {
-            return false;
+    if (current_pos >= termpos) {
+        return true;
+    }
+    Xapian::termcount from = current + 1;
+    if (blocks) {
+        if (positions.empty() || positions.back() < termpos) {
+            // Step over any blocks which end before termpos.  Since
+            // termpos < last, we'll stop at a block containing an entry
+            // >= termpos.
+            while (true) {
+                const char* p;
+                unsigned width;
+                Xapian::termpos block_last = read_block_header(p, width);
+                if (block_last >= termpos) break;
+                Xapian::termcount n =
+                    min(block_remaining,
+                        Xapian::termcount(HONEY_POSITION_BLOCK_SIZE));
+                block_ptr = p + (uint64_t(n) * width + 7) / 8;
+                block_prev = block_last;
+                block_remaining -= n;
+            }
+            decode_block();
+            from = 0;
         }
-        current_pos = rd.decode_interpolative_next();
+    } else if (positions.empty()) {
+        decode();
     }
+    // termpos < last so we know this will find an entry.
+    auto i = lower_bound(positions.begin() + from, positions.end(), termpos);
+    current = i - positions.begin();
+    current_pos = *i;
     return true;
 }
 
-HoneyPositionList::HoneyPositionList(string&& data)
+HoneyPositionList::HoneyPositionList(string&& data, bool blocks_)
+    : HoneyBasePositionList(blocks_)
 {
-    LOGCALL_CTOR(DB, "HoneyPositionList", data);
+    LOGCALL_CTOR(DB, "HoneyPositionList", data | blocks_);
 
     pos_data = std::move(data);
 
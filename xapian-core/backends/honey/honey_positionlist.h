@@ -1,7 +1,7 @@
 /** @file
  * @brief A position list in a honey database.
  */
-/* Copyright (C) 2005-2024 Olly Betts
+/* Copyright (C) 2005-2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -26,11 +26,35 @@
 #include "backends/positionlist.h"
 #include "bitstream.h"
 #include "honey_cursor.h"
+#include "honey_defs.h"
 #include "honey_lazytable.h"
 #include "pack.h"
 
 #include <string>
 #include <string_view>
+#include <vector>
+
+/** Maximum number of entries in a block of positions.
+ *
+ *  If a honey position table has the Honey::FORMAT_BLOCK_POSITIONS format
+ *  flag set, position lists with more than one entry are stored in blocks
+ *  rather than using interpolative coding.  The last entry is packed with
+ *  pack_uint() first as for the default encoding, followed by the number of
+ *  entries less two, then the blocks.  All blocks except the last contain
+ *  this many entries.
+ *
+ *  Each block starts with its last entry, stored as the difference from the
+ *  last entry of the previous block less one, and packed with pack_uint().
+ *  Then there's a byte giving a bit width, followed by the differences
+ *  between consecutive entries less one, each stored in that many bits, least
+ *  significant bit first.  The entry before the first is taken to be -1, so
+ *  the first difference less one is just the first entry.
+ *
+ *  Storing the last entry of each block allows skip_to() to step over
+ *  blocks without decoding them, which makes phrase matching much faster
+ *  when one of the terms has a long position list.
+ */
+#define HONEY_POSITION_BLOCK_SIZE 128
 
 /** Base-class for a position list in a honey database. */
 class HoneyBasePositionList : public PositionList {
@@ -44,6 +68,34 @@ class HoneyBasePositionList : public PositionList {
     /// Interpolative decoder.
     BitReader rd;
 
+    /** The decoded entries.
+     *
+     *  We only decode these when we first need to move past the first entry,
+     *  since we're often only interested in the size or first or last entry.
+     *  If we've not decoded them yet, this is empty.
+     *
+     *  If blocks is true, this holds just the entries in the current block.
+     */
+    std::vector<Xapian::termpos> positions;
+
+    /// Index of the current entry in positions.
+    Xapian::termcount current;
+
+    /// Are the entries stored in blocks?
+    bool blocks = false;
+
+    /// Start of the next block (if blocks is true).
+    const char* block_ptr;
+
+    /// End of the encoded data (if blocks is true).
+    const char* block_end;
+
+    /// Number of entries in blocks after the current one.
+    Xapian::termcount block_remaining;
+
+    /// Last entry of the current block (or -1 before the first block).
+    Xapian::termpos block_prev;
+
     /// Current entry.
     Xapian::termpos current_pos;
 
@@ -56,6 +108,21 @@ class HoneyBasePositionList : public PositionList {
     /// Have we started iterating yet?
     bool have_started;
 
+    /// Decode all the entries into positions.
+    void decode();
+
+    /** Read the header of the block starting at block_ptr.
+     *
+     *  @param p      Set to point to the data for the block.
+     *  @param width  Set to the bit width of the data for the block.
+     *
+     *  @return The last entry in the block.
+     */
+    Xapian::termpos read_block_header(const char*& p, unsigned& width) const;
+
+    /// Decode the next block into positions.
+    void decode_block();
+
     /** Set positional data and start to decode it.
      *
      *  @param data     The positional data.  Must stay valid
@@ -64,8 +131,14 @@ class HoneyBasePositionList : public PositionList {
     void set_data(const std::string& data);
 
   public:
-    /// Default constructor.
-    HoneyBasePositionList() {}
+    /** Constructor.
+     *
+     *  @param blocks_  Is the data stored in blocks (i.e. does the table
+     *                  have the Honey::FORMAT_BLOCK_POSITIONS format flag
+     *                  set)?
+     */
+    explicit
+    HoneyBasePositionList(bool blocks_) : blocks(blocks_) {}
 
     /// Returns size of position list.
     Xapian::termcount get_approx_size() const;
@@ -98,9 +171,12 @@ class HoneyPositionList : public HoneyBasePositionList {
     HoneyPositionList& operator=(const HoneyPositionList&) = delete;
 
   public:
-    /// Construct and initialise with data.
-    explicit
-    HoneyPositionList(std::string&& data);
+    /** Construct and initialise with data.
+     *
+     *  @param data     The positional data.
+     *  @param blocks_  Is the data stored in blocks?
+     */
+    HoneyPositionList(std::string&& data, bool blocks_);
 };
 
 /** A reusable position list in a honey database. */
@@ -118,7 +194,9 @@ class HoneyRePositionList : public HoneyBasePositionList {
     /// Constructor.
     explicit
     HoneyRePositionList(const HoneyTable& table)
-        : cursor(&table) {}
+        : HoneyBasePositionList(table.get_format_flags() &
+                                Honey::FORMAT_BLOCK_POSITIONS),
+          cursor(&table) {}
 
     /** Fill list with data, and move the position to the start. */
     void assign_data(std::string&& data);
@@ -156,14 +234,33 @@ class HoneyPositionTable : public HoneyLazyTable {
         if (!get_exact_entry(make_key(did, term), pos_data))
             return nullptr;
 
-        return new HoneyPositionList(std::move(pos_data));
+        return new HoneyPositionList(std::move(pos_data), blocks());
+    }
+
+    /// Are position lists in this table stored in blocks?
+    bool blocks() const {
+        return get_format_flags() & Honey::FORMAT_BLOCK_POSITIONS;
     }
 
     /** Pack a position list into a string.
      *
      *  @param s The string to append the position list data to.
      */
-    void pack(std::string& s, const Xapian::VecCOW<Xapian::termpos>& vec) const;
+    void pack(std::string& s,
+              const Xapian::VecCOW<Xapian::termpos>& vec) const {
+        encode(s, vec, blocks());
+    }
+
+    /** Encode a position list.
+     *
+     *  @param s       The string to append the position list data to.
+     *  @param vec     The positions.
+     *  @param blocks  Store the positions in blocks rather than using
+     *                 interpolative coding.
+     */
+    static void encode(std::string& s,
+                       const Xapian::VecCOW<Xapian::termpos>& vec,
+                       bool blocks);
 
     /** Set the position list for term @a term in document @a did.
      */
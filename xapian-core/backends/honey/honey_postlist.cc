@@ -1,7 +1,7 @@
 /** @file
  * @brief PostList in a honey database.
  */
-/* Copyright (C) 2017,2018,2022,2024 Olly Betts
+/* Copyright (C) 2017,2018,2022,2024,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -110,8 +110,9 @@ HoneyPostList::HoneyPostList(const HoneyDatabase* db_,
 
     termfreq = tf;
     collfreq = cf;
-    reader.init(tf, cf_info);
-    reader.assign(p, pend - p, first_did, last_did, first_wdf);
+    unsigned format_flags = db->postlist_table.get_format_flags();
+    reader.init(tf, cf_info, format_flags & FORMAT_BLOCK_POSTINGS);
+    reader.assign(p, pend - p, first_did, chunk_last, first_wdf);
 }
 
 HoneyPostList::~HoneyPostList()
@@ -301,6 +302,13 @@ PostingChunkReader::assign(const char* p_, size_t len,
                            Xapian::docid chunk_last)
 {
     const char* pend = p_ + len;
+    // The "constant wdf apart from maybe the first entry" case.  We may not
+    // have handled this yet if skip_to() moved straight here from the initial
+    // chunk, and it determines which header encoding is used.
+    if (collfreq_info & TOP_BIT_SET(decltype(collfreq_info))) {
+        wdf = collfreq_info &~ TOP_BIT_SET(decltype(collfreq_info));
+        collfreq_info = 0;
+    }
     if (collfreq_info ?
         !decode_delta_chunk_header(&p_, pend, chunk_last, did, wdf) :
         !decode_delta_chunk_header_no_wdf(&p_, pend, chunk_last, did)) {
@@ -309,6 +317,7 @@ PostingChunkReader::assign(const char* p_, size_t len,
     p = p_;
     end = pend;
     last_did = chunk_last;
+    block_len = block_pos = 0;
 }
 
 void
@@ -321,11 +330,28 @@ PostingChunkReader::assign(const char* p_, size_t len, Xapian::docid did_,
     did = did_;
     last_did = last_did_in_chunk;
     wdf = wdf_;
+    block_len = block_pos = 0;
+}
+
+void
+PostingChunkReader::decode_block()
+{
+    block_pos = 0;
+    block_len = decode_postings_block(&p, end, collfreq_info != 0, did,
+                                      block->did, block->wdf);
+    if (block_len == 0) {
+        throw Xapian::DatabaseCorruptError("postlist block");
+    }
 }
 
 bool
 PostingChunkReader::next()
 {
+    if (block_pos != block_len) {
+        skip_in_block(0);
+        return true;
+    }
+
     if (p == end) {
         if (termfreq == 2 && did != last_did) {
             did = last_did;
@@ -342,6 +368,12 @@ PostingChunkReader::next()
         collfreq_info = 0;
     }
 
+    if (block) {
+        decode_block();
+        skip_in_block(0);
+        return true;
+    }
+
     Xapian::docid delta;
     if (!unpack_uint(&p, end, &delta)) {
         throw Xapian::DatabaseCorruptError("postlist docid delta");
@@ -370,6 +402,17 @@ PostingChunkReader::skip_to(Xapian::docid target)
         return false;
     }
 
+    if (block_pos != block_len) {
+        if (block->did[block_len - 1] >= target) {
+            skip_in_block(target);
+            return true;
+        }
+        // The next block's docid deltas are relative to the last docid in
+        // this one.
+        block_pos = block_len;
+        did = block->did[block_len - 1];
+    }
+
     if (p == end) {
         // Given the checks above, this must be the termfreq == 2 case with the
         // current position being on the first entry, and so skip_to() must
@@ -386,6 +429,20 @@ PostingChunkReader::skip_to(Xapian::docid target)
         collfreq_info = 0;
     }
 
+    if (block) {
+        do {
+            if (rare(p == end)) {
+                // FIXME: Shouldn't happen unless last_did was wrong.
+                p = NULL;
+                return false;
+            }
+            decode_block();
+            did = block->did[block_len - 1];
+        } while (target > did);
+        skip_in_block(target);
+        return true;
+    }
+
     if (target == last_did) {
         if (collfreq_info) {
             if (!unpack_uint_backwards(&end, p, &wdf))
@@ -1,7 +1,7 @@
 /** @file
  * @brief PostList in a honey database.
  */
-/* Copyright (C) 2007,2009,2011,2013,2015,2016,2017,2018,2024 Olly Betts
+/* Copyright (C) 2007,2009,2011,2013,2015,2016,2017,2018,2024,2026 Olly Betts
  * Copyright (C) 2009 Lemur Consulting Ltd
  *
  * This program is free software; you can redistribute it and/or
@@ -24,8 +24,10 @@
 
 #include "backends/leafpostlist.h"
 #include "honey_positionlist.h"
+#include "honey_postlist_encodings.h"
 #include "pack.h"
 
+#include <memory>
 #include <string>
 #include <string_view>
 
@@ -111,6 +113,35 @@ class PostingChunkReader {
      */
     Xapian::termcount collfreq_info;
 
+    /// Decoded postings from a block.
+    struct PostingBlock {
+        Xapian::docid did[HONEY_POSTING_BLOCK_SIZE];
+        Xapian::termcount wdf[HONEY_POSTING_BLOCK_SIZE];
+    };
+
+    /** Decoded postings from the current block.
+     *
+     *  NULL unless the postings are block encoded.
+     */
+    std::unique_ptr<PostingBlock> block;
+
+    /// Number of postings in block.
+    unsigned block_len = 0;
+
+    /// Index in block of the next posting.
+    unsigned block_pos = 0;
+
+    /// Decode the next block of postings.
+    void decode_block();
+
+    /// Move to the first posting in block with docid >= target.
+    void skip_in_block(Xapian::docid target) {
+        while (block->did[block_pos] < target) ++block_pos;
+        did = block->did[block_pos];
+        if (collfreq_info) wdf = block->wdf[block_pos];
+        ++block_pos;
+    }
+
   public:
     /// Create an uninitialised PostingChunkReader.
     PostingChunkReader() { }
@@ -121,11 +152,15 @@ class PostingChunkReader {
         termfreq = 0;
     }
 
-    /// Initialise.
-    void init(Xapian::doccount tf, Xapian::termcount cf_info) {
+    /** Initialise.
+     *
+     *  @param blocks  Are postings block encoded?
+     */
+    void init(Xapian::doccount tf, Xapian::termcount cf_info, bool blocks) {
         p = NULL;
         termfreq = tf;
         collfreq_info = cf_info;
+        if (blocks) block.reset(new PostingBlock);
     }
 
     void assign(const char* p_, size_t len, Xapian::docid did);
@@ -1,7 +1,7 @@
 /** @file
  * @brief Encoding and decoding functions for honey postlists
  */
-/* Copyright (C) 2015,2018 Olly Betts
+/* Copyright (C) 2015,2018,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -21,7 +21,12 @@
 #ifndef XAPIAN_INCLUDED_HONEY_POSTLIST_ENCODINGS_H
 #define XAPIAN_INCLUDED_HONEY_POSTLIST_ENCODINGS_H
 
+#include "internaltypes.h"
 #include "pack.h"
+#include "xapian/error.h"
+
+#include <algorithm>
+#include <string>
 
 inline void
 encode_initial_chunk_header(Xapian::doccount termfreq,
@@ -289,4 +294,191 @@ decode_delta_chunk_header_no_wdf(const char** p, const char* end,
     return true;
 }
 
+/** Maximum number of postings in a block.
+ *
+ *  If a honey postlist table has the Honey::FORMAT_BLOCK_POSTINGS format flag
+ *  set, the postings after each chunk header are stored in blocks instead of
+ *  as a sequence of pack_uint() encoded docid deltas (and wdfs if stored).
+ *
+ *  Each block starts with a byte holding one less than the number of postings
+ *  in it (all blocks in a chunk except the last contain this many).  That's
+ *  followed by the docid deltas for the block, then the wdfs (if stored),
+ *  encoded like StreamVByte: the lengths of the values are stored as 2-bit
+ *  codes packed four to a byte, then the values follow with the lengths
+ *  specified, least significant byte first.
+ *
+ *  Decoding a block doesn't involve a data-dependent branch for every byte,
+ *  unlike pack_uint() encoded values, which makes it faster for long
+ *  postlists.
+ */
+#define HONEY_POSTING_BLOCK_SIZE 128
+
+namespace Honey {
+
+/// Table giving the data length for the four values a control byte covers.
+struct PostingBlockDataLengths {
+    unsigned char len[256];
+
+    constexpr PostingBlockDataLengths() : len() {
+        for (unsigned c = 0; c != 256; ++c) {
+            len[c] = (c & 3) + ((c >> 2) & 3) + ((c >> 4) & 3) + (c >> 6) + 4;
+        }
+    }
+};
+
+inline constexpr PostingBlockDataLengths posting_block_data_len;
+
+inline void
+append_posting_block_values(std::string& out, const uint4* values, size_t n)
+{
+    size_t ctrl = out.size();
+    out.append((n + 3) / 4, '\0');
+    for (size_t i = 0; i != n; ++i) {
+        uint4 v = values[i];
+        unsigned len = 1 + (v > 0xff) + (v > 0xffff) + (v > 0xffffff);
+        out[ctrl + i / 4] |= char((len - 1) << (i % 4 * 2));
+        do {
+            out += char(v);
+            v >>= 8;
+        } while (--len);
+    }
+}
+
+/** Convert pack_uint() encoded postings to block encoded postings.
+ *
+ *  @param p          Start of the encoded postings.
+ *  @param end        End of the encoded postings.
+ *  @param have_wdfs  Are wdfs stored as well as docid deltas?
+ *  @param out        String to append the block encoded postings to.
+ */
+inline void
+encode_postings_blocks(const char* p, const char* end, bool have_wdfs,
+                       std::string& out)
+{
+    // Docid deltas followed by wdfs.
+    uint4 values[HONEY_POSTING_BLOCK_SIZE * 2];
+    while (p != end) {
+        size_t n = 0;
+        do {
+            Xapian::docid delta;
+            Xapian::termcount wdf = 0;
+            if (!unpack_uint(&p, end, &delta) ||
+                (have_wdfs && !unpack_uint(&p, end, &wdf))) {
+                throw Xapian::DatabaseCorruptError("Decoding postings");
+            }
+            if (delta > 0xffffffff || wdf > 0xffffffff) {
+                throw Xapian::DatabaseError("Block encoded postings need "
+                                            "docid gaps and wdfs < 2**32");
+            }
+            values[n] = uint4(delta);
+            values[HONEY_POSTING_BLOCK_SIZE + n] = uint4(wdf);
+        } while (++n != HONEY_POSTING_BLOCK_SIZE && p != end);
+
+        out += char(n - 1);
+        if (have_wdfs) {
+            // Move the wdfs down so they immediately follow the deltas.
+            std::copy_n(values + HONEY_POSTING_BLOCK_SIZE, n, values + n);
+            append_posting_block_values(out, values, n * 2);
+        } else {
+            append_posting_block_values(out, values, n);
+        }
+    }
+}
+
+/** Decode a block of postings.
+ *
+ *  @param p          Pointer to the start of the block, which is updated to
+ *                    point to the end of it.
+ *  @param end        End of the encoded data.
+ *  @param have_wdfs  Are wdfs stored as well as docid deltas?
+ *  @param did        The docid before the first in the block.
+ *  @param dids       Array to store the decoded docids in.
+ *  @param wdfs       Array to store the decoded wdfs in (only used if
+ *                    @a have_wdfs is true).
+ *
+ *  @return The number of postings in the block, or 0 if the encoded data is
+ *          invalid.
+ */
+inline unsigned
+decode_postings_block(const char** p, const char* end, bool have_wdfs,
+                      Xapian::docid did,
+                      Xapian::docid* dids,
+                      Xapian::termcount* wdfs)
+{
+    const unsigned char* q = reinterpret_cast<const unsigned char*>(*p);
+    const unsigned char* q_end = reinterpret_cast<const unsigned char*>(end);
+    if (q == q_end) return 0;
+    unsigned n = *q++ + 1u;
+    if (n > HONEY_POSTING_BLOCK_SIZE) return 0;
+    size_t n_values = have_wdfs ? n * 2 : n;
+    size_t ctrl_len = (n_values + 3) / 4;
+    if (size_t(q_end - q) < ctrl_len) return 0;
+    const unsigned char* ctrl = q;
+    q += ctrl_len;
+
+    // Check all the data is present up front so we don't need to check as we
+    // decode.  The unused codes at the end of the last control byte are zero,
+    // which means a length of one byte.
+    size_t data_len = 0;
+    for (size_t i = 0; i != ctrl_len; ++i) {
+        data_len += posting_block_data_len.len[ctrl[i]];
+    }
+    data_len -= ctrl_len * 4 - n_values;
+    if (size_t(q_end - q) < data_len) return 0;
+    *p = reinterpret_cast<const char*>(q + data_len);
+
+    auto next_value = [&](size_t i) {
+        unsigned len = ((ctrl[i / 4] >> (i % 4 * 2)) & 3) + 1;
+        uint4 v = q[0];
+        if (len > 1) {
+            v |= uint4(q[1]) << 8;
+            if (len > 2) {
+                v |= uint4(q[2]) << 16;
+                if (len > 3) v |= uint4(q[3]) << 24;
+            }
+        }
+        q += len;
+        return v;
+    };
+    for (unsigned i = 0; i != n; ++i) {
+        did += Xapian::docid(next_value(i)) + 1;
+        dids[i] = did;
+    }
+    if (have_wdfs) {
+        for (unsigned i = 0; i != n; ++i) {
+            wdfs[i] = next_value(n + i);
+        }
+    }
+    return n;
+}
+
+/** Convert block encoded postings to pack_uint() encoded postings.
+ *
+ *  @param p          Start of the encoded postings.
+ *  @param end        End of the encoded postings.
+ *  @param have_wdfs  Are wdfs stored as well as docid deltas?
+ *  @param out        String to append the pack_uint() encoded postings to.
+ */
+inline void
+decode_postings_blocks(const char* p, const char* end, bool have_wdfs,
+                       std::string& out)
+{
+    Xapian::docid dids[HONEY_POSTING_BLOCK_SIZE];
+    Xapian::termcount wdfs[HONEY_POSTING_BLOCK_SIZE];
+    while (p != end) {
+        unsigned n = decode_postings_block(&p, end, have_wdfs, 0, dids, wdfs);
+        if (n == 0) {
+            throw Xapian::DatabaseCorruptError("Decoding posting block");
+        }
+        Xapian::docid prev = 0;
+        for (unsigned i = 0; i != n; ++i) {
+            pack_uint(out, dids[i] - prev - 1);
+            prev = dids[i];
+            if (have_wdfs) pack_uint(out, wdfs[i]);
+        }
+    }
+}
+
+}
+
 #endif // XAPIAN_INCLUDED_HONEY_POSTLIST_ENCODINGS_H
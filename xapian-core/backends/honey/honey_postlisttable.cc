@@ -1,7 +1,7 @@
 /** @file
  * @brief Subclass of HoneyTable which holds postlists.
  */
-/* Copyright (C) 2007-2024 Olly Betts
+/* Copyright (C) 2007-2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -43,8 +43,12 @@ HoneyPostListTable::open_post_list(const HoneyDatabase* db,
     Assert(!term.empty());
     // Try to position cursor first so we avoid creating HoneyPostList objects
     // for terms which don't exist.
+    string key = Honey::make_postingchunk_key(term);
+    if (!key_may_exist(key)) {
+        return nullptr;
+    }
     unique_ptr<HoneyCursor> cursor(cursor_get());
-    if (!cursor->find_exact(Honey::make_postingchunk_key(term))) {
+    if (!cursor->find_exact(key)) {
         return nullptr;
     }
 
@@ -1,7 +1,7 @@
 /** @file
  * @brief HoneyTable class
  */
-/* Copyright (C) 2017,2018,2024 Olly Betts
+/* Copyright (C) 2017,2018,2024,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -39,12 +39,187 @@ using Honey::RootInfo;
 
 using namespace std;
 
+#if defined SSTINDEX_ARRAY || defined SSTINDEX_AUTO
+void
+SSTIndex::build_array()
+{
+    if (!pointers) {
+        first = last = 0;
+        pointers = new off_t[1]();
+    }
+    data.resize(0);
+    data.resize(3 + (last - first + 1) * 4);
+    data[0] = 0;
+    data[1] = first;
+    data[2] = last - first;
+    for (unsigned ch = first; ch <= last; ++ch) {
+        size_t o = 3 + (ch - first) * 4;
+        // FIXME: Just make offsets 8 bytes?  Or allow different widths?
+        off_t ptr = pointers[ch];
+        if (sizeof(off_t) > 4 && ptr > off_t(0xffffffff))
+            throw Xapian::DatabaseError("Index offset needs >4 bytes");
+        Assert(o + 4 <= data.size());
+        unaligned_write4(reinterpret_cast<unsigned char*>(&data[o]), ptr);
+    }
+    delete [] pointers;
+    pointers = NULL;
+}
+#endif
+
+#ifdef SSTINDEX_AUTO
+void
+SSTIndexLevel::add(string_view key, make_unsigned_t<off_t> ptr)
+{
+    if (node.size() >= SSTIndex::INDEXNODE)
+        finish_node();
+    size_t reuse = 0;
+    if (node.empty()) {
+        firsts.emplace_back(key, nodes.size());
+    } else {
+        reuse = common_prefix_length(last_key, key);
+    }
+    node += char(reuse);
+    node += char(key.size() - reuse);
+    node.append(key, reuse, key.size() - reuse);
+    pack_uint(node, ptr);
+    last_key = key;
+}
+
+void
+SSTIndexLevel::finish_node()
+{
+    if (node.empty())
+        return;
+    pack_uint(nodes, node.size());
+    nodes += node;
+    node.resize(0);
+}
+
+bool
+SSTIndex::use_btree(off_t end) const
+{
+    if (!pointers) {
+        // Empty table.
+        return false;
+    }
+    if (sizeof(off_t) > 4 && end > off_t(0xffffffff)) {
+        // The array index uses 4 byte pointers.
+        return true;
+    }
+    for (unsigned ch = first; ch <= last; ++ch) {
+        off_t next = (ch == last ? end : pointers[ch + 1]);
+        if (next - pointers[ch] > ARRAY_MAX_SPAN)
+            return true;
+    }
+    return false;
+}
+
+void
+SSTIndex::build_btree()
+{
+    // The levels are stored lowest first, so each level is built before the
+    // one above it, which needs to know the offsets of its child nodes.
+    btree.finish_node();
+    string nodes = btree.get_nodes();
+    auto firsts = std::move(btree.get_firsts());
+    unsigned levels = 1;
+    size_t base = 0;
+    while (firsts.size() > 1) {
+        SSTIndexLevel level;
+        for (auto& entry : firsts) {
+            level.add(entry.first, base + entry.second);
+        }
+        level.finish_node();
+        base = nodes.size();
+        nodes += level.get_nodes();
+        firsts = std::move(level.get_firsts());
+        ++levels;
+    }
+
+    data.resize(0);
+    data += '\x03';
+    pack_uint(data, levels);
+    pack_uint(data, base + firsts[0].second);
+    data += nodes;
+}
+#endif
+
+off_t
+SSTIndex::btree_find(BufferedFile& store,
+                     string_view key,
+                     string& last_key)
+{
+    unsigned levels;
+    size_t node_offset;
+    if (!store.read_uint(&levels) || !store.read_uint(&node_offset)) {
+        throw Xapian::DatabaseCorruptError("Bad multi-level index header");
+    }
+    off_t base = store.get_pos();
+    string node;
+    string sep, candidate;
+    make_unsigned_t<off_t> ptr = 0;
+    bool matched = false;
+    while (levels--) {
+        // Read the whole node in one go.
+        store.set_pos(base + node_offset);
+        size_t node_len;
+        if (!store.read_uint(&node_len)) {
+            throw Xapian::DatabaseCorruptError("Bad index node length");
+        }
+        node.resize(node_len);
+        store.read(&node[0], node_len);
+
+        const char* p = node.data();
+        const char* end = p + node.size();
+        bool first_entry = true;
+        while (p != end) {
+            if (end - p < 2) {
+                throw Xapian::DatabaseCorruptError("Bad index node");
+            }
+            size_t reuse = static_cast<unsigned char>(*p++);
+            size_t len = static_cast<unsigned char>(*p++);
+            if (reuse > sep.size() || size_t(end - p) < len) {
+                throw Xapian::DatabaseCorruptError("Bad index node");
+            }
+            // Each entry after the first in a node reuses bytes from the
+            // previous entry, which is in sep as we stop at the first
+            // entry > key.
+            candidate.assign(sep, 0, reuse);
+            candidate.append(p, len);
+            p += len;
+            if (candidate > key) {
+                if (!first_entry) break;
+                // Only the first separator in the index can be > key, and
+                // the entry it points to is the first in the table.
+                matched = false;
+            } else {
+                matched = true;
+            }
+            first_entry = false;
+            swap(sep, candidate);
+            if (!unpack_uint(&p, end, &ptr)) {
+                throw Xapian::DatabaseCorruptError("Bad index pointer");
+            }
+            if (!matched) break;
+        }
+        node_offset = ptr;
+    }
+    if (matched) {
+        last_key = sep;
+    } else {
+        last_key.resize(0);
+    }
+    return off_t(ptr);
+}
+
 void
 HoneyTable::create_and_open(int flags_, const RootInfo& root_info)
 {
     Assert(!single_file());
     flags = flags_;
     compress_min = root_info.get_compress_min();
+    format_flags = root_info.get_format_flags();
+    filter_offset = root_info.get_filter();
     if (read_only) {
         num_entries = root_info.get_num_entries();
         root = root_info.get_root();
@@ -52,13 +227,23 @@ HoneyTable::create_and_open(int flags_, const RootInfo& root_info)
     }
     if (!store.open(path, read_only))
         throw Xapian::DatabaseOpeningError("Failed to open HoneyTable", errno);
+    if (read_only) {
+        store.map(0, -1);
+        read_filter();
+    } else if (format_flags & Honey::FORMAT_BLOOM_FILTER) {
+        // Use a minimal filter unless size_filter() is called.
+        filter.init(0);
+    }
 }
 
 void
-HoneyTable::open(int flags_, const RootInfo& root_info, honey_revision_number_t)
+HoneyTable::open(int flags_, const RootInfo& root_info, honey_revision_number_t,
+                 off_t end)
 {
     flags = flags_;
     compress_min = root_info.get_compress_min();
+    format_flags = root_info.get_format_flags();
+    filter_offset = root_info.get_filter();
     num_entries = root_info.get_num_entries();
     offset = root_info.get_offset();
     root = root_info.get_root();
@@ -66,10 +251,34 @@ HoneyTable::open(int flags_, const RootInfo& root_info, honey_revision_number_t)
         if (!lazy)
             throw Xapian::DatabaseOpeningError("Failed to open HoneyTable",
                                                errno);
+    } else if (read_only) {
+        store.map(offset, end);
+        read_filter();
+    } else if (format_flags & Honey::FORMAT_BLOOM_FILTER) {
+        // Use a minimal filter unless size_filter() is called.
+        filter.init(0);
     }
     store.set_pos(offset);
 }
 
+void
+HoneyTable::read_filter()
+{
+    if (!(format_flags & Honey::FORMAT_BLOOM_FILTER)) {
+        filter.assign(0, string());
+        return;
+    }
+    store.set_pos(filter_offset);
+    int k = store.read();
+    size_t len;
+    if (k == EOF || !store.read_uint(&len)) {
+        throw Xapian::DatabaseCorruptError("Bad Bloom filter");
+    }
+    string bits(len, '\0');
+    if (len) store.read(&bits[0], len);
+    filter.assign(k, std::move(bits));
+}
+
 void
 HoneyTable::add(std::string_view key,
                 const char* val,
@@ -99,10 +308,16 @@ HoneyTable::add(std::string_view key,
         throw Xapian::InvalidOperationError("New key <= previous key");
     size_t reuse = common_prefix_length(last_key, key);
 
+    if (format_flags & Honey::FORMAT_BLOOM_FILTER) {
+        filter.add(key);
+    }
+
 #ifdef SSTINDEX_ARRAY
     if (reuse == 0) {
         index.maybe_add_entry(key, store.get_pos());
     }
+#elif defined SSTINDEX_AUTO
+    index.maybe_add_entry(key, reuse, store.get_pos());
 #elif defined SSTINDEX_BINARY_CHOP
     // For a binary chop index, the index point is before the key info - the
     // index key must have the same N first bytes as the previous key, where
@@ -137,6 +352,19 @@ HoneyTable::add(std::string_view key,
     last_key = key;
 }
 
+void
+HoneyTable::flush_db()
+{
+    root = index.write(store);
+    if (format_flags & Honey::FORMAT_BLOOM_FILTER) {
+        filter_offset = store.get_pos();
+        string s;
+        filter.serialise(s);
+        store.write(s.data(), s.size());
+    }
+    store.flush();
+}
+
 void
 HoneyTable::commit(honey_revision_number_t, RootInfo* root_info)
 {
@@ -144,8 +372,10 @@ HoneyTable::commit(honey_revision_number_t, RootInfo* root_info)
         throw Xapian::InvalidOperationError("root not set");
 
     root_info->set_num_entries(num_entries);
+    root_info->set_format_flags(format_flags);
     // offset should already be set.
     root_info->set_root(root);
+    root_info->set_filter(filter_offset);
     // Not really meaningful.
     // root_info->set_free_list(std::string());
 
@@ -190,9 +420,13 @@ HoneyTable::read_key(std::string& key,
     }
     size_t key_size = ch;
     char buf[256];
-    store.read(buf, key_size);
     key.assign(last_key, 0, reuse);
-    key.append(buf, key_size);
+    if (const char* p = store.read_mapped(key_size)) {
+        key.append(p, key_size);
+    } else {
+        store.read(buf, key_size);
+        key.append(buf, key_size);
+    }
     last_key = key;
 
 #ifdef DEBUGGING
@@ -252,9 +486,11 @@ HoneyTable::get_exact_entry(std::string_view key, std::string* tag) const
             throw_database_closed();
         return false;
     }
-    store.rewind(root);
     if (rare(key.empty()))
         return false;
+    if (!filter.may_contain(key))
+        return false;
+    store.rewind(root);
     bool exact_match = false;
     bool compressed = false;
     size_t val_size = 0;
@@ -411,6 +647,11 @@ HoneyTable::get_exact_entry(std::string_view key, std::string* tag) const
 
             break;
         }
+        case 0x03: {
+            off_t jump = SSTIndex::btree_find(store, key, last_key);
+            store.rewind(jump);
+            break;
+        }
         default: {
             string m = "HoneyTable: Unknown index type ";
             m += str(index_type);
@@ -435,11 +676,15 @@ HoneyTable::get_exact_entry(std::string_view key, std::string* tag) const
     if (tag != NULL) {
         if (compressed) {
             std::string v;
-            read_val(v, val_size);
+            const char* p = store.read_mapped(val_size);
+            if (!p) {
+                read_val(v, val_size);
+                p = v.data();
+            }
             CompressionStream comp_stream;
             comp_stream.decompress_start();
             tag->resize(0);
-            if (!comp_stream.decompress_chunk(v.data(), v.size(), *tag)) {
+            if (!comp_stream.decompress_chunk(p, val_size, *tag)) {
                 // Decompression didn't complete.
                 abort();
             }
@@ -1,7 +1,7 @@
 /** @file
  * @brief HoneyTable class
  */
-/* Copyright (C) 2017,2018,2023,2024 Olly Betts
+/* Copyright (C) 2017,2018,2023,2024,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -25,7 +25,10 @@
 # error config.h must be included first in each C++ source file
 #endif
 
-#define SSTINDEX_ARRAY
+// SSTINDEX_AUTO picks SSTINDEX_ARRAY or a multi-level index for each table
+// when it is written.
+#define SSTINDEX_AUTO
+//#define SSTINDEX_ARRAY
 //#define SSTINDEX_BINARY_CHOP
 //#define SSTINDEX_SKIPLIST
 
@@ -39,22 +42,29 @@
 
 #include <algorithm>
 #include <string_view>
+#include <utility>
+#include <vector>
 #if 0
 #include <iostream> // FIXME
 #endif
 
+#include <cstdint> // For SIZE_MAX
 #include <cstdio> // For EOF
 #include <cstdlib> // std::abort()
 #include <type_traits>
 #ifdef HAVE_SYS_UIO_H
 # include <sys/uio.h>
 #endif
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
 
 #include <sys/types.h>
 #include "safesysstat.h"
 #include "safeunistd.h"
 
 #include "compression_stream.h"
+#include "honey_bloom.h"
 #include "honey_defs.h"
 #include "honey_version.h"
 #include "internaltypes.h"
@@ -80,12 +90,90 @@ class BufferedFileCommon {
     unsigned _refs = 0;
     off_t offset = 0;
 
+    /** The table's data mapped into memory, or NULL if it isn't mapped.
+     *
+     *  Honey tables are never modified once written, so when reading we try
+     *  to map the table, then read directly from the mapping which avoids a
+     *  system call and a copy into a buffer for each read.
+     *
+     *  map[0] is the byte at file offset map_start.
+     */
+    const char* map = nullptr;
+
+    /// File offset of the start of the mapped data.
+    off_t map_start = 0;
+
+    /// Size of the mapped data in bytes.
+    size_t map_size = 0;
+
+    /// Address and length of the mapping, for munmap().
+    void* map_addr = nullptr;
+    size_t map_len = 0;
+
     BufferedFileCommon(int fd_, off_t offset_)
         : fd(fd_), _refs(1), offset(offset_) {}
 
+    ~BufferedFileCommon() { unmap(); }
+
     BufferedFileCommon(const BufferedFileCommon&) = delete;
 
     BufferedFileCommon& operator=(const BufferedFileCommon&) = delete;
+
+    /** Try to map file offsets @a start to @a end into memory.
+     *
+     *  If @a end is -1, map up to the end of the file.  If this fails we
+     *  just read with pread() instead.
+     */
+    void map_range(off_t start, off_t end) {
+#ifdef HAVE_MMAP
+        unmap();
+        if (end < 0) {
+            struct stat statbuf;
+            if (fstat(fd, &statbuf) < 0)
+                return;
+            end = statbuf.st_size;
+        }
+        if (start < 0 || end <= start)
+            return;
+        // The offset passed to mmap() must be a multiple of the page size.
+        static const long page_size = sysconf(_SC_PAGESIZE);
+        if (page_size <= 0)
+            return;
+        off_t mmap_offset = start - start % page_size;
+        if (std::make_unsigned_t<off_t>(end - mmap_offset) > SIZE_MAX)
+            return;
+        size_t len = size_t(end - mmap_offset);
+        void* p = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, mmap_offset);
+        if (p == MAP_FAILED)
+            return;
+        map_addr = p;
+        map_len = len;
+        map = static_cast<const char*>(p) + (start - mmap_offset);
+        map_start = start;
+        map_size = size_t(end - start);
+#else
+        (void)start;
+        (void)end;
+#endif
+    }
+
+    void unmap() {
+#ifdef HAVE_MMAP
+        if (map) {
+            munmap(map_addr, map_len);
+            map = nullptr;
+            map_start = 0;
+            map_size = 0;
+            map_addr = nullptr;
+            map_len = 0;
+        }
+#endif
+    }
+
+    /// Is file offset @a pos within the mapped data?
+    bool mapped(off_t pos) const {
+        return pos >= map_start && size_t(pos - map_start) < map_size;
+    }
 };
 
 class BufferedFile {
@@ -122,7 +210,8 @@ class BufferedFile {
 
     BufferedFile(int fd_, off_t offset_, off_t pos_, bool read_only_)
         : common(new BufferedFileCommon(fd_, offset_)),
-          pos(pos_), read_only(read_only_) {}
+          pos(pos_), read_only(read_only_) {
+    }
 
     ~BufferedFile() {
         if (common && --common->_refs == 0)
@@ -133,6 +222,7 @@ class BufferedFile {
 
     void close(bool fd_owned) {
         if (common && common->fd >= 0) {
+            common->unmap();
             if (fd_owned) ::close(common->fd);
             common->fd = -1;
         }
@@ -140,6 +230,7 @@ class BufferedFile {
 
     void force_close(bool fd_owned) {
         if (common) {
+            common->unmap();
             if (fd_owned && common->fd >= 0) ::close(common->fd);
             common->fd = FORCED_CLOSE;
         }
@@ -168,6 +259,19 @@ class BufferedFile {
         return true;
     }
 
+    /** Try to map file offsets @a start to @a end into memory for reading.
+     *
+     *  If @a end is -1, map up to the end of the file.  Reads outside this
+     *  range act as if they were beyond the end of the file.
+     */
+    void map(off_t start, off_t end) {
+        if (!read_only) std::abort();
+        // We never buffer data when the file is mapped.
+        pos -= buf_end;
+        buf_end = 0;
+        common->map_range(start, end);
+    }
+
     off_t get_pos() const {
         return read_only ? pos - buf_end : pos + buf_end;
     }
@@ -273,6 +377,13 @@ class BufferedFile {
     }
 
     int read() const {
+        if (common->map) {
+            // We never buffer data when the file is mapped, so pos is the
+            // current position.
+            if (!common->mapped(pos)) return EOF;
+            return static_cast<unsigned char>(
+                common->map[pos++ - common->map_start]);
+        }
         if (buf_end == 0) {
             // The buffer is currently empty, so we need to read at least one
             // byte.
@@ -297,7 +408,45 @@ class BufferedFile {
         return res;
     }
 
+    /** Read an unsigned integer encoded with pack_uint().
+     *
+     *  Returns false if the encoded value is invalid or too large for @a U.
+     */
+    template<class U>
+    bool read_uint(U* result) const {
+        char enc[(sizeof(U) * 8 + 6) / 7];
+        size_t n = 0;
+        while (true) {
+            int ch = read();
+            if (ch == EOF || n == sizeof(enc)) return false;
+            enc[n++] = char(ch);
+            if (ch < 128) break;
+        }
+        const char* p = enc;
+        return unpack_uint(&p, enc + n, result);
+    }
+
+    /** Return a pointer to the next @a len bytes if the file is mapped.
+     *
+     *  If the file is mapped, the position is advanced past these bytes.
+     *  Otherwise NULL is returned and the position is unchanged.
+     */
+    const char* read_mapped(size_t len) const {
+        if (!common->map) return NULL;
+        if (rare(pos < common->map_start ||
+                 size_t(pos - common->map_start) > common->map_size ||
+                 len > common->map_size - size_t(pos - common->map_start)))
+            throw Xapian::DatabaseError("EOF reading database");
+        const char* p = common->map + (pos - common->map_start);
+        pos += len;
+        return p;
+    }
+
     void read(char* p, size_t len) const {
+        if (const char* m = read_mapped(len)) {
+            memcpy(p, m, len);
+            return;
+        }
         if (buf_end != 0) {
             if (len <= buf_end) {
                 memcpy(p, buf + sizeof(buf) - buf_end, len);
@@ -337,9 +486,47 @@ class BufferedFile {
 
 class HoneyCursor;
 
+#ifdef SSTINDEX_AUTO
+/** Builds one level of a multi-level SSTIndex.
+ *
+ *  Each entry is a separator key and a pointer, which is a file offset in the
+ *  data for the lowest level and the offset of a node in the level below
+ *  otherwise.  Entries are grouped into nodes of about SSTIndex::INDEXNODE
+ *  bytes, each preceded by its encoded length so it can be loaded with a
+ *  single read.  Within a node, each separator is encoded as the number of
+ *  bytes it shares with the previous one and the remaining bytes.
+ */
+class SSTIndexLevel {
+    /// The nodes which have been finished.
+    std::string nodes;
+
+    /// The encoded entries of the node being built.
+    std::string node;
+
+    /// The previous separator in the node being built.
+    std::string last_key;
+
+    /// The first separator in each node and the offset of that node.
+    std::vector<std::pair<std::string, size_t>> firsts;
+
+  public:
+    /// Add an entry.
+    void add(std::string_view key, std::make_unsigned_t<off_t> ptr);
+
+    /// Finish the node being built, if it isn't empty.
+    void finish_node();
+
+    const std::string& get_nodes() const { return nodes; }
+
+    std::vector<std::pair<std::string, size_t>>& get_firsts() {
+        return firsts;
+    }
+};
+#endif
+
 class SSTIndex {
     std::string data;
-#if defined SSTINDEX_BINARY_CHOP
+#if defined SSTINDEX_BINARY_CHOP || defined SSTINDEX_AUTO
     size_t block = size_t(-1);
 #elif defined SSTINDEX_SKIPLIST
     size_t block = 0;
@@ -347,19 +534,72 @@ class SSTIndex {
 #if defined SSTINDEX_BINARY_CHOP || defined SSTINDEX_SKIPLIST
     std::string last_index_key;
 #endif
+  public:
     // Put an index entry every this much:
     // FIXME: tune - seems 64K is common elsewhere
     enum { INDEXBLOCK = 4096 };
+
+    /** Size to aim for multi-level index nodes to be.
+     *
+     *  Smaller nodes mean fewer cache lines to scan in each node, but more
+     *  levels.
+     */
+    enum { INDEXNODE = 1024 };
+
+    /** Maximum span of data for one array index entry.
+     *
+     *  With SSTINDEX_AUTO, if we'd have to scan through more than this much
+     *  data for a key using an array index, we write a multi-level index
+     *  instead.  FIXME: tune
+     */
+    enum { ARRAY_MAX_SPAN = 8 * INDEXBLOCK };
+
+  private:
     SSTIndex* parent_index = NULL;
 
-#ifdef SSTINDEX_ARRAY
+#if defined SSTINDEX_ARRAY || defined SSTINDEX_AUTO
     unsigned char first, last = static_cast<unsigned char>(-1);
     off_t* pointers = NULL;
+
+    /// Add an array index entry for keys starting with @a initial.
+    void add_array_entry(unsigned char initial, off_t ptr) {
+        if (!pointers) {
+            pointers = new off_t[256]();
+            first = initial;
+        }
+        // We should only be called for valid index points.
+        AssertRel(int(initial), !=, last);
+
+        while (++last != int(initial)) {
+            pointers[last] = ptr;
+            // FIXME: Perhaps record this differently so that an exact key
+            // search can return false?
+        }
+        pointers[initial] = ptr;
+        last = initial;
+    }
+
+    /// Build an array index in data.
+    void build_array();
+#endif
+
+#ifdef SSTINDEX_AUTO
+    /// The lowest level of the multi-level index.
+    SSTIndexLevel btree;
+
+    /** Should we write a multi-level index rather than an array index?
+     *
+     *  @param end  The offset of the end of the data.
+     */
+    bool use_btree(off_t end) const;
+
+    /// Build a multi-level index in data.
+    void build_btree();
 #endif
 
   public:
     SSTIndex() {
-#ifdef SSTINDEX_ARRAY
+#if defined SSTINDEX_ARRAY || defined SSTINDEX_AUTO
         // Header added in write() method.
 #elif defined SSTINDEX_BINARY_CHOP
         data.assign(5, '\x01');
@@ -371,29 +611,40 @@ class SSTIndex {
     }
 
     ~SSTIndex() {
-#ifdef SSTINDEX_ARRAY
+#if defined SSTINDEX_ARRAY || defined SSTINDEX_AUTO
         delete [] pointers;
 #endif
     }
 
-    void maybe_add_entry(std::string_view key, off_t ptr) {
+#ifdef SSTINDEX_AUTO
+    /** Add an entry for @a key at file offset @a ptr if appropriate.
+     *
+     *  Called for every key.  @a reuse is the length of the prefix @a key
+     *  shares with the previous key.
+     */
+    void maybe_add_entry(std::string_view key, size_t reuse, off_t ptr) {
         Assert(!key.empty());
-#ifdef SSTINDEX_ARRAY
-        unsigned char initial = key[0];
-        if (!pointers) {
-            pointers = new off_t[256]();
-            first = initial;
+        if (reuse == 0) {
+            add_array_entry(key[0], ptr);
         }
-        // We should only be called for valid index points.
-        AssertRel(int(initial), !=, last);
 
-        while (++last != int(initial)) {
-            pointers[last] = ptr;
-            // FIXME: Perhaps record this differently so that an exact key
-            // search can return false?
-        }
-        pointers[initial] = ptr;
-        last = initial;
+        // Thin entries to at most one per INDEXBLOCK sized block.
+        size_t cur_block = ptr / INDEXBLOCK;
+        if (cur_block == block)
+            return;
+
+        // The separator is the shortest prefix of key which sorts after the
+        // previous key.  When jumping in to ptr from the index, the separator
+        // contains all the bytes the key at ptr reuses from the previous key.
+        btree.add(key.substr(0, reuse + 1), ptr);
+        block = cur_block;
+    }
+
+#else
+    void maybe_add_entry(std::string_view key, off_t ptr) {
+        Assert(!key.empty());
+#ifdef SSTINDEX_ARRAY
+        add_array_entry(key[0], ptr);
 #elif defined SSTINDEX_BINARY_CHOP
         // We store entries truncated to a maximum width (and trailing zeros
         // are used to indicate keys shorter than that max width).  These then
@@ -465,31 +716,21 @@ class SSTIndex {
 # error SSTINDEX type not specified
 #endif
     }
+#endif
 
     off_t write(BufferedFile& store) {
         off_t root = store.get_pos();
 
 #ifdef SSTINDEX_ARRAY
-        if (!pointers) {
-            first = last = 0;
-            pointers = new off_t[1]();
-        }
-        data.resize(0);
-        data.resize(3 + (last - first + 1) * 4);
-        data[0] = 0;
-        data[1] = first;
-        data[2] = last - first;
-        for (unsigned ch = first; ch <= last; ++ch) {
-            size_t o = 3 + (ch - first) * 4;
-            // FIXME: Just make offsets 8 bytes?  Or allow different widths?
-            off_t ptr = pointers[ch];
-            if (sizeof(off_t) > 4 && ptr > off_t(0xffffffff))
-                throw Xapian::DatabaseError("Index offset needs >4 bytes");
-            Assert(o + 4 <= data.size());
-            unaligned_write4(reinterpret_cast<unsigned char*>(&data[o]), ptr);
+        build_array();
+#elif defined SSTINDEX_AUTO
+        if (use_btree(root)) {
+            build_btree();
+            delete [] pointers;
+            pointers = NULL;
+        } else {
+            build_array();
         }
-        delete [] pointers;
-        pointers = NULL;
 #elif defined SSTINDEX_BINARY_CHOP
         if (last_index_key.size() == SSTINDEX_BINARY_CHOP_KEY_SIZE) {
             // Increment final byte(s) to give a key which is definitely
@@ -538,6 +779,19 @@ skip_adding_upper_bound:
         return root;
     }
 
+    /** Find where to start scanning for @a key using a multi-level index.
+     *
+     *  @param store     Positioned just after the index type byte.
+     *  @param key       The key to look for.
+     *  @param last_key  Set to the key prefix to decode the entry at the
+     *                   returned offset relative to.
+     *
+     *  @return The file offset to start scanning forwards from.
+     */
+    static off_t btree_find(BufferedFile& store,
+                            std::string_view key,
+                            std::string& last_key);
+
     size_t size() const {
         // FIXME: For SSTINDEX_ARRAY, data.size() only correct after calling
         // write().
@@ -559,6 +813,12 @@ class HoneyTable {
     bool read_only;
     int flags;
     uint4 compress_min;
+    /// Honey::FORMAT_* flags for this table.
+    unsigned format_flags = 0;
+    /// Bloom filter over the keys (if FORMAT_BLOOM_FILTER is set).
+    Honey::BloomFilter filter;
+    /// Offset of the Bloom filter in the file.
+    off_t filter_offset = 0;
     mutable BufferedFile store;
     mutable std::string last_key;
     SSTIndex index;
@@ -581,6 +841,9 @@ class HoneyTable {
 
     void read_val(std::string& val, size_t val_size) const;
 
+    /// Read the Bloom filter from filter_offset.
+    void read_filter();
+
   public:
     HoneyTable(const char*, const std::string& path_, bool read_only_,
                bool lazy_ = false)
@@ -616,8 +879,13 @@ class HoneyTable {
 
     void create_and_open(int flags_, const Honey::RootInfo& root_info);
 
+    /** Open the table.
+     *
+     *  @param end  File offset of the end of the table's data, or -1 if it
+     *              extends to the end of the file.  Only used when reading.
+     */
     void open(int flags_, const Honey::RootInfo& root_info,
-              honey_revision_number_t);
+              honey_revision_number_t, off_t end = -1);
 
     void close(bool permanent) {
         bool fd_owned = !single_file();
@@ -640,10 +908,7 @@ class HoneyTable {
         add(key, val.data(), val.size(), compressed);
     }
 
-    void flush_db() {
-        root = index.write(store);
-        store.flush();
-    }
+    void flush_db();
 
     void cancel(const Honey::RootInfo&, honey_revision_number_t) {
         std::abort();
@@ -692,6 +957,31 @@ class HoneyTable {
 
     honey_tablesize_t get_entry_count() const { return num_entries; }
 
+    unsigned get_format_flags() const { return format_flags; }
+
+    /** Might @a key be present in this table?
+     *
+     *  If there's no Bloom filter for the table then this always returns true.
+     */
+    bool key_may_exist(std::string_view key) const {
+        return filter.may_contain(key);
+    }
+
+    /// Size of the Bloom filter in bytes (0 if there isn't one).
+    size_t get_filter_size() const { return filter.size(); }
+
+    /** Size the Bloom filter being built for about @a num_keys keys.
+     *
+     *  Does nothing unless the table is being written with a Bloom filter.
+     *  Must be called before any entries are added.
+     */
+    void size_filter(honey_tablesize_t num_keys) {
+        if (!read_only && (format_flags & Honey::FORMAT_BLOOM_FILTER)) {
+            AssertEq(num_entries, 0);
+            filter.init(num_keys);
+        }
+    }
+
     /** Return an approximation of the number of entries in the table.
      *
      *  Currently this is exact, but may not be in the future.
@@ -1,7 +1,7 @@
 /** @file
  * @brief Honey class for value streams.
  */
-/* Copyright (C) 2007,2008,2009 Olly Betts
+/* Copyright (C) 2007,2008,2009,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -38,7 +38,7 @@ HoneyValueList::update_reader()
 
     cursor->read_tag();
     const string& tag = cursor->current_tag;
-    reader.assign(tag.data(), tag.size(), last_did);
+    reader.assign(tag.data(), tag.size(), last_did, columns);
     return true;
 }
 
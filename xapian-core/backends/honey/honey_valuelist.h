@@ -1,7 +1,7 @@
 /** @file
  * @brief Honey class for value streams.
  */
-/* Copyright (C) 2007,2008,2009,2011 Olly Betts
+/* Copyright (C) 2007,2008,2009,2011,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -41,14 +41,18 @@ class HoneyValueList : public Xapian::ValueIterator::Internal {
 
     Xapian::valueno slot;
 
+    /// Do value chunks start with a byte giving their encoding?
+    bool columns;
+
     Xapian::Internal::intrusive_ptr<const HoneyDatabase> db;
 
     /// Update @a reader to use the chunk currently pointed to by @a cursor.
     bool update_reader();
 
   public:
-    HoneyValueList(Xapian::valueno slot_, const HoneyDatabase* db_)
-        : slot(slot_), db(db_) { }
+    HoneyValueList(Xapian::valueno slot_, bool columns_,
+                   const HoneyDatabase* db_)
+        : slot(slot_), columns(columns_), db(db_) { }
 
     ~HoneyValueList();
 
@@ -1,7 +1,7 @@
 /** @file
  * @brief HoneyValueManager class
  */
-/* Copyright (C) 2008,2009,2010,2011,2012,2016,2017,2018 Olly Betts
+/* Copyright (C) 2008,2009,2010,2011,2012,2016,2017,2018,2026 Olly Betts
  * Copyright (C) 2008,2009 Lemur Consulting Ltd
  *
  * This program is free software; you can redistribute it and/or modify
@@ -38,7 +38,11 @@
 #include "xapian/valueiterator.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
 #include <memory>
+#include <string_view>
 
 using namespace Honey;
 using namespace std;
@@ -48,20 +52,120 @@ using namespace std;
 //  * values named instead of numbered?
 
 void
-ValueChunkReader::assign(const char* p_, size_t len, Xapian::docid last_did)
+ValueChunkReader::assign(const char* p_, size_t len, Xapian::docid last_did_,
+                         bool columns)
 {
     p = p_;
     end = p_ + len;
-    if (!unpack_uint(&p, end, &did))
+    last_did = last_did_;
+    encoding = VALUE_CHUNK_STREAM;
+    if (columns) {
+        if (p == end)
+            throw Xapian::DatabaseCorruptError("Empty value chunk");
+        encoding = static_cast<unsigned char>(*p++);
+    }
+    Xapian::docid delta;
+    if (!unpack_uint(&p, end, &delta))
         throw Xapian::DatabaseCorruptError("Failed to unpack docid delta");
-    did = last_did - did;
-    if (!unpack_string(&p, end, value))
-        throw Xapian::DatabaseCorruptError("Failed to unpack first value");
+    first_did = last_did - delta;
+    switch (encoding) {
+        case VALUE_CHUNK_STREAM:
+            did = first_did;
+            if (!unpack_string(&p, end, value))
+                throw Xapian::DatabaseCorruptError("Failed to unpack first "
+                                                   "value");
+            return;
+        case VALUE_CHUNK_DICTIONARY: {
+            size_t n;
+            if (!unpack_uint(&p, end, &n) || n == 0 || n > 0xffff) {
+                throw Xapian::DatabaseCorruptError("Bad value dictionary "
+                                                   "size");
+            }
+            dictionary.clear();
+            while (n--) {
+                size_t value_len;
+                if (!unpack_uint(&p, end, &value_len) ||
+                    value_len > size_t(end - p)) {
+                    throw Xapian::DatabaseCorruptError("Failed to unpack "
+                                                       "value dictionary "
+                                                       "entry");
+                }
+                dictionary.emplace_back(p, value_len);
+                p += value_len;
+            }
+            width = dictionary.size() < 256 ? 1 : 2;
+            break;
+        }
+        case VALUE_CHUNK_FIXED:
+            if (p == end)
+                throw Xapian::DatabaseCorruptError("Missing value width");
+            width = static_cast<unsigned char>(*p++) + 1;
+            break;
+        default:
+            throw Xapian::DatabaseCorruptError("Unknown value chunk "
+                                               "encoding");
+    }
+    if (size_t(end - p) / width != size_t(delta) + 1 ||
+        size_t(end - p) % width != 0) {
+        throw Xapian::DatabaseCorruptError("Value column has wrong size");
+    }
+    entries = p;
+    column_skip_to(first_did);
+}
+
+void
+ValueChunkReader::column_skip_to(Xapian::docid target)
+{
+    AssertRel(target, >=, first_did);
+    AssertRel(target, <=, last_did);
+    const char* e = entries + size_t(target - first_did) * width;
+    while (true) {
+        if (encoding == VALUE_CHUNK_DICTIONARY) {
+            unsigned i = static_cast<unsigned char>(e[0]);
+            if (width == 2) i |= unsigned(static_cast<unsigned char>(e[1])) << 8;
+            if (i) {
+                if (rare(i > dictionary.size())) {
+                    throw Xapian::DatabaseCorruptError("Bad value "
+                                                       "dictionary index");
+                }
+                value.assign(dictionary[i - 1]);
+                break;
+            }
+        } else {
+            unsigned value_len = static_cast<unsigned char>(e[0]);
+            if (value_len) {
+                if (rare(value_len >= width)) {
+                    throw Xapian::DatabaseCorruptError("Bad value length in "
+                                                       "column");
+                }
+                value.assign(e + 1, value_len);
+                break;
+            }
+        }
+        // No value for this docid.
+        if (target == last_did) {
+            p = NULL;
+            return;
+        }
+        ++target;
+        e += width;
+    }
+    did = target;
+    p = e;
 }
 
 void
 ValueChunkReader::next()
 {
+    if (encoding != VALUE_CHUNK_STREAM) {
+        if (did == last_did) {
+            p = NULL;
+            return;
+        }
+        column_skip_to(did + 1);
+        return;
+    }
+
     if (p == end) {
         p = NULL;
         return;
@@ -83,6 +187,15 @@ ValueChunkReader::skip_to(Xapian::docid target)
     if (p == NULL || target <= did)
         return;
 
+    if (encoding != VALUE_CHUNK_STREAM) {
+        if (target > last_did) {
+            p = NULL;
+            return;
+        }
+        column_skip_to(target);
+        return;
+    }
+
     size_t value_len;
     while (p != end) {
         // Get the next docid
@@ -263,7 +376,7 @@ class ValueUpdater {
                 cursor->read_tag();
                 // FIXME:swap(cursor->current_tag, ctag);
                 ctag = cursor->current_tag;
-                reader.assign(ctag.data(), ctag.size(), last_did);
+                reader.assign(ctag.data(), ctag.size(), last_did, false);
             }
             if (cursor->next()) {
                 const string& key = cursor->current_key;
@@ -300,6 +413,105 @@ class ValueUpdater {
     }
 };
 
+void
+ValueChunkWriter::append(Xapian::valueno slot_, Xapian::docid did,
+                         const string& val)
+{
+    Assert(!val.empty());
+    if (!stream.empty() && slot_ != slot) flush();
+    slot = slot_;
+    if (stream.empty()) {
+        first_did = did;
+    } else {
+        AssertRel(did, >, last_did);
+        pack_uint(stream, did - last_did - 1);
+    }
+    last_did = did;
+    pack_string(stream, val);
+    if (columns) {
+        dids.push_back(did);
+        values.push_back(val);
+    }
+    if (stream.size() >= CHUNK_SIZE_THRESHOLD) flush();
+}
+
+void
+ValueChunkWriter::flush()
+{
+    if (stream.empty()) return;
+
+    Xapian::docid delta = last_did - first_did;
+    string tag;
+    int encoding = VALUE_CHUNK_STREAM;
+    map<string_view, unsigned> distinct;
+    size_t max_len = 0;
+    if (columns) {
+        // Work out roughly how big each encoding would be.  A column gives
+        // direct access to the entry for each docid, so we use one if it's
+        // no more than twice the size of the stream, which means a chunk
+        // needs to have values for around half its docids or more.
+        size_t n = size_t(delta) + 1;
+        size_t dict_size = 0;
+        for (const string& val : values) {
+            if (val.size() > max_len) max_len = val.size();
+            if (distinct.emplace(val, 0).second) dict_size += val.size() + 1;
+        }
+        dict_size += n * (distinct.size() < 256 ? 1 : 2);
+        size_t fixed_size = SIZE_MAX;
+        if (max_len < 256) fixed_size = n * (max_len + 1);
+        size_t limit = stream.size() * 2;
+        if (dict_size < fixed_size) {
+            if (dict_size <= limit) encoding = VALUE_CHUNK_DICTIONARY;
+        } else {
+            if (fixed_size <= limit) encoding = VALUE_CHUNK_FIXED;
+        }
+        tag += char(encoding);
+    }
+    pack_uint(tag, delta);
+
+    switch (encoding) {
+        case VALUE_CHUNK_STREAM:
+            tag += stream;
+            break;
+        case VALUE_CHUNK_DICTIONARY: {
+            pack_uint(tag, distinct.size());
+            unsigned i = 0;
+            for (auto& entry : distinct) {
+                entry.second = ++i;
+                pack_string(tag, entry.first);
+            }
+            size_t width = distinct.size() < 256 ? 1 : 2;
+            size_t start = tag.size();
+            tag.append((size_t(delta) + 1) * width, '\0');
+            for (size_t j = 0; j != dids.size(); ++j) {
+                char* e = &tag[start + size_t(dids[j] - first_did) * width];
+                unsigned index = distinct.find(values[j])->second;
+                e[0] = char(index);
+                if (width == 2) e[1] = char(index >> 8);
+            }
+            break;
+        }
+        case VALUE_CHUNK_FIXED: {
+            tag += char(max_len);
+            size_t width = max_len + 1;
+            size_t start = tag.size();
+            tag.append((size_t(delta) + 1) * width, '\0');
+            for (size_t j = 0; j != dids.size(); ++j) {
+                char* e = &tag[start + size_t(dids[j] - first_did) * width];
+                const string& val = values[j];
+                e[0] = char(val.size());
+                memcpy(e + 1, val.data(), val.size());
+            }
+            break;
+        }
+    }
+
+    table.add(make_valuechunk_key(slot, last_did), tag);
+    stream.resize(0);
+    dids.clear();
+    values.clear();
+}
+
 }
 
 void
@@ -513,7 +725,9 @@ HoneyValueManager::get_value(Xapian::docid did, Xapian::valueno slot) const
     last_did = get_chunk_containing_did(slot, did, chunk);
     if (last_did == 0) return string();
 
-    ValueChunkReader reader(chunk.data(), chunk.size(), last_did);
+    bool columns = (postlist_table.get_format_flags() &
+                    Honey::FORMAT_VALUE_COLUMNS);
+    ValueChunkReader reader(chunk.data(), chunk.size(), last_did, columns);
     reader.skip_to(did);
     if (reader.at_end() || reader.get_docid() != did) return string();
     return reader.get_value();
@@ -31,6 +31,8 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace Honey {
 
@@ -223,6 +225,44 @@ class HoneyValueManager {
 
 namespace Honey {
 
+/** Encodings for value chunks.
+ *
+ *  If the postlist table has the FORMAT_VALUE_COLUMNS format flag set, each
+ *  value chunk starts with a byte giving its encoding, otherwise all value
+ *  chunks use VALUE_CHUNK_STREAM without this byte.
+ *
+ *  Every encoding then continues with the difference between the last and
+ *  first docids in the chunk, packed with pack_uint().
+ */
+enum {
+    /** Entries stored as a stream.
+     *
+     *  The first value follows, packed with pack_string(), then for each
+     *  subsequent entry the docid gap less one packed with pack_uint() and
+     *  the value packed with pack_string().
+     */
+    VALUE_CHUNK_STREAM = 0,
+
+    /** Entries stored as indices into a dictionary.
+     *
+     *  The number of distinct values follows, packed with pack_uint(), then
+     *  the distinct values each packed with pack_string().  Then there's an
+     *  index for every docid in the chunk, each one byte if there are fewer
+     *  than 256 distinct values and otherwise two bytes (little-endian).  An
+     *  index of zero means no value, and i means the i-th distinct value.
+     */
+    VALUE_CHUNK_DICTIONARY = 1,
+
+    /** Entries stored at a fixed width.
+     *
+     *  A byte giving the length of the longest value follows, then for every
+     *  docid in the chunk a byte giving the length of the value (zero means
+     *  no value) followed by the value padded with zero bytes to the length
+     *  of the longest value.
+     */
+    VALUE_CHUNK_FIXED = 2
+};
+
 class ValueChunkReader {
     const char* p;
     const char* end;
@@ -231,15 +271,50 @@ class ValueChunkReader {
 
     std::string value;
 
+    /// The encoding of the chunk (one of the VALUE_CHUNK_* constants).
+    int encoding;
+
+    /// The first docid in the chunk.
+    Xapian::docid first_did;
+
+    /// The last docid in the chunk.
+    Xapian::docid last_did;
+
+    /// The entry for first_did (for column encodings).
+    const char* entries;
+
+    /// Size in bytes of the entry for each docid (for column encodings).
+    unsigned width;
+
+    /// The distinct values (for VALUE_CHUNK_DICTIONARY).
+    std::vector<std::string_view> dictionary;
+
+    /** Move to the first entry with docid >= @a target.
+     *
+     *  Only used for column encodings.  @a target must be in the chunk.
+     */
+    void column_skip_to(Xapian::docid target);
+
   public:
     /// Create a ValueChunkReader which is already at_end().
     ValueChunkReader() : p(NULL) { }
 
-    ValueChunkReader(const char* p_, size_t len, Xapian::docid last_did) {
-        assign(p_, len, last_did);
+    ValueChunkReader(const char* p_, size_t len, Xapian::docid last_did_,
+                     bool columns) {
+        assign(p_, len, last_did_, columns);
     }
 
-    void assign(const char* p_, size_t len, Xapian::docid last_did);
+    /** Start reading a chunk.
+     *
+     *  @param p_         The chunk data.  Must stay valid while this object
+     *                    is using it.
+     *  @param len        The length of the chunk data.
+     *  @param last_did_  The last docid in the chunk (from its key).
+     *  @param columns    Does the chunk start with a byte giving its
+     *                    encoding (i.e. is FORMAT_VALUE_COLUMNS set)?
+     */
+    void assign(const char* p_, size_t len, Xapian::docid last_did_,
+                bool columns);
 
     bool at_end() const { return p == NULL; }
 
@@ -252,6 +327,55 @@ class ValueChunkReader {
     void skip_to(Xapian::docid target);
 };
 
+/** Write out the value chunks for a value slot.
+ *
+ *  Used when compacting to write chunks of about the same size regardless
+ *  of how the input was chunked, and to choose the encoding for each chunk.
+ */
+class ValueChunkWriter {
+    HoneyTable& table;
+
+    /// Should chunks be written as columns where that's more compact?
+    bool columns;
+
+    /// The slot chunks are currently being written for.
+    Xapian::valueno slot;
+
+    /// The current chunk in VALUE_CHUNK_STREAM encoding (without header).
+    std::string stream;
+
+    /// The docids in the current chunk (if columns is true).
+    std::vector<Xapian::docid> dids;
+
+    /// The values in the current chunk (if columns is true).
+    std::vector<std::string> values;
+
+    /// The first docid in the current chunk.
+    Xapian::docid first_did;
+
+    /// The last docid in the current chunk.
+    Xapian::docid last_did;
+
+  public:
+    /** Constructor.
+     *
+     *  @param table_    The table to write to.
+     *  @param columns_  Is FORMAT_VALUE_COLUMNS set for @a table_?
+     */
+    ValueChunkWriter(HoneyTable& table_, bool columns_)
+        : table(table_), columns(columns_) { }
+
+    /** Append an entry.
+     *
+     *  Entries must be in ascending order of slot and then docid.
+     */
+    void append(Xapian::valueno slot_, Xapian::docid did,
+                const std::string& val);
+
+    /// Write out any pending chunk.
+    void flush();
+};
+
 }
 
 #endif // XAPIAN_INCLUDED_HONEY_VALUES_H
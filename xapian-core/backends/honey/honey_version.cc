@@ -1,7 +1,7 @@
 /** @file
  * @brief HoneyVersion class
  */
-/* Copyright (C) 2006,2007,2008,2009,2010,2013,2014,2015,2016,2017,2018 Olly Betts
+/* Copyright (C) 2006,2007,2008,2009,2010,2013,2014,2015,2016,2017,2018,2026 Olly Betts
  * Copyright (C) 2011 Dan Colish
  *
  * This program is free software; you can redistribute it and/or modify
@@ -51,7 +51,10 @@
 using namespace std;
 
 /// Honey format version (date of change):
-#define HONEY_FORMAT_VERSION DATE_TO_VERSION(2018,4,3)
+#define HONEY_FORMAT_VERSION DATE_TO_VERSION(2026,10,19)
+// 2026,10,19 2.1.0 multi-level table index; per-table format flags; Bloom
+//                  filters; block encoded positions; value columns;
+//                  impacts
 // 2018,4,3   2.0.0 outlaw mixed-wdf terms
 // 2018,3,28        don't special case first entry in SSTable
 // 2018,3,27        new key format for value stats, value chunks, doclen chunks
@@ -76,6 +79,13 @@ using namespace std;
 // 2017,12,29       User metadata key changes
 // 2017,12,5        New Honey backend
 
+/** Oldest honey format version we can read.
+ *
+ *  Databases in this format differ only in never using a multi-level index
+ *  or setting any per-table format flags (that field was always zero).
+ */
+#define HONEY_FORMAT_VERSION_MIN DATE_TO_VERSION(2018,4,3)
+
 /// Convert date <-> version number.  Dates up to 2141-12-31 fit in 2 bytes.
 #define DATE_TO_VERSION(Y,M,D) \
         ((unsigned(Y) - 2014) << 9 | unsigned(M) << 5 | unsigned(D))
@@ -150,7 +160,7 @@ HoneyVersion::read()
     version = static_cast<unsigned char>(buf[HONEY_VERSION_MAGIC_LEN]);
     version <<= 8;
     version |= static_cast<unsigned char>(buf[HONEY_VERSION_MAGIC_LEN + 1]);
-    if (version != HONEY_FORMAT_VERSION) {
+    if (version < HONEY_FORMAT_VERSION_MIN || version > HONEY_FORMAT_VERSION) {
         string msg;
         if (!single_file()) {
             msg = db_dir;
@@ -161,6 +171,10 @@ HoneyVersion::read()
                    VERSION_TO_MONTH(version) * 100 +
                    VERSION_TO_DAY(version));
         msg += " but I only understand ";
+        msg += str(VERSION_TO_YEAR(HONEY_FORMAT_VERSION_MIN) * 10000 +
+                   VERSION_TO_MONTH(HONEY_FORMAT_VERSION_MIN) * 100 +
+                   VERSION_TO_DAY(HONEY_FORMAT_VERSION_MIN));
+        msg += " to ";
         msg += str(VERSION_TO_YEAR(HONEY_FORMAT_VERSION) * 10000 +
                    VERSION_TO_MONTH(HONEY_FORMAT_VERSION) * 100 +
                    VERSION_TO_DAY(HONEY_FORMAT_VERSION));
@@ -180,6 +194,17 @@ HoneyVersion::read()
         if (!root[table_no].unserialise(&p, end)) {
             throw Xapian::DatabaseCorruptError("Rev file root_info missing");
         }
+        unsigned format_flags = root[table_no].get_format_flags();
+        if (format_flags & ~unsigned(Honey::FORMAT_BLOCK_POSTINGS |
+                                     Honey::FORMAT_BLOOM_FILTER |
+                                     Honey::FORMAT_BLOCK_POSITIONS |
+                                     Honey::FORMAT_VALUE_COLUMNS |
+                                     Honey::FORMAT_IMPACTS |
+                                     Honey::FORMAT_TAG_CODECS)) {
+            throw Xapian::DatabaseVersionError("Database uses an encoding "
+                                               "this version doesn't "
+                                               "support");
+        }
         old_root[table_no] = root[table_no];
     }
 
@@ -480,6 +505,18 @@ HoneyVersion::create()
     }
 }
 
+off_t
+HoneyVersion::get_table_end(Honey::table_type tbl) const
+{
+    off_t start = root[tbl].get_offset();
+    off_t end = -1;
+    for (unsigned table_no = 0; table_no < Honey::MAX_; ++table_no) {
+        off_t o = root[table_no].get_offset();
+        if (o > start && (end < 0 || o < end)) end = o;
+    }
+    return end;
+}
+
 namespace Honey {
 
 void
@@ -489,6 +526,8 @@ RootInfo::init(uint4 compress_min_)
     root = 0;
     num_entries = 0;
     compress_min = compress_min_;
+    format_flags = 0;
+    filter = 0;
     fl_serialised.resize(0);
 }
 
@@ -500,31 +539,39 @@ RootInfo::serialise(string& s) const
     AssertRel(root, >=, offset);
     pack_uint(s, uoffset);
     pack_uint(s, root - uoffset);
-    pack_uint(s, 0u);
+    pack_uint(s, format_flags);
     pack_uint(s, num_entries);
     pack_uint(s, 2048u >> 11);
     pack_uint(s, compress_min);
     pack_string(s, fl_serialised);
+    if (format_flags & FORMAT_BLOOM_FILTER) {
+        AssertRel(filter, >=, root);
+        pack_uint(s, std::make_unsigned_t<off_t>(filter - root));
+    }
 }
 
 bool
 RootInfo::unserialise(const char** p, const char* end)
 {
     std::make_unsigned_t<off_t> uoffset, uroot;
-    unsigned dummy_val;
     unsigned dummy_blocksize;
     if (!unpack_uint(p, end, &uoffset) ||
         !unpack_uint(p, end, &uroot) ||
-        !unpack_uint(p, end, &dummy_val) ||
+        !unpack_uint(p, end, &format_flags) ||
         !unpack_uint(p, end, &num_entries) ||
         !unpack_uint(p, end, &dummy_blocksize) ||
         !unpack_uint(p, end, &compress_min) ||
         !unpack_string(p, end, fl_serialised)) return false;
     offset = uoffset;
     root = uoffset + uroot;
+    filter = 0;
+    if (format_flags & FORMAT_BLOOM_FILTER) {
+        std::make_unsigned_t<off_t> ufilter;
+        if (!unpack_uint(p, end, &ufilter)) return false;
+        filter = root + ufilter;
+    }
     // Not meaningful, but still there so that existing honey databases
     // continue to work.
-    (void)dummy_val;
     (void)dummy_blocksize;
     // Map old default to new default.
     if (compress_min == 4) {
@@ -1,7 +1,7 @@
 /** @file
  * @brief HoneyVersion class
  */
-/* Copyright (C) 2006-2024 Olly Betts
+/* Copyright (C) 2006-2026 Olly Betts
  * Copyright (C) 2011 Dan Colish
  *
  * This program is free software; you can redistribute it and/or modify
@@ -43,6 +43,10 @@ class RootInfo {
     honey_tablesize_t num_entries;
     /// Should be >= 4 or 0 for no compression.
     uint4 compress_min;
+    /// Honey::FORMAT_* flags.
+    unsigned format_flags;
+    /// Offset of the Bloom filter (if FORMAT_BLOOM_FILTER is set).
+    off_t filter;
     std::string fl_serialised;
 
   public:
@@ -56,12 +60,16 @@ class RootInfo {
     off_t get_root() const { return root; }
     honey_tablesize_t get_num_entries() const { return num_entries; }
     uint4 get_compress_min() const { return compress_min; }
+    unsigned get_format_flags() const { return format_flags; }
+    off_t get_filter() const { return filter; }
     const std::string& get_free_list() const { return fl_serialised; }
 
     void set_num_entries(honey_tablesize_t n) { num_entries = n; }
     void set_offset(off_t offset_) { offset = offset_; }
     void set_root(off_t root_) { root = root_; }
     void set_free_list(const std::string& s) { fl_serialised = s; }
+    void set_format_flags(unsigned f) { format_flags = f; }
+    void set_filter(off_t filter_) { filter = filter_; }
 };
 
 }
@@ -181,6 +189,14 @@ class HoneyVersion {
         return &root[tbl];
     }
 
+    /** Return the file offset of the end of table @a tbl's data.
+     *
+     *  In a single-file database the tables follow one another, so this is
+     *  where the next table starts, or -1 for the last table (which extends
+     *  to the end of the file).
+     */
+    off_t get_table_end(Honey::table_type tbl) const;
+
     /// Return pointer to 16 byte UUID.
     const char* get_uuid() const {
         return uuid.data();
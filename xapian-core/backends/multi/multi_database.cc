@@ -33,6 +33,7 @@
 
 #include <memory>
 #include <string_view>
+#include <vector>
 
 using namespace std;
 
@@ -419,6 +420,14 @@ MultiDatabase::keep_alive()
     }
 }
 
+void
+MultiDatabase::cache_doclengths()
+{
+    for (auto&& shard : shards) {
+        shard->cache_doclengths();
+    }
+}
+
 TermList*
 MultiDatabase::open_spelling_termlist(string_view word) const
 {
@@ -561,7 +570,7 @@ MultiDatabase::locked() const
 }
 
 void
-MultiDatabase::write_changesets_to_fd(int,
+MultiDatabase::write_changesets_to_fd(RemoteConnection&,
                                       std::string_view,
                                       bool,
                                       Xapian::ReplicationInfo*)
@@ -710,6 +719,24 @@ MultiDatabase::request_document(Xapian::docid did) const
     shard->request_document(shard_did);
 }
 
+void
+MultiDatabase::request_documents(const vector<Xapian::docid>& dids) const
+{
+    // Split the docids up by shard so each shard gets a single batch.
+    auto n_shards = shards.size();
+    vector<vector<Xapian::docid>> shard_dids(n_shards);
+    for (auto did : dids) {
+        Assert(did != 0);
+        shard_dids[shard_number(did, n_shards)].push_back(
+            shard_docid(did, n_shards));
+    }
+    for (size_t i = 0; i != n_shards; ++i) {
+        if (!shard_dids[i].empty()) {
+            shards[i]->request_documents(shard_dids[i]);
+        }
+    }
+}
+
 void
 MultiDatabase::add_spelling(string_view word,
                             Xapian::termcount freqinc) const
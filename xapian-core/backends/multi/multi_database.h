@@ -1,7 +1,7 @@
 /** @file
  *  @brief Sharded database backend
  */
-/* Copyright 2017,2019,2024 Olly Betts
+/* Copyright 2017,2019,2024,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -26,6 +26,7 @@
 #include "backends/valuelist.h"
 
 #include <string_view>
+#include <vector>
 
 class LeafPostList;
 class Matcher;
@@ -124,6 +125,8 @@ class MultiDatabase : public Xapian::Database::Internal {
 
     void keep_alive();
 
+    void cache_doclengths();
+
     TermList* open_spelling_termlist(std::string_view word) const;
 
     TermList* open_spelling_wordlist() const;
@@ -142,7 +145,7 @@ class MultiDatabase : public Xapian::Database::Internal {
 
     bool locked() const;
 
-    void write_changesets_to_fd(int fd,
+    void write_changesets_to_fd(RemoteConnection& conn,
                                 std::string_view start_revision,
                                 bool need_whole_db,
                                 Xapian::ReplicationInfo* info);
@@ -174,6 +177,8 @@ class MultiDatabase : public Xapian::Database::Internal {
 
     void request_document(Xapian::docid did) const;
 
+    void request_documents(const std::vector<Xapian::docid>& dids) const;
+
     void add_spelling(std::string_view word, Xapian::termcount freqinc) const;
 
     Xapian::termcount remove_spelling(std::string_view word,
@@ -1,7 +1,7 @@
 /** @file
  *  @brief Remote backend database class
  */
-/* Copyright (C) 2006-2024 Olly Betts
+/* Copyright (C) 2006-2026 Olly Betts
  * Copyright (C) 2007,2009,2010 Lemur Consulting Ltd
  *
  * This program is free software; you can redistribute it and/or
@@ -57,14 +57,23 @@
 using namespace std;
 using Xapian::Internal::intrusive_ptr;
 
+/** Maximum number of documents request_documents() will have outstanding.
+ *
+ *  Each request is only a few bytes, so this many will comfortably fit in
+ *  the buffers of a pipe or socket.
+ */
+static constexpr size_t MAX_REQUESTED_DOCS = 1000;
+
 /// Return true if further replies should be expected.
 static inline bool
 is_intermediate_reply(int reply_code)
 {
     return reply_code == REPLY_DOCDATA ||
+           reply_code == REPLY_DOCUMENT ||
            reply_code == REPLY_VALUE ||
            reply_code == REPLY_TERMLISTHEADER ||
-           reply_code == REPLY_POSTLISTHEADER;
+           reply_code == REPLY_POSTLISTHEADER ||
+           reply_code == REPLY_PARTIALRESULTS;
 }
 
 [[noreturn]]
@@ -89,6 +98,33 @@ throw_connection_closed_unexpectedly()
     throw Xapian::NetworkError("Connection closed unexpectedly");
 }
 
+/** Read a reply from the server.
+ *
+ *  @param conn             The connection to read from.
+ *  @param[out] reply_id    The id of the request this is a reply to.
+ *  @param[out] result      The reply (without the request id).
+ *  @param end_time         Time to give up (or 0.0 to wait indefinitely).
+ *
+ *  @return The reply type, or -1 for EOF.
+ */
+static int
+read_message(RemoteConnection& conn,
+             unsigned& reply_id,
+             string& result,
+             double end_time)
+{
+    int type = conn.get_message(result, end_time);
+    if (type < 0)
+        return type;
+
+    const char* p = result.data();
+    if (!unpack_uint(&p, p + result.size(), &reply_id)) {
+        throw Xapian::NetworkError("Bad reply id", conn.get_context());
+    }
+    result.erase(0, p - result.data());
+    return type;
+}
+
 RemoteDatabase::RemoteDatabase(pair<int, string> fd_and_context,
                                double timeout_,
                                bool writable,
@@ -115,6 +151,39 @@ RemoteDatabase::RemoteDatabase(pair<int, string> fd_and_context,
     }
 }
 
+RemoteDatabase::RemoteDatabase(IdleRemoteConnection&& idle, double timeout_)
+    : Xapian::Database::Internal(TRANSACTION_READONLY),
+      link(-1, -1),
+      cached_stats_valid(),
+      mru_valstats(),
+      mru_slot(Xapian::BAD_VALUENO),
+      timeout(timeout_)
+{
+    link.swap(*idle.link);
+    // Carry on from the request ids the connection was using so we can't
+    // mistake a reply to a request by its previous user for a reply to ours.
+    next_request_id = idle.next_request_id;
+
+    // The database may have been updated since the connection was last used.
+    if (!update_stats(MSG_REOPEN)) {
+        // It hasn't, so the stats we last received are still current.
+        (void)read_update(idle.last_update);
+    }
+}
+
+bool
+RemoteDatabase::release_connection(IdleRemoteConnection& idle)
+{
+    if (!is_read_only() || link.get_read_fd() < 0 || last_update.empty())
+        return false;
+    idle.link.reset(new OwnedRemoteConnection(-1, -1));
+    idle.link->swap(link);
+    idle.next_request_id = next_request_id;
+    idle.last_update = last_update;
+    idle.idle_since = RealTime::now();
+    return true;
+}
+
 Xapian::termcount
 RemoteDatabase::positionlist_count(Xapian::docid did,
                                    std::string_view term) const
@@ -278,6 +347,8 @@ bool
 RemoteDatabase::reopen()
 {
     mru_slot = Xapian::BAD_VALUENO;
+    // Documents we've requested may be from the old revision.
+    discard_requested_documents();
     return update_stats(MSG_REOPEN);
 }
 
@@ -314,6 +385,19 @@ RemoteDatabase::open_document(Xapian::docid did, bool /*lazy*/) const
 {
     Assert(did);
 
+    auto it = requested_docs.find(did);
+    if (it != requested_docs.end()) {
+        read_requested_documents(it->second);
+    }
+    auto fetched = fetched_docs.find(did);
+    if (fetched != fetched_docs.end()) {
+        auto doc = new RemoteDocument(this, did,
+                                      std::move(fetched->second.first),
+                                      std::move(fetched->second.second));
+        fetched_docs.erase(fetched);
+        return doc;
+    }
+
     string message;
     pack_uint_last(message, did);
     send_message(MSG_DOCUMENT, message);
@@ -350,6 +434,26 @@ RemoteDatabase::update_stats(message_type msg_code, const string & body) const
         return false;
     }
 
+    unsigned compression = read_update(message);
+    if (msg_code == MSG_MAX && compression != 0) {
+        // The server is offering to compress messages with codec
+        // (compression - 1).  If we support that codec too, accept the offer.
+        // We don't need to wait for the reply.
+        unsigned c = compression - 1;
+        if (c < Compression::CODEC_MAX_ &&
+            Compression::codec_available(Compression::codec(c))) {
+            string message_out;
+            pack_uint_last(message_out, c);
+            send_message(MSG_COMPRESSION, message_out);
+            link.set_compression(Compression::codec(c));
+        }
+    }
+    return true;
+}
+
+unsigned
+RemoteDatabase::read_update(string& message) const
+{
     if (message.size() < 3) {
         throw_handshake_failed(link.get_context());
     }
@@ -381,12 +485,14 @@ RemoteDatabase::update_stats(message_type msg_code, const string & body) const
         throw Xapian::NetworkError(errmsg, link.get_context());
     }
 
+    unsigned compression;
     if (!unpack_uint(&p, p_end, &doccount) ||
         !unpack_uint(&p, p_end, &lastdocid) ||
         !unpack_uint(&p, p_end, &doclen_lbound) ||
         !unpack_uint(&p, p_end, &doclen_ubound) ||
         !unpack_bool(&p, p_end, &has_positional_info) ||
-        !unpack_uint(&p, p_end, &total_length)) {
+        !unpack_uint(&p, p_end, &total_length) ||
+        !unpack_uint(&p, p_end, &compression)) {
         throw Xapian::NetworkError("Bad stats update message received",
                                    link.get_context());
     }
@@ -394,7 +500,8 @@ RemoteDatabase::update_stats(message_type msg_code, const string & body) const
     doclen_ubound += doclen_lbound;
     uuid.assign(p, p_end);
     cached_stats_valid = true;
-    return true;
+    last_update = std::move(message);
+    return compression;
 }
 
 Xapian::doccount
@@ -590,15 +697,67 @@ RemoteDatabase::get_wdfdocmax(Xapian::docid did) const
     return wdfdocmax;
 }
 
+int
+RemoteDatabase::read_reply(unsigned id, string& result) const
+{
+    auto deferred = deferred_replies.find(id);
+    if (deferred != deferred_replies.end() && !deferred->second.empty()) {
+        // We've already read this reply.
+        int type = deferred->second.front().first;
+        result = std::move(deferred->second.front().second);
+        deferred->second.pop_front();
+        if (!is_intermediate_reply(type)) {
+            deferred_replies.erase(deferred);
+        }
+        return type;
+    }
+
+    double end_time = RealTime::end_time(timeout);
+    while (true) {
+        unsigned reply_id;
+        int type = read_message(link, reply_id, result, end_time);
+        if (type < 0)
+            return type;
+
+        // Request id 0 is used for replies which aren't to a particular
+        // request, such as reporting a timeout.
+        if (reply_id == id || reply_id == 0) {
+            if (deferred != deferred_replies.end() &&
+                !is_intermediate_reply(type)) {
+                deferred_replies.erase(deferred);
+            }
+            return type;
+        }
+
+        store_reply(reply_id, type, result);
+    }
+}
+
+void
+RemoteDatabase::store_reply(unsigned reply_id, int type, string& message) const
+{
+    auto i = deferred_replies.find(reply_id);
+    if (i != deferred_replies.end()) {
+        // A reply to a request we want to read the reply to later.
+        i->second.emplace_back(type, std::move(message));
+    }
+    // Otherwise this is a reply which our caller didn't read, probably
+    // because an exception occurred, so just discard it.
+}
+
 reply_type
-RemoteDatabase::get_message(string &result,
+RemoteDatabase::get_message(unsigned id,
+                            string &result,
                             reply_type required_type,
                             reply_type required_type2) const
 {
-    double end_time = RealTime::end_time(timeout);
-    int type = link.get_message(result, end_time);
-    if (pending_reply && !is_intermediate_reply(type)) {
-        pending_reply = false;
+    int type;
+    if (id == 0) {
+        // The greeting isn't a reply to a request so has no request id.
+        double end_time = RealTime::end_time(timeout);
+        type = link.get_message(result, end_time);
+    } else {
+        type = read_reply(id, result);
     }
     if (type < 0)
         throw_connection_closed_unexpectedly();
@@ -627,21 +786,74 @@ RemoteDatabase::get_message(string &result,
     return static_cast<reply_type>(type);
 }
 
-void
+unsigned
 RemoteDatabase::send_message(message_type type, string_view message) const
+{
+    // Request id 0 is reserved for replies which aren't to a request.
+    if (rare(next_request_id == 0)) ++next_request_id;
+    request_id = next_request_id++;
+    send_request(link, request_id, type, message);
+    return request_id;
+}
+
+void
+RemoteDatabase::send_request(RemoteConnection& conn,
+                             unsigned id,
+                             message_type type,
+                             string_view message) const
 {
     double end_time = RealTime::end_time(timeout);
-    while (pending_reply) {
-        string dummy;
-        int reply_code = link.get_message(dummy, end_time);
-        if (reply_code < 0)
-            throw_connection_closed_unexpectedly();
-        if (!is_intermediate_reply(reply_code)) {
-            pending_reply = false;
+    string prefix;
+    pack_uint(prefix, id);
+    conn.send_message(static_cast<unsigned char>(type), prefix, message,
+                      end_time);
+}
+
+void
+RemoteDatabase::read_requested_documents(unsigned id) const
+{
+    // Remove the entries first so we don't wait for this reply again if
+    // reading it fails.
+    for (auto i = requested_docs.begin(); i != requested_docs.end(); ) {
+        if (i->second == id) {
+            i = requested_docs.erase(i);
+        } else {
+            ++i;
         }
     }
-    link.send_message(static_cast<unsigned char>(type), message, end_time);
-    pending_reply = true;
+
+    string message;
+    while (get_message_or_done(id, message, REPLY_DOCUMENT)) {
+        const char* p = message.data();
+        const char* p_end = p + message.size();
+        Xapian::docid did;
+        string doc_data;
+        if (!unpack_uint(&p, p_end, &did) ||
+            !unpack_string(&p, p_end, doc_data)) {
+            unpack_throw_serialisation_error(p);
+        }
+        map<Xapian::valueno, string> values;
+        while (p != p_end) {
+            Xapian::valueno slot;
+            string value;
+            if (!unpack_uint(&p, p_end, &slot) ||
+                !unpack_string(&p, p_end, value)) {
+                unpack_throw_serialisation_error(p);
+            }
+            values.emplace(slot, std::move(value));
+        }
+        fetched_docs[did] = make_pair(std::move(doc_data), std::move(values));
+    }
+}
+
+void
+RemoteDatabase::discard_requested_documents() const
+{
+    for (auto&& i : requested_docs) {
+        deferred_replies.erase(i.second);
+    }
+    requested_docs.clear();
+    fetched_docs.clear();
 }
 
 void
@@ -719,14 +931,179 @@ RemoteDatabase::set_query(const Xapian::Query& query,
         pack_string(message, i->serialise());
     }
 
-    send_message(MSG_QUERY, message);
+    // Discard any unread replies to a previous query, and any documents
+    // requested for it which weren't opened.  Otherwise those documents would
+    // count towards MAX_REQUESTED_DOCS indefinitely.
+    deferred_replies.erase(query_id);
+    deferred_replies.erase(getmset_id);
+    discard_requested_documents();
+    // Other shards may need to be sent the query before we read the reply.
+    query_id = send_deferred_message(MSG_QUERY, message);
+    if (replicas) {
+        // Keep the query in case we want to send it to another replica.
+        query_message = std::move(message);
+        query_time = RealTime::now();
+    }
+}
+
+unique_ptr<OwnedRemoteConnection>
+RemoteDatabase::open_hedge() const
+{
+    unique_ptr<OwnedRemoteConnection> hedge_link;
+    try {
+        auto fd_and_context = replicas->open_hedge_socket();
+        hedge_link.reset(new OwnedRemoteConnection(fd_and_context.first,
+                                                   fd_and_context.first,
+                                                   fd_and_context.second));
+        // We send the query without waiting for the greeting, which we check
+        // when it arrives.  We don't accept any offer to compress messages on
+        // this connection, as the reply would then arrive before the reply to
+        // the query.
+        send_request(*hedge_link, query_id, MSG_QUERY, query_message);
+    } catch (const Xapian::NetworkError&) {
+        // Carry on waiting for the replica we're using.
+        return nullptr;
+    }
+    return hedge_link;
+}
+
+void
+RemoteDatabase::wait_for_query_reply() const
+{
+    auto deferred = deferred_replies.find(query_id);
+    if (deferred == deferred_replies.end() || !deferred->second.empty()) {
+        // We've already read the reply.
+        return;
+    }
+
+    double end_time = RealTime::end_time(timeout);
+    double delay = replicas->hedge_delay();
+    double hedge_time = delay < 0.0 ? 0.0 : query_time + delay;
+    if (end_time != 0.0 && hedge_time >= end_time) hedge_time = 0.0;
+    unique_ptr<OwnedRemoteConnection> hedge_link;
+    bool hedge_greeted = false;
+    double hedge_sent = 0.0;
+
+    // If the replica we're using has gone away, switch to the other replica
+    // (sending it the query now if we haven't already).  Returns false if
+    // there isn't another replica we can use.
+    auto fail_over = [&]() {
+        if (!hedge_link && hedge_sent == 0.0) {
+            hedge_time = 0.0;
+            hedge_link = open_hedge();
+            hedge_sent = RealTime::now();
+        }
+        if (!hedge_link) return false;
+        if (!hedge_greeted) {
+            string greeting;
+            try {
+                int type = hedge_link->get_message(greeting, end_time);
+                if (type != REPLY_UPDATE || greeting != last_update)
+                    return false;
+            } catch (const Xapian::NetworkError&) {
+                return false;
+            }
+        }
+        link.swap(*hedge_link);
+        replicas->use_hedge();
+        discard_requested_documents();
+        query_time = hedge_sent;
+        hedge_link.reset();
+        return true;
+    };
+
+    while (true) {
+        int ready = RemoteConnection::wait_for_input(link,
+                                                     hedge_link.get(),
+                                                     hedge_time ?
+                                                     hedge_time : end_time);
+        if (ready < 0) {
+            if (hedge_time == 0.0) {
+                // Leave get_message() to report the timeout.
+                return;
+            }
+            // The reply is late so send the query to another replica too.
+            hedge_time = 0.0;
+            hedge_link = open_hedge();
+            hedge_sent = RealTime::now();
+            continue;
+        }
+
+        string message;
+        unsigned reply_id = 0;
+        int type;
+        if (ready == 0) {
+            try {
+                type = read_message(link, reply_id, message, end_time);
+            } catch (const Xapian::NetworkTimeoutError&) {
+                throw;
+            } catch (const Xapian::NetworkError&) {
+                if (!fail_over()) throw;
+                continue;
+            }
+            if (type < 0 && fail_over()) continue;
+        } else {
+            // A problem with the other replica shouldn't cause the query to
+            // fail, so we just stop using it.
+            try {
+                if (!hedge_greeted) {
+                    // The server sends a greeting when we connect, which will
+                    // only match the most recent one from the replica we're
+                    // using if the database is at the same revision with the
+                    // same stats.
+                    type = hedge_link->get_message(message, end_time);
+                    if (type != REPLY_UPDATE || message != last_update) {
+                        hedge_link.reset();
+                    }
+                    hedge_greeted = true;
+                    continue;
+                }
+                type = read_message(*hedge_link, reply_id, message, end_time);
+            } catch (const Xapian::NetworkError&) {
+                type = -1;
+            }
+            if (type < 0) {
+                hedge_link.reset();
+                continue;
+            }
+        }
+        if (reply_id != query_id && reply_id != 0) {
+            // Request id 0 is used for replies which aren't to a particular
+            // request, such as reporting a timeout, so we treat those as the
+            // reply, but this reply is to a different request.
+            store_reply(reply_id, type, message);
+            continue;
+        }
+
+        double now = RealTime::now();
+        if (ready) {
+            // The hedged request won.  We don't know how long the replica we
+            // were using would have taken, but it's at least this long.
+            replicas->record_latency(false, now - query_time);
+            replicas->record_latency(true, now - hedge_sent);
+            link.swap(*hedge_link);
+            replicas->use_hedge();
+            // Any documents we requested were from the other replica.
+            discard_requested_documents();
+        } else if (type >= 0) {
+            replicas->record_latency(false, now - query_time);
+            if (hedge_link) {
+                replicas->record_latency(true, now - hedge_sent);
+            }
+        }
+        // The losing connection (if any) is closed when hedge_link is
+        // destroyed, so that server won't be asked to run the match.
+        deferred_replies[query_id].emplace_back(type, std::move(message));
+        return;
+    }
 }
 
 void
 RemoteDatabase::accumulate_remote_stats(Xapian::Weight::Internal& total) const
 {
+    if (replicas) wait_for_query_reply();
     string message;
-    get_message(message, REPLY_STATS);
+    get_message(query_id, message, REPLY_STATS, REPLY_STATS);
     const char* p = message.data();
     Xapian::Weight::Internal remote_stats;
     unserialise_stats(p, p + message.size(), remote_stats);
@@ -738,12 +1115,17 @@ RemoteDatabase::send_global_stats(Xapian::doccount first,
                                   Xapian::doccount maxitems,
                                   Xapian::doccount check_at_least,
                                   const Xapian::KeyMaker* sorter,
-                                  const Xapian::Weight::Internal &stats) const
+                                  const Xapian::Weight::Internal &stats,
+                                  bool stream) const
 {
     string message;
+    // The server keeps the state for the query from MSG_QUERY, so tell it
+    // which query this is for.
+    pack_uint(message, query_id);
     pack_uint(message, first);
     pack_uint(message, maxitems);
     pack_uint(message, check_at_least);
+    pack_bool(message, stream);
     if (!sorter) {
         pack_string_empty(message);
     } else {
@@ -755,14 +1137,14 @@ RemoteDatabase::send_global_stats(Xapian::doccount first,
         pack_string(message, sorter->serialise());
     }
     message += serialise_stats(stats);
-    send_message(MSG_GETMSET, message);
+    getmset_id = send_deferred_message(MSG_GETMSET, message);
 }
 
 Xapian::MSet
 RemoteDatabase::get_mset(const vector<opt_ptr_spy>& matchspies) const
 {
     string message;
-    get_message(message, REPLY_RESULTS);
+    get_message(getmset_id, message, REPLY_RESULTS, REPLY_RESULTS);
     const char * p = message.data();
     const char * p_end = p + message.size();
 
@@ -778,6 +1160,39 @@ RemoteDatabase::get_mset(const vector<opt_ptr_spy>& matchspies) const
     return mset;
 }
 
+bool
+RemoteDatabase::get_streamed_mset(Xapian::MSet& mset, double& bound) const
+{
+    string message;
+    reply_type type = get_message(getmset_id, message,
+                                  REPLY_RESULTS, REPLY_PARTIALRESULTS);
+    const char* p = message.data();
+    const char* p_end = p + message.size();
+    if (type == REPLY_PARTIALRESULTS) {
+        bound = unserialise_double(&p, p_end);
+    }
+    mset.internal->unserialise(p, p_end);
+    return type == REPLY_RESULTS;
+}
+
+bool
+RemoteDatabase::mset_reply_pending() const
+{
+    while (true) {
+        auto i = deferred_replies.find(getmset_id);
+        if (i != deferred_replies.end() && !i->second.empty()) return true;
+        if (!link.message_pending()) return false;
+        // We have a whole message, so this won't wait.
+        string message;
+        unsigned reply_id;
+        int type = read_message(link, reply_id, message, 0.0);
+        // Request id 0 is used for replies which aren't to a particular
+        // request, such as reporting a timeout.
+        if (reply_id == 0) reply_id = getmset_id;
+        store_reply(reply_id, type, message);
+    }
+}
+
 void
 RemoteDatabase::commit()
 {
@@ -927,11 +1342,51 @@ RemoteDatabase::set_metadata(string_view key, string_view value)
 void
 RemoteDatabase::request_document(Xapian::docid did) const
 {
+    if (!is_read_only()) {
+        // The document could be modified before it is opened, so just ask
+        // the server to prefetch it.
+        string message;
+        pack_uint_last(message, did);
+        send_message(MSG_REQUESTDOCUMENT, message);
+
+        get_message(message, REPLY_DONE);
+        return;
+    }
+
+    request_documents(vector<Xapian::docid>(1, did));
+}
+
+void
+RemoteDatabase::request_documents(const vector<Xapian::docid>& dids) const
+{
+    if (!is_read_only()) {
+        Xapian::Database::Internal::request_documents(dids);
+        return;
+    }
+
+    // Send MSG_DOCUMENTS now without waiting for the reply, which
+    // open_document() will read.  We limit how many documents we have
+    // outstanding as the replies have to be buffered, and so the requests
+    // don't fill the socket buffers while the server is blocked sending
+    // replies we aren't reading yet.
     string message;
-    pack_uint(message, did);
-    send_message(MSG_REQUESTDOCUMENT, message);
+    // No flags are currently defined.
+    pack_uint(message, 0u);
+    size_t n = requested_docs.size() + fetched_docs.size();
+    vector<Xapian::docid> batch;
+    for (auto did : dids) {
+        if (n >= MAX_REQUESTED_DOCS) break;
+        if (requested_docs.count(did) || fetched_docs.count(did)) continue;
+        pack_uint(message, did);
+        batch.push_back(did);
+        ++n;
+    }
+    if (batch.empty()) return;
 
-    get_message(message, REPLY_DONE);
+    unsigned id = send_deferred_message(MSG_DOCUMENTS, message);
+    for (auto did : batch) {
+        requested_docs.emplace(did, id);
+    }
 }
 
 void
@@ -1,7 +1,7 @@
 /** @file
  *  @brief RemoteDatabase is the baseclass for remote database implementations.
  */
-/* Copyright (C) 2006-2024 Olly Betts
+/* Copyright (C) 2006-2026 Olly Betts
  * Copyright (C) 2007,2009,2010 Lemur Consulting Ltd
  *
  * This program is free software; you can redistribute it and/or
@@ -27,9 +27,14 @@
 #include "api/enquireinternal.h"
 #include "api/queryinternal.h"
 #include "net/remoteconnection.h"
+#include "net/remotereplicas.h"
 #include "backends/valuestats.h"
 #include "xapian/weight.h"
 
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
 #include <utility>
 
 namespace Xapian {
@@ -38,6 +43,24 @@ namespace Xapian {
 
 class NetworkPostList;
 
+/** A connection to a server which a RemoteDatabase has finished with.
+ *
+ *  Used to pass a connection to another RemoteDatabase to reuse.
+ */
+struct IdleRemoteConnection {
+    /// The connection.
+    std::unique_ptr<OwnedRemoteConnection> link;
+
+    /// The id to use for the next request sent over link.
+    unsigned next_request_id = 1;
+
+    /// The most recent REPLY_UPDATE message received over link.
+    std::string last_update;
+
+    /// The time the connection became idle.
+    double idle_since = 0.0;
+};
+
 /** RemoteDatabase is the baseclass for remote database implementations.
  *
  *  A subclass of this class is required which opens a TCP connection or
@@ -72,15 +95,69 @@ class RemoteDatabase : public Xapian::Database::Internal {
     /// Has positional information?
     mutable bool has_positional_info;
 
-    /** Are we currently expecting a reply?
+    /// The id to use for the next request we send.
+    mutable unsigned next_request_id = 1;
+
+    /** The id of the request we most recently sent.
+     *
+     *  Each message we send starts with a request id, and the server starts
+     *  each reply with the id of the request it is replying to.  Initially
+     *  this is 0, which signifies the greeting sent by the server when we
+     *  connect.
+     */
+    mutable unsigned request_id = 0;
+
+    /** Replies to requests which we'll read later.
+     *
+     *  A request whose replies we don't want to read straight away gets an
+     *  entry here, and any replies to it which we read while waiting for the
+     *  reply to a different request are stored in that entry.
      *
      *  Our caller might send a message but then an exception (from another
      *  shard or locally) might cause it not to try to read the reply before
-     *  sending another message.  This flag allows us to detect that situation
-     *  and discard the unwanted reply rather than trying to read it as the
-     *  response to the new message.
+     *  sending another message.  Replies to requests without an entry here
+     *  are discarded, which handles this situation.
+     */
+    mutable std::map<unsigned,
+                     std::deque<std::pair<int, std::string>>> deferred_replies;
+
+    /** Documents requested by request_documents().
+     *
+     *  Maps docid to the id of the MSG_DOCUMENTS request, which has an entry
+     *  in deferred_replies.
+     */
+    mutable std::map<Xapian::docid, unsigned> requested_docs;
+
+    /** Documents read from the reply to MSG_DOCUMENTS but not yet opened.
+     *
+     *  Maps docid to the document data and values.
+     */
+    mutable std::map<Xapian::docid,
+                     std::pair<std::string,
+                               std::map<Xapian::valueno, std::string>>>
+        fetched_docs;
+
+    /// The id of the MSG_QUERY request sent by set_query().
+    mutable unsigned query_id = 0;
+
+    /// The id of the MSG_GETMSET request sent by send_global_stats().
+    mutable unsigned getmset_id = 0;
+
+    /** The MSG_QUERY request sent by set_query().
+     *
+     *  Only kept if we might send a hedged request to another replica.
+     */
+    mutable std::string query_message;
+
+    /// The time set_query() sent MSG_QUERY (only set if query_message is).
+    mutable double query_time = 0.0;
+
+    /** The most recent REPLY_UPDATE message received.
+     *
+     *  Another replica is only used for a hedged request if its greeting
+     *  matches this.
      */
-    mutable bool pending_reply = false;
+    mutable std::string last_update;
 
     /// The UUID of the remote database.
     mutable std::string uuid;
@@ -107,6 +184,45 @@ class RemoteDatabase : public Xapian::Database::Internal {
     bool update_stats(message_type msg_code = MSG_UPDATE,
                       const std::string & body = std::string()) const;
 
+    /** Read the stats from a REPLY_UPDATE message.
+     *
+     *  @param message  The message, which is moved to last_update.
+     *
+     *  @return The compression the server is offering (0 for none, otherwise
+     *          the codec + 1).
+     */
+    unsigned read_update(std::string& message) const;
+
+    /** Store a reply to read later, if we want it.
+     *
+     *  @param reply_id  The request id the reply is to.
+     *  @param type      The reply type.
+     *  @param message   The reply (without the request id).
+     */
+    void store_reply(unsigned reply_id, int type, std::string& message) const;
+
+    /** Open a connection to another replica and send it the query.
+     *
+     *  @return The connection, or NULL if we couldn't connect to another
+     *          replica.  The greeting from the server will be the first
+     *          message to read from it.
+     */
+    std::unique_ptr<OwnedRemoteConnection> open_hedge() const;
+
+    /** Wait for the reply to MSG_QUERY.
+     *
+     *  If the reply is slow compared to recent queries, the query is also sent
+     *  to another replica, and we switch to using whichever replica replies
+     *  first.  If the connection to the replica we're using fails, we switch
+     *  to another replica straight away.  The reply is left in
+     *  deferred_replies for reading.
+     *
+     *  Only the wait for this reply can trigger a hedged request.  Once
+     *  we've picked a replica, the rest of the query (including MSG_GETMSET)
+     *  is only sent to that replica, subject to the usual timeout.
+     */
+    void wait_for_query_reply() const;
+
   protected:
     /** Constructor.  The constructor is protected so that raw instances
      *  can't be created - a derived class must be instantiated which
@@ -131,23 +247,116 @@ class RemoteDatabase : public Xapian::Database::Internal {
                    bool writable,
                    int flags);
 
-    /// Receive a message from the server.
-    reply_type get_message(std::string& message,
+    /** Constructor which reuses a connection.
+     *
+     *  The connection is only reused for read-only access.
+     *
+     *  @param idle     The connection to reuse.
+     *  @param timeout_ The timeout used with the network operations.
+     *                  Generally a Xapian::NetworkTimeoutError exception will
+     *                  be thrown if the remote end doesn't respond for this
+     *                  length of time (in seconds).  A timeout of 0 means that
+     *                  operations will never timeout.
+     */
+    RemoteDatabase(IdleRemoteConnection&& idle, double timeout_);
+
+    /** Give up the connection so it can be reused.
+     *
+     *  The database is then closed.
+     *
+     *  @param[out] idle    Set to the connection.
+     *
+     *  @return true if the connection was given up, or false if it can't be
+     *          reused (because this is a WritableDatabase or the connection
+     *          has been closed).
+     */
+    bool release_connection(IdleRemoteConnection& idle);
+
+    /** Replicas of the database we can use (NULL if there aren't any).
+     *
+     *  Set by a subclass which supports replica groups.  Only supported for
+     *  read-only access.
+     */
+    std::unique_ptr<RemoteReplicas> replicas;
+
+    /** Read the next reply to a request.
+     *
+     *  @param id       The id of the request.
+     *  @param message  Set to the reply (without the request id).
+     *
+     *  @return The reply type, or -1 for EOF.
+     */
+    int read_reply(unsigned id, std::string& message) const;
+
+    /// Receive a reply to request @a id from the server.
+    reply_type get_message(unsigned id,
+                           std::string& message,
                            reply_type required_type,
                            reply_type required_type2) const;
 
+    /// Receive a reply to the request we most recently sent.
+    reply_type get_message(std::string& message,
+                           reply_type required_type,
+                           reply_type required_type2) const {
+        return get_message(request_id, message,
+                           required_type, required_type2);
+    }
+
     void get_message(std::string& message,
                      reply_type required_type) const {
         (void)get_message(message, required_type, required_type);
     }
 
+    bool get_message_or_done(unsigned id,
+                             std::string& message,
+                             reply_type required_type) const {
+        return get_message(id, message,
+                           required_type, REPLY_DONE) != REPLY_DONE;
+    }
+
     bool get_message_or_done(std::string& message,
                              reply_type required_type) const {
-        return get_message(message, required_type, REPLY_DONE) != REPLY_DONE;
+        return get_message_or_done(request_id, message, required_type);
     }
 
-    /// Send a message to the server.
-    void send_message(message_type type, std::string_view data) const;
+    /** Send a message to the server.
+     *
+     *  @return The request id for the message.
+     */
+    unsigned send_message(message_type type, std::string_view data) const;
+
+    /** Send a message with request id @a id over connection @a conn.
+     *
+     *  @param conn     The connection to send it over.
+     *  @param id       The request id.
+     *  @param type     The message type.
+     *  @param data     The message data.
+     */
+    void send_request(RemoteConnection& conn,
+                      unsigned id,
+                      message_type type,
+                      std::string_view data) const;
+
+    /** Send a message to the server, deferring reading the replies.
+     *
+     *  @return The request id for the message, which should be passed to
+     *          get_message() to read the replies.
+     */
+    unsigned send_deferred_message(message_type type,
+                                   std::string_view data) const {
+        unsigned id = send_message(type, data);
+        deferred_replies[id];
+        return id;
+    }
+
+    /** Read the reply to a MSG_DOCUMENTS request into fetched_docs.
+     *
+     *  @param id  The id of the request.
+     */
+    void read_requested_documents(unsigned id) const;
+
+    /// Discard any documents requested by request_documents().
+    void discard_requested_documents() const;
 
     /// Close the socket
     void do_close();
@@ -216,16 +425,63 @@ class RemoteDatabase : public Xapian::Database::Internal {
     /// Accumulate stats from the remote server.
     void accumulate_remote_stats(Xapian::Weight::Internal& total) const;
 
-    /// Send the global stats to the remote server.
+    /** Send the global stats to the remote server.
+     *
+     *  @param stream   Ask the server to send the best results so far while
+     *                  the match runs (read them with get_streamed_mset()).
+     */
     void send_global_stats(Xapian::doccount first,
                            Xapian::doccount maxitems,
                            Xapian::doccount check_at_least,
                            const Xapian::KeyMaker* sorter,
-                           const Xapian::Weight::Internal &stats) const;
+                           const Xapian::Weight::Internal &stats,
+                           bool stream) const;
 
     /// Get the MSet from the remote server.
     Xapian::MSet get_mset(const std::vector<opt_ptr_spy>& matchspies) const;
 
+    /** Get the next results streamed from the remote server.
+     *
+     *  Only for use if send_global_stats() was called with stream=true and
+     *  without any matchspies.
+     *
+     *  @param[out] mset    The final MSet, or the best results so far.
+     *  @param[out] bound   If the results aren't final, set to an upper bound
+     *                      on the weight of any document the server hasn't yet
+     *                      considered.
+     *
+     *  @return true if @a mset is the final MSet.
+     */
+    bool get_streamed_mset(Xapian::MSet& mset, double& bound) const;
+
+    /** Can we read the next reply to MSG_GETMSET without waiting for input?
+     *
+     *  Any whole replies to other requests which we've already read from the
+     *  connection are dealt with first, so this only returns true if there's
+     *  a whole reply to MSG_GETMSET to read.
+     */
+    bool mset_reply_pending() const;
+
+    /** Read whatever input is available from the remote server.
+     *
+     *  Use mset_reply_pending() to check if this has completed a reply.
+     *
+     *  @param end_time     If this time is reached, then a timeout exception
+     *                      will be thrown.  If (end_time == 0.0) then the
+     *                      operation will never timeout.
+     *
+     *  @return false if the connection was closed, otherwise true.
+     */
+    bool read_mset_input(double end_time) const {
+        return link.read_more(end_time);
+    }
+
+    /** Stop waiting for the MSet from the remote server.
+     *
+     *  Any further replies to MSG_GETMSET will be discarded.
+     */
+    void discard_mset() const { deferred_replies.erase(getmset_id); }
+
     /// Get remote metadata key list.
     TermList* open_metadata_keylist(std::string_view prefix) const;
 
@@ -305,6 +561,8 @@ class RemoteDatabase : public Xapian::Database::Internal {
 
     void request_document(Xapian::docid did) const;
 
+    void request_documents(const std::vector<Xapian::docid>& dids) const;
+
     void add_spelling(std::string_view word, Xapian::termcount freqinc) const;
 
     TermList* open_synonym_termlist(std::string_view term) const;
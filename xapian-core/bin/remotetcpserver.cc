@@ -3,7 +3,7 @@
  */
 /* Copyright 1999,2000,2001 BrightStation PLC
  * Copyright 2002 Ananova Ltd
- * Copyright 2002,2003,2004,2005,2006,2007,2008,2010,2015 Olly Betts
+ * Copyright 2002,2003,2004,2005,2006,2007,2008,2010,2015,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -29,6 +29,7 @@
 #include "net/remoteserver.h"
 
 #include <iostream>
+#include <memory>
 
 using namespace std;
 
@@ -41,6 +42,11 @@ RemoteTcpServer::RemoteTcpServer(const vector<std::string> &dbpaths_,
       dbpaths(dbpaths_), writable(writable_),
       active_timeout(active_timeout_), idle_timeout(idle_timeout_)
 {
+    // Build the same context RemoteServer does.
+    for (auto& dbpath : dbpaths) {
+        if (!context.empty()) context += ' ';
+        context += dbpath;
+    }
 }
 
 void
@@ -48,8 +54,10 @@ RemoteTcpServer::handle_one_connection(int socket)
 {
     try {
         RemoteServer sserv(dbpaths, socket, socket,
-                           active_timeout, idle_timeout, writable);
+                           active_timeout, idle_timeout, writable,
+                           compression);
         sserv.set_registry(reg);
+        sserv.set_result_cache(result_cache.get());
         sserv.run();
     } catch (const Xapian::NetworkTimeoutError &e) {
         if (verbose)
@@ -60,3 +68,97 @@ RemoteTcpServer::handle_one_connection(int socket)
         // ignore other exceptions
     }
 }
+
+/// A connection being serviced by TcpServer::run_threaded().
+class RemoteTcpConnection : public TcpServer::Connection {
+    /// The server which created this connection.
+    RemoteTcpServer& server;
+
+    /// The RemoteServer handling the connection.
+    unique_ptr<RemoteServer> sserv;
+
+    /// The idle timeout (in seconds).
+    double idle_timeout;
+
+  public:
+    RemoteTcpConnection(RemoteTcpServer& server_,
+                        RemoteServer* sserv_,
+                        double idle_timeout_)
+        : server(server_), sserv(sserv_), idle_timeout(idle_timeout_) { }
+
+    ~RemoteTcpConnection() {
+        // If the client didn't ask for write access, the database handle can
+        // be reused by another connection.
+        const Xapian::Database* db = sserv->get_read_only_database();
+        if (db) server.release_database(*db);
+    }
+
+    bool handle_input() {
+        try {
+            return sserv->process_message();
+        } catch (const Xapian::NetworkTimeoutError &e) {
+            if (server.get_verbose()) {
+                cerr << "Connection timed out: " << e.get_description()
+                     << '\n';
+            }
+        } catch (const Xapian::Error &e) {
+            cerr << "Got exception " << e.get_description() << '\n';
+        } catch (...) {
+            // ignore other exceptions
+        }
+        return false;
+    }
+
+    bool input_pending() const {
+        return sserv->input_pending();
+    }
+
+    double get_idle_timeout() const {
+        return idle_timeout;
+    }
+
+    void idle_timeout_expired() {
+        try {
+            sserv->idle_timeout_expired();
+        } catch (const Xapian::NetworkTimeoutError &e) {
+            if (server.get_verbose()) {
+                cerr << "Connection timed out: " << e.get_description()
+                     << '\n';
+            }
+        } catch (const Xapian::Error &e) {
+            cerr << "Got exception " << e.get_description() << '\n';
+        } catch (...) {
+            // ignore other exceptions
+        }
+    }
+};
+
+TcpServer::Connection*
+RemoteTcpServer::open_connection(int socket)
+{
+    unique_ptr<RemoteServer> sserv;
+    while (!db_pool.empty()) {
+        Xapian::Database db = std::move(db_pool.back());
+        db_pool.pop_back();
+        try {
+            // Make sure a new connection sees the latest revision, as it
+            // would if it opened the database afresh.
+            db.reopen();
+        } catch (const Xapian::Error &) {
+            // Discard this handle and try the next.
+            continue;
+        }
+        sserv.reset(new RemoteServer(db, context, socket, socket,
+                                     active_timeout, idle_timeout, writable,
+                                     compression));
+        break;
+    }
+    if (!sserv) {
+        sserv.reset(new RemoteServer(dbpaths, socket, socket,
+                                     active_timeout, idle_timeout, writable,
+                                     compression));
+    }
+    sserv->set_registry(reg);
+    sserv->set_result_cache(result_cache.get());
+    return new RemoteTcpConnection(*this, sserv.release(), idle_timeout);
+}
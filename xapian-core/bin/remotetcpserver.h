@@ -1,7 +1,7 @@
 /** @file
  *  @brief TCP/IP socket based server for RemoteDatabase.
  */
-/* Copyright (C) 2007,2008,2010,2015 Olly Betts
+/* Copyright (C) 2007,2008,2010,2015,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -21,11 +21,14 @@
 #ifndef XAPIAN_INCLUDED_REMOTETCPSERVER_H
 #define XAPIAN_INCLUDED_REMOTETCPSERVER_H
 
+#include "compression_stream.h"
+#include "net/remoteresultcache.h"
 #include "net/tcpserver.h"
 
 #include <xapian/database.h>
 #include <xapian/registry.h>
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -58,6 +61,33 @@ class RemoteTcpServer : public TcpServer {
     /** Registry used for (un)serialisation. */
     Xapian::Registry reg;
 
+    /** Codec to offer to compress messages with.
+     *
+     *  Compression::CODEC_MAX_ means not to offer compression.
+     */
+    Compression::codec compression = Compression::CODEC_MAX_;
+
+    /** The context to report with errors.
+     *
+     *  Used for connections which reuse a database from db_pool.
+     */
+    std::string context;
+
+    /** Database handles not currently in use by a connection.
+     *
+     *  Used by run_threaded() to avoid having to open the database(s) for
+     *  every connection.  Each handle is only used by one connection at a
+     *  time.
+     */
+    std::vector<Xapian::Database> db_pool;
+
+    /** Cache of query results shared by all connections, or NULL for none.
+     *
+     *  If we fork for each connection, each child process effectively gets
+     *  its own copy of this.
+     */
+    std::unique_ptr<RemoteResultCache> result_cache;
+
     /** Accept a connection and return the file descriptor for it. */
     int accept_connection();
 
@@ -84,11 +114,48 @@ class RemoteTcpServer : public TcpServer {
     /// Set the registry used for (un)serialisation.
     void set_registry(const Xapian::Registry & reg_) { reg = reg_; }
 
+    /// Offer clients compression of messages using @a codec.
+    void set_compression(Compression::codec codec) { compression = codec; }
+
+    /** Cache query results.
+     *
+     *  @param max_size     Approximate maximum number of bytes to use for
+     *                      the cache (0 for no cache).
+     */
+    void set_result_cache_size(size_t max_size) {
+        result_cache.reset(max_size ? new RemoteResultCache(max_size) : NULL);
+    }
+
     /** Handle a single connection on an already connected socket.
      *
      *  This method may be called by multiple threads.
      */
     void handle_one_connection(int socket);
+
+    /** Create a Connection for an already connected socket.
+     *
+     *  Used by run_threaded().
+     */
+    Connection* open_connection(int socket);
+
+    /** Accept connections and service requests indefinitely using threads.
+     *
+     *  @param n_threads    The number of worker threads to use.
+     */
+    void run_threaded(unsigned n_threads) {
+        TcpServer::run_threaded(n_threads,
+                                [this](int socket) {
+                                    return open_connection(socket);
+                                });
+    }
+
+    /** Return a database handle to db_pool.
+     *
+     *  @param db   The handle to return.
+     */
+    void release_database(const Xapian::Database& db) {
+        db_pool.push_back(db);
+    }
 };
 
 #endif // XAPIAN_INCLUDED_REMOTETCPSERVER_H
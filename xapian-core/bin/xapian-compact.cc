@@ -28,6 +28,7 @@
 #include <iostream>
 
 #include "gnu_getopt.h"
+#include "parseint.h"
 
 #include "backends/glass/glass_defs.h"
 
@@ -39,6 +40,11 @@ using namespace std;
 #define OPT_HELP 1
 #define OPT_VERSION 2
 #define OPT_NO_RENUMBER 3
+#define OPT_BLOCK_POSTINGS 4
+#define OPT_BLOOM_FILTERS 5
+#define OPT_BLOCK_POSITIONS 6
+#define OPT_VALUE_COLUMNS 7
+#define OPT_IMPACTS 8
 
 static void show_usage() {
     cout << "Usage: " PROG_NAME " [OPTIONS] SOURCE_DATABASE... DESTINATION_DATABASE\n\n"
@@ -60,6 +66,22 @@ static void show_usage() {
 "                     option is only supported when merging databases if they\n"
 "                     have disjoint ranges of used document ids\n"
 "  -s, --single-file  Produce a single file database\n"
+"      --block-postings\n"
+"                     Store postings in blocks which are faster to decode\n"
+"                     (honey only)\n"
+"      --bloom-filters\n"
+"                     Store Bloom filters so lookups of terms and documents\n"
+"                     which don't exist are faster (honey only)\n"
+"      --block-positions\n"
+"                     Store positions in blocks which phrase searches can skip\n"
+"                     over (honey only)\n"
+"      --value-columns\n"
+"                     Store dense value slots as columns so the value for a\n"
+"                     document can be found directly (honey only)\n"
+"      --impacts      Store quantised BM25 impacts instead of wdf for searching\n"
+"                     with ImpactWeight (honey only)\n"
+"  -j, --threads=N    Merge tables using up to N threads (0 means pick based on\n"
+"                     the number of CPUs, default 1)\n"
 "  --help             display this help and exit\n"
 "  --version          output version information and exit\n";
 }
@@ -87,7 +109,9 @@ MyCompactor::set_status(const string & table, const string & status)
         return;
     if (!status.empty())
         cout << '\r' << table << ": " << status << '\n';
-    else
+    else if (get_threads() == 1)
+        // With multiple threads the tables are merged concurrently, so only
+        // report each as it finishes.
         cout << table << " ..." << flush;
 }
 
@@ -111,7 +135,7 @@ MyCompactor::resolve_duplicate_metadata(const string & key,
 int
 main(int argc, char **argv)
 {
-    const char * opts = "b:B:nFmqs";
+    const char * opts = "b:B:nFmqsj:";
     static const struct option long_opts[] = {
         {"fuller",      no_argument, 0, 'F'},
         {"no-full",     no_argument, 0, 'n'},
@@ -120,6 +144,12 @@ main(int argc, char **argv)
         {"backend",     required_argument, 0, 'B'},
         {"no-renumber", no_argument, 0, OPT_NO_RENUMBER},
         {"single-file", no_argument, 0, 's'},
+        {"block-postings", no_argument, 0, OPT_BLOCK_POSTINGS},
+        {"bloom-filters", no_argument, 0, OPT_BLOOM_FILTERS},
+        {"block-positions", no_argument, 0, OPT_BLOCK_POSITIONS},
+        {"value-columns", no_argument, 0, OPT_VALUE_COLUMNS},
+        {"impacts",     no_argument, 0, OPT_IMPACTS},
+        {"threads",     required_argument, 0, 'j'},
         {"quiet",       no_argument, 0, 'q'},
         {"help",        no_argument, 0, OPT_HELP},
         {"version",     no_argument, 0, OPT_VERSION},
@@ -183,9 +213,34 @@ main(int argc, char **argv)
             case 's':
                 flags |= Xapian::DBCOMPACT_SINGLE_FILE;
                 break;
+            case OPT_BLOCK_POSTINGS:
+                flags |= Xapian::DBCOMPACT_BLOCK_POSTINGS;
+                break;
+            case OPT_BLOOM_FILTERS:
+                flags |= Xapian::DBCOMPACT_BLOOM_FILTERS;
+                break;
+            case OPT_BLOCK_POSITIONS:
+                flags |= Xapian::DBCOMPACT_BLOCK_POSITIONS;
+                break;
+            case OPT_VALUE_COLUMNS:
+                flags |= Xapian::DBCOMPACT_VALUE_COLUMNS;
+                break;
+            case OPT_IMPACTS:
+                flags |= Xapian::DBCOMPACT_IMPACTS;
+                break;
             case 'q':
                 compactor.set_quiet(true);
                 break;
+            case 'j': {
+                unsigned threads;
+                if (!parse_unsigned(optarg, threads)) {
+                    cerr << PROG_NAME": Bad value '" << optarg << "' passed "
+                            "for threads, must be a non-negative integer\n";
+                    exit(1);
+                }
+                compactor.set_threads(threads);
+                break;
+            }
             case OPT_HELP:
                 cout << PROG_NAME " - " PROG_DESC "\n\n";
                 show_usage();
@@ -1,7 +1,7 @@
 /** @file
  * @brief Remote server for use with ProgClient.
  */
-/* Copyright (C) 2002,2003,2006,2007,2008,2010,2011,2023 Olly Betts
+/* Copyright (C) 2002,2003,2006,2007,2008,2010,2011,2023,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -24,6 +24,7 @@
 
 #include "gnu_getopt.h"
 #include "parseint.h"
+#include "parsecompression.h"
 
 #include <cstdlib>
 #include <iostream>
@@ -36,11 +37,13 @@ using namespace std;
 
 #define OPT_HELP 1
 #define OPT_VERSION 2
+#define OPT_COMPRESSION 3
 
 static const char * opts = "t:w";
 static const struct option long_opts[] = {
     {"timeout",         required_argument,      0, 't'},
     {"writable",        no_argument,            0, 'w'},
+    {"compression",     required_argument,      0, OPT_COMPRESSION},
     {"help",            no_argument,            0, OPT_HELP},
     {"version",         no_argument,            0, OPT_VERSION},
     {NULL, 0, 0, 0}
@@ -51,6 +54,8 @@ static void show_usage() {
 "Options:\n"
 "  --timeout MSECS         set timeout\n"
 "  --writable              allow updates\n"
+"  --compression CODEC     offer to compress large messages using CODEC\n"
+"                          (zlib, lz4 or zstd)\n"
 "  --help                  display this help and exit\n"
 "  --version               output version information and exit\n";
 }
@@ -59,6 +64,7 @@ int main(int argc, char **argv)
 {
     double timeout = 60.0;
     bool writable = false;
+    Compression::codec compression = Compression::CODEC_MAX_;
     bool syntax_error = false;
 
     int c;
@@ -83,6 +89,10 @@ int main(int argc, char **argv)
             case 'w':
                 writable = true;
                 break;
+            case OPT_COMPRESSION:
+                parse_compression(optarg, compression,
+                                  RemoteServer::compression_available);
+                break;
             default:
                 syntax_error = true;
         }
@@ -103,7 +113,8 @@ int main(int argc, char **argv)
     try {
         // We communicate with the client via stdin (fd 0) and stdout (fd 1).
         // Note that RemoteServer closes these fds.
-        RemoteServer server(dbnames, 0, 1, timeout, timeout, writable);
+        RemoteServer server(dbnames, 0, 1, timeout, timeout, writable,
+                            compression);
 
         // If you have defined your own weighting scheme, register it here
         // like so:
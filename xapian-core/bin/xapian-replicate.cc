@@ -1,7 +1,7 @@
 /** @file
  * @brief Replicate a database from a master server to a local copy.
  */
-/* Copyright (C) 2008,2011,2012,2015 Olly Betts
+/* Copyright (C) 2008,2011,2012,2015,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -25,6 +25,7 @@
 #include <xapian.h>
 
 #include "gnu_getopt.h"
+#include "parsecompression.h"
 #include "parseint.h"
 #include "stringutils.h"
 #include "safeunistd.h"
@@ -38,6 +39,7 @@ using namespace std;
 
 #define OPT_HELP 1
 #define OPT_VERSION 2
+#define OPT_COMPRESSION 3
 
 // Wait DEFAULT_INTERVAL seconds between updates unless --interval is passed.
 #define DEFAULT_INTERVAL 60
@@ -65,6 +67,8 @@ static void show_usage() {
 "  -o, --one-shot      replicate only once and then exit\n"
 "  -q, --quiet         only report errors\n"
 "  -v, --verbose       be more verbose\n"
+"  --compression=CODEC ask the master to compress what it sends using CODEC\n"
+"                      (zlib, lz4 or zstd)\n"
 "  --help              display this help and exit\n"
 "  --version           output version information and exit\n";
 }
@@ -84,6 +88,7 @@ main(int argc, char **argv)
         {"force-copy",  no_argument,        0, 'f'},
         {"quiet",       no_argument,        0, 'q'},
         {"verbose",     no_argument,        0, 'v'},
+        {"compression", required_argument,  0, OPT_COMPRESSION},
         {"help",        no_argument,        0, OPT_HELP},
         {"version",     no_argument,        0, OPT_VERSION},
         {NULL,          0, 0, 0}
@@ -98,6 +103,7 @@ main(int argc, char **argv)
     bool force_copy = false;
     int reader_close_time = READER_CLOSE_TIME;
     int timeout = DEFAULT_TIMEOUT;
+    Compression::codec compression = Compression::CODEC_MAX_;
 
     int c;
     while ((c = gnu_getopt_long(argc, argv, opts, long_opts, 0)) != -1) {
@@ -158,6 +164,10 @@ main(int argc, char **argv)
             case 'v':
                 verbosity = VERBOSE;
                 break;
+            case OPT_COMPRESSION:
+                parse_compression(optarg, compression,
+                                  ReplicateTcpClient::compression_available);
+                break;
             case OPT_HELP:
                 cout << PROG_NAME " - " PROG_DESC "\n\n";
                 show_usage();
@@ -200,6 +210,8 @@ main(int argc, char **argv)
                 cout << "Connecting to " << host << ":" << port << '\n';
             }
             ReplicateTcpClient client(host, port, 10.0, timeout);
+            if (compression != Compression::CODEC_MAX_)
+                client.set_compression(compression);
             if (verbosity == VERBOSE) {
                 cout << "Getting update for " << dbpath << " from "
                      << masterdb << '\n';
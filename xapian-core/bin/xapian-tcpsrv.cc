@@ -3,7 +3,7 @@
  */
 /* Copyright 1999,2000,2001 BrightStation PLC
  * Copyright 2001,2002 Ananova Ltd
- * Copyright 2002,2003,2004,2006,2007,2008,2009,2010,2011,2013,2015,2023 Olly Betts
+ * Copyright 2002,2003,2004,2006,2007,2008,2009,2010,2011,2013,2015,2023,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -32,6 +32,7 @@
 #include "xapian/constants.h"
 #include "xapian/error.h"
 #include "parseint.h"
+#include "parsecompression.h"
 #include "remotetcpserver.h"
 #include "net/remoteserver.h"
 #include "stringutils.h"
@@ -54,6 +55,9 @@ static void register_user_weighting_schemes(RemoteTcpServer &server) {
 
 #define OPT_HELP 1
 #define OPT_VERSION 2
+#define OPT_THREADS 3
+#define OPT_COMPRESSION 4
+#define OPT_RESULT_CACHE 5
 
 static const char * opts = "I:p:a:i:t:oqw";
 static const struct option long_opts[] = {
@@ -65,6 +69,9 @@ static const struct option long_opts[] = {
     {"one-shot",        no_argument,        0, 'o'},
     {"quiet",           no_argument,        0, 'q'},
     {"writable",        no_argument,        0, 'w'},
+    {"threads",         required_argument,  0, OPT_THREADS},
+    {"compression",     required_argument,  0, OPT_COMPRESSION},
+    {"result-cache",    required_argument,  0, OPT_RESULT_CACHE},
     {"help",            no_argument,        0, OPT_HELP},
     {"version",         no_argument,        0, OPT_VERSION},
     {NULL, 0, 0, 0}
@@ -84,6 +91,14 @@ static void show_usage() {
 "  --one-shot              serve a single connection and exit\n"
 "  --quiet                 disable information messages to stdout\n"
 "  --writable              allow updates\n"
+"  --threads N             serve connections from a single process using N\n"
+"                          worker threads instead of forking a process for\n"
+"                          each connection\n"
+"  --compression CODEC     offer to compress large messages using CODEC\n"
+"                          (zlib, lz4 or zstd)\n"
+"  --result-cache MB       cache the results of up to MB megabytes of queries\n"
+"                          (most useful with --threads, and not used when\n"
+"                          serving more than one database)\n"
 "  --help                  display this help and exit\n"
 "  --version               output version information and exit\n";
 }
@@ -95,6 +110,9 @@ int main(int argc, char **argv) {
     double idle_timeout   = MSECS_IDLE_TIMEOUT_DEFAULT * 1e-3;
 
     bool one_shot = false;
+    unsigned threads = 0;
+    Compression::codec compression = Compression::CODEC_MAX_;
+    unsigned result_cache_mb = 0;
     bool verbose = true;
     bool writable = false;
     bool syntax_error = false;
@@ -156,6 +174,22 @@ int main(int argc, char **argv) {
             case 'w':
                 writable = true;
                 break;
+            case OPT_THREADS:
+                if (!parse_unsigned(optarg, threads) || threads == 0) {
+                    cerr << "Number of threads must be > 0\n";
+                    exit(1);
+                }
+                break;
+            case OPT_COMPRESSION:
+                parse_compression(optarg, compression,
+                                  RemoteServer::compression_available);
+                break;
+            case OPT_RESULT_CACHE:
+                if (!parse_unsigned(optarg, result_cache_mb)) {
+                    cerr << "Result cache size must be >= 0\n";
+                    exit(1);
+                }
+                break;
             default:
                 syntax_error = true;
         }
@@ -203,9 +237,13 @@ int main(int argc, char **argv) {
             cout << "Listening...\n" << flush;
 
         register_user_weighting_schemes(server);
+        server.set_compression(compression);
+        server.set_result_cache_size(size_t(result_cache_mb) << 20);
 
         if (one_shot) {
             server.run_once();
+        } else if (threads) {
+            server.run_threaded(threads);
         } else {
             server.run();
         }
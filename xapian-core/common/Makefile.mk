@@ -24,6 +24,8 @@ noinst_HEADERS +=\
 	common/output.h\
 	common/overflow.h\
 	common/pack.h\
+	common/parallel.h\
+	common/parsecompression.h\
 	common/parseint.h\
 	common/popcount.h\
 	common/posixy_wrapper.h\
@@ -64,6 +66,7 @@ lib_src +=\
 	common/msvc_dirent.cc\
 	common/omassert.cc\
 	common/pack.cc\
+	common/parallel.cc\
 	common/posixy_wrapper.cc\
 	common/replicate_utils.cc\
 	common/safe.cc\
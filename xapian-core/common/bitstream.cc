@@ -1,7 +1,7 @@
 /** @file
  * @brief Classes to encode/decode a bitstream.
  */
-/* Copyright (C) 2004,2005,2006,2008,2013,2014,2016,2017,2018 Olly Betts
+/* Copyright (C) 2004,2005,2006,2008,2013,2014,2016,2017,2018,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -24,8 +24,12 @@
 
 #include <xapian/types.h>
 
+#include <cstdint>
+#include <cstring>
+
 #include "omassert.h"
 #include "pack.h"
+#include "wordaccess.h"
 
 using namespace std;
 
@@ -260,4 +264,160 @@ BitReader::decode_interpolative_next()
     return di_current.pos_k;
 }
 
+/** Read bits from a stream created by BitWriter a word at a time.
+ *
+ *  BitReader reads a byte at a time into an accumulator of type
+ *  Xapian::termpos, and decoding one value involves up to two calls to
+ *  read_bits().  This class instead keeps a 64-bit accumulator which is
+ *  refilled with a single unaligned load while at least 8 bytes of input
+ *  remain, and decodes each value from a single peek at the accumulator.
+ */
+class WordBitReader {
+    const char* p;
+
+    const char* end;
+
+    /** Bit accumulator.
+     *
+     *  Bits above n_bits may also be set, but if so they are the following
+     *  bits from the input.
+     */
+    uint64_t acc;
+
+    unsigned n_bits;
+
+    /// Load 8 bytes in little-endian order.
+    static uint64_t load_le64(const char* ptr) {
+        uint64_t v;
+        memcpy(&v, ptr, sizeof(v));
+#ifdef WORDS_BIGENDIAN
+        v = do_bswap(v);
+#endif
+        return v;
+    }
+
+    /// Ensure acc contains at least 57 bits if there's enough input left.
+    void refill() {
+        if (usual(end - p >= 8)) {
+            // We load a whole word, but only advance by the whole bytes which
+            // fitted.  Any extra bits from the last partial byte are in the
+            // right place, so will just get ORed in again by the next refill.
+            acc |= load_le64(p) << n_bits;
+            unsigned bytes = (63 - n_bits) >> 3;
+            p += bytes;
+            n_bits += bytes * 8;
+            return;
+        }
+        while (n_bits <= 56 && p != end) {
+            acc |= uint64_t(static_cast<unsigned char>(*p++)) << n_bits;
+            n_bits += 8;
+        }
+    }
+
+    /// Return the next count bits without consuming them.
+    uint64_t peek(unsigned count) {
+        AssertRel(count, <=, 57);
+        if (n_bits < count) refill();
+        // Valid streams should never run out of data, so a short read means
+        // the data is corrupt.  In that case we just pretend the missing
+        // bits are zero.
+        AssertRel(n_bits, >=, count);
+        return acc & ((uint64_t(1) << count) - 1);
+    }
+
+    /// Consume count bits.
+    void consume(unsigned count) {
+        acc >>= count;
+        n_bits = (count > n_bits ? 0 : n_bits - count);
+    }
+
+    /// Read and consume count bits.
+    uint64_t read(unsigned count) {
+        if (rare(count > 56)) {
+            // Only possible with a 64-bit Xapian::termpos.
+            uint64_t result = read(32);
+            return result | (read(count - 32) << 32);
+        }
+        uint64_t result = peek(count);
+        consume(count);
+        return result;
+    }
+
+  public:
+    /// Construct from the state of a BitReader.
+    WordBitReader(const char* p_, const char* end_,
+                  Xapian::termpos acc_, int n_bits_)
+        : p(p_), end(end_), acc(acc_), n_bits(n_bits_) { }
+
+    /// Return the state for a BitReader.
+    void save(const char*& p_, Xapian::termpos& acc_, int& n_bits_) const {
+        // Push back any whole bytes we've loaded but not used.
+        p_ = p - n_bits / 8;
+        n_bits_ = n_bits % 8;
+        acc_ = Xapian::termpos(acc & ((uint64_t(1) << n_bits_) - 1));
+    }
+
+    /// Decode value, known to be less than outof.
+    Xapian::termpos decode(Xapian::termpos outof) {
+        unsigned bits = highest_order_bit(outof - Xapian::termpos(1));
+        const Xapian::termpos spare =
+            UNSIGNED_OVERFLOW_OK(safe_shl(Xapian::termpos(1), bits) - outof);
+        if (!spare) {
+            return Xapian::termpos(read(bits));
+        }
+        // See BitWriter::encode() for the details of the encoding.  The
+        // values in the middle of the range use one fewer bit, and we can
+        // tell if that's the case from the first (bits - 1) bits.  Which case
+        // we're in is essentially random, so we avoid branching on it.
+        const Xapian::termpos mid_start = (outof - spare) / 2;
+        if (usual(bits <= 56)) {
+            uint64_t w = peek(bits);
+            Xapian::termpos value =
+                Xapian::termpos(w & ((uint64_t(1) << (bits - 1)) - 1));
+            Xapian::termpos is_long = (value < mid_start);
+            consume(bits - 1 + is_long);
+            Xapian::termpos top = Xapian::termpos(w >> (bits - 1)) & is_long;
+            return value + (-top & (mid_start + spare));
+        }
+        Xapian::termpos value = Xapian::termpos(read(bits - 1));
+        if (value < mid_start) {
+            if (read(1)) value += mid_start + spare;
+        }
+        return value;
+    }
+};
+
+/// Decode pos[j + 1] to pos[k - 1] given pos[j] and pos[k].
+static void
+decode_interpolative_all(WordBitReader& rd, Xapian::termpos* pos, int j, int k)
+{
+    // This follows the recursion in BitWriter::encode_interpolative() so that
+    // the values are decoded in the order they were encoded.
+    while (j + 1 < k) {
+        const Xapian::termpos outof = pos[k] - pos[j] + j - k + 1;
+        if (outof == 1) {
+            // The entries between j and k must be consecutive so no bits
+            // were written for them, and the same is true for every subrange
+            // so we can just fill them in.
+            for (int i = j + 1; i < k; ++i) {
+                pos[i] = pos[i - 1] + 1;
+            }
+            return;
+        }
+        const int mid = j + (k - j) / 2;
+        pos[mid] = rd.decode(outof) + (pos[j] + mid - j);
+        decode_interpolative_all(rd, pos, j, mid);
+        j = mid;
+    }
+}
+
+void
+BitReader::decode_interpolative(Xapian::termpos* pos, int j, int k)
+{
+    Assert(!di_current.is_initialized());
+    WordBitReader rd(p, end, acc, n_bits);
+    decode_interpolative_all(rd, pos, j, k);
+    rd.save(p, acc, n_bits);
+}
+
 }
@@ -1,7 +1,7 @@
 /** @file
  * @brief Classes to encode/decode a bitstream.
  */
-/* Copyright (C) 2004,2005,2006,2008,2012,2013,2014,2017,2018 Olly Betts
+/* Copyright (C) 2004,2005,2006,2008,2012,2013,2014,2017,2018,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -153,6 +153,20 @@ class BitReader {
 
     /// Perform on-demand interpolative decoding.
     Xapian::termpos decode_interpolative_next();
+
+    /** Perform interpolative decoding of a whole list.
+     *
+     *  This gives the same results as decode_interpolative() followed by
+     *  calls to decode_interpolative_next(), but is much faster as it
+     *  extracts bits a word at a time and doesn't need to maintain an
+     *  explicit stack.
+     *
+     *  @param pos  Array to decode into.  pos[j] and pos[k] must already be
+     *              set, and pos[j + 1] to pos[k - 1] are filled in.
+     *  @param j    Index of the first entry.
+     *  @param k    Index of the last entry.
+     */
+    void decode_interpolative(Xapian::termpos* pos, int j, int k);
 };
 
 }
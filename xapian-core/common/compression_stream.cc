@@ -1,7 +1,7 @@
 /** @file
- * @brief class wrapper around zlib
+ * @brief class wrapper around zlib (and optionally LZ4 and Zstandard)
  */
-/* Copyright (C) 2007,2009,2012,2013,2014,2016,2019 Olly Betts
+/* Copyright (C) 2007,2009,2012,2013,2014,2016,2019,2026 Olly Betts
  * Copyright (C) 2009 Richard Boulton
  * Copyright (C) 2012 Dan Colish
  *
@@ -23,7 +23,17 @@
 #include <config.h>
 #include "compression_stream.h"
 
+#include <cstring>
+
+#ifdef HAVE_LZ4
+# include <lz4.h>
+#endif
+#ifdef HAVE_ZSTD
+# include <zstd.h>
+#endif
+
 #include "omassert.h"
+#include "pack.h"
 #include "str.h"
 #include "stringutils.h"
 
@@ -31,6 +41,46 @@
 
 using namespace std;
 
+/** Bits set in the first byte of data compressed with a codec other than zlib.
+ *
+ *  In a raw deflate stream, the first byte starts with the BFINAL bit followed
+ *  by the two BTYPE bits, and BTYPE 3 is reserved so a valid stream can't have
+ *  both of these bits set.  The codec is stored in the upper bits.
+ */
+static constexpr unsigned char NON_ZLIB_MARKER = 0x06;
+
+/** Zstandard compression level to use.
+ *
+ *  Decompression speed is much the same whatever level was used to compress,
+ *  so we use the default level which is a good trade-off between compression
+ *  speed and ratio.
+ */
+static constexpr int ZSTD_LEVEL = 3;
+
+bool
+Compression::codec_available(codec c)
+{
+    switch (c) {
+        case ZLIB:
+            return true;
+        case LZ4:
+#ifdef HAVE_LZ4
+            return true;
+#else
+            return false;
+#endif
+        case ZSTD:
+#ifdef HAVE_ZSTD
+            return true;
+#else
+            return false;
+#endif
+        case CODEC_MAX_:
+            break;
+    }
+    return false;
+}
+
 CompressionStream::~CompressionStream() {
     if (deflate_zstream) {
         // Errors which we care about have already been handled, so just ignore
@@ -46,11 +96,22 @@ CompressionStream::~CompressionStream() {
         delete inflate_zstream;
     }
 
+#ifdef HAVE_ZSTD
+    ZSTD_freeCCtx(zstd_cctx);
+    ZSTD_freeDCtx(zstd_dctx);
+#endif
+
     delete [] out;
 }
 
 const char*
 CompressionStream::compress(const char* buf, size_t* p_size) {
+    if (codec != Compression::ZLIB) return compress_other(buf, p_size);
+    return compress_zlib(buf, p_size);
+}
+
+const char*
+CompressionStream::compress_zlib(const char* buf, size_t* p_size) {
     lazy_alloc_deflate_zstream();
     size_t size = *p_size;
     if (!out || out_len < size) {
@@ -82,9 +143,104 @@ CompressionStream::compress(const char* buf, size_t* p_size) {
     return out;
 }
 
+const char*
+CompressionStream::compress_other(const char* buf, size_t* p_size) {
+    size_t size = *p_size;
+    if (!out || out_len < size) {
+        out_len = size;
+        delete [] out;
+        out = NULL;
+        out = new char[size];
+    }
+
+    // The marker byte is followed by the compressed and uncompressed lengths.
+    // We only want the result if it's smaller than the input, so we know the
+    // compressed length will pack to no more bytes than the input size does.
+    string header(1, char(NON_ZLIB_MARKER | (codec << 3)));
+    pack_uint(header, size);
+    size_t header_max = header.size() * 2 - 1;
+    if (size <= header_max) return NULL;
+    char* dest = out + header_max;
+    size_t dest_len = size - header_max;
+
+    size_t comp_len = 0;
+    switch (codec) {
+#ifdef HAVE_LZ4
+        case Compression::LZ4: {
+            if (size > size_t(LZ4_MAX_INPUT_SIZE)) return NULL;
+            int r = LZ4_compress_default(buf, dest, int(size), int(dest_len));
+            // 0 means the output wouldn't fit.
+            if (r <= 0) return NULL;
+            comp_len = size_t(r);
+            break;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case Compression::ZSTD: {
+            if (!zstd_cctx) {
+                zstd_cctx = ZSTD_createCCtx();
+                if (!zstd_cctx) throw std::bad_alloc();
+            }
+            size_t r = ZSTD_compressCCtx(zstd_cctx, dest, dest_len, buf, size,
+                                         ZSTD_LEVEL);
+            // Presumably the output wouldn't fit.
+            if (ZSTD_isError(r)) return NULL;
+            comp_len = r;
+            break;
+        }
+#endif
+        default:
+            // Avoid warnings if no codecs other than zlib are enabled.
+            (void)buf;
+            (void)dest_len;
+            throw Xapian::FeatureUnavailableError("Compression codec " +
+                                                  str(int(codec)) +
+                                                  " not supported");
+    }
+
+    header.resize(1);
+    pack_uint(header, comp_len);
+    pack_uint(header, size);
+    if (header.size() + comp_len >= size) {
+        // It didn't get smaller.
+        return NULL;
+    }
+
+    // Put the header immediately before the compressed data.
+    char* start = dest - header.size();
+    memcpy(start, header.data(), header.size());
+    *p_size = header.size() + comp_len;
+    return start;
+}
+
 bool
 CompressionStream::decompress_chunk(const char* p, int len, string& buf)
 {
+    if (decompress_codec != Compression::ZLIB) {
+        if (decompress_codec == Compression::CODEC_MAX_) {
+            if (len == 0) return false;
+            unsigned char ch = static_cast<unsigned char>(*p);
+            if ((ch & NON_ZLIB_MARKER) != NON_ZLIB_MARKER) {
+                // A raw deflate stream.
+                lazy_alloc_inflate_zstream();
+                decompress_codec = Compression::ZLIB;
+            } else {
+                unsigned c = ch >> 3;
+                if ((ch & 0x01) || c == Compression::ZLIB ||
+                    c >= Compression::CODEC_MAX_) {
+                    throw Xapian::DatabaseCorruptError("Unknown compression "
+                                                       "codec " + str(c));
+                }
+                decompress_codec = Compression::codec(c);
+                pending.assign(p, len);
+                return decompress_other(buf);
+            }
+        } else {
+            pending.append(p, len);
+            return decompress_other(buf);
+        }
+    }
+
     Bytef blk[8192];
 
     inflate_zstream->next_in = reinterpret_cast<const Bytef*>(p);
@@ -112,6 +268,87 @@ CompressionStream::decompress_chunk(const char* p, int len, string& buf)
     }
 }
 
+bool
+CompressionStream::decompress_other(string& buf)
+{
+    // Skip the marker byte.
+    const char* p = pending.data() + 1;
+    const char* end = pending.data() + pending.size();
+    size_t comp_len, uncomp_len;
+    if (!unpack_uint(&p, end, &comp_len) ||
+        !unpack_uint(&p, end, &uncomp_len)) {
+        // Wait for more data, unless a length overflowed.
+        if (!p) return false;
+        throw Xapian::DatabaseCorruptError("Bad compressed data header");
+    }
+    size_t avail = size_t(end - p);
+    if (avail < comp_len) return false;
+    if (avail > comp_len) {
+        throw Xapian::DatabaseCorruptError("Junk after compressed data");
+    }
+
+    size_t offset = buf.size();
+    switch (decompress_codec) {
+#ifdef HAVE_LZ4
+        case Compression::LZ4: {
+            // LZ4 can't compress by a factor of more than 255, so check for
+            // a corrupt length before trying to allocate space for it.
+            if (comp_len > size_t(LZ4_MAX_INPUT_SIZE) ||
+                uncomp_len > size_t(LZ4_MAX_INPUT_SIZE) ||
+                uncomp_len > comp_len * 255 + 16) {
+                throw Xapian::DatabaseCorruptError("Bad LZ4 data lengths");
+            }
+            buf.resize(offset + uncomp_len);
+            int r = LZ4_decompress_safe(p, &buf[offset], int(comp_len),
+                                        int(uncomp_len));
+            if (r < 0 || size_t(r) != uncomp_len) {
+                buf.resize(offset);
+                throw Xapian::DatabaseCorruptError("LZ4 decompression "
+                                                   "failed");
+            }
+            break;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case Compression::ZSTD: {
+            // The frame header records the uncompressed size, so check it
+            // matches before trying to allocate space for it.
+            auto frame_size = ZSTD_getFrameContentSize(p, comp_len);
+            if (frame_size != uncomp_len) {
+                throw Xapian::DatabaseCorruptError("Bad Zstandard data "
+                                                   "lengths");
+            }
+            if (!zstd_dctx) {
+                zstd_dctx = ZSTD_createDCtx();
+                if (!zstd_dctx) throw std::bad_alloc();
+            }
+            buf.resize(offset + uncomp_len);
+            size_t r = ZSTD_decompressDCtx(zstd_dctx, &buf[offset],
+                                           uncomp_len, p, comp_len);
+            if (ZSTD_isError(r) || r != uncomp_len) {
+                buf.resize(offset);
+                string msg = "Zstandard decompression failed";
+                if (ZSTD_isError(r)) {
+                    msg += " (";
+                    msg += ZSTD_getErrorName(r);
+                    msg += ')';
+                }
+                throw Xapian::DatabaseCorruptError(msg);
+            }
+            break;
+        }
+#endif
+        default:
+            // Avoid a warning if no codecs other than zlib are enabled.
+            (void)offset;
+            throw Xapian::FeatureUnavailableError("Compression codec " +
+                                                  str(int(decompress_codec)) +
+                                                  " not supported");
+    }
+    pending.resize(0);
+    return true;
+}
+
 void
 CompressionStream::lazy_alloc_deflate_zstream() {
     if (usual(deflate_zstream)) {
@@ -1,8 +1,8 @@
 /** @file
- * @brief class wrapper around zlib
+ * @brief class wrapper around zlib (and optionally LZ4 and Zstandard)
  */
 /* Copyright (C) 2012 Dan Colish
- * Copyright (C) 2012,2013,2014,2016 Olly Betts
+ * Copyright (C) 2012,2013,2014,2016,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -26,9 +26,53 @@
 #include <string>
 #include <zlib.h>
 
+#ifdef HAVE_ZSTD
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+#endif
+
+namespace Compression {
+
+/** Codecs which CompressionStream can compress with.
+ *
+ *  These values are stored in glass version files so mustn't be changed.
+ */
+enum codec {
+    ZLIB = 0,
+    LZ4 = 1,
+    ZSTD = 2,
+    CODEC_MAX_
+};
+
+/// Is support for codec @a c compiled in?
+bool codec_available(codec c);
+
+}
+
+/** Compress and decompress tags.
+ *
+ *  Data compressed with zlib is a raw deflate stream (as written by older
+ *  versions).  Data compressed with another codec starts with a byte which
+ *  can't start a valid deflate stream, so decompression works whichever codec
+ *  was used to compress, and compressed data can be copied between tables
+ *  which use different codecs.
+ */
 class CompressionStream {
     int compress_strategy;
 
+    /// Codec to use when compressing.
+    Compression::codec codec = Compression::ZLIB;
+
+    /** Codec of the data being decompressed.
+     *
+     *  CODEC_MAX_ means decompress_start() has been called but we've not yet
+     *  seen the first byte.
+     */
+    Compression::codec decompress_codec = Compression::CODEC_MAX_;
+
+    /// Buffered input when decompressing LZ4 or Zstandard data.
+    std::string pending;
+
     size_t out_len = 0;
 
     char* out = nullptr;
@@ -39,12 +83,32 @@ class CompressionStream {
     /// Zlib state object for inflating
     z_stream* inflate_zstream = nullptr;
 
+#ifdef HAVE_ZSTD
+    /// Zstandard compression context.
+    ZSTD_CCtx_s* zstd_cctx = nullptr;
+
+    /// Zstandard decompression context.
+    ZSTD_DCtx_s* zstd_dctx = nullptr;
+#endif
+
     /// Allocate the zstream for deflating, if not already allocated.
     void lazy_alloc_deflate_zstream();
 
     /// Allocate the zstream for inflating, if not already allocated.
     void lazy_alloc_inflate_zstream();
 
+    /// Compress with zlib.
+    const char* compress_zlib(const char* buf, size_t* p_size);
+
+    /// Compress with LZ4 or Zstandard.
+    const char* compress_other(const char* buf, size_t* p_size);
+
+    /** Decompress LZ4 or Zstandard data once we have all of it.
+     *
+     *  Returns true if this was the final chunk.
+     */
+    bool decompress_other(std::string& buf);
+
   public:
     /* Create a new CompressionStream object.
      *
@@ -57,9 +121,21 @@ class CompressionStream {
 
     ~CompressionStream();
 
+    /// Set the codec to use when compressing.
+    void set_codec(Compression::codec codec_) { codec = codec_; }
+
+    /// Get the codec used when compressing.
+    Compression::codec get_codec() const { return codec; }
+
+    /** Compress @a *p_size bytes of data at @a buf.
+     *
+     *  @return NULL if the data doesn't get smaller, otherwise a pointer
+     *          to the compressed data (which remains valid until the next
+     *          call) with @a *p_size set to its size.
+     */
     const char* compress(const char* buf, size_t* p_size);
 
-    void decompress_start() { lazy_alloc_inflate_zstream(); }
+    void decompress_start() { decompress_codec = Compression::CODEC_MAX_; }
 
     /** Returns true if this was the final chunk. */
     bool decompress_chunk(const char* p, int len, std::string& buf);
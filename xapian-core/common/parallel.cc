@@ -0,0 +1,123 @@
+/** @file
+ * @brief Run independent tasks in parallel.
+ */
+/* Copyright (C) 2026 Olly Betts
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#if defined HAVE_STD_THREAD && defined XAPIAN_DEBUG_LOG
+// The debug log isn't thread-safe.
+# undef HAVE_STD_THREAD
+#endif
+#ifdef HAVE_STD_THREAD
+# include <system_error>
+# include <thread>
+#endif
+
+using namespace std;
+
+#ifdef HAVE_STD_THREAD
+/** Extra threads which run_parallel() calls in this thread may still start.
+ *
+ *  This is set while running tasks, so nested run_parallel() calls share the
+ *  limit of the outermost call rather than each starting up to their own
+ *  @a max_threads threads.
+ */
+static thread_local atomic<int>* thread_budget = nullptr;
+#endif
+
+void
+Xapian::Internal::run_parallel(const vector<function<void()>>& tasks,
+                               unsigned max_threads)
+{
+    size_t n_tasks = tasks.size();
+    vector<exception_ptr> errors(n_tasks);
+    atomic<size_t> next_task{0};
+
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next_task++) < n_tasks) {
+            try {
+                tasks[i]();
+            } catch (...) {
+                errors[i] = current_exception();
+            }
+        }
+    };
+
+#ifdef HAVE_STD_THREAD
+    if (max_threads == 0) {
+        // This can return 0 if the value isn't known, in which case we don't
+        // start any extra threads.
+        max_threads = thread::hardware_concurrency();
+    }
+    size_t n_threads = min(size_t(max_threads), n_tasks);
+
+    atomic<int>* outer_budget = thread_budget;
+    atomic<int> own_budget{int(max(max_threads, 1u)) - 1};
+    atomic<int>* budget = outer_budget ? outer_budget : &own_budget;
+
+    // Reserve the extra threads we want from the budget.
+    int n_extra = 0;
+    if (n_threads > 1) {
+        int avail = budget->load();
+        do {
+            n_extra = min(avail, int(n_threads - 1));
+        } while (n_extra > 0 &&
+                 !budget->compare_exchange_weak(avail, avail - n_extra));
+    }
+
+    vector<thread> threads;
+    if (n_extra > 0) {
+        threads.reserve(n_extra);
+        try {
+            while (threads.size() < size_t(n_extra)) {
+                threads.emplace_back([&]() {
+                    thread_budget = budget;
+                    worker();
+                    // Let nested calls still running in other threads use
+                    // this thread's share of the budget.
+                    ++*budget;
+                });
+            }
+        } catch (const system_error&) {
+            // Failing to start a thread isn't fatal - the threads we did
+            // manage to start (and this one) will run all the tasks.
+            *budget += n_extra - int(threads.size());
+        }
+    }
+    thread_budget = budget;
+    worker();
+    thread_budget = outer_budget;
+    for (auto&& t : threads) {
+        t.join();
+    }
+#else
+    (void)max_threads;
+    worker();
+#endif
+
+    for (auto&& e : errors) {
+        if (e) rethrow_exception(e);
+    }
+}
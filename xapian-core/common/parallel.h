@@ -0,0 +1,84 @@
+/** @file
+ * @brief Run independent tasks in parallel.
+ */
+/* Copyright (C) 2026 Olly Betts
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef XAPIAN_INCLUDED_PARALLEL_H
+#define XAPIAN_INCLUDED_PARALLEL_H
+
+#ifndef PACKAGE
+# error config.h must be included first in each C++ source file
+#endif
+
+#include <functional>
+#include <vector>
+#ifdef HAVE_STD_THREAD
+# include <mutex>
+#endif
+
+namespace Xapian {
+namespace Internal {
+
+/** Run @a tasks, using up to @a max_threads threads.
+ *
+ *  The calling thread also runs tasks.  If @a max_threads is 0 then the
+ *  number of threads is picked based on the hardware.  If std::thread isn't
+ *  supported then the tasks are simply run in order in the calling thread.
+ *
+ *  If called from a task being run by run_parallel(), the threads started
+ *  count against the outermost call's limit, so nesting doesn't multiply the
+ *  number of threads.
+ *
+ *  All the tasks are run even if some of them throw an exception.  Once all
+ *  the tasks have finished, the exception thrown by the first failing task
+ *  (in the order in @a tasks) is rethrown.
+ */
+void run_parallel(const std::vector<std::function<void()>>& tasks,
+                  unsigned max_threads = 0);
+
+/** Mutex for tasks run by run_parallel() which share state.
+ *
+ *  If std::thread isn't supported then this does nothing.  Use with
+ *  std::lock_guard.
+ */
+class ParallelMutex {
+#ifdef HAVE_STD_THREAD
+    std::mutex mutex;
+#endif
+
+  public:
+    void lock() {
+#ifdef HAVE_STD_THREAD
+        mutex.lock();
+#endif
+    }
+
+    void unlock() {
+#ifdef HAVE_STD_THREAD
+        mutex.unlock();
+#endif
+    }
+};
+
+}
+}
+
+using Xapian::Internal::run_parallel;
+using Xapian::Internal::ParallelMutex;
+
+#endif // XAPIAN_INCLUDED_PARALLEL_H
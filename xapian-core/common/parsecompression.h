@@ -0,0 +1,62 @@
+/** @file
+ * @brief Parse the name of a compression codec from the command line.
+ */
+/* Copyright (C) 2026 Olly Betts
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef XAPIAN_INCLUDED_PARSECOMPRESSION_H
+#define XAPIAN_INCLUDED_PARSECOMPRESSION_H
+
+#include "compression_stream.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+/** Parse the name of a compression codec given to a command line option.
+ *
+ *  If @a name isn't a known codec, or @a available returns false for it, an
+ *  error is reported and the program exits.
+ *
+ *  @param name       The codec name (zlib, lz4 or zstd).
+ *  @param codec      Set to the codec.
+ *  @param available  Function which checks if a codec is supported by this
+ *                    build (e.g. RemoteServer::compression_available).
+ */
+inline void
+parse_compression(const char* name, Compression::codec& codec,
+                  bool (*available)(Compression::codec))
+{
+    if (std::strcmp(name, "zlib") == 0) {
+        codec = Compression::ZLIB;
+    } else if (std::strcmp(name, "lz4") == 0) {
+        codec = Compression::LZ4;
+    } else if (std::strcmp(name, "zstd") == 0) {
+        codec = Compression::ZSTD;
+    } else {
+        std::cerr << "Unknown compression codec '" << name << "' (expected "
+                     "zlib, lz4 or zstd)\n";
+        std::exit(1);
+    }
+    if (!available(codec)) {
+        std::cerr << "Compression codec '" << name << "' isn't supported by "
+                     "this build of Xapian\n";
+        std::exit(1);
+    }
+}
+
+#endif // XAPIAN_INCLUDED_PARSECOMPRESSION_H
@@ -2,6 +2,7 @@
  *  @brief Replication protocol version and message numbers
  */
 /* Copyright (C) 2008 Lemur Consulting Ltd
+ * Copyright (C) 2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -23,8 +24,10 @@
 
 // Versions:
 // 1: Initial support
+// 1.1: Replica can ask for compression by sending 'C' with the codec number
+//      before 'R'.  Files are then sent in compressed blocks with a checksum.
 #define XAPIAN_REPLICATION_PROTOCOL_MAJOR_VERSION 1
-#define XAPIAN_REPLICATION_PROTOCOL_MINOR_VERSION 0
+#define XAPIAN_REPLICATION_PROTOCOL_MINOR_VERSION 1
 
 // Reply types (master -> replica)
 enum replicate_reply_type {
@@ -21,6 +21,7 @@ xapianinclude_HEADERS =\
 	include/xapian/enquire.h\
 	include/xapian/eset.h\
 	include/xapian/expanddecider.h\
+	include/xapian/honeybuilder.h\
 	include/xapian/intrusive_ptr.h\
 	include/xapian/iterator.h\
 	include/xapian/keymaker.h\
@@ -1,7 +1,7 @@
 /** @file
  *  @brief Public interfaces for the Xapian library.
  */
-// Copyright (C) 2003,2004,2005,2007,2008,2009,2010,2012,2013,2015,2016,2019 Olly Betts
+// Copyright (C) 2003,2004,2005,2007,2008,2009,2010,2012,2013,2015,2016,2019,2026 Olly Betts
 //
 // This program is free software; you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -100,6 +100,9 @@
 // Database compaction and merging
 #include <xapian/compactor.h>
 
+// Building honey databases
+#include <xapian/honeybuilder.h>
+
 // ELF visibility annotations for GCC.
 #include <xapian/visibility.h>
 
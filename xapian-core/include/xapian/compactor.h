@@ -54,8 +54,48 @@ class XAPIAN_VISIBILITY_DEFAULT Compactor {
 
     Compactor() {}
 
+    /** Copy constructor.
+     *
+     *  Copies the thread count set by set_threads().
+     */
+    Compactor(const Compactor& o);
+
+    /** Assignment operator.
+     *
+     *  Copies the thread count set by set_threads().
+     */
+    Compactor& operator=(const Compactor& o);
+
     virtual ~Compactor();
 
+    /** Set the maximum number of threads to use.
+     *
+     *  The tables are independent so can be merged concurrently, and when
+     *  merging the postlists in multiple passes (see
+     *  Xapian::DBCOMPACT_MULTIPASS) the merges in each pass are independent
+     *  too.  Compacting to a single file always uses one thread.
+     *
+     *  The limit covers every thread used by the compaction, including those
+     *  merging postlists in multiple passes while other tables are merged.
+     *
+     *  When using more than one thread, calls to set_status() and
+     *  resolve_duplicate_metadata() may be made from any of the threads, but
+     *  won't be made concurrently, and set_status() calls for different
+     *  tables may be interleaved.
+     *
+     *  @param threads_  Maximum number of threads to use.  0 means pick a
+     *                   number based on the hardware.  The default is 1.
+     *
+     *  @since Added in Xapian 2.1.0.
+     */
+    void set_threads(unsigned threads_);
+
+    /** Get the maximum number of threads to use.
+     *
+     *  @since Added in Xapian 2.1.0.
+     */
+    unsigned get_threads() const;
+
     /** Update progress.
      *
      *  Subclass this method if you want to get progress updates during
@@ -1,7 +1,7 @@
 /** @file
  * @brief Constants in the Xapian namespace
  */
-/* Copyright (C) 2012,2013,2014,2015,2016,2017,2018 Olly Betts
+/* Copyright (C) 2012,2013,2014,2015,2016,2017,2018,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -143,6 +143,80 @@ const int DB_NO_TERMLIST         = 0x20;
  */
 const int DB_RETRY_LOCK          = 0x40;
 
+/** Optimise for loading a large number of documents.
+ *
+ *  For backends which support it (currently glass), when the flush threshold
+ *  is reached the buffered postlist and position changes are written to
+ *  temporary files as sorted runs instead of being merged into the tables.
+ *  The runs are merged into the tables in key order by an explicit commit,
+ *  which is much more efficient for a large batch of documents.
+ *
+ *  Changes are only committed by an explicit call to commit() (or by
+ *  closing the database) - reaching the flush threshold won't trigger an
+ *  automatic commit when this flag is in effect.
+ *
+ *  Once the flush threshold has been reached, reading postings, positions
+ *  or document lengths from the WritableDatabase object (including running
+ *  a search on it) throws Xapian::InvalidOperationError until the changes
+ *  are committed.  Deleting or replacing an existing document is supported,
+ *  but has to merge the runs into the tables first so is best avoided.
+ *
+ *  @since Added in Xapian 2.1.0.
+ */
+const int DB_BULK_LOAD           = 0x80;
+
+/** Compress tags with LZ4 when creating a new glass database.
+ *
+ *  By default glass compresses larger tags in the tables which benefit from
+ *  it (document data, termlists, spelling and synonyms) using zlib.  LZ4
+ *  compresses less well than zlib, but decompresses much faster.
+ *
+ *  This flag is ignored when opening an existing database - the codec used
+ *  is recorded for each table when the database is created.  Databases
+ *  created with this flag can't be read by Xapian versions before 2.1.0.
+ *
+ *  @exception Xapian::FeatureUnavailableError is thrown when creating a
+ *             database if Xapian was built without LZ4 support.
+ *
+ *  @since Added in Xapian 2.1.0.
+ */
+const int DB_COMPRESS_LZ4        = 0x800;
+
+/** Compress tags with Zstandard when creating a new glass database.
+ *
+ *  Zstandard typically compresses better than zlib and decompresses faster.
+ *  Otherwise this works like Xapian::DB_COMPRESS_LZ4 (and you can't specify
+ *  both).
+ *
+ *  @exception Xapian::FeatureUnavailableError is thrown when creating a
+ *             database if Xapian was built without Zstandard support.
+ *
+ *  @since Added in Xapian 2.1.0.
+ */
+const int DB_COMPRESS_ZSTD       = 0x1000;
+
+/** Cache document lengths in memory.
+ *
+ *  For backends which support it (currently glass and honey), all the
+ *  document lengths are read into an array in memory the first time one is
+ *  needed, and subsequent lookups come from this array.  Weighting schemes
+ *  such as BM25 look up the length of every document they score, so this
+ *  can make searches faster, particularly when most of the database is
+ *  cached by the OS anyway.
+ *
+ *  The array is shared by all the Enquire objects using the Database.  It
+ *  takes 1, 2 or 4 bytes per document id up to the highest one in use,
+ *  depending on the length of the longest document.
+ *
+ *  This flag is only supported when opening a Database, and is ignored for
+ *  a WritableDatabase.
+ *
+ *  @since Added in Xapian 2.1.0.
+ */
+// 0x2000 is used by DBCOMPACT_VALUE_COLUMNS, and the DB_* and DBCOMPACT_*
+// flags can be combined when compacting, so skip it.
+const int DB_CACHE_DOCLENGTHS    = 0x4000;
+
 /** Use the glass backend.
  *
  *  When opening a WritableDatabase, this means create a glass database if a
@@ -200,6 +274,9 @@ const int DB_BACKEND_HONEY       = 0x500;
 /** @internal Bit mask for backend codes. */
 const int DB_BACKEND_MASK_       = 0x700;
 
+/** @internal Bit mask for compression codecs. */
+const int DB_COMPRESS_MASK_      = 0x1800;
+
 /** @internal Used internally to signify opening read-only. */
 const int DB_READONLY_           = -1;
 #endif
@@ -262,6 +339,93 @@ const int DBCOMPACT_MULTIPASS = 8;
  */
 const int DBCOMPACT_SINGLE_FILE = 16;
 
+/** Store postings in blocks in a honey database.
+ *
+ *  Postings are stored in blocks of up to 128 entries rather than as a
+ *  sequence of variable length integers, which makes them faster to decode
+ *  but usually a little larger.  Docid gaps and wdfs must be less than 2**32.
+ *
+ *  Only supported by the honey backend, and ignored for other backends.
+ *
+ *  @since Added in Xapian 2.1.0.
+ */
+const int DBCOMPACT_BLOCK_POSTINGS = 32;
+
+/** Store Bloom filters over the keys of tables in a honey database.
+ *
+ *  These are stored for the postlist and termlist tables and allow most
+ *  lookups of terms or document ids which aren't present to be answered
+ *  without reading the table.  They use about 10 bits per term and per
+ *  document, which is loaded into memory when the database is opened.
+ *
+ *  Only supported by the honey backend, and ignored for other backends.
+ *
+ *  @since Added in Xapian 2.1.0.
+ */
+const int DBCOMPACT_BLOOM_FILTERS = 64;
+
+/** Store positions in blocks in a honey database.
+ *
+ *  Position lists are stored in blocks of up to 128 entries, each starting
+ *  with its last position, rather than using interpolative coding.  This is
+ *  usually a little larger, but allows phrase searches to skip over blocks
+ *  without decoding them, which can make them much faster when a term
+ *  occurs many times in a document.  Gaps between positions must be less
+ *  than 2**32.
+ *
+ *  Only supported by the honey backend, and ignored for other backends.
+ *
+ *  @since Added in Xapian 2.1.0.
+ */
+const int DBCOMPACT_BLOCK_POSITIONS = 128;
+
+/** Store dense value slots as columns in a honey database.
+ *
+ *  Where a chunk of a value slot has a value for most documents, it is
+ *  stored as a column with a fixed-width entry for each document id, either
+ *  the value itself padded to the longest in the chunk or an index into a
+ *  table of the distinct values in the chunk (which suits slots holding a
+ *  category).  The value for a document can then be found without decoding
+ *  the chunk up to it, which speeds up sorting, collapsing, value ranges and
+ *  matchspies over such slots.  Sparse chunks are stored as before.
+ *
+ *  Only supported by the honey backend, and ignored for other backends.
+ *
+ *  @since Added in Xapian 2.1.0.
+ */
+// Values 256 to 4096 would clash with the DB_BACKEND_* and DB_COMPRESS_*
+// flags, so we skip over them.
+const int DBCOMPACT_VALUE_COLUMNS = 8192;
+
+/** Store precomputed impacts instead of wdf in a honey database.
+ *
+ *  For each posting the part of the weight Xapian::BM25Weight would give with
+ *  its default parameters which depends on the wdf and document length is
+ *  calculated, quantised to an integer between 1 and 255, and stored in place
+ *  of the wdf.  Searching with Xapian::ImpactWeight then needs neither the
+ *  document lengths nor any floating point calculation per posting beyond a
+ *  multiplication, and the bound on each term's weight is exact.
+ *
+ *  Xapian::ImpactWeight applies the term weight at search time, using the
+ *  statistics for all the databases being searched, so shards compacted
+ *  separately can be searched together.  However, document lengths are
+ *  normalised using the average document length of the database being
+ *  compacted, so shards should have similar average document lengths (as
+ *  they will if documents are spread between them at random).
+ *
+ *  The wdf values returned when iterating postings and the collection
+ *  frequencies reported for terms are then those of the impacts (the wdf
+ *  values in termlists are unaffected), so other weighting schemes won't
+ *  give useful results with such a database.  It also can't be used as the
+ *  input to further compaction.
+ *
+ *  Only supported by the honey backend, and ignored for other backends.
+ *
+ *  @since Added in Xapian 2.1.0.
+ */
+// 16384 is used by DB_CACHE_DOCLENGTHS, so skip it.
+const int DBCOMPACT_IMPACTS = 32768;
+
 /** Assume document id is valid.
  *
  *  By default, Database::get_document() checks that the document id passed is
@@ -1031,6 +1031,9 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
      *   - Xapian::DB_DANGEROUS don't be crash-safe, no concurrent readers
      *   - Xapian::DB_NO_TERMLIST don't use a termlist table
      *   - Xapian::DB_RETRY_LOCK to wait to get a write lock
+     *   - Xapian::DB_BULK_LOAD write changes as sorted runs until commit
+     *   - Xapian::DB_COMPRESS_LZ4 or Xapian::DB_COMPRESS_ZSTD to select the
+     *     codec for compressing tags when creating a glass database
      *
      *  @param block_size  The block size in bytes to use when creating a
      *                     new database.  This is ignored when opening an
@@ -1,7 +1,7 @@
 /** @file
  * @brief Factory functions for constructing Database and WritableDatabase objects
  */
-/* Copyright (C) 2005,2006,2007,2008,2009,2011,2013,2014,2016,2024 Olly Betts
+/* Copyright (C) 2005,2006,2007,2008,2009,2011,2013,2014,2016,2024,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -92,6 +92,78 @@ WritableDatabase open_writable(std::string_view host,
                                unsigned connect_timeout = 10000,
                                int flags = 0);
 
+/** Construct a Database object for read-only access to a remote database
+ *  replicated on several servers accessed via TCP connections.
+ *
+ * The replicas must be copies of the same database (for example, kept in sync
+ * using Xapian's replication support) and should be served by xapian-tcpsrv
+ * with the same options.
+ *
+ * Recent query latencies for each server are tracked across the process, and
+ * we connect to the server with the lowest median latency, trying the next
+ * best if we fail to connect.
+ *
+ * If the statistics for a query haven't arrived after the @a hedge_percentile
+ * percentile of the recent latencies for that server, the query is also sent
+ * to the next best replica which is at the same revision, and whichever
+ * replies first is used for the rest of the query and subsequent operations.
+ * The connection to the other is closed, which cancels the query there.
+ * If the connection to the server fails while waiting for the statistics,
+ * the query is sent to another replica straight away.
+ *
+ * Only the wait for the statistics can trigger a hedged request - the match
+ * itself is only run on the chosen replica, and is subject to @a timeout as
+ * usual.
+ *
+ * @param replicas      space-separated list of servers to connect to, each
+ *                      in the form HOST:PORT (an IPv6 address can be given as
+ *                      [ADDRESS]:PORT).
+ * @param timeout       timeout in milliseconds.  If this timeout is exceeded
+ *                      for any individual operation on the remote database
+ *                      then Xapian::NetworkTimeoutError is thrown.  A timeout
+ *                      of 0 means don't timeout.  (Default is 10000ms, which
+ *                      is 10 seconds).
+ * @param connect_timeout       timeout to use when connecting to a server.
+ *                              If this timeout is exceeded for all the
+ *                              servers then Xapian::NetworkTimeoutError is
+ *                              thrown.  A timeout of 0 means don't timeout.
+ *                              (Default is 10000ms, which is 10 seconds).
+ * @param hedge_percentile      percentile of the recent query latency of a
+ *                              server after which to send a hedged request
+ *                              to another replica, from 1 to 100, or 0 to
+ *                              never send hedged requests.  (Default is 95).
+ *
+ * @since Added in Xapian 2.1.0.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+Database open_replicas(std::string_view replicas,
+                       unsigned timeout = 10000,
+                       unsigned connect_timeout = 10000,
+                       unsigned hedge_percentile = 95);
+
+/** Set how many idle TCP connections to keep for reuse for each server.
+ *
+ * When a Database opened read-only by Remote::open() with a host and port is
+ * closed or destroyed, its connection is kept in a process-wide pool (up to
+ * @a max_idle connections for each server), and a later Remote::open() call
+ * for the same host and port will reuse it instead of opening a new
+ * connection.  This saves the cost of connecting and the initial exchange of
+ * messages with the server, which matters for a client which opens many
+ * short-lived remote databases.
+ *
+ * Idle connections are kept for up to 30 seconds, which is less than the
+ * default idle timeout of xapian-tcpsrv.
+ *
+ * @param max_idle      maximum number of idle connections to keep for each
+ *                      server.  0 disables the pool and closes any idle
+ *                      connections currently in it.  (The pool is disabled
+ *                      by default).
+ *
+ * @since Added in Xapian 2.1.0.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+void set_connection_pool_size(unsigned max_idle);
+
 /** Construct a Database object for read-only access to a remote database
  *  accessed via a program.
  *
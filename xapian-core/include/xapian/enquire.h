@@ -1,7 +1,7 @@
 /** @file
  * @brief Querying session
  */
-/* Copyright (C) 2005,2013,2016,2017,2024 Olly Betts
+/* Copyright (C) 2005,2013,2016,2017,2024,2026 Olly Betts
  * Copyright (C) 2009 Lemur Consulting Ltd
  *
  * This program is free software; you can redistribute it and/or
@@ -357,6 +357,37 @@ class XAPIAN_VISIBILITY_DEFAULT Enquire {
      */
     void set_time_limit(double time_limit);
 
+    /** Allow get_mset() to use partial results from remote shards.
+     *
+     *  By default, when searching more than one shard get_mset() waits for
+     *  every remote shard to finish its match before merging the results.
+     *  If this is enabled then each remote shard sends the best results it
+     *  has found so far every so often while its match runs, along with an
+     *  upper bound on the weight of any document it hasn't yet considered,
+     *  and get_mset() returns as soon as these show that the requested
+     *  results can't change.  If @a deadline is non-zero, get_mset() also
+     *  stops waiting for remote shards after that many seconds, and returns
+     *  the best results found so far.
+     *
+     *  The bounds and estimate of the number of matches include the
+     *  documents an unfinished shard had considered so far, so may be less
+     *  accurate.  A remote shard stops its match when it sees the next
+     *  request on its connection.
+     *
+     *  Limitations:
+     *
+     *  This is currently only used when sorting by relevance, and without
+     *  collapsing, a percentage cut-off or matchspies.  Otherwise, and on
+     *  platforms without poll(), get_mset() waits for every remote shard.
+     *
+     *  @param partial   true to allow partial results (default: false).
+     *  @param deadline  time in seconds after which to stop waiting for
+     *                   remote shards (default: 0.0 which means no deadline).
+     *
+     *  @since Added in Xapian 2.1.0.
+     */
+    void set_remote_partial_results(bool partial, double deadline = 0.0);
+
     /** Run the query.
      *
      *  Run the query using the settings in this Enquire object and those
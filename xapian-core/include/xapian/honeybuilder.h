@@ -0,0 +1,148 @@
+/** @file
+ * @brief Build a honey database directly from documents.
+ */
+/* Copyright (C) 2026 Olly Betts
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef XAPIAN_INCLUDED_HONEYBUILDER_H
+#define XAPIAN_INCLUDED_HONEYBUILDER_H
+
+#if !defined XAPIAN_IN_XAPIAN_H && !defined XAPIAN_LIB_BUILD
+# error Never use <xapian/honeybuilder.h> directly; include <xapian.h> instead.
+#endif
+
+#include <xapian/intrusive_ptr.h>
+#include <xapian/types.h>
+#include <xapian/visibility.h>
+
+#include <string>
+#include <string_view>
+
+namespace Xapian {
+
+class Compactor;
+class Document;
+
+/** Build a honey database directly from documents.
+ *
+ *  Honey databases are read-only, so normally one has to be produced by
+ *  building a glass database and then compacting it.  HoneyBuilder instead
+ *  buffers documents in memory and writes each batch out as a sorted run in
+ *  a temporary directory.  Each batch is written as a small glass database
+ *  which is immediately converted to a honey run and removed, so the only
+ *  glass database ever on disk holds a single batch.  When 32 runs of the
+ *  same size accumulate they're merged into a single larger honey run, to
+ *  limit how many files need to be open at once.  When finish() is called
+ *  the remaining runs are merged into the honey database, and the temporary
+ *  directory is removed.
+ *
+ *  Since the runs are honey, which is much more compact than glass, this
+ *  needs less disk I/O and peak disk space than building a full-size glass
+ *  database and then compacting it.  The peak is reached during the final
+ *  merge, when both the runs and the output exist.
+ *
+ *  Documents are numbered sequentially from 1 in the order they're added.
+ *
+ *  @since Added in Xapian 2.1.0.
+ */
+class XAPIAN_VISIBILITY_DEFAULT HoneyBuilder {
+  public:
+    /// @private @internal Class representing the HoneyBuilder internals.
+    class Internal;
+    /// @private @internal Reference counted internals.
+    Xapian::Internal::intrusive_ptr_nonnull<Internal> internal;
+
+    /// Copy constructor.
+    HoneyBuilder(const HoneyBuilder& o);
+
+    /// Assignment.
+    HoneyBuilder& operator=(const HoneyBuilder& o);
+
+    /// Move constructor.
+    HoneyBuilder(HoneyBuilder&& o);
+
+    /// Move assignment operator.
+    HoneyBuilder& operator=(HoneyBuilder&& o);
+
+    /** Constructor.
+     *
+     *  @param path   The path of the honey database to create.  The runs
+     *                are stored in a temporary directory named by appending
+     *                ".tmp" to this.
+     *  @param flags  Xapian::DBCOMPACT_* flags to use when writing the honey
+     *                database (e.g. Xapian::DBCOMPACT_SINGLE_FILE or
+     *                Xapian::DBCOMPACT_BLOOM_FILTERS).  Default: 0.
+     *  @param batch_size  Number of documents to buffer in memory before
+     *                     writing out a run.  0 means use the same default as
+     *                     for the flush threshold of a WritableDatabase
+     *                     (10000, or the value of XAPIAN_FLUSH_THRESHOLD if
+     *                     set).  Default: 0.
+     */
+    explicit HoneyBuilder(std::string_view path,
+                          int flags = 0,
+                          Xapian::doccount batch_size = 0);
+
+    /** Destructor.
+     *
+     *  If finish() hasn't been called, any buffered documents are discarded
+     *  and no database is created.
+     */
+    ~HoneyBuilder();
+
+    /** Add a document.
+     *
+     *  @return The document id of the new document.
+     */
+    Xapian::docid add_document(const Xapian::Document& doc);
+
+    /** Set the user-specified metadata associated with a given key.
+     *
+     *  Setting the same key more than once keeps the last value set, and
+     *  setting an empty value removes the key.
+     */
+    void set_metadata(std::string_view key, std::string_view value);
+
+    /// Add a word to the spelling dictionary.
+    void add_spelling(std::string_view word,
+                      Xapian::termcount freqinc = 1);
+
+    /// Add a synonym for a term.
+    void add_synonym(std::string_view term, std::string_view synonym);
+
+    /** Merge everything into the honey database.
+     *
+     *  After this has been called, the HoneyBuilder can't be used further.
+     */
+    void finish();
+
+    /** Merge everything into the honey database.
+     *
+     *  After this has been called, the HoneyBuilder can't be used further.
+     *
+     *  @param compactor  Functor to use to report progress on the final
+     *                    merge.  Its get_threads() setting is used for it
+     *                    too.
+     */
+    void finish(Xapian::Compactor& compactor);
+
+    /// Return a string describing this object.
+    std::string get_description() const;
+};
+
+}
+
+#endif // XAPIAN_INCLUDED_HONEYBUILDER_H
@@ -1,7 +1,7 @@
 /** @file
  * @brief Weighting scheme API.
  */
-/* Copyright (C) 2004-2024 Olly Betts
+/* Copyright (C) 2004-2026 Olly Betts
  * Copyright (C) 2009 Lemur Consulting Ltd
  * Copyright (C) 2013,2014 Aarsh Shah
  * Copyright (C) 2016,2017 Vivek Pal
@@ -2240,6 +2240,54 @@ class XAPIAN_VISIBILITY_DEFAULT DiceWeight : public Weight {
 
     DiceWeight* create_from_parameters(const char* params) const;
 };
+
+/** Xapian::Weight subclass using precomputed impacts.
+ *
+ *  This is intended for use with a honey database compacted with
+ *  Xapian::DBCOMPACT_IMPACTS, where each posting stores a quantised impact
+ *  instead of the wdf.  The weight for a term in a document is the impact
+ *  multiplied by a factor for the term, which is calculated from the term
+ *  frequency and the number of documents being searched, and adjusted for
+ *  the wqf, as Xapian::BM25Weight does with its default parameters.  The
+ *  ranking therefore approximates that of BM25Weight without needing the
+ *  document length or any calculation for each posting beyond a
+ *  multiplication.  The bound on each term's weight is also exact.
+ *
+ *  With any other database the wdf is used in place of the impact.
+ *
+ *  @since Added in Xapian 2.1.0.
+ */
+class XAPIAN_VISIBILITY_DEFAULT ImpactWeight : public Weight {
+    /// The factor to multiply impacts by.
+    double factor;
+
+    void init(double factor_);
+
+  public:
+    ImpactWeight* clone() const;
+
+    /** Construct an ImpactWeight. */
+    ImpactWeight() {
+        need_stat(COLLECTION_SIZE);
+        need_stat(TERMFREQ);
+        need_stat(WDF);
+        need_stat(WDF_MAX);
+        need_stat(WQF);
+    }
+
+    std::string name() const;
+
+    std::string serialise() const;
+    ImpactWeight* unserialise(const std::string& serialised) const;
+
+    double get_sumpart(Xapian::termcount wdf,
+                       Xapian::termcount doclen,
+                       Xapian::termcount uniqterms,
+                       Xapian::termcount wdfdocmax) const;
+    double get_maxpart() const;
+
+    ImpactWeight* create_from_parameters(const char* params) const;
+};
 }
 
 #endif // XAPIAN_INCLUDED_WEIGHT_H
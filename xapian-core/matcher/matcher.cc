@@ -32,6 +32,7 @@
 #include "omassert.h"
 #include "postlisttree.h"
 #include "protomset.h"
+#include "realtime.h"
 #include "spymaster.h"
 #include "valuestreamdocument.h"
 #include "weight/weightinternal.h"
@@ -47,6 +48,8 @@
 #include <algorithm>
 #include <cerrno>
 #include <cfloat> // For DBL_EPSILON.
+#include <cmath>
+#include <functional>
 #include <vector>
 
 #ifdef HAVE_POLL_H
@@ -68,6 +71,18 @@ static constexpr auto REL_VAL = Xapian::Enquire::Internal::REL_VAL;
 static constexpr auto VAL = Xapian::Enquire::Internal::VAL;
 static constexpr auto VAL_REL = Xapian::Enquire::Internal::VAL_REL;
 
+/** How many documents to consider between checks if we should report progress.
+ *
+ *  This is also how often we check if we should stop the match early.
+ */
+static constexpr Xapian::doccount PROGRESS_CHECK_DOCS = 256;
+
+/** Initial time between progress reports (in seconds).
+ *
+ *  This is doubled after each report.
+ */
+static constexpr double PROGRESS_INTERVAL = 0.005;
+
 #ifdef XAPIAN_HAS_REMOTE_BACKEND
 [[noreturn]]
 static void unimplemented(const char* msg)
@@ -176,6 +191,112 @@ Matcher::for_all_remotes(Action action)
     }
 #endif
 }
+
+# ifdef HAVE_POLL
+void
+Matcher::get_streamed_msets(Xapian::doccount maxitems,
+                            const Xapian::MSet& local_mset,
+                            double end_time,
+                            vector<Xapian::MSet>& msets)
+{
+    size_t n_remotes = remotes.size();
+    msets.resize(n_remotes);
+    // For each remote, an upper bound on the weight of any result which it
+    // hasn't sent us, or -1.0 once we have its final results.
+    vector<double> bounds(n_remotes, HUGE_VAL);
+    size_t n_running = n_remotes;
+
+    auto read_results = [&](size_t i) {
+        double bound;
+        if (remotes[i]->get_streamed_mset(msets[i], bound)) {
+            bounds[i] = -1.0;
+            --n_running;
+        } else {
+            bounds[i] = bound;
+        }
+    };
+
+    // The best maxitems results can't change once the maxitems-th best
+    // weight we know about is more than the weight of any result we don't
+    // know about yet.  We require it to be strictly more as equal weights
+    // are ordered by docid.
+    vector<double> weights;
+    auto results_settled = [&]() {
+        if (maxitems == 0) return false;
+        weights.clear();
+        for (auto&& item : local_mset.internal->items) {
+            weights.push_back(item.get_weight());
+        }
+        for (auto&& mset : msets) {
+            for (auto&& item : mset.internal->items) {
+                weights.push_back(item.get_weight());
+            }
+        }
+        if (weights.size() < maxitems) return false;
+        auto nth = weights.begin() + (maxitems - 1);
+        nth_element(weights.begin(), nth, weights.end(), greater<double>());
+        return *nth > *max_element(bounds.begin(), bounds.end());
+    };
+
+    unique_ptr<struct pollfd[]> fds(new struct pollfd[n_remotes]);
+    unique_ptr<size_t[]> fd_remote(new size_t[n_remotes]);
+    while (n_running && !results_settled()) {
+        // Handle any results which we've already read from the connection
+        // first, as poll() won't report those.
+        bool read_any = false;
+        for (size_t i = 0; i != n_remotes; ++i) {
+            if (bounds[i] >= 0.0 && remotes[i]->mset_reply_pending()) {
+                read_results(i);
+                read_any = true;
+            }
+        }
+        if (read_any) continue;
+
+        int timeout = -1;
+        if (end_time != 0.0) {
+            double time_diff = end_time - RealTime::now();
+            if (time_diff <= 0.0) break;
+            timeout = int(ceil(time_diff * 1000));
+        }
+        nfds_t nfds = 0;
+        for (size_t i = 0; i != n_remotes; ++i) {
+            if (bounds[i] < 0.0) continue;
+            fds[nfds].fd = remotes[i]->get_read_fd();
+            fds[nfds].events = POLLIN;
+            fds[nfds].revents = 0;
+            fd_remote[nfds++] = i;
+        }
+        int r = poll(fds.get(), nfds, timeout);
+        if (r < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            throw Xapian::NetworkError("poll() failed waiting for remotes",
+                                       errno);
+        }
+        for (nfds_t j = 0; j != nfds; ++j) {
+            if (!fds[j].revents) continue;
+            // Just read what's available - we handle any whole replies at
+            // the top of the loop, so we won't wait for the rest of a reply
+            // beyond end_time.  If the connection was closed, reading the
+            // results reports the error.
+            size_t i = fd_remote[j];
+            if (!remotes[i]->read_mset_input(end_time)) read_results(i);
+        }
+    }
+
+    for (size_t i = 0; i != n_remotes; ++i) {
+        if (bounds[i] < 0.0) continue;
+        // We're not going to wait for this remote to finish, so its results
+        // will be discarded when they arrive.
+        remotes[i]->discard_mset();
+        if (bounds[i] == HUGE_VAL) {
+            // We've had no results at all from this remote.
+            auto& mseti = msets[i].internal;
+            mseti->matches_upper_bound = remotes[i]->get_doccount();
+            mseti->uncollapsed_upper_bound = mseti->matches_upper_bound;
+        }
+    }
+}
+# endif
 #endif
 
 Matcher::Matcher(const Xapian::Database& db_,
@@ -506,12 +627,49 @@ Matcher::get_local_mset(Xapian::doccount first,
                          time_limit);
     proto_mset.set_new_min_weight(weight_threshold);
 
+    // If reporting progress or checking if we should stop, how many more
+    // documents to consider before we next check, and when to next report.
+    bool report_progress = (progress &&
+                            sort_by == REL &&
+                            collapse_max == 0 &&
+                            percent_threshold == 0);
+    bool check_progress = (report_progress || stop);
+    Xapian::doccount progress_countdown = PROGRESS_CHECK_DOCS;
+    double progress_interval = PROGRESS_INTERVAL;
+    double next_progress = 0.0;
+    if (report_progress) next_progress = RealTime::now() + progress_interval;
+
     while (true) {
         double min_weight = proto_mset.get_min_weight();
         if (!pltree.next(min_weight)) {
             break;
         }
 
+        if (check_progress && --progress_countdown == 0) {
+            progress_countdown = PROGRESS_CHECK_DOCS;
+            if (stop && stop()) {
+                break;
+            }
+            if (report_progress) {
+                double now = RealTime::now();
+                if (now >= next_progress) {
+                    // Estimate how far through the match we are from the
+                    // docid we've reached.
+                    Xapian::docid did = pltree.get_docid();
+                    double considered = did / double(db.get_lastdocid());
+                    pltree.force_recalc();
+                    double bound = pltree.recalc_maxweight();
+                    progress(proto_mset.snapshot(considered,
+                                                 db.get_doccount()),
+                             bound);
+                    // Back off so the number of reports only grows with the
+                    // log of how long the match takes.
+                    progress_interval *= 2;
+                    next_progress = now + progress_interval;
+                }
+            }
+        }
+
         // The weight calculation can be expensive enough that it's worth being
         // lazy and only calculating it once we know we need to.  If sort_by
         // is DOCID then all weights are zero.
@@ -589,12 +747,31 @@ Matcher::get_mset(Xapian::doccount first,
                   Xapian::Enquire::Internal::sort_setting sort_by,
                   bool sort_val_reverse,
                   double time_limit,
-                  const vector<opt_intrusive_ptr<Xapian::MatchSpy>>& matchspies)
+                  const vector<opt_intrusive_ptr<Xapian::MatchSpy>>& matchspies,
+                  bool partial_results,
+                  double partial_end_time)
 {
     AssertRel(check_at_least, >=, first + maxitems);
 
 #ifdef XAPIAN_HAS_REMOTE_BACKEND
-    if (locals.empty() && remotes.size() == 1) {
+# ifdef HAVE_POLL
+    // We can only tell when streamed results can't change if sorting by
+    // relevance, and we need the final results from each remote to merge
+    // collapse counts, percentage cut-offs and matchspy results.
+    bool stream = (partial_results &&
+                   !remotes.empty() &&
+                   sort_by == REL &&
+                   collapse_max == 0 &&
+                   percent_threshold == 0 &&
+                   matchspies.empty());
+# else
+    // We need poll() to wait for streamed results.
+    constexpr bool stream = false;
+    (void)partial_results;
+    (void)partial_end_time;
+# endif
+
+    if (locals.empty() && remotes.size() == 1 && !stream) {
         // Short cut for a single remote database.
         Assert(remotes[0]);
         remotes[0]->start_match(first, maxitems, check_at_least, sorter,
@@ -624,8 +801,11 @@ Matcher::get_mset(Xapian::doccount first,
             remote_maxitems = check_at_least;
         }
         submatch->start_match(0, remote_maxitems, check_at_least, sorter,
-                              stats);
+                              stats, stream);
     }
+#else
+    (void)partial_results;
+    (void)partial_end_time;
 #endif
 
     Xapian::MSet local_mset;
@@ -676,31 +856,49 @@ Matcher::get_mset(Xapian::doccount first,
     // than we need.
     vector<pair<Xapian::MSet, Xapian::doccount>> msets;
     Xapian::MSet merged_mset;
-    for_all_remotes(
-        [&](RemoteSubMatch* submatch) {
-            Xapian::MSet remote_mset = submatch->get_mset(matchspies);
+    auto add_remote_mset =
+        [&](Xapian::MSet& remote_mset, Xapian::doccount shard) {
             merged_mset.internal->merge_stats(remote_mset.internal.get(),
                                               collapse_max != 0);
-            auto& merged_stats = merged_mset.internal->stats;
-            if (!merged_stats) {
-                merged_stats = std::move(remote_mset.internal->stats);
-            } else {
-                merged_stats->merge(*(remote_mset.internal->stats));
+            // The best results so far from a remote which is still running
+            // don't have stats.
+            if (remote_mset.internal->stats) {
+                auto& merged_stats = merged_mset.internal->stats;
+                if (!merged_stats) {
+                    merged_stats = std::move(remote_mset.internal->stats);
+                } else {
+                    merged_stats->merge(*(remote_mset.internal->stats));
+                }
             }
             if (remote_mset.empty()) {
                 return;
             }
-            remote_mset.internal->unshard_docids(submatch->get_shard(),
-                                                 db.internal->size());
+            remote_mset.internal->unshard_docids(shard, db.internal->size());
             msets.push_back({remote_mset, 0});
-        });
+        };
+    if (stream) {
+        vector<Xapian::MSet> remote_msets;
+        get_streamed_msets(first + maxitems, local_mset, partial_end_time,
+                           remote_msets);
+        for (size_t i = 0; i != remotes.size(); ++i) {
+            add_remote_mset(remote_msets[i], remotes[i]->get_shard());
+        }
+    } else {
+        for_all_remotes(
+            [&](RemoteSubMatch* submatch) {
+                Xapian::MSet remote_mset = submatch->get_mset(matchspies);
+                add_remote_mset(remote_mset, submatch->get_shard());
+            });
+    }
 
     if (!locals.empty()) {
         if (!local_mset.empty())
             msets.push_back({local_mset, 0});
         merged_mset.internal->merge_stats(local_mset.internal.get(),
                                           collapse_max != 0);
-        merged_mset.internal->stats->merge(stats);
+        // If there are no stats from the remotes, the caller will use stats.
+        if (merged_mset.internal->stats)
+            merged_mset.internal->stats->merge(stats);
     }
 
     if (merged_mset.internal->max_possible == 0.0) {
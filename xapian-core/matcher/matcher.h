@@ -1,7 +1,7 @@
 /** @file
  * @brief Matcher class
  */
-/* Copyright (C) 2017,2018,2019 Olly Betts
+/* Copyright (C) 2017,2018,2019,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -32,6 +32,7 @@
 
 #include "xapian/database.h"
 
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -87,6 +88,21 @@ class Matcher {
 # endif
 #endif
 
+    /** Function to report the best results so far during a local match.
+     *
+     *  If set, this is called every so often during the match with the best
+     *  results so far and an upper bound on the weight of any document not
+     *  yet considered.
+     */
+    std::function<void(const Xapian::MSet&, double)> progress;
+
+    /** Function to check if a local match should stop early.
+     *
+     *  If set, this is called every PROGRESS_CHECK_DOCS documents considered
+     *  during the match, and if it returns true the match stops.
+     */
+    std::function<bool()> stop;
+
     Matcher(const Matcher&) = delete;
 
     Matcher& operator=(const Matcher&) = delete;
@@ -112,6 +128,22 @@ class Matcher {
     /// Perform action on remotes as they become ready using poll() or select().
     template<typename Action> void for_all_remotes(Action action);
 
+    /** Read results from remotes which are streaming them.
+     *
+     *  Returns once the best @a maxitems results can't change, or when
+     *  @a end_time is reached.
+     *
+     *  @param maxitems     The number of results we need.
+     *  @param local_mset   Results from local shards.
+     *  @param end_time     Give up waiting at this time (0.0 for never).
+     *  @param[out] msets   Set to the results for each remote (the final
+     *                      results, or the best so far if it's still running).
+     */
+    void get_streamed_msets(Xapian::doccount maxitems,
+                            const Xapian::MSet& local_mset,
+                            double end_time,
+                            std::vector<Xapian::MSet>& msets);
+
   public:
     /** Constructor.
      *
@@ -189,6 +221,11 @@ class Matcher {
      *  @param time_limit       time in seconds after which to disable
      *                          check_at_least (0.0 means don't).
      *  @param matchspies       MatchSpy objects to use
+     *  @param partial_results  Use results streamed from remote shards?
+     *  @param partial_end_time Time after which to use the best results so far
+     *                          from remote shards which haven't finished (0.0
+     *                          means wait for them).  Only used if
+     *                          partial_results is true.
      */
     Xapian::MSet get_mset(Xapian::doccount first,
                           Xapian::doccount maxitems,
@@ -206,7 +243,28 @@ class Matcher {
                           Xapian::Enquire::Internal::sort_setting sort_by,
                           bool sort_val_reverse,
                           double time_limit,
-                          const std::vector<opt_ptr_spy>& matchspies);
+                          const std::vector<opt_ptr_spy>& matchspies,
+                          bool partial_results,
+                          double partial_end_time);
+
+    /** Set functions to report progress and to stop the match early.
+     *
+     *  @param progress_    Called every so often during the match with the
+     *                      best results so far and an upper bound on the
+     *                      weight of any document not yet considered, with
+     *                      the time between calls doubling each time.  Only
+     *                      used when sorting by relevance, and not collapsing
+     *                      or using a percentage cut-off.
+     *  @param stop_        Called frequently during the match (independent
+     *                      of when progress is reported).  If it returns
+     *                      true, the match stops early.
+     */
+    void set_progress(std::function<void(const Xapian::MSet&, double)>
+                      progress_,
+                      std::function<bool()> stop_) {
+        progress = std::move(progress_);
+        stop = std::move(stop_);
+    }
 };
 
 #endif // XAPIAN_INCLUDED_MATCHER_H
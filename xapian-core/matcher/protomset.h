@@ -471,6 +471,56 @@ class ProtoMSet {
         min_weight_pending = true;
     }
 
+    /** Return the best results found so far, for reporting progress.
+     *
+     *  Only supported when not collapsing and without a percentage cut-off.
+     *
+     *  @param considered   Estimate of the fraction of the documents which
+     *                      have been considered so far (> 0.0).
+     *  @param upper_bound  Upper bound on the number of matches.
+     */
+    Xapian::MSet snapshot(double considered,
+                          Xapian::doccount upper_bound) const {
+        AssertRel(considered, >, 0.0);
+        std::vector<Result> items;
+        items.reserve(results.size());
+        for (auto& result : results) {
+            items.emplace_back(result.get_weight(), result.get_docid(),
+                               std::string(result.get_collapse_key()),
+                               result.get_collapse_count(),
+                               std::string(result.get_sort_key()));
+        }
+        std::sort(items.begin(), items.end(), mcmp);
+        if (first != 0) {
+            items.erase(items.begin(),
+                        items.begin() + std::min(first, size()));
+        }
+
+        double scale = 0.0;
+        if (max_weight != 0.0) {
+            scale = max_weight_subqs_matched / double(total_subqs);
+            scale /= max_weight;
+        }
+
+        // Scale up the number of matches we've seen assuming matches are
+        // spread evenly across the documents.
+        Xapian::doccount lower_bound = known_matching_docs;
+        upper_bound = std::max(upper_bound, lower_bound);
+        double est = std::min(lower_bound / considered, double(upper_bound));
+        auto estimated = std::max(Xapian::doccount(est + 0.5), lower_bound);
+        return Xapian::MSet(new Xapian::MSet::Internal(first,
+                                                       upper_bound,
+                                                       lower_bound,
+                                                       estimated,
+                                                       upper_bound,
+                                                       lower_bound,
+                                                       estimated,
+                                                       max_possible,
+                                                       max_weight,
+                                                       std::move(items),
+                                                       scale * 100.0));
+    }
+
     void finalise_percentages() {
         if (results.empty() || max_weight == 0.0)
             return;
@@ -1,7 +1,7 @@
 /** @file
  *  @brief SubMatch class for a remote database.
  */
-/* Copyright (C) 2006,2007,2009,2010,2011,2014,2015,2018,2019,2023 Olly Betts
+/* Copyright (C) 2006,2007,2009,2010,2011,2014,2015,2018,2019,2023,2026 Olly Betts
  * Copyright (C) 2007,2008 Lemur Consulting Ltd
  *
  * This program is free software; you can redistribute it and/or modify
@@ -71,14 +71,17 @@ class RemoteSubMatch {
      *  @param check_at_least The minimum number of items to check.
      *  @param sorter         KeyMaker for sort keys (NULL for none).
      *  @param total_stats    The total statistics for the collection.
+     *  @param stream         Ask for the best results so far to be sent
+     *                        while the match runs?
      */
     void start_match(Xapian::doccount first,
                      Xapian::doccount maxitems,
                      Xapian::doccount check_at_least,
                      const Xapian::KeyMaker* sorter,
-                     const Xapian::Weight::Internal& total_stats) {
+                     const Xapian::Weight::Internal& total_stats,
+                     bool stream = false) {
         db->send_global_stats(first, maxitems, check_at_least, sorter,
-                              total_stats);
+                              total_stats, stream);
     }
 
     typedef Xapian::Internal::opt_intrusive_ptr<Xapian::MatchSpy> opt_ptr_spy;
@@ -91,6 +94,35 @@ class RemoteSubMatch {
         return db->get_mset(matchspies);
     }
 
+    /** Get the next results streamed by the remote server.
+     *
+     *  @param[out] mset    The final MSet, or the best results so far.
+     *  @param[out] bound   If the results aren't final, set to an upper bound
+     *                      on the weight of any document not yet considered.
+     *
+     *  @return true if @a mset is the final MSet.
+     */
+    bool get_streamed_mset(Xapian::MSet& mset, double& bound) {
+        return db->get_streamed_mset(mset, bound);
+    }
+
+    /// Can we read the next results without waiting for input?
+    bool mset_reply_pending() const { return db->mset_reply_pending(); }
+
+    /** Read whatever input is available from the remote server.
+     *
+     *  @return false if the connection was closed, otherwise true.
+     */
+    bool read_mset_input(double end_time) {
+        return db->read_mset_input(end_time);
+    }
+
+    /// Stop waiting for results from the remote server.
+    void discard_mset() { db->discard_mset(); }
+
+    /// Return the number of documents in the remote database.
+    Xapian::doccount get_doccount() const { return db->get_doccount(); }
+
     /// Return the index of the corresponding Database shard.
     Xapian::doccount get_shard() const { return shard; }
 };
@@ -2,6 +2,8 @@ noinst_HEADERS +=\
 	net/progclient.h\
 	net/remoteconnection.h\
 	net/remoteprotocol.h\
+	net/remotereplicas.h\
+	net/remoteresultcache.h\
 	net/remoteserver.h\
 	net/remotetcpclient.h\
 	net/replicatetcpclient.h\
@@ -22,6 +24,8 @@ if BUILD_BACKEND_REMOTE
 lib_src +=\
 	net/progclient.cc\
 	net/remoteconnection.cc\
+	net/remotereplicas.cc\
+	net/remoteresultcache.cc\
 	net/remoteserver.cc\
 	net/remotetcpclient.cc\
 	net/replicatetcpclient.cc\
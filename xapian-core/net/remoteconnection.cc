@@ -32,6 +32,14 @@
 #else
 # include "safesysselect.h"
 #endif
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
+#if defined HAVE_SENDFILE && defined HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+# include <signal.h>
+# define USE_SENDFILE
+#endif
 
 #include <algorithm>
 #include <cerrno>
@@ -41,6 +49,7 @@
 #ifdef __WIN32__
 # include <type_traits>
 #endif
+#include <zlib.h>
 
 #include "debuglog.h"
 #include "fd.h"
@@ -56,6 +65,32 @@ using namespace std;
 
 static constexpr size_t CHUNKSIZE{4096};
 
+/** Don't try to compress messages smaller than this.
+ *
+ *  Small messages don't usually compress well, and the time spent on them
+ *  isn't worth the bandwidth saved.
+ */
+static constexpr size_t COMPRESS_MIN{1024};
+
+/** Flag set in the type byte of a compressed message.
+ *
+ *  Message and reply types are all less than this.
+ */
+static constexpr unsigned char COMPRESSED_FLAG{0x80};
+
+/** Size of the blocks send_file() splits a file into when compressing.
+ *
+ *  Each block is compressed separately, so the receiver only needs to buffer
+ *  one block at a time.
+ */
+static constexpr size_t COMPRESS_BLOCK_SIZE{65536};
+
+/// Flag set in the length of a block which is compressed.
+static constexpr unsigned BLOCK_COMPRESSED{1};
+
+/// Flag set in the length of the last block of a file.
+static constexpr unsigned BLOCK_LAST{2};
+
 [[noreturn]]
 static void
 throw_database_closed()
@@ -70,6 +105,50 @@ throw_timeout(const char* msg, const string& context)
     throw Xapian::NetworkTimeoutError(msg, context);
 }
 
+#if defined USE_SENDFILE && defined USE_MSG_NOSIGNAL
+/** Prevent SIGPIPE being delivered while sending with sendfile().
+ *
+ *  There's no equivalent of MSG_NOSIGNAL for sendfile(), so we block SIGPIPE
+ *  for this thread and discard any SIGPIPE generated while it's blocked.
+ */
+class SigpipeSuppressor {
+    bool active;
+
+    bool was_pending = true;
+
+    sigset_t old_mask;
+
+  public:
+    explicit SigpipeSuppressor(bool active_) : active(active_) {
+        if (!active) return;
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &mask, &old_mask);
+        sigset_t pending;
+        if (sigpending(&pending) == 0)
+            was_pending = (sigismember(&pending, SIGPIPE) == 1);
+    }
+
+    ~SigpipeSuppressor() {
+        if (!active) return;
+        int saved_errno = errno;
+        sigset_t pending;
+        if (!was_pending && sigpending(&pending) == 0 &&
+            sigismember(&pending, SIGPIPE) == 1) {
+            sigset_t mask;
+            sigemptyset(&mask);
+            sigaddset(&mask, SIGPIPE);
+            static const struct timespec zero_timeout = { 0, 0 };
+            while (sigtimedwait(&mask, NULL, &zero_timeout) < 0 &&
+                   errno == EINTR) { }
+        }
+        pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+        errno = saved_errno;
+    }
+};
+#endif
+
 #ifdef __WIN32__
 static inline void
 update_overlapped_offset(WSAOVERLAPPED & overlapped, DWORD n)
@@ -271,10 +350,81 @@ RemoteConnection::read_at_least(size_t min_len, double end_time)
     RETURN(true);
 }
 
-#ifndef __WIN32__
+#ifdef __WIN32__
+void
+RemoteConnection::send_all(string_view* parts, size_t n_parts,
+                           double end_time)
+{
+    HANDLE hout = fd_to_handle(fdout);
+    for (size_t i = 0; i != n_parts; ++i) {
+        string_view& part = parts[i];
+        while (!part.empty()) {
+            DWORD n;
+            BOOL ok = WriteFile(hout, part.data(), part.size(), &n,
+                                &overlapped);
+            if (!ok) {
+                int errcode = GetLastError();
+                if (errcode != ERROR_IO_PENDING)
+                    throw Xapian::NetworkError("write failed",
+                                               context, -errcode);
+                // Just wait for the data to be sent, or a timeout.
+                DWORD waitrc;
+                waitrc = WaitForSingleObject(overlapped.hEvent,
+                                             calc_read_wait_msecs(end_time));
+                if (waitrc != WAIT_OBJECT_0) {
+                    LOGLINE(REMOTE, "write: timeout has expired");
+                    throw_timeout("Timeout expired while trying to write",
+                                  context);
+                }
+                // Get the final result.
+                if (!GetOverlappedResult(hout, &overlapped, &n, FALSE))
+                    throw Xapian::NetworkError("Failed to get overlapped "
+                                               "result",
+                                               context, -int(GetLastError()));
+            }
+
+            // We must update the offset in the OVERLAPPED structure manually.
+            update_overlapped_offset(overlapped, n);
+
+            part.remove_prefix(n);
+        }
+    }
+}
+#else
 ssize_t
-RemoteConnection::send_or_write(const void* p, size_t len)
+RemoteConnection::send_or_write(const string_view* parts, size_t n_parts)
 {
+#ifdef HAVE_WRITEV
+    // We only ever send a few parts at once.
+    constexpr int MAX_IOV = 4;
+    struct iovec iov[MAX_IOV];
+    int iovcnt = 0;
+    for (size_t i = 0; i != n_parts && iovcnt != MAX_IOV; ++i) {
+        if (parts[i].empty()) continue;
+        iov[iovcnt].iov_base = const_cast<char*>(parts[i].data());
+        iov[iovcnt].iov_len = parts[i].size();
+        ++iovcnt;
+    }
+# ifdef USE_MSG_NOSIGNAL
+    if (send_flags) {
+        struct msghdr msg = {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        ssize_t n = sendmsg(fdout, &msg, send_flags);
+        if (usual(n >= 0 || errno != ENOTSOCK)) return n;
+        // In some testcases in the testsuite and in xapian-progsrv (in some
+        // cases) fdout won't be a socket.  Clear send_flags so we only try
+        // sendmsg() once in this case.
+        send_flags = 0;
+    }
+# endif
+    return writev(fdout, iov, iovcnt);
+#else
+    // Without writev() we just write the first non-empty part.
+    (void)n_parts;
+    while (parts->empty()) ++parts;
+    const char* p = parts->data();
+    size_t len = parts->size();
 # ifdef USE_MSG_NOSIGNAL
     if (send_flags) {
         ssize_t n = send(fdout, p, len, send_flags);
@@ -286,78 +436,85 @@ RemoteConnection::send_or_write(const void* p, size_t len)
     }
 # endif
     return write(fdout, p, len);
-}
 #endif
+}
 
 void
-RemoteConnection::send_message(char type, string_view message, double end_time)
+RemoteConnection::wait_for_output(double end_time)
 {
-    LOGCALL_VOID(REMOTE, "RemoteConnection::send_message", type | message | end_time);
-    if (fdout == -1)
-        throw_database_closed();
-
-    string header;
-    header += type;
-    pack_uint(header, message.size());
-    string_view header_view = header;
-
-#ifdef __WIN32__
-    HANDLE hout = fd_to_handle(fdout);
-    const string_view* str = &header_view;
+    double now = RealTime::now();
+    double time_diff = end_time - now;
+    if (time_diff < 0) {
+        LOGLINE(REMOTE, "write: timeout has expired");
+        throw_timeout("Timeout expired while trying to write", context);
+    }
 
-    size_t count = 0;
-    while (true) {
-        DWORD n;
-        BOOL ok = WriteFile(hout, str->data() + count, str->size() - count, &n, &overlapped);
-        if (!ok) {
-            int errcode = GetLastError();
-            if (errcode != ERROR_IO_PENDING)
-                throw Xapian::NetworkError("write failed", context, -errcode);
-            // Just wait for the data to be sent, or a timeout.
-            DWORD waitrc;
-            waitrc = WaitForSingleObject(overlapped.hEvent, calc_read_wait_msecs(end_time));
-            if (waitrc != WAIT_OBJECT_0) {
-                LOGLINE(REMOTE, "write: timeout has expired");
-                throw_timeout("Timeout expired while trying to write", context);
-            }
-            // Get the final result.
-            if (!GetOverlappedResult(hout, &overlapped, &n, FALSE))
-                throw Xapian::NetworkError("Failed to get overlapped result",
-                                           context, -int(GetLastError()));
-        }
+    // Wait until there is space or the timeout is reached.
+# ifdef HAVE_POLL
+    struct pollfd fds;
+    fds.fd = fdout;
+    fds.events = POLLOUT;
+    int result = poll(&fds, 1, int(time_diff * 1000));
+#  define POLLSELECT "poll"
+# else
+    if (fdout >= FD_SETSIZE) {
+        // We can't block with a timeout, so just sleep and retry.
+        RealTime::sleep(now + min(0.001, time_diff / 4));
+        return;
+    }
 
-        count += n;
+    fd_set fdset;
+    FD_ZERO(&fdset);
+    FD_SET(fdout, &fdset);
 
-        // We must update the offset in the OVERLAPPED structure manually.
-        update_overlapped_offset(overlapped, n);
+    struct timeval tv;
+    RealTime::to_timeval(time_diff, &tv);
+    int result = select(fdout + 1, 0, &fdset, 0, &tv);
+#  define POLLSELECT "select"
+# endif
 
-        if (count == str->size()) {
-            if (str == &message || message.empty()) return;
-            str = &message;
-            count = 0;
+    if (result < 0) {
+        if (errno == EINTR || errno == EAGAIN) {
+            // EINTR/EAGAIN means select was interrupted by a signal.
+            // We could just retry the poll/select, but it's easier to just
+            // retry the write.
+            return;
         }
-    }
-#else
-    // If there's no end_time, just use blocking I/O.
-    if (fcntl(fdout, F_SETFL, (end_time != 0.0) ? O_NONBLOCK : 0) < 0) {
-        throw Xapian::NetworkError("Failed to set fdout non-blocking-ness",
+        throw Xapian::NetworkError(POLLSELECT " failed during write",
                                    context, errno);
+# undef POLLSELECT
     }
 
-    const string_view* str = &header_view;
+    if (result == 0)
+        throw_timeout("Timeout expired while trying to write", context);
+}
 
-    size_t count = 0;
+void
+RemoteConnection::send_all(string_view* parts, size_t n_parts,
+                           double end_time)
+{
     while (true) {
+        while (n_parts && parts->empty()) {
+            ++parts;
+            --n_parts;
+        }
+        if (n_parts == 0) return;
+
         // We've set write to non-blocking, so just try writing as there
         // will usually be space.
-        ssize_t n = send_or_write(str->data() + count, str->size() - count);
+        ssize_t n = send_or_write(parts, n_parts);
 
         if (n >= 0) {
-            count += n;
-            if (count == str->size()) {
-                if (str == &message || message.empty()) return;
-                str = &message;
-                count = 0;
+            size_t written = n;
+            while (written) {
+                if (parts->empty()) {
+                    ++parts;
+                    --n_parts;
+                    continue;
+                }
+                size_t c = min(written, parts->size());
+                parts->remove_prefix(c);
+                written -= c;
             }
             continue;
         }
@@ -368,53 +525,58 @@ RemoteConnection::send_message(char type, string_view message, double end_time)
         if (errno != EAGAIN)
             throw Xapian::NetworkError("write failed", context, errno);
 
-        double now = RealTime::now();
-        double time_diff = end_time - now;
-        if (time_diff < 0) {
-            LOGLINE(REMOTE, "write: timeout has expired");
-            throw_timeout("Timeout expired while trying to write", context);
-        }
-
-        // Wait until there is space or the timeout is reached.
-# ifdef HAVE_POLL
-        struct pollfd fds;
-        fds.fd = fdout;
-        fds.events = POLLOUT;
-        int result = poll(&fds, 1, int(time_diff * 1000));
-#  define POLLSELECT "poll"
-# else
-        if (fdout >= FD_SETSIZE) {
-            // We can't block with a timeout, so just sleep and retry.
-            RealTime::sleep(now + min(0.001, time_diff / 4));
-            continue;
-        }
-
-        fd_set fdset;
-        FD_ZERO(&fdset);
-        FD_SET(fdout, &fdset);
+        wait_for_output(end_time);
+    }
+}
+#endif
 
-        struct timeval tv;
-        RealTime::to_timeval(time_diff, &tv);
-        int result = select(fdout + 1, 0, &fdset, 0, &tv);
-#  define POLLSELECT "select"
-# endif
+void
+RemoteConnection::send_message(char type,
+                               string_view prefix,
+                               string_view message,
+                               double end_time)
+{
+    LOGCALL_VOID(REMOTE, "RemoteConnection::send_message", type | prefix | message | end_time);
+    if (fdout == -1)
+        throw_database_closed();
 
-        if (result < 0) {
-            if (errno == EINTR || errno == EAGAIN) {
-                // EINTR/EAGAIN means select was interrupted by a signal.
-                // We could just retry the poll/select, but it's easier to just
-                // retry the write.
-                continue;
-            }
-            throw Xapian::NetworkError(POLLSELECT " failed during write",
-                                       context, errno);
-# undef POLLSELECT
+    size_t size = prefix.size() + message.size();
+    string uncompressed;
+    if (compressor && size >= COMPRESS_MIN && size <= size_t(INT_MAX)) {
+        const char* data = message.data();
+        if (!prefix.empty()) {
+            // We need the data to compress in a single buffer.
+            uncompressed.reserve(size);
+            uncompressed = prefix;
+            uncompressed += message;
+            data = uncompressed.data();
         }
+        size_t len = size;
+        const char* p = compressor->compress(data, &len);
+        if (p) {
+            // Compression made the message smaller.
+            type = char(static_cast<unsigned char>(type) | COMPRESSED_FLAG);
+            prefix = string_view();
+            message = string_view(p, len);
+            size = len;
+        }
+    }
 
-        if (result == 0)
-            throw_timeout("Timeout expired while trying to write", context);
+    string header;
+    header += type;
+    pack_uint(header, size);
+
+#ifndef __WIN32__
+    // If there's no end_time, just use blocking I/O.
+    if (fcntl(fdout, F_SETFL, (end_time != 0.0) ? O_NONBLOCK : 0) < 0) {
+        throw Xapian::NetworkError("Failed to set fdout non-blocking-ness",
+                                   context, errno);
     }
 #endif
+
+    // Send the header, prefix and message without copying them together.
+    string_view parts[3] = { header, prefix, message };
+    send_all(parts, 3, end_time);
 }
 
 void
@@ -427,146 +589,130 @@ RemoteConnection::send_file(char type, int fd, double end_time)
     auto size = file_size(fd);
     if (errno)
         throw Xapian::NetworkError("Couldn't stat file to send", errno);
-    // FIXME: Use sendfile() or similar if available?
 
-    char buf[CHUNKSIZE];
-    buf[0] = type;
-    size_t c = 1;
-    {
-        string enc_size;
-        pack_uint(enc_size, size);
-        c += enc_size.size();
-        // An encoded length should be just a few bytes.
-        AssertRel(c, <=, sizeof(buf));
-        memcpy(buf + 1, enc_size.data(), enc_size.size());
-    }
-
-#ifdef __WIN32__
-    HANDLE hout = fd_to_handle(fdout);
-    size_t count = 0;
-    while (true) {
-        DWORD n;
-        BOOL ok = WriteFile(hout, buf + count, c - count, &n, &overlapped);
-        if (!ok) {
-            int errcode = GetLastError();
-            if (errcode != ERROR_IO_PENDING)
-                throw Xapian::NetworkError("write failed", context, -errcode);
-            // Just wait for the data to be sent, or a timeout.
-            DWORD waitrc;
-            waitrc = WaitForSingleObject(overlapped.hEvent, calc_read_wait_msecs(end_time));
-            if (waitrc != WAIT_OBJECT_0) {
-                LOGLINE(REMOTE, "write: timeout has expired");
-                throw_timeout("Timeout expired while trying to write", context);
-            }
-            // Get the final result.
-            if (!GetOverlappedResult(hout, &overlapped, &n, FALSE))
-                throw Xapian::NetworkError("Failed to get overlapped result",
-                                           context, -int(GetLastError()));
-        }
-
-        count += n;
-
-        // We must update the offset in the OVERLAPPED structure manually.
-        update_overlapped_offset(overlapped, n);
-
-        if (count == c) {
-            if (size == 0) return;
-
-            ssize_t res;
-            do {
-                res = read(fd, buf, sizeof(buf));
-            } while (res < 0 && errno == EINTR);
-            if (res < 0) throw Xapian::NetworkError("read failed", errno);
-            c = size_t(res);
+    string header;
+    header += type;
+    pack_uint(header, size);
+    string_view part = header;
 
-            size -= c;
-            count = 0;
-        }
-    }
-#else
+#ifndef __WIN32__
     // If there's no end_time, just use blocking I/O.
     if (fcntl(fdout, F_SETFL, (end_time != 0.0) ? O_NONBLOCK : 0) < 0) {
         throw Xapian::NetworkError("Failed to set fdout non-blocking-ness",
                                    context, errno);
     }
+#endif
 
-    size_t count = 0;
-    while (true) {
-        // We've set write to non-blocking, so just try writing as there
-        // will usually be space.
-        ssize_t n = send_or_write(buf + count, c - count);
-
-        if (n >= 0) {
-            count += n;
-            if (count == c) {
-                if (size == 0) return;
-
-                ssize_t res;
-                do {
-                    res = read(fd, buf, sizeof(buf));
-                } while (res < 0 && errno == EINTR);
-                if (res < 0) throw Xapian::NetworkError("read failed", errno);
-                c = size_t(res);
-
-                size -= c;
-                count = 0;
+    if (compressor) {
+        // A compressed message with no data is followed by the file data in
+        // blocks, each of which is sent compressed if that makes it smaller.
+        // The length of each block is sent shifted left two bits with
+        // BLOCK_COMPRESSED and BLOCK_LAST flags in the low bits, and the last
+        // block is followed by a CRC32 of the uncompressed data so the
+        // receiver can check the file arrived intact.
+        header.resize(1);
+        header[0] = char(static_cast<unsigned char>(type) | COMPRESSED_FLAG);
+        pack_uint(header, 0u);
+        part = header;
+        send_all(&part, 1, end_time);
+
+        unique_ptr<char[]> buf(new char[COMPRESS_BLOCK_SIZE]);
+        uLong crc = crc32(0L, Z_NULL, 0);
+        do {
+            size_t n = size_t(min(size, decltype(size)(COMPRESS_BLOCK_SIZE)));
+            size_t got = 0;
+            while (got < n) {
+                ssize_t res = read(fd, buf.get() + got, n - got);
+                if (res < 0) {
+                    if (errno == EINTR) continue;
+                    throw Xapian::NetworkError("read failed", errno);
+                }
+                if (res == 0)
+                    throw Xapian::NetworkError("File to send was truncated",
+                                               context);
+                got += res;
             }
-            continue;
-        }
-
-        LOGLINE(REMOTE, "write gave errno = " << errno);
-        if (errno == EINTR) continue;
-
-        if (errno != EAGAIN)
-            throw Xapian::NetworkError("write failed", context, errno);
-
-        double now = RealTime::now();
-        double time_diff = end_time - now;
-        if (time_diff < 0) {
-            LOGLINE(REMOTE, "write: timeout has expired");
-            throw_timeout("Timeout expired while trying to write", context);
-        }
-
-        // Wait until there is space or the timeout is reached.
-# ifdef HAVE_POLL
-        struct pollfd fds;
-        fds.fd = fdout;
-        fds.events = POLLOUT;
-        int result = poll(&fds, 1, int(time_diff * 1000));
-#  define POLLSELECT "poll"
-# else
-        if (fdout >= FD_SETSIZE) {
-            // We can't block with a timeout, so just sleep and retry.
-            RealTime::sleep(now + min(0.001, time_diff / 4));
-            continue;
-        }
+            size -= n;
+            crc = crc32(crc, reinterpret_cast<const Bytef*>(buf.get()),
+                        uInt(n));
+
+            string_view data(buf.get(), n);
+            uint_least64_t code = 0;
+            if (n >= COMPRESS_MIN) {
+                size_t len = n;
+                const char* p = compressor->compress(buf.get(), &len);
+                if (p) {
+                    data = string_view(p, len);
+                    code = BLOCK_COMPRESSED;
+                }
+            }
+            string block_header, trailer;
+            if (size == 0) {
+                code |= BLOCK_LAST;
+                pack_uint(trailer, uint32_t(crc));
+            }
+            pack_uint(block_header, (uint_least64_t(data.size()) << 2) | code);
+            string_view parts[3] = { block_header, data, trailer };
+            send_all(parts, 3, end_time);
+        } while (size);
+        return;
+    }
 
-        fd_set fdset;
-        FD_ZERO(&fdset);
-        FD_SET(fdout, &fdset);
+#ifdef USE_SENDFILE
+    send_all(&part, 1, end_time);
+    if (size == 0) return;
 
-        struct timeval tv;
-        RealTime::to_timeval(time_diff, &tv);
-        int result = select(fdout + 1, 0, &fdset, 0, &tv);
-#  define POLLSELECT "select"
+    {
+# ifdef USE_MSG_NOSIGNAL
+        SigpipeSuppressor suppress_sigpipe(send_flags != 0);
 # endif
+        // Have the kernel copy the file data to fdout, which avoids copying
+        // it to and from userspace.
+        bool sent_any = false;
+        while (true) {
+            ssize_t n = sendfile(fdout, fd, NULL, size);
+            if (n > 0) {
+                size -= n;
+                if (size == 0) return;
+                sent_any = true;
+                continue;
+            }
+            if (n == 0)
+                throw Xapian::NetworkError("File to send was truncated",
+                                           context);
 
-        if (result < 0) {
-            if (errno == EINTR || errno == EAGAIN) {
-                // EINTR/EAGAIN means select was interrupted by a signal.
-                // We could just retry the poll/select, but it's easier to just
-                // retry the write.
+            LOGLINE(REMOTE, "sendfile gave errno = " << errno);
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) {
+                wait_for_output(end_time);
                 continue;
             }
-            throw Xapian::NetworkError(POLLSELECT " failed during write",
-                                       context, errno);
-# undef POLLSELECT
+            // sendfile() doesn't support all types of file, so fall back to
+            // read() and write() if it fails that way before we've sent
+            // anything.
+            if (sent_any || (errno != EINVAL && errno != ENOSYS))
+                throw Xapian::NetworkError("sendfile failed", context, errno);
+            break;
         }
-
-        if (result == 0)
-            throw_timeout("Timeout expired while trying to write", context);
     }
 #endif
+
+    char buf[CHUNKSIZE];
+    while (true) {
+        send_all(&part, 1, end_time);
+        if (size == 0) return;
+
+        ssize_t res;
+        do {
+            res = read(fd, buf, sizeof(buf));
+        } while (res < 0 && errno == EINTR);
+        if (res < 0) throw Xapian::NetworkError("read failed", errno);
+        if (res == 0)
+            throw Xapian::NetworkError("File to send was truncated", context);
+        size_t c = min(size_t(res), size_t(size));
+        part = string_view(buf, c);
+        size -= c;
+    }
 }
 
 int
@@ -579,7 +725,7 @@ RemoteConnection::sniff_next_message_type(double end_time)
     if (!read_at_least(1, end_time))
         RETURN(-1);
     unsigned char type = buffer[0];
-    RETURN(type);
+    RETURN(type & ~COMPRESSED_FLAG);
 }
 
 int
@@ -600,6 +746,10 @@ RemoteConnection::get_message(string &result, double end_time)
         result.assign(buffer.data() + 2, len);
         unsigned char type = buffer[0];
         buffer.erase(0, len + 2);
+        if (type & COMPRESSED_FLAG) {
+            decompress_message(result);
+            type &= ~COMPRESSED_FLAG;
+        }
         RETURN(type);
     }
 
@@ -619,9 +769,172 @@ RemoteConnection::get_message(string &result, double end_time)
     result.assign(buffer.data() + header_len, len);
     unsigned char type = buffer[0];
     buffer.erase(0, header_len + len);
+    if (type & COMPRESSED_FLAG) {
+        decompress_message(result);
+        type &= ~COMPRESSED_FLAG;
+    }
     RETURN(type);
 }
 
+void
+RemoteConnection::decompress_message(string& message)
+{
+    string uncompressed;
+    decompress_append(message.data(), message.size(), uncompressed);
+    message = std::move(uncompressed);
+}
+
+void
+RemoteConnection::decompress_append(const char* p, size_t len, string& out)
+{
+    if (len > size_t(INT_MAX)) {
+        throw Xapian::NetworkError("Compressed message too large", context);
+    }
+    if (!decompressor) decompressor.reset(new CompressionStream);
+    try {
+        decompressor->decompress_start();
+        if (!decompressor->decompress_chunk(p, int(len), out)) {
+            throw Xapian::NetworkError("Truncated compressed message",
+                                       context);
+        }
+    } catch (const Xapian::DatabaseError& e) {
+        throw Xapian::NetworkError("Bad compressed message: " + e.get_msg(),
+                                   context);
+    }
+}
+
+void
+RemoteConnection::set_compression(Compression::codec codec)
+{
+    compressor.reset(new CompressionStream);
+    compressor->set_codec(codec);
+}
+
+void
+RemoteConnection::swap(RemoteConnection& o)
+{
+    std::swap(fdin, o.fdin);
+    std::swap(fdout, o.fdout);
+#ifdef USE_MSG_NOSIGNAL
+    std::swap(send_flags, o.send_flags);
+#endif
+    buffer.swap(o.buffer);
+    std::swap(chunked_data_left, o.chunked_data_left);
+    std::swap(chunked_compressed, o.chunked_compressed);
+    std::swap(chunked_in_blocks, o.chunked_in_blocks);
+    std::swap(chunked_crc, o.chunked_crc);
+    compressor.swap(o.compressor);
+    decompressor.swap(o.decompressor);
+    context.swap(o.context);
+}
+
+int
+RemoteConnection::wait_for_input(const RemoteConnection& a,
+                                 const RemoteConnection* b,
+                                 double end_time)
+{
+    LOGCALL_STATIC(REMOTE, int, "RemoteConnection::wait_for_input", a.fdin | b | end_time);
+
+    if (a.input_pending()) RETURN(0);
+    if (b && b->input_pending()) RETURN(1);
+#ifdef __WIN32__
+    // We use overlapped IO on Windows, so just report that there's input for
+    // the first connection, and the caller will block reading from it.
+    (void)end_time;
+    RETURN(0);
+#else
+    while (true) {
+        int wait_msecs = -1;
+        if (end_time != 0.0) {
+            double time_diff = end_time - RealTime::now();
+            if (time_diff < 0) RETURN(-1);
+            wait_msecs = int(time_diff * 1000);
+        }
+# ifdef HAVE_POLL
+        struct pollfd fds[2];
+        fds[0].fd = a.fdin;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        nfds_t nfds = 1;
+        if (b) {
+            fds[1].fd = b->fdin;
+            fds[1].events = POLLIN;
+            fds[1].revents = 0;
+            nfds = 2;
+        }
+        int result = poll(fds, nfds, wait_msecs);
+        if (result > 0) RETURN(fds[0].revents ? 0 : 1);
+#  define POLLSELECT "poll"
+# else
+        int nfds = b ? max(a.fdin, b->fdin) + 1 : a.fdin + 1;
+        if (nfds > FD_SETSIZE) {
+            // We can't wait using select(), so report that there's input for
+            // the first connection, and the caller will block reading from it.
+            RETURN(0);
+        }
+        fd_set fdset;
+        FD_ZERO(&fdset);
+        FD_SET(a.fdin, &fdset);
+        if (b) FD_SET(b->fdin, &fdset);
+
+        struct timeval tv;
+        struct timeval* tv_ptr = NULL;
+        if (wait_msecs >= 0) {
+            RealTime::to_timeval(wait_msecs * 1e-3, &tv);
+            tv_ptr = &tv;
+        }
+        int result = select(nfds, &fdset, 0, 0, tv_ptr);
+        if (result > 0) RETURN(FD_ISSET(a.fdin, &fdset) ? 0 : 1);
+#  define POLLSELECT "select"
+# endif
+        // If result is 0, we loop back to check if end_time has been reached.
+        if (result < 0 && errno != EINTR && errno != EAGAIN) {
+            throw Xapian::NetworkError(POLLSELECT " failed waiting for input",
+                                       a.context, errno);
+        }
+# undef POLLSELECT
+    }
+#endif
+}
+
+bool
+RemoteConnection::message_pending() const
+{
+    LOGCALL(REMOTE, bool, "RemoteConnection::message_pending", NO_ARGS);
+    if (buffer.size() < 2) RETURN(false);
+    const char* p = buffer.data() + 1;
+    const char* p_end = buffer.data() + buffer.size();
+    size_t len;
+    // If we only have part of the length, unpack_uint() will fail.
+    if (!unpack_uint(&p, p_end, &len)) RETURN(false);
+    RETURN(size_t(p_end - p) >= len);
+}
+
+bool
+RemoteConnection::input_ready() const
+{
+    LOGCALL(REMOTE, bool, "RemoteConnection::input_ready", NO_ARGS);
+    if (input_pending()) RETURN(true);
+#ifdef __WIN32__
+    RETURN(false);
+#elif defined HAVE_POLL
+    struct pollfd fds;
+    fds.fd = fdin;
+    fds.events = POLLIN;
+    fds.revents = 0;
+    RETURN(poll(&fds, 1, 0) > 0);
+#else
+    if (fdin >= FD_SETSIZE) RETURN(false);
+    fd_set fdset;
+    FD_ZERO(&fdset);
+    FD_SET(fdin, &fdset);
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = 0;
+    RETURN(select(fdin + 1, &fdset, 0, 0, &tv) > 0);
+#endif
+}
+
 int
 RemoteConnection::get_message_chunked(double end_time)
 {
@@ -635,30 +948,100 @@ RemoteConnection::get_message_chunked(double end_time)
     // This code assume things about the pack_uint() encoding in order to
     // handle partial reads.
     uint_least64_t len = static_cast<unsigned char>(buffer[1]);
-    if (len < 128) {
-        chunked_data_left = len;
-        char type = buffer[0];
-        buffer.erase(0, 2);
-        RETURN(type);
-    }
-
-    // We know the message payload is at least 128 bytes of data, and if we
-    // read that much we'll definitely have the whole of the length.
-    if (!read_at_least(128 + 2, end_time))
-        RETURN(-1);
-    const char* p = buffer.data();
-    const char* p_end = p + buffer.size();
-    ++p;
-    if (!unpack_uint(&p, p_end, &len)) {
-        RETURN(-1);
+    size_t header_len = 2;
+    if (len >= 128) {
+        // We know the message payload is at least 128 bytes of data, and if
+        // we read that much we'll definitely have the whole of the length.
+        if (!read_at_least(128 + 2, end_time))
+            RETURN(-1);
+        const char* p = buffer.data();
+        const char* p_end = p + buffer.size();
+        ++p;
+        if (!unpack_uint(&p, p_end, &len)) {
+            RETURN(-1);
+        }
+        header_len = (p - buffer.data());
     }
     chunked_data_left = len;
-    size_t header_len = (p - buffer.data());
     unsigned char type = buffer[0];
     buffer.erase(0, header_len);
+    chunked_compressed = (type & COMPRESSED_FLAG);
+    if (chunked_compressed) {
+        type &= ~COMPRESSED_FLAG;
+        // A compressed message with no data is a file sent in blocks.
+        chunked_in_blocks = (len == 0);
+        chunked_crc = uint32_t(crc32(0L, Z_NULL, 0));
+    }
     RETURN(type);
 }
 
+bool
+RemoteConnection::read_uint(uint_least64_t& value, double end_time)
+{
+    size_t min_len = 1;
+    while (true) {
+        if (!read_at_least(min_len, end_time))
+            return false;
+        const char* p = buffer.data();
+        if (unpack_uint(&p, p + buffer.size(), &value)) {
+            buffer.erase(0, p - buffer.data());
+            return true;
+        }
+        if (p) {
+            throw Xapian::NetworkError("Bad encoded integer", context);
+        }
+        // We need more data.
+        min_len = buffer.size() + 1;
+    }
+}
+
+bool
+RemoteConnection::read_compressed_block(string& result, double end_time)
+{
+    uint_least64_t len = chunked_data_left;
+    bool compressed = true;
+    bool last = true;
+    if (chunked_in_blocks) {
+        uint_least64_t code;
+        if (!read_uint(code, end_time))
+            return false;
+        len = code >> 2;
+        compressed = (code & BLOCK_COMPRESSED);
+        last = (code & BLOCK_LAST);
+    }
+    if (len > size_t(INT_MAX)) {
+        throw Xapian::NetworkError("Compressed block too large", context);
+    }
+    if (!read_at_least(len, end_time))
+        return false;
+
+    size_t offset = result.size();
+    if (compressed) {
+        decompress_append(buffer.data(), len, result);
+    } else {
+        result.append(buffer, 0, len);
+    }
+    buffer.erase(0, len);
+    chunked_data_left = 0;
+
+    if (chunked_in_blocks) {
+        auto data = reinterpret_cast<const Bytef*>(result.data() + offset);
+        chunked_crc = uint32_t(crc32(chunked_crc, data,
+                                     uInt(result.size() - offset)));
+        if (last) {
+            uint_least64_t crc;
+            if (!read_uint(crc, end_time))
+                return false;
+            if (crc != chunked_crc) {
+                throw Xapian::NetworkError("Checksum of received data doesn't "
+                                           "match", context);
+            }
+        }
+    }
+    if (last) chunked_compressed = false;
+    return true;
+}
+
 int
 RemoteConnection::get_message_chunk(string &result, size_t at_least,
                                     double end_time)
@@ -668,6 +1051,18 @@ RemoteConnection::get_message_chunk(string &result, size_t at_least,
         throw_database_closed();
 
     if (at_least <= result.size()) RETURN(true);
+
+    if (chunked_compressed) {
+        // We have to decompress whole blocks, so we may return more than
+        // at_least bytes.
+        do {
+            if (!read_compressed_block(result, end_time))
+                RETURN(-1);
+            if (result.size() >= at_least) RETURN(1);
+        } while (chunked_compressed);
+        RETURN(0);
+    }
+
     at_least -= result.size();
 
     bool read_enough = (at_least <= chunked_data_left);
@@ -712,6 +1107,18 @@ RemoteConnection::receive_file(const string &file, double end_time)
         throw Xapian::NetworkError("Couldn't open file for writing: " + file, errno);
 
     int type = get_message_chunked(end_time);
+    if (chunked_compressed) {
+        string chunk;
+        int res;
+        do {
+            res = get_message_chunk(chunk, CHUNKSIZE, end_time);
+            if (res < 0)
+                RETURN(-1);
+            write_all(fd, chunk.data(), chunk.size());
+            chunk.resize(0);
+        } while (res);
+        RETURN(type);
+    }
     do {
         size_t min_read = min(chunked_data_left, CHUNKSIZE);
         if (!read_at_least(min_read, end_time))
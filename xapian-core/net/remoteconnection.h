@@ -21,8 +21,11 @@
 #ifndef XAPIAN_INCLUDED_REMOTECONNECTION_H
 #define XAPIAN_INCLUDED_REMOTECONNECTION_H
 
+#include <cstdint>
+#include <memory>
 #include <string>
 
+#include "compression_stream.h"
 #include "remoteprotocol.h"
 
 #ifdef __WIN32__
@@ -93,6 +96,62 @@ class RemoteConnection {
     /// Remaining bytes of message data still to come over fdin for a chunked read.
     size_t chunked_data_left;
 
+    /// True if compressed data for a chunked read is still to come.
+    bool chunked_compressed = false;
+
+    /// True if the message for a chunked read was sent in blocks by send_file().
+    bool chunked_in_blocks = false;
+
+    /// Checksum of the data so far from a message sent in blocks.
+    uint32_t chunked_crc = 0;
+
+    /// Compressor for messages we send, or NULL if we're not compressing.
+    std::unique_ptr<CompressionStream> compressor;
+
+    /// Decompressor for messages we receive (created when first needed).
+    std::unique_ptr<CompressionStream> decompressor;
+
+    /** Decompress a compressed message in place.
+     *
+     *  @param[in,out] message  The message data.
+     */
+    void decompress_message(std::string& message);
+
+    /** Decompress data and append it to a string.
+     *
+     *  @param p        The compressed data.
+     *  @param len      The length of the compressed data.
+     *  @param[in,out] out  The string to append the decompressed data to.
+     */
+    void decompress_append(const char* p, size_t len, std::string& out);
+
+    /** Read an unsigned integer encoded with pack_uint() from fdin.
+     *
+     *  @param[out] value   The integer read.
+     *  @param end_time     If this time is reached, then a timeout
+     *                      exception will be thrown.  If (end_time == 0.0),
+     *                      then keep trying indefinitely.
+     *
+     *  @return false on EOF, otherwise true.
+     */
+    bool read_uint(uint_least64_t& value, double end_time);
+
+    /** Read the next compressed block of a chunked read.
+     *
+     *  A compressed message sent by send_message() is handled as a single
+     *  block.  After the last block of a message sent in blocks by
+     *  send_file(), the checksum is read and checked.
+     *
+     *  @param[in,out] result   The decompressed data is appended to this.
+     *  @param end_time         If this time is reached, then a timeout
+     *                          exception will be thrown.  If
+     *                          (end_time == 0.0), then keep trying
+     *                          indefinitely.
+     *
+     *  @return false on EOF, otherwise true.
+     */
+    bool read_compressed_block(std::string& result, double end_time);
+
     /** Read until there are at least min_len bytes in buffer.
      *
      *  If for some reason this isn't possible, returns false upon EOF and
@@ -122,10 +181,37 @@ class RemoteConnection {
      */
     DWORD calc_read_wait_msecs(double end_time);
 #else
-    /** Helper which calls send() or write(). */
-    ssize_t send_or_write(const void* p, size_t n);
+    /** Helper which calls sendmsg() or writev() (or send() or write()).
+     *
+     *  Empty parts are skipped.
+     *
+     *  @param parts    Data to write.
+     *  @param n_parts  Number of entries in @a parts.
+     *
+     *  @return The number of bytes written, or -1 on error.
+     */
+    ssize_t send_or_write(const std::string_view* parts, size_t n_parts);
+
+    /** Wait until there's space to write to fdout.
+     *
+     *  If end_time is reached, a timeout exception is thrown.
+     */
+    void wait_for_output(double end_time);
 #endif
 
+    /** Write all of a sequence of data.
+     *
+     *  The parts are written without copying them into a single buffer.
+     *
+     *  @param parts    Data to write.  The entries are updated as data is
+     *                  written.
+     *  @param n_parts  Number of entries in @a parts.
+     *  @param end_time If this time is reached, then a timeout exception
+     *                  will be thrown.  If (end_time == 0.0) then the
+     *                  operation will never timeout.
+     */
+    void send_all(std::string_view* parts, size_t n_parts, double end_time);
+
   protected:
     /** The context to report with errors.
      *
@@ -146,6 +232,43 @@ class RemoteConnection {
     /** Return the underlying fd this remote connection reads from. */
     int get_read_fd() const { return fdin; }
 
+    /** Swap the connection with another.
+     *
+     *  Everything specific to the connection is swapped (the fds, any
+     *  buffered input, compression, and the context).
+     */
+    void swap(RemoteConnection& o);
+
+    /** Wait until there's input to read on one of two connections.
+     *
+     *  @param a            The first connection.
+     *  @param b            The second connection, or NULL to just wait for
+     *                      @a a.
+     *  @param end_time     Give up at this time.  If (end_time == 0.0) then
+     *                      wait indefinitely.
+     *
+     *  @return 0 if there's input for @a a, 1 if there's input for @a b (but
+     *          not @a a), or -1 if end_time is reached.  Input here includes
+     *          EOF or an error condition, as then reading won't block.
+     */
+    static int wait_for_input(const RemoteConnection& a,
+                              const RemoteConnection* b,
+                              double end_time);
+
+    /** Compress messages we send when it's worthwhile.
+     *
+     *  Only messages sent by send_message() which are at least a threshold
+     *  size are compressed, and they're only sent compressed if that makes
+     *  them smaller.  Files sent by send_file() are sent as a sequence of
+     *  blocks, each compressed where that makes it smaller, followed by a
+     *  checksum.  Compressed messages are received transparently by
+     *  get_message(), get_message_chunked() and receive_file() (which also
+     *  check the checksum), but the other end must support @a codec.
+     *
+     *  @param codec  The codec to compress with.
+     */
+    void set_compression(Compression::codec codec);
+
     /** Check what the next message type is.
      *
      *  This must not be called after a call to get_message_chunked() until
@@ -235,9 +358,32 @@ class RemoteConnection {
      *                      will be thrown.  If (end_time == 0.0) then the
      *                      operation will never timeout.
      */
-    void send_message(char type, std::string_view s, double end_time);
+    void send_message(char type, std::string_view s, double end_time) {
+        send_message(type, std::string_view(), s, end_time);
+    }
+
+    /** Send a message with a prefix.
+     *
+     *  This is the same as send_message(type, prefix + s, end_time) but
+     *  avoids copying @a s.
+     *
+     *  @param type         Message type code.
+     *  @param prefix       Data to send before @a s.
+     *  @param s            Message data.
+     *  @param end_time     If this time is reached, then a timeout exception
+     *                      will be thrown.  If (end_time == 0.0) then the
+     *                      operation will never timeout.
+     */
+    void send_message(char type,
+                      std::string_view prefix,
+                      std::string_view s,
+                      double end_time);
 
     /** Send the contents of a file as a message.
+     *
+     *  If set_compression() has been called, the file is sent in blocks as
+     *  described there, and the message must be read with
+     *  get_message_chunked() or receive_file().
      *
      *  @param type         Message type code.
      *  @param fd           File containing the message data.
@@ -259,6 +405,41 @@ class RemoteConnection {
 
     /** Return the context to report with errors. */
     const std::string& get_context() const { return context; }
+
+    /** Is there already input in our buffer waiting to be processed?
+     *
+     *  If so, waiting for fdin to become readable before calling
+     *  get_message() may wait indefinitely.
+     */
+    bool input_pending() const { return !buffer.empty(); }
+
+    /** Is there a whole message in our buffer?
+     *
+     *  If so, get_message() will return it without reading from fdin.
+     */
+    bool message_pending() const;
+
+    /** Read whatever input is available into our buffer.
+     *
+     *  If none is available, waits for some.
+     *
+     *  @param end_time If this time is reached, then a timeout exception
+     *                  will be thrown.  If (end_time == 0.0) then the
+     *                  operation will never timeout.
+     *
+     *  @return false on EOF, otherwise true.
+     */
+    bool read_more(double end_time) {
+        return read_at_least(buffer.size() + 1, end_time);
+    }
+
+    /** Is there input we can read without waiting?
+     *
+     *  Like input_pending() but also checks if fdin is readable (which
+     *  includes EOF or an error condition).  Under __WIN32__ only our buffer
+     *  is checked.
+     */
+    bool input_ready() const;
 };
 
 /** RemoteConnection which owns its own fd(s).
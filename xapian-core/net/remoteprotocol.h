@@ -1,7 +1,7 @@
 /** @file
  *  @brief Remote protocol version and message numbers
  */
-/* Copyright (C) 2006-2024 Olly Betts
+/* Copyright (C) 2006-2026 Olly Betts
  * Copyright (C) 2007,2010 Lemur Consulting Ltd
  *
  * This program is free software; you can redistribute it and/or modify
@@ -61,7 +61,11 @@
 // 46: pre-2.0.0 Drop unused fields; front-code term names in serialised stats
 // 46.1: pre-2.0.0 MSG_REQUESTDOCUMENT added
 // 47: 2.0.0 Updated Weight::Internal serialisation for db_*_bound
-#define XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION 47
+// 48: pre-2.1.0 Request ids in messages; MSG_GETMSET carries the query id
+// 48.1: pre-2.1.0 MSG_DOCUMENTS added
+// 49: pre-2.1.0 Optional compression of messages offered in REPLY_UPDATE
+// 50: pre-2.1.0 MSG_GETMSET can ask for REPLY_PARTIALRESULTS to be sent
+#define XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION 50
 #define XAPIAN_REMOTE_PROTOCOL_MINOR_VERSION 0
 
 /** Message types (client -> server).
@@ -110,6 +114,8 @@ enum message_type {
     MSG_REMOVESYNONYM,          // Remove a synonym
     MSG_CLEARSYNONYMS,          // Clear synonyms for a term
     MSG_REQUESTDOCUMENT,        // Request a document (pre-read hint)
+    MSG_DOCUMENTS,              // Get several documents (flags must be 0)
+    MSG_COMPRESSION,            // Accept offer to compress messages
     MSG_MAX
 };
 
@@ -145,6 +151,8 @@ enum reply_type {
     REPLY_RECONSTRUCTTEXT,      // Reconstruct document text
     REPLY_SYNONYMTERMLIST,      // Get synonyms for a term
     REPLY_SYNONYMKEYLIST,       // Get terms with an entry in synonym table
+    REPLY_DOCUMENT,             // A document from MSG_DOCUMENTS
+    REPLY_PARTIALRESULTS,       // Best results so far from MSG_GETMSET
     REPLY_MAX
 };
 
@@ -0,0 +1,221 @@
+/** @file
+ *  @brief A group of TCP remote servers with replicas of the same database.
+ */
+/* Copyright (C) 2026 Olly Betts
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "remotereplicas.h"
+
+#include <xapian/error.h>
+
+#include "parallel.h"
+#include "parseint.h"
+#include "realtime.h"
+#include "str.h"
+#include "tcpclient.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <mutex>
+
+using namespace std;
+
+/// How many recent latencies to keep for each server.
+static constexpr size_t LATENCY_RECORDS = 64;
+
+/** How many latencies we need for a server before we'll hedge.
+ *
+ *  With fewer than this, the percentile isn't meaningful.
+ */
+static constexpr size_t MIN_LATENCY_RECORDS = 8;
+
+/// How long to avoid a server after failing to connect to it (in seconds).
+static constexpr double CONNECT_FAILURE_BACKOFF = 10.0;
+
+namespace {
+
+/// Recent query latencies for a server.
+class Latencies {
+    /// The latencies, used as a circular buffer.
+    double latency[LATENCY_RECORDS];
+
+    /// The number of latencies which have been added.
+    size_t count = 0;
+
+  public:
+    /// Don't prefer this server until this time (0.0 for no restriction).
+    double avoid_until = 0.0;
+
+    void add(double l) { latency[count++ % LATENCY_RECORDS] = l; }
+
+    size_t size() const { return min(count, LATENCY_RECORDS); }
+
+    /// Return percentile @a p of the latencies (size() must be > 0).
+    double percentile(unsigned p) const {
+        vector<double> v(latency, latency + size());
+        auto nth = v.begin() + (v.size() - 1) * min(p, 100u) / 100;
+        nth_element(v.begin(), nth, v.end());
+        return *nth;
+    }
+};
+
+}
+
+/// Latencies for each server, keyed by "host:port".
+static map<string, Latencies, less<>> latencies;
+
+/// Mutex protecting latencies.
+static ParallelMutex latencies_mutex;
+
+RemoteReplicas::RemoteReplicas(string_view list,
+                               unsigned percentile_,
+                               double timeout_connect_)
+    : percentile(percentile_), timeout_connect(timeout_connect_)
+{
+    while (true) {
+        auto start = list.find_first_not_of(' ');
+        if (start == string_view::npos) break;
+        list.remove_prefix(start);
+        auto end = list.find(' ');
+        string_view entry = list.substr(0, end);
+        list.remove_prefix(entry.size());
+
+        auto colon = entry.rfind(':');
+        unsigned port;
+        if (colon == string_view::npos ||
+            !parse_unsigned(string(entry.substr(colon + 1)).c_str(), port) ||
+            port == 0 || port > 65535) {
+            string msg = "Bad remote replica: ";
+            msg += entry;
+            throw Xapian::InvalidArgumentError(msg);
+        }
+        string_view host = entry.substr(0, colon);
+        if (host.size() > 1 && host[0] == '[' && host.back() == ']') {
+            host = host.substr(1, host.size() - 2);
+        }
+        replicas.push_back(Replica{string(host), int(port), string(entry)});
+    }
+    if (replicas.empty()) {
+        throw Xapian::InvalidArgumentError("No remote replicas specified");
+    }
+}
+
+vector<size_t>
+RemoteReplicas::ranked(size_t exclude) const
+{
+    // Rank servers we've recently failed to connect to last, then by median
+    // latency.  We rank servers without any latencies recorded first so that
+    // we find out how they're performing.
+    vector<pair<double, size_t>> order;
+    double now = RealTime::now();
+    {
+        lock_guard<ParallelMutex> lock(latencies_mutex);
+        for (size_t i = 0; i != replicas.size(); ++i) {
+            if (i == exclude) continue;
+            double rank = 0.0;
+            auto it = latencies.find(replicas[i].key);
+            if (it != latencies.end()) {
+                if (it->second.avoid_until > now) {
+                    rank = HUGE_VAL;
+                } else if (it->second.size()) {
+                    rank = it->second.percentile(50);
+                }
+            }
+            order.emplace_back(rank, i);
+        }
+    }
+    // Use a stable sort so servers which rank equally are tried in the order
+    // specified.
+    stable_sort(order.begin(), order.end(),
+                [](const pair<double, size_t>& a,
+                   const pair<double, size_t>& b) {
+                    return a.first < b.first;
+                });
+    vector<size_t> result;
+    result.reserve(order.size());
+    for (auto&& i : order) {
+        result.push_back(i.second);
+    }
+    return result;
+}
+
+pair<int, string>
+RemoteReplicas::connect(const vector<size_t>& order, size_t& index) const
+{
+    for (size_t j = 0; j != order.size(); ++j) {
+        const Replica& replica = replicas[order[j]];
+        // Build a context string for use when constructing
+        // Xapian::NetworkError.
+        string context{"remote:tcp("};
+        context += replica.host;
+        context += ':';
+        context += str(replica.port);
+        context += ')';
+        try {
+            int fd = TcpClient::open_socket(replica.host, replica.port,
+                                            timeout_connect, true, context);
+            index = order[j];
+            return {fd, context};
+        } catch (const Xapian::NetworkError&) {
+            {
+                lock_guard<ParallelMutex> lock(latencies_mutex);
+                latencies[replica.key].avoid_until =
+                    RealTime::now() + CONNECT_FAILURE_BACKOFF;
+            }
+            // Report the error if this was the last server to try.
+            if (j + 1 == order.size()) throw;
+        }
+    }
+    throw Xapian::NetworkError("No other remote replica to connect to");
+}
+
+pair<int, string>
+RemoteReplicas::open_socket()
+{
+    return connect(ranked(replicas.size()), current);
+}
+
+pair<int, string>
+RemoteReplicas::open_hedge_socket()
+{
+    return connect(ranked(current), hedge);
+}
+
+double
+RemoteReplicas::hedge_delay() const
+{
+    if (percentile == 0 || replicas.size() < 2) return -1.0;
+    lock_guard<ParallelMutex> lock(latencies_mutex);
+    auto it = latencies.find(replicas[current].key);
+    if (it == latencies.end() || it->second.size() < MIN_LATENCY_RECORDS)
+        return -1.0;
+    return it->second.percentile(percentile);
+}
+
+void
+RemoteReplicas::record_latency(bool hedged, double latency)
+{
+    const Replica& replica = replicas[hedged ? hedge : current];
+    lock_guard<ParallelMutex> lock(latencies_mutex);
+    Latencies& l = latencies[replica.key];
+    l.add(latency);
+    l.avoid_until = 0.0;
+}
@@ -0,0 +1,130 @@
+/** @file
+ *  @brief A group of TCP remote servers with replicas of the same database.
+ */
+/* Copyright (C) 2026 Olly Betts
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef XAPIAN_INCLUDED_REMOTEREPLICAS_H
+#define XAPIAN_INCLUDED_REMOTEREPLICAS_H
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/** A group of TCP remote servers with replicas of the same database.
+ *
+ *  We keep a process-wide record of the recent latencies of the queries run
+ *  on each server, which is used to pick which replica to connect to, and to
+ *  decide when the reply to a query is late enough that it's worth sending
+ *  the query to another replica too (a "hedged" request).
+ */
+class RemoteReplicas {
+    /// A server in the group.
+    struct Replica {
+        /// The hostname or IP address.
+        std::string host;
+
+        /// The port number.
+        int port;
+
+        /// Key for the latency records ("host:port").
+        std::string key;
+    };
+
+    /// The servers in the group, in the order specified.
+    std::vector<Replica> replicas;
+
+    /// The percentile of the latency to wait for before hedging (0 for never).
+    unsigned percentile;
+
+    /// Timeout for trying to connect (in seconds).
+    double timeout_connect;
+
+    /// Index in replicas of the server we're using.
+    size_t current = 0;
+
+    /// Index in replicas of the server we sent a hedged request to.
+    size_t hedge = 0;
+
+    /** Connect to the first server in @a order which we can.
+     *
+     *  @param order  Indices into replicas, best first.
+     *  @param[out] index  Set to the index of the server we connected to.
+     */
+    std::pair<int, std::string> connect(const std::vector<size_t>& order,
+                                        size_t& index) const;
+
+    /** Return the indices of the servers we could use, best first.
+     *
+     *  @param exclude  Index of a server to leave out, or size() to include
+     *                  all of them.
+     */
+    std::vector<size_t> ranked(size_t exclude) const;
+
+  public:
+    /** Constructor.
+     *
+     *  @param list         Space separated list of "HOST:PORT" entries (an IPv6
+     *                      address can be given in the form "[ADDRESS]:PORT").
+     *  @param percentile_  Percentile of the recent query latency of a server
+     *                      after which to send a hedged request (0 for never).
+     *  @param timeout_connect_  Timeout for trying to connect (in seconds).
+     */
+    RemoteReplicas(std::string_view list,
+                   unsigned percentile_,
+                   double timeout_connect_);
+
+    /// Return the number of servers in the group.
+    size_t size() const { return replicas.size(); }
+
+    /** Open a TCP/IP socket connection to the best server in the group.
+     *
+     *  The best server is the one with the lowest median recent latency, and
+     *  if we fail to connect we try the next best, and so on.
+     *
+     *  @return A std::pair containing the file descriptor for the connection
+     *          and a context string to return with any error messages.
+     */
+    std::pair<int, std::string> open_socket();
+
+    /** Open a connection to a different server to send a hedged request to.
+     *
+     *  Throws Xapian::NetworkError if we can't connect to any of them.
+     */
+    std::pair<int, std::string> open_hedge_socket();
+
+    /// Switch to using the server we sent the hedged request to.
+    void use_hedge() { current = hedge; }
+
+    /** How long to wait for a reply to a query before hedging.
+     *
+     *  @return The delay in seconds, or a negative value to never hedge
+     *          (because hedging is disabled, there isn't another server to
+     *          use, or we don't have enough latency records yet).
+     */
+    double hedge_delay() const;
+
+    /** Record how long a query took.
+     *
+     *  @param hedged   Was this the hedged request?
+     *  @param latency  Time from sending the query to the reply (in seconds).
+     */
+    void record_latency(bool hedged, double latency);
+};
+
+#endif // XAPIAN_INCLUDED_REMOTEREPLICAS_H
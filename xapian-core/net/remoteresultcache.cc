@@ -0,0 +1,103 @@
+/** @file
+ *  @brief Cache of query results for RemoteServer.
+ */
+/* Copyright (C) 2026 Olly Betts
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "remoteresultcache.h"
+
+#include "omassert.h"
+
+#include <mutex>
+
+using namespace std;
+
+/// Allowance for the memory used by each entry besides the key and value.
+static constexpr size_t ENTRY_OVERHEAD = 128;
+
+bool
+RemoteResultCache::check_revision(const string& uuid_, Xapian::rev revision_)
+{
+    if (uuid_ == uuid) {
+        if (revision_ == revision) return true;
+        // Don't throw away the entries for a connection which hasn't seen
+        // the latest revision yet.
+        if (revision_ < revision) return false;
+    }
+    // The database has been updated or replaced.
+    entries.clear();
+    index.clear();
+    size = 0;
+    uuid = uuid_;
+    revision = revision_;
+    return true;
+}
+
+void
+RemoteResultCache::evict()
+{
+    Assert(!entries.empty());
+    Entry& entry = entries.back();
+    size -= entry.key.size() + entry.value.size() + ENTRY_OVERHEAD;
+    index.erase(entry.key);
+    entries.pop_back();
+}
+
+bool
+RemoteResultCache::get(const string& uuid_, Xapian::rev revision_,
+                       const string& key, string& value)
+{
+    lock_guard<ParallelMutex> lock(mutex);
+    if (!check_revision(uuid_, revision_)) return false;
+    auto it = index.find(key);
+    if (it == index.end()) return false;
+    // Move the entry to the front of the list as it's now the most recently
+    // used.
+    entries.splice(entries.begin(), entries, it->second);
+    value = it->second->value;
+    return true;
+}
+
+void
+RemoteResultCache::set(const string& uuid_, Xapian::rev revision_,
+                       string&& key, string_view value)
+{
+    size_t entry_size = key.size() + value.size() + ENTRY_OVERHEAD;
+    if (entry_size > max_size) return;
+
+    lock_guard<ParallelMutex> lock(mutex);
+    if (!check_revision(uuid_, revision_)) return;
+    // Another thread may have added this entry meanwhile.
+    if (index.find(key) != index.end()) return;
+    while (size + entry_size > max_size) {
+        evict();
+    }
+    entries.push_front(Entry{std::move(key), string(value)});
+    index.emplace(entries.front().key, entries.begin());
+    size += entry_size;
+}
+
+void
+RemoteResultCache::clear()
+{
+    lock_guard<ParallelMutex> lock(mutex);
+    entries.clear();
+    index.clear();
+    size = 0;
+}
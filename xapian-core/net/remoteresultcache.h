@@ -0,0 +1,130 @@
+/** @file
+ *  @brief Cache of query results for RemoteServer.
+ */
+/* Copyright (C) 2026 Olly Betts
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef XAPIAN_INCLUDED_REMOTERESULTCACHE_H
+#define XAPIAN_INCLUDED_REMOTERESULTCACHE_H
+
+#include "parallel.h"
+#include "xapian/types.h"
+#include "xapian/visibility.h"
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/** Cache of query results for RemoteServer.
+ *
+ *  This maps the messages a client sends to run a query to the serialised
+ *  results, so that a server which gets the same query repeatedly (e.g. from
+ *  an aggregator sending popular queries to every shard) doesn't need to run
+ *  the match each time.
+ *
+ *  Entries are only valid for a particular revision of a database, and
+ *  everything in the cache is discarded when a newer revision is seen.  The
+ *  least recently used entries are discarded to keep the size under a limit.
+ *
+ *  A single cache can be shared by RemoteServer objects in different threads.
+ */
+class XAPIAN_VISIBILITY_DEFAULT RemoteResultCache {
+    /// Don't allow assignment.
+    RemoteResultCache& operator=(const RemoteResultCache&) = delete;
+
+    /// Don't allow copying.
+    RemoteResultCache(const RemoteResultCache&) = delete;
+
+    /// An entry in the cache.
+    struct Entry {
+        /// The key.
+        std::string key;
+
+        /// The cached value.
+        std::string value;
+    };
+
+    /// Entries, most recently used first.
+    std::list<Entry> entries;
+
+    /// Map from key to the entry in entries.
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+
+    /// Protects all the other members.
+    ParallelMutex mutex;
+
+    /// The approximate number of bytes used by the entries.
+    size_t size = 0;
+
+    /// The maximum number of bytes to use.
+    size_t max_size;
+
+    /// The UUID of the database the entries are for.
+    std::string uuid;
+
+    /// The revision of the database the entries are for.
+    Xapian::rev revision = 0;
+
+    /** Check if the cache can be used for a revision of a database.
+     *
+     *  If the database has been updated, the cache is cleared.
+     *
+     *  Must be called with mutex held.
+     *
+     *  @return false if the cache is for a newer revision.
+     */
+    bool check_revision(const std::string& uuid_, Xapian::rev revision_);
+
+    /// Remove the least recently used entry.  Must be called with mutex held.
+    void evict();
+
+  public:
+    /** Constructor.
+     *
+     *  @param max_size_  Approximate maximum number of bytes to use.
+     */
+    explicit RemoteResultCache(size_t max_size_) : max_size(max_size_) { }
+
+    /** Look up an entry.
+     *
+     *  @param uuid_        The UUID of the database.
+     *  @param revision_    The revision of the database.
+     *  @param key          The key to look up.
+     *  @param[out] value   Set to the cached value if found.
+     *
+     *  @return true if found.
+     */
+    bool get(const std::string& uuid_, Xapian::rev revision_,
+             const std::string& key, std::string& value);
+
+    /** Add an entry.
+     *
+     *  @param uuid_        The UUID of the database.
+     *  @param revision_    The revision of the database.
+     *  @param key          The key.
+     *  @param value        The value to cache.
+     */
+    void set(const std::string& uuid_, Xapian::rev revision_,
+             std::string&& key, std::string_view value);
+
+    /// Remove all entries.
+    void clear();
+};
+
+#endif // XAPIAN_INCLUDED_REMOTERESULTCACHE_H
@@ -42,6 +42,7 @@
 #include "omassert.h"
 #include "pack.h"
 #include "realtime.h"
+#include "remoteresultcache.h"
 #include "serialise.h"
 #include "serialise-double.h"
 #include "serialise-error.h"
@@ -61,13 +62,64 @@ throw_read_only()
 /// Class to throw when we receive the connection closing message.
 struct ConnectionClosed { };
 
+/** Maximum number of queries to keep state for.
+ *
+ *  State for a query is kept from MSG_QUERY until the corresponding
+ *  MSG_GETMSET, but if an exception occurs on the client between the two
+ *  then MSG_GETMSET is never sent.
+ */
+static constexpr size_t MAX_PENDING_QUERIES = 16;
+
+/// State for a query between MSG_QUERY and MSG_GETMSET.
+struct RemoteServer::PendingQuery {
+    Xapian::Query query;
+
+    unique_ptr<Xapian::Weight> wt;
+
+    Xapian::RSet rset;
+
+    vector<Xapian::Internal::opt_intrusive_ptr<Xapian::MatchSpy>> matchspies;
+
+    Xapian::Weight::Internal local_stats;
+
+    Xapian::valueno collapse_key;
+
+    Xapian::doccount collapse_max;
+
+    int percent_threshold;
+
+    double weight_threshold;
+
+    Xapian::Enquire::docid_order order;
+
+    Xapian::valueno sort_key;
+
+    Xapian::Enquire::Internal::sort_setting sort_by;
+
+    bool sort_value_forward;
+
+    double time_limit;
+
+    unique_ptr<Matcher> matcher;
+
+    /// Key for the result cache (empty if the results can't be cached).
+    string cache_key;
+
+    /// UUID of the database the results are for (if they can be cached).
+    string uuid;
+
+    /// Revision of the database the results are for (if they can be cached).
+    Xapian::rev revision = 0;
+};
+
 RemoteServer::RemoteServer(const vector<string>& dbpaths,
                            int fdin_, int fdout_,
                            double active_timeout_, double idle_timeout_,
-                           bool writable_)
+                           bool writable_, Compression::codec compression_)
     : RemoteConnection(fdin_, fdout_, string()),
       writable(writable_),
-      active_timeout(active_timeout_), idle_timeout(idle_timeout_)
+      active_timeout(active_timeout_), idle_timeout(idle_timeout_),
+      compression(compression_)
 {
     // Catch errors opening the database and propagate them to the client.
     try {
@@ -88,12 +140,41 @@ RemoteServer::RemoteServer(const vector<string>& dbpaths,
             context += *i;
         }
     } catch (const Xapian::Error &err) {
-        // Propagate the exception to the client.
-        send_message(REPLY_EXCEPTION, serialise_error(err));
+        // Propagate the exception to the client.  This is sent in place of
+        // the greeting so it doesn't have a request id.
+        double end_time = RealTime::end_time(active_timeout);
+        RemoteConnection::send_message(REPLY_EXCEPTION, serialise_error(err),
+                                       end_time);
         // And rethrow it so our caller can log it and close the connection.
         throw;
     }
 
+    init();
+}
+
+RemoteServer::RemoteServer(const Xapian::Database& db_,
+                           const string& context_,
+                           int fdin_, int fdout_,
+                           double active_timeout_, double idle_timeout_,
+                           bool writable_, Compression::codec compression_)
+    : RemoteConnection(fdin_, fdout_, context_),
+      db(new Xapian::Database(db_)),
+      writable(writable_),
+      active_timeout(active_timeout_), idle_timeout(idle_timeout_),
+      compression(compression_)
+{
+    init();
+}
+
+bool
+RemoteServer::compression_available(Compression::codec codec)
+{
+    return Compression::codec_available(codec);
+}
+
+void
+RemoteServer::init()
+{
 #ifndef __WIN32__
     // It's simplest to just ignore SIGPIPE.  We'll still know if the
     // connection dies because we'll get EPIPE back from write().
@@ -106,8 +187,10 @@ RemoteServer::RemoteServer(const vector<string>& dbpaths,
         throw Xapian::NetworkError("Couldn't set SIGPIPE to SIG_IGN", errno);
 #endif
 
-    // Send greeting message.
-    msg_update(string_view());
+    // Send greeting message.  This isn't a reply to a request so it doesn't
+    // have a request id.
+    double end_time = RealTime::end_time(active_timeout);
+    RemoteConnection::send_message(REPLY_UPDATE, get_update(), end_time);
 }
 
 RemoteServer::~RemoteServer()
@@ -117,8 +200,7 @@ RemoteServer::~RemoteServer()
 }
 
 message_type
-RemoteServer::get_message(double timeout, string & result,
-                          message_type required_type)
+RemoteServer::get_message(double timeout, string & result)
 {
     double end_time = RealTime::end_time(timeout);
     int type = RemoteConnection::get_message(result, end_time);
@@ -135,22 +217,30 @@ RemoteServer::get_message(double timeout, string & result,
         errmsg += str(type);
         throw Xapian::NetworkError(errmsg);
     }
-    if (required_type != MSG_MAX && type != int(required_type)) {
-        string errmsg("Expecting message type ");
-        errmsg += str(int(required_type));
-        errmsg += ", got ";
-        errmsg += str(type);
-        throw Xapian::NetworkError(errmsg);
+    // Each message starts with the id of the request, which we send back at
+    // the start of each reply to it.
+    const char* p = result.data();
+    if (!unpack_uint(&p, p + result.size(), &request_id)) {
+        throw Xapian::NetworkError("Bad request id");
     }
+    result.erase(0, p - result.data());
     return static_cast<message_type>(type);
 }
 
 void
 RemoteServer::send_message(reply_type type, string_view message)
 {
-    double end_time = RealTime::end_time(active_timeout);
+    send_message(type, message, RealTime::end_time(active_timeout));
+}
+
+void
+RemoteServer::send_message(reply_type type, string_view message,
+                           double end_time)
+{
+    string prefix;
+    pack_uint(prefix, request_id);
     unsigned char type_as_char = static_cast<unsigned char>(type);
-    RemoteConnection::send_message(type_as_char, message, end_time);
+    RemoteConnection::send_message(type_as_char, prefix, message, end_time);
 }
 
 typedef void (RemoteServer::* dispatch_func)(string_view);
@@ -158,164 +248,196 @@ typedef void (RemoteServer::* dispatch_func)(string_view);
 void
 RemoteServer::run()
 {
-    while (true) {
-        try {
-            string message;
-            size_t type = get_message(idle_timeout, message);
-            switch (type) {
-                case MSG_ALLTERMS:
-                    msg_allterms(message);
-                    continue;
-                case MSG_COLLFREQ:
-                    msg_collfreq(message);
-                    continue;
-                case MSG_DOCUMENT:
-                    msg_document(message);
-                    continue;
-                case MSG_TERMEXISTS:
-                    msg_termexists(message);
-                    continue;
-                case MSG_TERMFREQ:
-                    msg_termfreq(message);
-                    continue;
-                case MSG_VALUESTATS:
-                    msg_valuestats(message);
-                    continue;
-                case MSG_KEEPALIVE:
-                    msg_keepalive(message);
-                    continue;
-                case MSG_DOCLENGTH:
-                    msg_doclength(message);
-                    continue;
-                case MSG_QUERY:
-                    msg_query(message);
-                    continue;
-                case MSG_TERMLIST:
-                    msg_termlist(message);
-                    continue;
-                case MSG_POSITIONLIST:
-                    msg_positionlist(message);
-                    continue;
-                case MSG_POSTLIST:
-                    msg_postlist(message);
-                    continue;
-                case MSG_REOPEN:
-                    msg_reopen(message);
-                    continue;
-                case MSG_UPDATE:
-                    msg_update(message);
-                    continue;
-                case MSG_ADDDOCUMENT:
-                    msg_adddocument(message);
-                    continue;
-                case MSG_CANCEL:
-                    msg_cancel(message);
-                    continue;
-                case MSG_DELETEDOCUMENTTERM:
-                    msg_deletedocumentterm(message);
-                    continue;
-                case MSG_COMMIT:
-                    msg_commit(message);
-                    continue;
-                case MSG_REPLACEDOCUMENT:
-                    msg_replacedocument(message);
-                    continue;
-                case MSG_REPLACEDOCUMENTTERM:
-                    msg_replacedocumentterm(message);
-                    continue;
-                case MSG_DELETEDOCUMENT:
-                    msg_deletedocument(message);
-                    continue;
-                case MSG_WRITEACCESS:
-                    msg_writeaccess(message);
-                    continue;
-                case MSG_GETMETADATA:
-                    msg_getmetadata(message);
-                    continue;
-                case MSG_SETMETADATA:
-                    msg_setmetadata(message);
-                    continue;
-                case MSG_REQUESTDOCUMENT:
-                    msg_requestdocument(message);
-                    continue;
-                case MSG_ADDSPELLING:
-                    msg_addspelling(message);
-                    continue;
-                case MSG_REMOVESPELLING:
-                    msg_removespelling(message);
-                    continue;
-                case MSG_METADATAKEYLIST:
-                    msg_metadatakeylist(message);
-                    continue;
-                case MSG_FREQS:
-                    msg_freqs(message);
-                    continue;
-                case MSG_UNIQUETERMS:
-                    msg_uniqueterms(message);
-                    continue;
-                case MSG_WDFDOCMAX:
-                    msg_wdfdocmax(message);
-                    continue;
-                case MSG_POSITIONLISTCOUNT:
-                    msg_positionlistcount(message);
-                    continue;
-                case MSG_RECONSTRUCTTEXT:
-                    msg_reconstructtext(message);
-                    continue;
-                case MSG_SYNONYMTERMLIST:
-                    msg_synonymtermlist(message);
-                    continue;
-                case MSG_SYNONYMKEYLIST:
-                    msg_synonymkeylist(message);
-                    continue;
-                case MSG_ADDSYNONYM:
-                    msg_addsynonym(message);
-                    continue;
-                case MSG_REMOVESYNONYM:
-                    msg_removesynonym(message);
-                    continue;
-                case MSG_CLEARSYNONYMS:
-                    msg_clearsynonyms(message);
-                    continue;
-                default: {
-                    // MSG_GETMSET - used during a conversation.
-                    // MSG_SHUTDOWN - handled by get_message().
-                    string errmsg("Unexpected message type ");
-                    errmsg += str(type);
-                    throw Xapian::InvalidArgumentError(errmsg);
-                }
-            }
-        } catch (const Xapian::NetworkTimeoutError & e) {
-            try {
-                // We've had a timeout, so the client may not be listening, so
-                // set the end_time to 1 and if we can't send the message right
-                // away, just exit and the client will cope.
-                send_message(REPLY_EXCEPTION, serialise_error(e), 1.0);
-            } catch (...) {
+    while (process_message()) { }
+}
+
+void
+RemoteServer::idle_timeout_expired()
+{
+    Xapian::NetworkTimeoutError e("Timeout expired while trying to read",
+                                  context);
+    try {
+        // This isn't a reply to any particular request, which we signal with
+        // request id 0.
+        request_id = 0;
+        // As in process_message(), the client may not be listening so don't
+        // wait to send the message.
+        send_message(REPLY_EXCEPTION, serialise_error(e), 1.0);
+    } catch (...) {
+    }
+    throw e;
+}
+
+bool
+RemoteServer::process_message()
+{
+    try {
+        string message;
+        size_t type = get_message(idle_timeout, message);
+        switch (type) {
+            case MSG_ALLTERMS:
+                msg_allterms(message);
+                return true;
+            case MSG_COLLFREQ:
+                msg_collfreq(message);
+                return true;
+            case MSG_DOCUMENT:
+                msg_document(message);
+                return true;
+            case MSG_TERMEXISTS:
+                msg_termexists(message);
+                return true;
+            case MSG_TERMFREQ:
+                msg_termfreq(message);
+                return true;
+            case MSG_VALUESTATS:
+                msg_valuestats(message);
+                return true;
+            case MSG_KEEPALIVE:
+                msg_keepalive(message);
+                return true;
+            case MSG_DOCLENGTH:
+                msg_doclength(message);
+                return true;
+            case MSG_QUERY:
+                msg_query(message);
+                return true;
+            case MSG_TERMLIST:
+                msg_termlist(message);
+                return true;
+            case MSG_POSITIONLIST:
+                msg_positionlist(message);
+                return true;
+            case MSG_POSTLIST:
+                msg_postlist(message);
+                return true;
+            case MSG_REOPEN:
+                msg_reopen(message);
+                return true;
+            case MSG_UPDATE:
+                msg_update(message);
+                return true;
+            case MSG_ADDDOCUMENT:
+                msg_adddocument(message);
+                return true;
+            case MSG_CANCEL:
+                msg_cancel(message);
+                return true;
+            case MSG_DELETEDOCUMENTTERM:
+                msg_deletedocumentterm(message);
+                return true;
+            case MSG_COMMIT:
+                msg_commit(message);
+                return true;
+            case MSG_REPLACEDOCUMENT:
+                msg_replacedocument(message);
+                return true;
+            case MSG_REPLACEDOCUMENTTERM:
+                msg_replacedocumentterm(message);
+                return true;
+            case MSG_DELETEDOCUMENT:
+                msg_deletedocument(message);
+                return true;
+            case MSG_WRITEACCESS:
+                msg_writeaccess(message);
+                return true;
+            case MSG_GETMETADATA:
+                msg_getmetadata(message);
+                return true;
+            case MSG_SETMETADATA:
+                msg_setmetadata(message);
+                return true;
+            case MSG_REQUESTDOCUMENT:
+                msg_requestdocument(message);
+                return true;
+            case MSG_DOCUMENTS:
+                msg_documents(message);
+                return true;
+            case MSG_COMPRESSION:
+                msg_compression(message);
+                return true;
+            case MSG_ADDSPELLING:
+                msg_addspelling(message);
+                return true;
+            case MSG_REMOVESPELLING:
+                msg_removespelling(message);
+                return true;
+            case MSG_METADATAKEYLIST:
+                msg_metadatakeylist(message);
+                return true;
+            case MSG_FREQS:
+                msg_freqs(message);
+                return true;
+            case MSG_UNIQUETERMS:
+                msg_uniqueterms(message);
+                return true;
+            case MSG_WDFDOCMAX:
+                msg_wdfdocmax(message);
+                return true;
+            case MSG_POSITIONLISTCOUNT:
+                msg_positionlistcount(message);
+                return true;
+            case MSG_RECONSTRUCTTEXT:
+                msg_reconstructtext(message);
+                return true;
+            case MSG_SYNONYMTERMLIST:
+                msg_synonymtermlist(message);
+                return true;
+            case MSG_SYNONYMKEYLIST:
+                msg_synonymkeylist(message);
+                return true;
+            case MSG_ADDSYNONYM:
+                msg_addsynonym(message);
+                return true;
+            case MSG_REMOVESYNONYM:
+                msg_removesynonym(message);
+                return true;
+            case MSG_CLEARSYNONYMS:
+                msg_clearsynonyms(message);
+                return true;
+            case MSG_GETMSET:
+                msg_getmset(message);
+                return true;
+            default: {
+                // MSG_SHUTDOWN - handled by get_message().
+                string errmsg("Unexpected message type ");
+                errmsg += str(type);
+                throw Xapian::InvalidArgumentError(errmsg);
             }
-            // And rethrow it so our caller can log it and close the
-            // connection.
-            throw;
-        } catch (const Xapian::NetworkError &) {
-            // All other network errors mean we are fatally confused and are
-            // unlikely to be able to communicate further across this
-            // connection.  So we don't try to propagate the error to the
-            // client, but instead just rethrow the exception so our caller can
-            // log it and close the connection.
-            throw;
-        } catch (const Xapian::Error &e) {
-            // Propagate the exception to the client, then return to the main
-            // message handling loop.
-            send_message(REPLY_EXCEPTION, serialise_error(e));
-        } catch (ConnectionClosed &) {
-            return;
+        }
+    } catch (const Xapian::NetworkTimeoutError & e) {
+        try {
+            // We've had a timeout, so the client may not be listening, so
+            // set the end_time to 1 and if we can't send the message right
+            // away, just exit and the client will cope.  Use request id 0 so
+            // the client sees the error whichever request it's waiting for.
+            request_id = 0;
+            send_message(REPLY_EXCEPTION, serialise_error(e), 1.0);
         } catch (...) {
-            // Propagate an unknown exception to the client.
-            send_message(REPLY_EXCEPTION, {});
-            // And rethrow it so our caller can log it and close the
-            // connection.
-            throw;
         }
+        // And rethrow it so our caller can log it and close the
+        // connection.
+        throw;
+    } catch (const Xapian::NetworkError &) {
+        // All other network errors mean we are fatally confused and are
+        // unlikely to be able to communicate further across this
+        // connection.  So we don't try to propagate the error to the
+        // client, but instead just rethrow the exception so our caller can
+        // log it and close the connection.
+        throw;
+    } catch (const Xapian::Error &e) {
+        // Propagate the exception to the client, then carry on handling
+        // messages.
+        send_message(REPLY_EXCEPTION, serialise_error(e));
+        return true;
+    } catch (ConnectionClosed &) {
+        return false;
+    } catch (...) {
+        // Propagate an unknown exception to the client.
+        send_message(REPLY_EXCEPTION, {});
+        // And rethrow it so our caller can log it and close the
+        // connection.
+        throw;
     }
 }
 
@@ -461,6 +583,7 @@ RemoteServer::msg_writeaccess(string_view msg)
     }
 
     wdb = new Xapian::WritableDatabase(db->lock(flags));
+    pending_queries.clear();
     delete db;
     db = wdb;
     msg_update(msg);
@@ -473,11 +596,12 @@ RemoteServer::msg_reopen(string_view msg)
         send_message(REPLY_DONE, {});
         return;
     }
+    pending_queries.clear();
     msg_update(msg);
 }
 
-void
-RemoteServer::msg_update(string_view)
+string
+RemoteServer::get_update() const
 {
     static const char protocol[2] = {
         char(XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION),
@@ -492,8 +616,22 @@ RemoteServer::msg_update(string_view)
     pack_uint(message, db->get_doclength_upper_bound() - doclen_lb);
     pack_bool(message, db->has_positions());
     pack_uint(message, db->get_total_length());
+    // The codec we offer to compress messages with, plus one (0 means we
+    // aren't offering compression).
+    if (compression == Compression::CODEC_MAX_ ||
+        !Compression::codec_available(compression)) {
+        pack_uint(message, 0u);
+    } else {
+        pack_uint(message, unsigned(compression) + 1);
+    }
     message += db->get_uuid();
-    send_message(REPLY_UPDATE, message);
+    return message;
+}
+
+void
+RemoteServer::msg_update(string_view)
+{
+    send_message(REPLY_UPDATE, get_update());
 }
 
 void
@@ -607,29 +745,82 @@ RemoteServer::msg_query(string_view message_in)
                                                    reg)->release());
     }
 
-    Xapian::Weight::Internal local_stats;
-    Matcher matcher(*db,
-                    query, qlen, &rset, local_stats, *wt,
-                    false,
-                    collapse_key, collapse_max,
-                    percent_threshold, weight_threshold,
-                    order, sort_key, sort_by, sort_value_forward, time_limit,
-                    matchspies);
+    unique_ptr<PendingQuery> q(new PendingQuery);
+    q->query = query;
+    q->wt = std::move(wt);
+    q->rset = rset;
+    q->matchspies = std::move(matchspies);
+    q->collapse_key = collapse_key;
+    q->collapse_max = collapse_max;
+    q->percent_threshold = percent_threshold;
+    q->weight_threshold = weight_threshold;
+    q->order = order;
+    q->sort_key = sort_key;
+    q->sort_by = sort_by;
+    q->sort_value_forward = sort_value_forward;
+    q->time_limit = time_limit;
+    if (result_cache && !wdb && time_limit == 0.0 && db->size() == 1) {
+        // The results only depend on the database revision and the messages
+        // for this query, unless there's a time limit or the client can see
+        // uncommitted changes.  With several databases there's no single
+        // UUID and revision to check, so we don't cache those.
+        try {
+            q->revision = db->get_revision();
+            q->uuid = db->get_uuid();
+            pack_string(q->cache_key, message_in);
+        } catch (const Xapian::UnimplementedError&) {
+            // The backend doesn't support revisions.
+        }
+    }
+    q->matcher.reset(new Matcher(*db,
+                                 q->query, qlen, &q->rset, q->local_stats,
+                                 *q->wt,
+                                 false,
+                                 collapse_key, collapse_max,
+                                 percent_threshold, weight_threshold,
+                                 order, sort_key, sort_by, sort_value_forward,
+                                 time_limit,
+                                 q->matchspies));
+
+    send_message(REPLY_STATS, serialise_stats(q->local_stats));
+
+    // The client sends MSG_GETMSET (with the id of this request) once it has
+    // the statistics from all the shards.  We don't wait for it here, so
+    // other requests can be handled meanwhile.
+    if (pending_queries.size() >= MAX_PENDING_QUERIES) {
+        // The client must have abandoned some queries, so discard the oldest.
+        pending_queries.erase(pending_queries.begin());
+    }
+    pending_queries[request_id] = std::move(q);
+}
 
-    send_message(REPLY_STATS, serialise_stats(local_stats));
+void
+RemoteServer::msg_getmset(string_view message)
+{
+    const char* p = message.data();
+    const char* p_end = p + message.size();
 
-    string message;
-    get_message(active_timeout, message, MSG_GETMSET);
-    p = message.c_str();
-    p_end = p + message.size();
+    unsigned query_id;
+    if (!unpack_uint(&p, p_end, &query_id)) {
+        throw Xapian::NetworkError("Bad MSG_GETMSET");
+    }
+    const char* p_rest = p;
+    auto it = pending_queries.find(query_id);
+    if (it == pending_queries.end()) {
+        throw Xapian::InvalidOperationError("MSG_GETMSET for unknown query");
+    }
+    unique_ptr<PendingQuery> q = std::move(it->second);
+    pending_queries.erase(it);
 
     Xapian::termcount first;
     Xapian::termcount maxitems;
     Xapian::termcount check_at_least;
+    bool stream;
     string sorter_type;
     if (!unpack_uint(&p, p_end, &first) ||
         !unpack_uint(&p, p_end, &maxitems) ||
         !unpack_uint(&p, p_end, &check_at_least) ||
+        !unpack_bool(&p, p_end, &stream) ||
         !unpack_string(&p, p_end, sorter_type)) {
         throw Xapian::NetworkError("Bad MSG_GETMSET");
     }
@@ -648,26 +839,64 @@ RemoteServer::msg_query(string_view message_in)
         sorter.reset(sorterclass->unserialise(serialised_sorter, reg));
     }
 
+    if (!q->cache_key.empty()) {
+        // The rest of the message (including the global statistics) also
+        // affects the results.
+        q->cache_key.append(p_rest, p_end);
+        string reply;
+        if (result_cache->get(q->uuid, q->revision, q->cache_key, reply)) {
+            send_message(REPLY_RESULTS, reply);
+            return;
+        }
+    }
+
     unique_ptr<Xapian::Weight::Internal> total_stats(new Xapian::Weight::Internal);
     unserialise_stats(p, p_end, *total_stats);
 
-    Xapian::MSet mset = matcher.get_mset(first, maxitems, check_at_least,
-                                         *total_stats, *wt, 0, sorter.get(),
-                                         collapse_key, collapse_max,
-                                         percent_threshold, weight_threshold,
-                                         order,
-                                         sort_key, sort_by, sort_value_forward,
-                                         time_limit, matchspies);
+    bool stopped_early = false;
+    if (stream) {
+        q->matcher->set_progress(
+            [this](const Xapian::MSet& partial, double bound) {
+                string reply = serialise_double(bound);
+                reply += partial.internal->serialise();
+                send_message(REPLY_PARTIALRESULTS, reply);
+            },
+            [this, &stopped_early]() {
+                // If the client has sent another request then it's stopped
+                // waiting for the results of this one.
+                stopped_early = input_ready();
+                return stopped_early;
+            });
+    } else {
+        q->matcher->set_progress(nullptr, nullptr);
+    }
+
+    Xapian::MSet mset = q->matcher->get_mset(first, maxitems, check_at_least,
+                                             *total_stats, *q->wt, 0,
+                                             sorter.get(),
+                                             q->collapse_key, q->collapse_max,
+                                             q->percent_threshold,
+                                             q->weight_threshold,
+                                             q->order,
+                                             q->sort_key, q->sort_by,
+                                             q->sort_value_forward,
+                                             q->time_limit, q->matchspies,
+                                             false, 0.0);
     // FIXME: The local side already has these stats, except for the maxpart
     // information.
     mset.internal->set_stats(total_stats.release());
 
-    message.resize(0);
-    for (auto i : matchspies) {
-        pack_string(message, i->serialise_results());
+    string reply;
+    for (auto i : q->matchspies) {
+        pack_string(reply, i->serialise_results());
+    }
+    reply += mset.internal->serialise();
+    send_message(REPLY_RESULTS, reply);
+
+    if (!q->cache_key.empty() && !stopped_early) {
+        result_cache->set(q->uuid, q->revision, std::move(q->cache_key),
+                          reply);
     }
-    message += mset.internal->serialise();
-    send_message(REPLY_RESULTS, message);
 }
 
 void
@@ -694,6 +923,50 @@ RemoteServer::msg_document(string_view message)
     send_message(REPLY_DONE, {});
 }
 
+void
+RemoteServer::msg_documents(string_view message)
+{
+    const char* p = message.data();
+    const char* p_end = p + message.size();
+    unsigned flags;
+    if (!unpack_uint(&p, p_end, &flags) || flags != 0) {
+        throw Xapian::NetworkError("Bad MSG_DOCUMENTS");
+    }
+    vector<Xapian::docid> dids;
+    while (p != p_end) {
+        Xapian::docid did;
+        if (!unpack_uint(&p, p_end, &did) || did == 0) {
+            throw Xapian::NetworkError("Bad MSG_DOCUMENTS");
+        }
+        dids.push_back(did);
+    }
+
+    // Let the backend start reading all the documents.
+    db->internal->request_documents(dids);
+
+    string reply;
+    for (auto did : dids) {
+        Xapian::Document doc;
+        try {
+            doc = db->get_document(did);
+        } catch (const Xapian::DocNotFoundError&) {
+            // Just omit the document - the client will report the error if
+            // it actually tries to open it.
+            continue;
+        }
+
+        reply.resize(0);
+        pack_uint(reply, did);
+        pack_string(reply, doc.get_data());
+        for (auto i = doc.values_begin(); i != doc.values_end(); ++i) {
+            pack_uint(reply, i.get_valueno());
+            pack_string(reply, *i);
+        }
+        send_message(REPLY_DOCUMENT, reply);
+    }
+    send_message(REPLY_DONE, {});
+}
+
 void
 RemoteServer::msg_keepalive(string_view)
 {
@@ -1079,3 +1352,21 @@ RemoteServer::msg_clearsynonyms(string_view message)
     wdb->clear_synonyms(message);
     send_message(REPLY_DONE, {});
 }
+
+void
+RemoteServer::msg_compression(string_view message)
+{
+    const char* p = message.data();
+    const char* p_end = p + message.size();
+    unsigned codec;
+    if (!unpack_uint_last(&p, p_end, &codec)) {
+        throw Xapian::NetworkError("Bad MSG_COMPRESSION");
+    }
+    if (compression == Compression::CODEC_MAX_ ||
+        codec != unsigned(compression)) {
+        throw Xapian::InvalidArgumentError("Compression codec not offered");
+    }
+    set_compression(compression);
+
+    send_message(REPLY_DONE, {});
+}
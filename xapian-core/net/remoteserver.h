@@ -30,9 +30,13 @@
 
 #include "remoteconnection.h"
 
+#include <map>
+#include <memory>
 #include <string>
 #include <string_view>
 
+class RemoteResultCache;
+
 /** Remote backend server base class. */
 class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     /// Don't allow assignment.
@@ -70,10 +74,41 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     /// The registry, which allows unserialisation of user subclasses.
     Xapian::Registry reg;
 
+    /** Codec to offer to compress messages with.
+     *
+     *  Compression::CODEC_MAX_ means not to offer compression.
+     */
+    Compression::codec compression;
+
+    /// Ignore SIGPIPE and send the greeting message.
+    XAPIAN_VISIBILITY_INTERNAL
+    void init();
+
+    /** The id of the request currently being handled.
+     *
+     *  Each message from the client starts with a request id, which we send
+     *  back at the start of each reply to that message.  This allows the
+     *  client to have several requests in progress at once.  Request id 0
+     *  is used for a reply which isn't to any particular request (e.g. to
+     *  report a timeout).
+     */
+    unsigned request_id = 0;
+
+    struct PendingQuery;
+
+    /** Queries waiting for MSG_GETMSET, keyed by the id of the MSG_QUERY.
+     *
+     *  Keeping this state allows other requests to be handled between
+     *  MSG_QUERY and MSG_GETMSET.
+     */
+    std::map<unsigned, std::unique_ptr<PendingQuery>> pending_queries;
+
+    /// Cache of query results to use, or NULL for none.
+    RemoteResultCache* result_cache = nullptr;
+
     /// Accept a message from the client.
     XAPIAN_VISIBILITY_INTERNAL
-    message_type get_message(double timeout, std::string & result,
-                             message_type required_type = MSG_MAX);
+    message_type get_message(double timeout, std::string & result);
 
     /// Send a message to the client.
     XAPIAN_VISIBILITY_INTERNAL
@@ -82,10 +117,7 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     /// Send a message to the client, with specific end_time.
     XAPIAN_VISIBILITY_INTERNAL
     void send_message(reply_type type, std::string_view message,
-                      double end_time) {
-        unsigned char type_as_char = static_cast<unsigned char>(type);
-        RemoteConnection::send_message(type_as_char, message, end_time);
-    }
+                      double end_time);
 
     // all terms
     XAPIAN_VISIBILITY_INTERNAL
@@ -123,10 +155,14 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     XAPIAN_VISIBILITY_INTERNAL
     void msg_doclength(std::string_view message);
 
-    // set the query; return the mset
+    // set the query; return the stats
     XAPIAN_VISIBILITY_INTERNAL
     void msg_query(std::string_view message);
 
+    // return the mset for a query
+    XAPIAN_VISIBILITY_INTERNAL
+    void msg_getmset(std::string_view message);
+
     // get termlist
     XAPIAN_VISIBILITY_INTERNAL
     void msg_termlist(std::string_view message);
@@ -155,6 +191,10 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     XAPIAN_VISIBILITY_INTERNAL
     void msg_update(std::string_view message);
 
+    /// Build the message body for REPLY_UPDATE.
+    XAPIAN_VISIBILITY_INTERNAL
+    std::string get_update() const;
+
     // commit
     XAPIAN_VISIBILITY_INTERNAL
     void msg_commit(std::string_view message);
@@ -199,6 +239,10 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     XAPIAN_VISIBILITY_INTERNAL
     void msg_requestdocument(std::string_view message);
 
+    // get several documents
+    XAPIAN_VISIBILITY_INTERNAL
+    void msg_documents(std::string_view message);
+
     // add a spelling
     XAPIAN_VISIBILITY_INTERNAL
     void msg_addspelling(std::string_view message);
@@ -239,6 +283,10 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     XAPIAN_VISIBILITY_INTERNAL
     void msg_clearsynonyms(std::string_view message);
 
+    // accept offer to compress messages
+    XAPIAN_VISIBILITY_INTERNAL
+    void msg_compression(std::string_view message);
+
   public:
     /** Construct a RemoteServer.
      *
@@ -251,12 +299,53 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
      *  @param idle_timeout_    Timeout while waiting for a new action from
      *                          the client (specified in seconds).
      *  @param writable         Should the database be opened for writing?
+     *  @param compression_     Codec to offer to compress messages with, or
+     *                          Compression::CODEC_MAX_ (the default) not to
+     *                          offer compression.
      */
     RemoteServer(const std::vector<std::string> &dbpaths,
                  int fdin, int fdout,
                  double active_timeout_,
                  double idle_timeout_,
-                 bool writable = false);
+                 bool writable = false,
+                 Compression::codec compression_ = Compression::CODEC_MAX_);
+
+    /** Construct a RemoteServer using an already open database.
+     *
+     *  This allows a server handling many connections to reuse database
+     *  handles rather than opening the databases afresh for each one.
+     *
+     *  @param db_              The Xapian database to use.  The caller must
+     *                          ensure that it isn't used by anything else
+     *                          while this object exists.
+     *  @param context_         The context to report with errors (usually
+     *                          the database path(s)).
+     *  @param fdin             The file descriptor to read from.
+     *  @param fdout            The file descriptor to write to (fdin and fdout
+     *                          may be the same).
+     *  @param active_timeout_  Timeout for actions during a conversation
+     *                          (specified in seconds).
+     *  @param idle_timeout_    Timeout while waiting for a new action from
+     *                          the client (specified in seconds).
+     *  @param writable         Can the client upgrade to write access?
+     *  @param compression_     Codec to offer to compress messages with, or
+     *                          Compression::CODEC_MAX_ (the default) not to
+     *                          offer compression.
+     */
+    RemoteServer(const Xapian::Database& db_,
+                 const std::string& context_,
+                 int fdin, int fdout,
+                 double active_timeout_,
+                 double idle_timeout_,
+                 bool writable = false,
+                 Compression::codec compression_ = Compression::CODEC_MAX_);
+
+    /** Is support for compressing with @a codec compiled in?
+     *
+     *  Server programs can use this to check a codec they've been asked to
+     *  offer.
+     */
+    static bool compression_available(Compression::codec codec);
 
     /// Destructor.
     ~RemoteServer();
@@ -268,8 +357,44 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
      */
     void run();
 
+    /** Accept a single message from the client and process it.
+     *
+     *  @return false if the connection has been closed.
+     */
+    bool process_message();
+
+    using RemoteConnection::input_pending;
+
+    /** Report to the client that the connection has been idle too long.
+     *
+     *  This is for use when the caller is waiting for input itself rather
+     *  than via run().  After reporting the timeout to the client (if
+     *  possible), Xapian::NetworkTimeoutError is thrown.
+     */
+    void idle_timeout_expired();
+
+    /** Return the database if the client hasn't been given write access.
+     *
+     *  Otherwise returns NULL.
+     */
+    const Xapian::Database* get_read_only_database() const {
+        return wdb ? nullptr : db;
+    }
+
     /// Set the registry used for (un)serialisation.
     void set_registry(const Xapian::Registry & reg_) { reg = reg_; }
+
+    /** Set a cache of query results to use.
+     *
+     *  Results are only cached for read-only access to a single database
+     *  without a time limit.  The cache is never used if the server has more
+     *  than one database open, since there's no single UUID and revision to
+     *  tag the results with.
+     *
+     *  @param cache    The cache to use, or NULL for none.  The caller must
+     *                  ensure that it outlives this object.
+     */
+    void set_result_cache(RemoteResultCache* cache) { result_cache = cache; }
 };
 
 #endif // XAPIAN_INCLUDED_REMOTESERVER_H
@@ -1,7 +1,7 @@
 /** @file
  *  @brief TCP/IP socket based RemoteDatabase implementation
  */
-/* Copyright (C) 2008,2010,2024 Olly Betts
+/* Copyright (C) 2008,2010,2024,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -24,11 +24,126 @@
 
 #include <xapian/error.h>
 
+#include "parallel.h"
+#include "realtime.h"
 #include "str.h"
 #include "tcpclient.h"
 
+#include <map>
+#include <mutex>
+#include <vector>
+
 using namespace std;
 
+/** How long to keep an idle connection in the pool (in seconds).
+ *
+ *  This is less than xapian-tcpsrv's default idle timeout of 60 seconds so
+ *  that we don't usually try to reuse a connection which the server has
+ *  closed.
+ */
+static constexpr double MAX_IDLE_SECS = 30.0;
+
+/// Idle connections to each server, keyed by "host:port", oldest first.
+static map<string, vector<IdleRemoteConnection>, less<>> pool;
+
+/// Maximum number of idle connections to keep for each server.
+static unsigned pool_max_idle = 0;
+
+/// Mutex protecting pool and pool_max_idle.
+static ParallelMutex pool_mutex;
+
+/** Take the most recently used idle connection for @a key from the pool.
+ *
+ *  @return true if a connection was found.
+ */
+static bool
+pool_checkout(const string& key, IdleRemoteConnection& idle)
+{
+    lock_guard<ParallelMutex> lock(pool_mutex);
+    auto it = pool.find(key);
+    if (it == pool.end()) return false;
+    auto& conns = it->second;
+    // Drop connections which have been idle too long - the oldest are at the
+    // start.
+    double expired = RealTime::now() - MAX_IDLE_SECS;
+    auto i = conns.begin();
+    while (i != conns.end() && i->idle_since < expired) ++i;
+    conns.erase(conns.begin(), i);
+    if (conns.empty()) {
+        pool.erase(it);
+        return false;
+    }
+    idle = std::move(conns.back());
+    conns.pop_back();
+    return true;
+}
+
+void
+RemoteTcpClient::set_pool_key(string_view hostname, int port)
+{
+    pool_key = hostname;
+    pool_key += ':';
+    pool_key += str(port);
+}
+
+void
+RemoteTcpClient::return_to_pool()
+{
+    if (pool_key.empty()) return;
+    {
+        lock_guard<ParallelMutex> lock(pool_mutex);
+        if (pool_max_idle == 0) return;
+    }
+    IdleRemoteConnection idle;
+    if (!release_connection(idle)) return;
+    lock_guard<ParallelMutex> lock(pool_mutex);
+    auto& conns = pool[pool_key];
+    // Drop the oldest connections if there are too many.
+    if (conns.size() >= pool_max_idle) {
+        conns.erase(conns.begin(),
+                    conns.begin() + (conns.size() - pool_max_idle + 1));
+    }
+    conns.push_back(std::move(idle));
+}
+
+RemoteTcpClient*
+RemoteTcpClient::open(string_view hostname, int port,
+                      double timeout_, double timeout_connect)
+{
+    string key{hostname};
+    key += ':';
+    key += str(port);
+    IdleRemoteConnection idle;
+    while (pool_checkout(key, idle)) {
+        try {
+            return new RemoteTcpClient(std::move(idle), string(key), timeout_);
+        } catch (const Xapian::NetworkError&) {
+            // The server has probably closed the connection, so try the next
+            // idle connection, or open a new connection.
+        }
+    }
+    return new RemoteTcpClient(hostname, port, timeout_, timeout_connect,
+                               false, 0);
+}
+
+void
+RemoteTcpClient::set_pool_size(unsigned max_idle)
+{
+    lock_guard<ParallelMutex> lock(pool_mutex);
+    pool_max_idle = max_idle;
+    if (max_idle == 0) {
+        pool.clear();
+    } else {
+        for (auto&& i : pool) {
+            auto& conns = i.second;
+            if (conns.size() > max_idle) {
+                conns.erase(conns.begin(),
+                            conns.begin() + (conns.size() - max_idle));
+            }
+        }
+    }
+}
+
 pair<int, string>
 RemoteTcpClient::open_socket(string_view hostname, int port,
                              double timeout_connect)
@@ -47,7 +162,15 @@ RemoteTcpClient::open_socket(string_view hostname, int port,
 RemoteTcpClient::~RemoteTcpClient()
 {
     try {
+        return_to_pool();
         do_close();
     } catch (...) {
     }
 }
+
+void
+RemoteTcpClient::close()
+{
+    return_to_pool();
+    RemoteDatabase::close();
+}
@@ -1,7 +1,7 @@
 /** @file
  *  @brief TCP/IP socket based RemoteDatabase implementation
  */
-/* Copyright (C) 2007,2008,2010,2011,2014,2024 Olly Betts
+/* Copyright (C) 2007,2008,2010,2011,2014,2024,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -24,8 +24,10 @@
 #include "backends/remote/remote-database.h"
 #include "socket_utils.h"
 
+#include <memory>
 #include <string>
 #include <string_view>
+#include <utility>
 
 #ifdef __WIN32__
 # define SOCKET_INITIALIZER_MIXIN private WinsockInitializer,
@@ -62,6 +64,24 @@ class RemoteTcpClient : SOCKET_INITIALIZER_MIXIN public RemoteDatabase {
                                                    int port,
                                                    double timeout_connect);
 
+    /** Key for our connection in the connection pool ("host:port").
+     *
+     *  Empty if the connection shouldn't be returned to the pool.
+     */
+    std::string pool_key;
+
+    /// Set pool_key from @a hostname and @a port.
+    void set_pool_key(std::string_view hostname, int port);
+
+    /// Constructor which reuses a connection from the connection pool.
+    RemoteTcpClient(IdleRemoteConnection&& idle, std::string&& key,
+                    double timeout_)
+        : RemoteDatabase(std::move(idle), timeout_),
+          pool_key(std::move(key)) { }
+
+    /// Return our connection to the connection pool, if we can.
+    void return_to_pool();
+
   public:
     /** Constructor.
      *
@@ -78,10 +98,47 @@ class RemoteTcpClient : SOCKET_INITIALIZER_MIXIN public RemoteDatabase {
                     double timeout_, double timeout_connect, bool writable,
                     int flags)
         : RemoteDatabase(open_socket(hostname, port, timeout_connect),
-                         timeout_, writable, flags) { }
+                         timeout_, writable, flags) {
+        if (!writable) set_pool_key(hostname, port);
+    }
+
+    /** Constructor for a group of replicas.
+     *
+     *  Attempts to open a TCP/IP connection to the best of the xapian-tcpsrv
+     *  servers in @a replicas_, and uses the others for hedged requests.
+     *
+     *  @param timeout          Timeout during communication after successfully
+     *                          connecting (in seconds).
+     */
+    RemoteTcpClient(std::unique_ptr<RemoteReplicas> replicas_,
+                    double timeout_)
+        : RemoteDatabase(replicas_->open_socket(), timeout_, false, 0) {
+        replicas = std::move(replicas_);
+    }
+
+    /** Open a read-only connection to xapian-tcpsrv.
+     *
+     *  If there's an idle connection to the same server in the connection
+     *  pool then it's reused, otherwise a new connection is opened.
+     *
+     *  @param timeout_connect  Timeout for trying to connect (in seconds).
+     *  @param timeout          Timeout during communication after successfully
+     *                          connecting (in seconds).
+     */
+    static RemoteTcpClient* open(std::string_view hostname, int port,
+                                 double timeout_, double timeout_connect);
+
+    /** Set the maximum number of idle connections to keep for each server.
+     *
+     *  @param max_idle  The maximum number (0 disables the connection pool and
+     *                   closes any idle connections in it).
+     */
+    static void set_pool_size(unsigned max_idle);
 
     /** Destructor. */
     ~RemoteTcpClient();
+
+    void close();
 };
 
 #endif  // XAPIAN_INCLUDED_REMOTETCPCLIENT_H
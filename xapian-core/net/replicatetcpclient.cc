@@ -1,7 +1,7 @@
 /** @file
  *  @brief TCP/IP replication client class.
  */
-/* Copyright (C) 2008,2010,2011,2015 Olly Betts
+/* Copyright (C) 2008,2010,2011,2015,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -46,6 +46,12 @@ ReplicateTcpClient::open_socket(const string & hostname, int port,
                                   string());
 }
 
+bool
+ReplicateTcpClient::compression_available(Compression::codec codec)
+{
+    return Compression::codec_available(codec);
+}
+
 void
 ReplicateTcpClient::update_from_master(const std::string & path,
                                        const std::string & masterdb,
@@ -54,6 +60,9 @@ ReplicateTcpClient::update_from_master(const std::string & path,
                                        bool force_copy)
 {
     Xapian::DatabaseReplica replica(path);
+    if (compression != Compression::CODEC_MAX_) {
+        remconn.send_message('C', string(1, char(compression)), 0.0);
+    }
     remconn.send_message('R',
                          force_copy ? string() : replica.get_revision_info(),
                          0.0);
@@ -1,7 +1,7 @@
 /** @file
  *  @brief TCP/IP replication client class.
  */
-/* Copyright (C) 2008,2010,2011,2015 Olly Betts
+/* Copyright (C) 2008,2010,2011,2015,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -47,6 +47,9 @@ class XAPIAN_VISIBILITY_DEFAULT ReplicateTcpClient SOCKET_INITIALIZER_MIXIN {
     /// Write-only connection to the server.
     OwnedRemoteConnection remconn;
 
+    /// Codec to ask the server to compress with, or CODEC_MAX_ for none.
+    Compression::codec compression = Compression::CODEC_MAX_;
+
     /** Attempt to open a TCP/IP socket connection to a replication server.
      *
      *  Connect to replication server running on port @a port of host @a hostname.
@@ -73,6 +76,23 @@ class XAPIAN_VISIBILITY_DEFAULT ReplicateTcpClient SOCKET_INITIALIZER_MIXIN {
     ReplicateTcpClient(const std::string & hostname, int port,
                        double timeout_connect, double socket_timeout);
 
+    /** Ask the server to compress what it sends.
+     *
+     *  The server will use @a codec if it supports it, and zlib otherwise.
+     *  Servers older than Xapian 2.1.0 don't support compression and will
+     *  reject the request.
+     *
+     *  @param codec  The codec to ask for.
+     */
+    void set_compression(Compression::codec codec) { compression = codec; }
+
+    /** Is support for compressing with @a codec compiled in?
+     *
+     *  Client programs can use this to check a codec they've been asked to
+     *  use.
+     */
+    static bool compression_available(Compression::codec codec);
+
     void update_from_master(const std::string & path,
                             const std::string & remotedb,
                             Xapian::ReplicationInfo & info,
@@ -1,7 +1,7 @@
 /** @file
  * @brief TCP/IP replication server class.
  */
-/* Copyright (C) 2008,2010,2011 Olly Betts
+/* Copyright (C) 2008,2010,2011,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -39,9 +39,29 @@ ReplicateTcpServer::handle_one_connection(int socket)
 {
     RemoteConnection client(socket, -1);
     try {
-        // Read start_revision from the client.
+        // Read start_revision from the client, which may first ask us to
+        // compress what we send.
         string start_revision;
-        if (client.get_message(start_revision, 0.0) != 'R') {
+        int type = client.get_message(start_revision, 0.0);
+        Compression::codec compression = Compression::CODEC_MAX_;
+        if (type == 'C') {
+            if (start_revision.size() != 1) {
+                throw Xapian::NetworkError("Bad compression request");
+            }
+            unsigned char codec = start_revision[0];
+            if (codec >= Compression::CODEC_MAX_) {
+                throw Xapian::NetworkError("Bad compression request");
+            }
+            compression = Compression::codec(codec);
+            // Fall back to zlib, which is always supported, if we don't
+            // support the requested codec.  The replica can decompress
+            // whichever codec was used.
+            if (!Compression::codec_available(compression)) {
+                compression = Compression::ZLIB;
+            }
+            type = client.get_message(start_revision, 0.0);
+        }
+        if (type != 'R') {
             throw Xapian::NetworkError("Bad replication client message");
         }
 
@@ -58,6 +78,8 @@ ReplicateTcpServer::handle_one_connection(int socket)
         dbpath += '/';
         dbpath += dbname;
         Xapian::DatabaseMaster master(dbpath);
+        if (compression != Compression::CODEC_MAX_)
+            master.set_compression(compression);
         master.write_changesets_to_fd(socket, start_revision, NULL);
     } catch (...) {
         // Ignore exceptions.
@@ -43,10 +43,32 @@
 # include <sys/wait.h>
 #endif
 
+#if defined HAVE_STD_THREAD && !defined __WIN32__ && \
+    (defined HAVE_SYS_EPOLL_H || defined HAVE_POLL)
+# define USE_RUN_THREADED
+# ifdef HAVE_SYS_EPOLL_H
+#  include <sys/epoll.h>
+# else
+#  include <poll.h>
+# endif
+# include <condition_variable>
+# include <deque>
+# include <iterator>
+# include <map>
+# include <memory>
+# include <mutex>
+# include <system_error>
+# include <thread>
+# include <utility>
+# include <vector>
+# include "realtime.h"
+#endif
+
 #include <iostream>
 #include <limits>
 
 #include <cerrno>
+#include <cmath>
 #include <cstring>
 #include <cstdlib>
 #include <sys/types.h>
@@ -54,11 +76,11 @@
 using namespace std;
 
 // The parent process/main thread sits in a loop which calls accept() and
-// then passes the connection off to a new process/threadm so we should accept
-// connections promptly and shouldn't need to handle a large backlog.
-//
-// We've been using 5 for this since 2006 without anyone reporting a problem.
-#define LISTEN_BACKLOG 5
+// then passes the connection off to a new process/thread so we should accept
+// connections promptly, but a client tier which opens many connections at
+// once can easily overflow a small backlog (we used 5 from 2006 until 2026)
+// and then has to wait for SYN retransmission, so use the system maximum.
+#define LISTEN_BACKLOG SOMAXCONN
 
 /** Create a listening socket ready to accept connections.
  *
@@ -240,6 +262,12 @@ TcpServer::accept_connection()
     }
 #endif
 
+    return accept_waiting_connection();
+}
+
+int
+TcpServer::accept_waiting_connection()
+{
     struct sockaddr_storage client_address;
     SOCKLEN_T client_address_size = sizeof(client_address);
     int connection = accept(listener,
@@ -463,6 +491,337 @@ TcpServer::run()
 # error Neither HAVE_FORK nor __WIN32__ are defined.
 #endif
 
+#ifdef USE_RUN_THREADED
+
+/// Per-connection state for run_threaded().
+struct ThreadedConnection {
+    /// The connection.
+    unique_ptr<TcpServer::Connection> conn;
+
+    /// The socket for the connection.
+    int socket;
+
+    /** Entry in the map of idle timeouts.
+     *
+     *  Only valid while we're waiting for input and the connection has an
+     *  idle timeout.
+     */
+    multimap<double, ThreadedConnection*>::iterator timeout;
+};
+
+/** Wait for any of a set of file descriptors to become readable.
+ *
+ *  Uses epoll() if available, or else poll().
+ */
+class ReadablePoller {
+#ifdef HAVE_SYS_EPOLL_H
+    /// The epoll file descriptor.
+    int epfd;
+#else
+    /// The file descriptors to wait for, with the data for each.
+    map<int, void*> fds;
+
+    /// Array to pass to poll().
+    vector<struct pollfd> pfds;
+#endif
+
+  public:
+    ReadablePoller() {
+#ifdef HAVE_SYS_EPOLL_H
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (epfd < 0)
+            throw Xapian::NetworkError("epoll_create1 failed", errno);
+#endif
+    }
+
+    ~ReadablePoller() {
+#ifdef HAVE_SYS_EPOLL_H
+        close(epfd);
+#endif
+    }
+
+    /// Start waiting for @a fd, reporting it as @a data.
+    void add(int fd, void* data) {
+#ifdef HAVE_SYS_EPOLL_H
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = data;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event) < 0)
+            throw Xapian::NetworkError("epoll_ctl failed", errno);
+#else
+        fds[fd] = data;
+#endif
+    }
+
+    /// Stop waiting for @a fd.
+    void remove(int fd) {
+#ifdef HAVE_SYS_EPOLL_H
+        // Linux < 2.6.9 requires a non-NULL event pointer.
+        struct epoll_event event;
+        if (epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &event) < 0)
+            throw Xapian::NetworkError("epoll_ctl failed", errno);
+#else
+        fds.erase(fd);
+#endif
+    }
+
+    /** Wait until at least one file descriptor is readable.
+     *
+     *  @param timeout  Timeout in milliseconds, or -1 to wait indefinitely.
+     *  @param result   The data for the readable file descriptors is appended
+     *                  to this.
+     */
+    void wait(int timeout, vector<void*>& result) {
+#ifdef HAVE_SYS_EPOLL_H
+        struct epoll_event events[64];
+        int n = epoll_wait(epfd, events, int(std::size(events)), timeout);
+        if (n < 0) {
+            if (errno == EINTR) return;
+            throw Xapian::NetworkError("epoll_wait failed", errno);
+        }
+        for (int i = 0; i != n; ++i) {
+            result.push_back(events[i].data.ptr);
+        }
+#else
+        pfds.clear();
+        for (auto&& i : fds) {
+            struct pollfd pfd;
+            pfd.fd = i.first;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            pfds.push_back(pfd);
+        }
+        int n = poll(pfds.data(), pfds.size(), timeout);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) return;
+            throw Xapian::NetworkError("poll failed", errno);
+        }
+        for (auto&& pfd : pfds) {
+            if (pfd.revents) result.push_back(fds[pfd.fd]);
+        }
+#endif
+    }
+};
+
+void
+TcpServer::run_threaded(unsigned n_threads,
+                        const function<Connection*(int)>& open_connection)
+{
+    if (n_threads == 0) {
+        throw Xapian::InvalidArgumentError("run_threaded() needs at least "
+                                           "one thread");
+    }
+
+    ReadablePoller poller;
+
+    // Worker threads write a byte to this pipe to wake up the main thread
+    // when they've finished with a connection.
+    int wake_fds[2];
+    if (pipe(wake_fds) < 0)
+        throw Xapian::NetworkError("pipe failed", errno);
+    try {
+        for (int fd : wake_fds) {
+            (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+            // Workers mustn't ever block writing to the pipe - if it's full
+            // then the main thread is going to wake up anyway.
+            if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0)
+                throw Xapian::NetworkError("fcntl O_NONBLOCK failed", errno);
+        }
+        // We use the address of wake_fds to identify the wake up pipe, and
+        // NULL to identify the listening socket.
+        poller.add(listener, nullptr);
+        poller.add(wake_fds[0], wake_fds);
+    } catch (...) {
+        close(wake_fds[0]);
+        close(wake_fds[1]);
+        throw;
+    }
+
+    // Connections with input to process.
+    mutex ready_mutex;
+    condition_variable ready_cond;
+    deque<ThreadedConnection*> ready;
+
+    // Connections which a worker has finished with, and whether to keep them
+    // open.
+    mutex done_mutex;
+    vector<pair<ThreadedConnection*, bool>> done;
+
+    auto worker = [&]() {
+        while (true) {
+            ThreadedConnection* c;
+            {
+                unique_lock<mutex> lock(ready_mutex);
+                ready_cond.wait(lock, [&]() { return !ready.empty(); });
+                c = ready.front();
+                ready.pop_front();
+            }
+            bool keep = false;
+            try {
+                keep = c->conn->handle_input();
+            } catch (const Xapian::Error& e) {
+                cerr << "Caught " << e.get_description() << '\n';
+            } catch (...) {
+                cerr << "Caught unknown exception\n";
+            }
+            {
+                lock_guard<mutex> lock(done_mutex);
+                done.emplace_back(c, keep);
+            }
+            char ch = 0;
+            if (write(wake_fds[1], &ch, 1) < 0) {
+                // EAGAIN means the pipe is full, which is fine.
+            }
+        }
+    };
+
+    // Once any worker thread is started this method must never return or
+    // throw, as the worker threads refer to the local variables above.  If
+    // we can't start all the threads we asked for, make do with those we
+    // could start.
+    for (unsigned i = 0; i != n_threads; ++i) {
+        try {
+            thread(worker).detach();
+        } catch (const std::system_error& e) {
+            if (i == 0) {
+                close(wake_fds[0]);
+                close(wake_fds[1]);
+                throw Xapian::NetworkError("Failed to start worker thread",
+                                           e.code().value());
+            }
+            cerr << "Only started " << i << " of " << n_threads
+                 << " worker threads: " << e.what() << '\n';
+            break;
+        }
+    }
+
+    // Idle connections which have a timeout, ordered by when it expires.
+    multimap<double, ThreadedConnection*> timeouts;
+
+    auto close_connection = [&](ThreadedConnection* c) {
+        c->conn.reset();
+        CLOSESOCKET(c->socket);
+        delete c;
+        if (verbose) cout << "Connection closed.\n";
+    };
+
+    auto wait_for_input = [&](ThreadedConnection* c) {
+        double idle_timeout = c->conn->get_idle_timeout();
+        if (idle_timeout > 0) {
+            c->timeout = timeouts.emplace(RealTime::now() + idle_timeout, c);
+        } else {
+            c->timeout = timeouts.end();
+        }
+        try {
+            poller.add(c->socket, c);
+        } catch (...) {
+            if (c->timeout != timeouts.end()) timeouts.erase(c->timeout);
+            close_connection(c);
+            throw;
+        }
+    };
+
+    auto dispatch = [&](ThreadedConnection* c) {
+        {
+            lock_guard<mutex> lock(ready_mutex);
+            ready.push_back(c);
+        }
+        ready_cond.notify_one();
+    };
+
+    vector<void*> readable;
+    vector<pair<ThreadedConnection*, bool>> finished;
+    while (true) {
+        try {
+            int timeout = -1;
+            if (!timeouts.empty()) {
+                double now = RealTime::now();
+                while (!timeouts.empty() && timeouts.begin()->first <= now) {
+                    ThreadedConnection* c = timeouts.begin()->second;
+                    timeouts.erase(timeouts.begin());
+                    // Make sure the connection gets closed even if either of
+                    // these throws.
+                    try {
+                        poller.remove(c->socket);
+                        c->conn->idle_timeout_expired();
+                    } catch (...) {
+                        close_connection(c);
+                        throw;
+                    }
+                    close_connection(c);
+                }
+                if (!timeouts.empty()) {
+                    double delay = timeouts.begin()->first - now;
+                    timeout = int(ceil(delay * 1000.0));
+                }
+            }
+
+            readable.clear();
+            poller.wait(timeout, readable);
+            for (void* p : readable) {
+                if (p == nullptr) {
+                    int fd = accept_waiting_connection();
+                    Connection* conn;
+                    try {
+                        conn = open_connection(fd);
+                    } catch (...) {
+                        CLOSESOCKET(fd);
+                        throw;
+                    }
+                    ThreadedConnection* c = new ThreadedConnection;
+                    c->conn.reset(conn);
+                    c->socket = fd;
+                    wait_for_input(c);
+                } else if (p == wake_fds) {
+                    char buf[256];
+                    while (read(wake_fds[0], buf, sizeof(buf)) > 0) { }
+                    {
+                        lock_guard<mutex> lock(done_mutex);
+                        finished.insert(finished.end(),
+                                        done.begin(), done.end());
+                        done.clear();
+                    }
+                    // Remove each entry before handling it so that if an
+                    // exception is thrown the rest still get handled next
+                    // time around.
+                    while (!finished.empty()) {
+                        auto [c, keep] = finished.back();
+                        finished.pop_back();
+                        if (!keep) {
+                            close_connection(c);
+                        } else if (c->conn->input_pending()) {
+                            dispatch(c);
+                        } else {
+                            wait_for_input(c);
+                        }
+                    }
+                } else {
+                    ThreadedConnection* c =
+                        static_cast<ThreadedConnection*>(p);
+                    poller.remove(c->socket);
+                    if (c->timeout != timeouts.end()) timeouts.erase(c->timeout);
+                    dispatch(c);
+                }
+            }
+        } catch (const Xapian::Error& e) {
+            cerr << "Caught " << e.get_description() << '\n';
+        } catch (...) {
+            cerr << "Caught unknown exception\n";
+        }
+    }
+}
+
+#else
+
+void
+TcpServer::run_threaded(unsigned, const function<Connection*(int)>&)
+{
+    throw Xapian::FeatureUnavailableError("Threaded server mode not "
+                                          "supported on this platform");
+}
+
+#endif
+
 void
 TcpServer::run_once()
 {
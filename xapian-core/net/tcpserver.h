@@ -1,7 +1,7 @@
 /** @file
  *  @brief Generic TCP/IP socket based server base class.
  */
-/* Copyright (C) 2007,2008,2023 Olly Betts
+/* Copyright (C) 2007,2008,2023,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -30,6 +30,7 @@
 
 #include <xapian/visibility.h>
 
+#include <functional>
 #include <string>
 
 /** Generic TCP/IP socket based server base class. */
@@ -51,7 +52,52 @@ class XAPIAN_VISIBILITY_DEFAULT TcpServer SOCKET_INITIALIZER_MIXIN {
     XAPIAN_VISIBILITY_INTERNAL
     int accept_connection();
 
+    /** Accept a connection which we know is waiting.
+     *
+     *  @return The file descriptor for the connection.
+     */
+    XAPIAN_VISIBILITY_INTERNAL
+    int accept_waiting_connection();
+
   public:
+    /** A connection being serviced by run_threaded().
+     *
+     *  Between messages the connection isn't associated with any thread, so
+     *  an idle connection only costs the memory for this object.
+     */
+    class Connection {
+      public:
+        /// Virtual destructor as we delete subclasses via this class.
+        virtual ~Connection() { }
+
+        /** Process input from the client.
+         *
+         *  Called by a worker thread when input is available.
+         *
+         *  @return false if the connection should be closed.
+         */
+        virtual bool handle_input() = 0;
+
+        /** Is there input already read which needs processing?
+         *
+         *  If this returns true, handle_input() gets called again without
+         *  waiting for the socket to become readable.
+         */
+        virtual bool input_pending() const = 0;
+
+        /** Timeout while waiting for input (in seconds).
+         *
+         *  If this is 0 then the connection will wait indefinitely.
+         */
+        virtual double get_idle_timeout() const = 0;
+
+        /** Called when the idle timeout expires.
+         *
+         *  The connection is closed after this returns.
+         */
+        virtual void idle_timeout_expired() { }
+    };
+
     /** Construct a TcpServer and start listening for connections.
      *
      *  @param host         The hostname or address for the interface to listen
@@ -80,6 +126,24 @@ class XAPIAN_VISIBILITY_DEFAULT TcpServer SOCKET_INITIALIZER_MIXIN {
      */
     void run();
 
+    /** Accept connections and service requests indefinitely using threads.
+     *
+     *  This method runs the TcpServer as a daemon in a single process.  The
+     *  thread which calls it waits for connections and for input on existing
+     *  connections (using epoll() where available, or else poll()), and hands
+     *  connections with input to a fixed pool of worker threads.
+     *
+     *  @param n_threads        The number of worker threads to use.
+     *  @param open_connection  Function to create a Connection for an
+     *                          already connected socket.  This is always
+     *                          called from the thread which called
+     *                          run_threaded().  The Connection is also
+     *                          destroyed by that thread, after which the
+     *                          socket gets closed.
+     */
+    void run_threaded(unsigned n_threads,
+                      const std::function<Connection*(int)>& open_connection);
+
     /** Accept a single connection, service requests on it, then stop.  */
     void run_once();
 
@@ -1057,6 +1057,30 @@ DEFINE_TESTCASE(fetchdocs1, backend) {
     TEST_EQUAL(it1, mymset2.end());
 }
 
+// test prefetched documents are correct when other requests happen first
+DEFINE_TESTCASE(fetchdocs2, backend) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    Xapian::Enquire enquire(db);
+    enquire.set_query(query(Xapian::Query::OP_OR, "this", "word"));
+
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    TEST_REL(mset.size(), >, 2);
+    mset.fetch();
+
+    // Run another query and make other calls before reading the documents.
+    enquire.set_query(Xapian::Query("paragraph"));
+    Xapian::MSet mset2 = enquire.get_mset(0, 10);
+    TEST(!mset2.empty());
+    TEST_REL(db.get_doclength(*mset2[0]), >, 0);
+
+    // Read the documents in reverse order.
+    for (auto i = mset.size(); i > 0; --i) {
+        Xapian::docid did = *mset[i - 1];
+        TEST_EQUAL(mset[i - 1].get_document().get_data(),
+                   db.get_document(did).get_data());
+    }
+}
+
 // test that searching for a term not in the database fails nicely
 DEFINE_TESTCASE(absentterm1, backend) {
     Xapian::Enquire enquire(get_database("apitest_simpledata"));
@@ -1,7 +1,7 @@
 /** @file
  * @brief Backend-related tests.
  */
-/* Copyright (C) 2008-2023 Olly Betts
+/* Copyright (C) 2008-2026 Olly Betts
  * Copyright (C) 2010 Richard Boulton
  *
  * This program is free software; you can redistribute it and/or
@@ -26,9 +26,12 @@
 #include <xapian.h>
 
 #include "backendmanager.h"
+#include "backends/honey/honey_defs.h"
+#include "dbcheck.h"
 #include "errno_to_string.h"
 #include "filetests.h"
 #include "net/resolver.h"
+#include "setenv.h"
 #include "str.h"
 #include "socket_utils.h"
 #include "testrunner.h"
@@ -48,7 +51,16 @@
 # include "safesyswait.h"
 #endif
 
+#if defined HAVE_STD_THREAD && defined HAVE_POLL && !defined __WIN32__
+# include <atomic>
+# include <poll.h>
+# include <thread>
+# include <netinet/in.h>
+# include "safesyssocket.h"
+#endif
+
 #include <cerrno>
+#include <cmath>
 #include <fstream>
 #include <iterator>
 
@@ -1198,6 +1210,215 @@ DEFINE_TESTCASE(notermlist1, glass) {
     TEST_EXCEPTION(Xapian::FeatureUnavailableError, db.termlist_begin(1));
 }
 
+// Restore XAPIAN_FLUSH_THRESHOLD so we don't affect the next testcase, even
+// if this one exits with an exception.  An empty value means the default.
+struct restore_flush_threshold_helper_ {
+    string saved;
+    restore_flush_threshold_helper_() {
+        const char* p = getenv("XAPIAN_FLUSH_THRESHOLD");
+        if (p) saved = p;
+    }
+    ~restore_flush_threshold_helper_() {
+        setenv("XAPIAN_FLUSH_THRESHOLD", saved.c_str(), 1);
+    }
+};
+
+/// Feature test for Xapian::DB_BULK_LOAD.
+DEFINE_TESTCASE(bulkload1, glass) {
+    string path = get_named_writable_database_path("bulkload1");
+    string ref_path = get_named_writable_database_path("bulkload1ref");
+    rm_rf(path);
+    rm_rf(ref_path);
+    // Check that run files left by a process which was killed get removed.
+    {
+        Xapian::WritableDatabase db(path,
+                                    Xapian::DB_CREATE|Xapian::DB_BACKEND_GLASS);
+    }
+    touch(path + "/bulk3.tmp");
+    touch(path + "/bulkfoo.tmp");
+
+    // Use a small flush threshold so we get enough runs that some get merged
+    // before commit.
+    restore_flush_threshold_helper_ restore_threshold_afterwards;
+    setenv("XAPIAN_FLUSH_THRESHOLD", "3", 1);
+    Xapian::WritableDatabase db(path, Xapian::DB_BACKEND_GLASS|
+                                      Xapian::DB_BULK_LOAD);
+    Xapian::WritableDatabase ref(ref_path,
+                                 Xapian::DB_CREATE|Xapian::DB_BACKEND_GLASS);
+    TEST(!file_exists(path + "/bulk3.tmp"));
+    TEST(file_exists(path + "/bulkfoo.tmp"));
+
+    auto make_doc = [](unsigned i) {
+        Xapian::Document doc;
+        doc.add_posting("all", i % 5 + 1);
+        doc.add_term("mod" + str(i % 7), i % 3 + 1);
+        doc.add_posting("t" + str(i), 1);
+        doc.add_posting("t" + str(i), 3);
+        return doc;
+    };
+    for (unsigned i = 1; i <= 200; ++i) {
+        Xapian::Document doc = make_doc(i);
+        db.add_document(doc);
+        ref.add_document(doc);
+        if (i == 10) {
+            // The first run should have been spilled to disk by now.
+            TEST(file_exists(path + "/bulk0.tmp"));
+            // Reading would require merging the runs, so isn't allowed.
+            TEST_EXCEPTION(Xapian::InvalidOperationError,
+                           db.get_doclength(1));
+            TEST_EXCEPTION(Xapian::InvalidOperationError,
+                           db.postlist_begin("all"));
+            TEST_EXCEPTION(Xapian::InvalidOperationError,
+                           db.positionlist_begin(1, "t1"));
+            TEST_EXCEPTION(Xapian::InvalidOperationError,
+                           db.get_termfreq("all"));
+        }
+    }
+    // The changes shouldn't be visible to a reader before commit.
+    TEST_EQUAL(Xapian::Database(path).get_doccount(), 0);
+
+    // Replacing a document beyond the end can be written to a run.
+    db.replace_document(300, make_doc(300));
+    ref.replace_document(300, make_doc(300));
+    for (unsigned i = 301; i <= 310; ++i) {
+        Xapian::Document doc = make_doc(i);
+        db.add_document(doc);
+        ref.add_document(doc);
+    }
+
+    // Deleting and replacing existing documents needs the runs merged first.
+    db.delete_document(7);
+    ref.delete_document(7);
+    db.replace_document(8, make_doc(1000));
+    ref.replace_document(8, make_doc(1000));
+    for (unsigned i = 311; i <= 330; ++i) {
+        Xapian::Document doc = make_doc(i);
+        db.add_document(doc);
+        ref.add_document(doc);
+    }
+    db.commit();
+    ref.commit();
+    TEST(!file_exists(path + "/bulk0.tmp"));
+
+    auto positions = [](const Xapian::Database& d, Xapian::docid did,
+                        const string& term) {
+        string result;
+        for (auto p = d.positionlist_begin(did, term);
+             p != d.positionlist_end(did, term); ++p) {
+            result += str(*p);
+            result += ' ';
+        }
+        return result;
+    };
+
+    Xapian::Database rdb(path);
+    TEST_EQUAL(rdb.get_doccount(), ref.get_doccount());
+    TEST_EQUAL(rdb.get_lastdocid(), ref.get_lastdocid());
+    TEST_EQUAL(rdb.get_total_length(), ref.get_total_length());
+    Xapian::TermIterator r = ref.allterms_begin();
+    for (auto t = rdb.allterms_begin(); t != rdb.allterms_end(); ++t) {
+        TEST(r != ref.allterms_end());
+        TEST_EQUAL(*t, *r);
+        TEST_EQUAL(t.get_termfreq(), r.get_termfreq());
+        TEST_EQUAL(rdb.get_collection_freq(*t), ref.get_collection_freq(*r));
+        Xapian::PostingIterator q = ref.postlist_begin(*r);
+        for (auto p = rdb.postlist_begin(*t); p != rdb.postlist_end(*t); ++p) {
+            TEST(q != ref.postlist_end(*r));
+            TEST_EQUAL(*p, *q);
+            TEST_EQUAL(p.get_wdf(), q.get_wdf());
+            TEST_EQUAL(p.get_doclength(), q.get_doclength());
+            TEST_EQUAL(rdb.get_doclength(*p), ref.get_doclength(*q));
+            TEST_EQUAL(positions(rdb, *p, *t), positions(ref, *q, *r));
+            ++q;
+        }
+        TEST(q == ref.postlist_end(*r));
+        ++r;
+    }
+    TEST(r == ref.allterms_end());
+    TEST_EXCEPTION(Xapian::DocNotFoundError, rdb.get_doclength(7));
+}
+
+/// Feature test for Xapian::DB_COMPRESS_LZ4 and Xapian::DB_COMPRESS_ZSTD.
+DEFINE_TESTCASE(compresscodec1, glass) {
+    string path = get_named_writable_database_path("compresscodec1");
+    string out_path = get_compaction_output_path("compresscodec1");
+    string honey_path = out_path + "honey";
+    string honey2_path = out_path + "honey2";
+    rm_rf(path);
+    // Specifying both is an error, and shouldn't create anything.
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+                   Xapian::WritableDatabase(path,
+                                            Xapian::DB_CREATE|
+                                            Xapian::DB_BACKEND_GLASS|
+                                            Xapian::DB_COMPRESS_LZ4|
+                                            Xapian::DB_COMPRESS_ZSTD));
+    TEST(!dir_exists(path));
+
+    // Test with the default codec (zlib), which is always available, as well
+    // as LZ4 and Zstandard if they're enabled.
+    for (int codec_flag : { 0,
+                            Xapian::DB_COMPRESS_LZ4,
+                            Xapian::DB_COMPRESS_ZSTD }) {
+        rm_rf(path);
+        int flags = Xapian::DB_CREATE|Xapian::DB_BACKEND_GLASS|codec_flag;
+        Xapian::WritableDatabase db;
+        try {
+            db = Xapian::WritableDatabase(path, flags);
+        } catch (const Xapian::FeatureUnavailableError&) {
+            // This codec isn't enabled.
+            TEST(!dir_exists(path));
+            continue;
+        }
+        for (unsigned i = 1; i <= 100; ++i) {
+            Xapian::Document doc;
+            string data;
+            for (unsigned j = 0; j < i; ++j) {
+                data += "compressible data ";
+                doc.add_term("term" + str(j));
+            }
+            doc.set_data(data);
+            db.add_document(doc);
+        }
+        db.commit();
+        db.close();
+
+        // Check data and termlists are read back correctly, and again after
+        // compacting (which copies compressed tags as they are) to glass and
+        // to honey, and then from honey to honey.
+        Xapian::Database(path).compact(out_path);
+        rm_rf(honey_path);
+        Xapian::Database(path).compact(honey_path, Xapian::DB_BACKEND_HONEY);
+        rm_rf(honey2_path);
+        Xapian::Database(honey_path).compact(honey2_path);
+        for (const string& p : { path, out_path, honey_path, honey2_path }) {
+            Xapian::Database rdb(p);
+            TEST_EQUAL(rdb.get_doccount(), 100);
+            for (unsigned i = 1; i <= 100; ++i) {
+                Xapian::Document doc = rdb.get_document(i);
+                TEST_EQUAL(doc.get_data().size(), i * 18);
+                TEST_EQUAL(doc.termlist_count(), i);
+            }
+            TEST_EQUAL(Xapian::Database::check(p), 0);
+        }
+
+        // Honey tables with tags compressed with LZ4 or Zstandard must be
+        // flagged so that older versions reject them, but tables which only
+        // use zlib mustn't be, so older versions can still read them.  The
+        // postlist table isn't compressed.
+        for (const string& p : { honey_path, honey2_path }) {
+            for (unsigned t : { Honey::POSTLIST,
+                                Honey::DOCDATA,
+                                Honey::TERMLIST }) {
+                bool tag_codecs = (honey_format_flags(p, t) &
+                                   Honey::FORMAT_TAG_CODECS);
+                tout << p << " table " << t << '\n';
+                TEST_EQUAL(tag_codecs,
+                           codec_flag != 0 && t != Honey::POSTLIST);
+            }
+        }
+    }
+}
+
 /// Regression test for bug starting a new glass freelist block.
 DEFINE_TESTCASE(newfreelistblock1, writable) {
     Xapian::Document doc;
@@ -2010,6 +2231,495 @@ DEFINE_TESTCASE(remoteportreuse1, remotetcp) {
     }
 }
 
+/// Test Remote::open_replicas() and replica groups in stub files.
+DEFINE_TESTCASE(remotereplicas1, remotetcp) {
+    // The test harness runs xapian-tcpsrv with --one-shot so we can't open
+    // extra connections to the servers it starts, but we can test the
+    // handling of bad replica groups and of failing to connect.
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+                   Xapian::Remote::open_replicas("127.0.0.1"));
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+                   Xapian::Remote::open_replicas("127.0.0.1:1 localhost:0"));
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+                   Xapian::Remote::open_replicas(" "));
+
+    // Nothing should be listening on port 1, and we should report the error
+    // once we've tried all the replicas.
+    TEST_EXCEPTION(Xapian::NetworkError,
+                   Xapian::Remote::open_replicas("127.0.0.1:1 [::1]:1"));
+
+    mkdir(".stub", 0755);
+    const char* stubpath = ".stub/remotereplicas1";
+    {
+        ofstream out(stubpath);
+        TEST(out.is_open());
+        out << "remote 127.0.0.1:1 127.0.0.1:1\n";
+    }
+    TEST_EXCEPTION(Xapian::NetworkError,
+                   Xapian::Database db(stubpath));
+    TEST_EXCEPTION(Xapian::DatabaseOpeningError,
+                   Xapian::WritableDatabase db(stubpath, Xapian::DB_OPEN));
+}
+
+// Ensure that we don't leave the connection pool enabled for the next
+// testcase, even if this one exits with an exception.
+struct disable_connection_pool_helper_ {
+    disable_connection_pool_helper_() { }
+    ~disable_connection_pool_helper_() {
+        Xapian::Remote::set_connection_pool_size(0);
+    }
+};
+
+/// Test reusing a connection from the remote connection pool.
+DEFINE_TESTCASE(remotepool1, remotetcp) {
+    disable_connection_pool_helper_ disable_pool_afterwards;
+    Xapian::Remote::set_connection_pool_size(1);
+    int port;
+    Xapian::Database db = get_remote_database("apitest_simpledata",
+                                              300000,
+                                              &port);
+    Xapian::doccount doccount = db.get_doccount();
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query("this"));
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    TEST(!mset.empty());
+    db.close();
+
+    // The server was started with --one-shot, so this only works if the
+    // connection is reused.
+    Xapian::Database db2 = Xapian::Remote::open("127.0.0.1", port);
+    TEST_EQUAL(db2.get_doccount(), doccount);
+    Xapian::Enquire enq2(db2);
+    enq2.set_query(Xapian::Query("this"));
+    TEST(enq2.get_mset(0, 10) == mset);
+
+    // Disabling the pool should close idle connections.
+    Xapian::Remote::set_connection_pool_size(0);
+    db2.close();
+    TEST_EXCEPTION(Xapian::NetworkError,
+                   Xapian::Remote::open("127.0.0.1", port, 0, 1000));
+}
+
+/// Test MSet::fetch() prefetches documents from a remote database.
+DEFINE_TESTCASE(remoteprefetch1, remotetcp) {
+    Xapian::Database db = get_database("remoteprefetch1",
+                                       [](Xapian::WritableDatabase& wdb,
+                                          const string&) {
+                                           for (int i = 1; i <= 1500; ++i) {
+                                               Xapian::Document doc;
+                                               doc.set_data(str(i));
+                                               doc.add_term("all");
+                                               if (i > 1000)
+                                                   doc.add_term("late");
+                                               wdb.add_document(doc);
+                                           }
+                                       });
+    Xapian::Enquire enq(db);
+
+    // Request more documents than the limit on how many can be outstanding,
+    // but only open one of them, which reads the rest.
+    enq.set_query(Xapian::Query("all"));
+    Xapian::MSet mset = enq.get_mset(0, 1500);
+    TEST_EQUAL(mset.size(), 1500);
+    mset.fetch();
+    TEST_EQUAL(mset.begin().get_document().get_data(), str(*mset.begin()));
+
+    // Those should be discarded by the next query, so prefetching works
+    // for its results.
+    enq.set_query(Xapian::Query("late"));
+    mset = enq.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), 10);
+    mset.fetch();
+
+    // Once the server has replied to a later request it must have sent the
+    // documents, so we can kill it and still open them.
+    db.keep_alive();
+    kill_remote(db);
+    for (auto i = mset.begin(); i != mset.end(); ++i) {
+        TEST_EQUAL(i.get_document().get_data(), str(*i));
+    }
+    // A document which wasn't prefetched has to be read from the server.
+    TEST_EXCEPTION_BASE_CLASS(Xapian::NetworkError, db.get_document(1));
+}
+
+/// Test xapian-tcpsrv --threads.
+DEFINE_TESTCASE(remotethreaded1, remotetcp) {
+#if !defined HAVE_STD_THREAD || defined __WIN32__ || \
+    !(defined HAVE_SYS_EPOLL_H || defined HAVE_POLL)
+    SKIP_TEST("Threaded server mode not supported on this platform");
+#else
+    Xapian::Query query(Xapian::Query::OP_OR,
+                        Xapian::Query("king"), Xapian::Query("queen"));
+    Xapian::Enquire enq(get_database("etext"));
+    enq.set_query(query);
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    TEST(!mset.empty());
+
+    int port = start_remote_server("etext", "--threads 2 --idle-timeout 1000");
+
+    // Use more connections than there are threads, and interleave requests
+    // on them.
+    vector<Xapian::Enquire> enquires;
+    for (int i = 0; i != 3; ++i) {
+        enquires.emplace_back(Xapian::Remote::open("127.0.0.1", port));
+        enquires.back().set_query(query);
+    }
+    for (int j = 0; j != 2; ++j) {
+        for (auto&& e : enquires) {
+            TEST(e.get_mset(0, 10) == mset);
+        }
+    }
+
+    // Closing a connection should allow its database handle to be reused.
+    enquires.pop_back();
+    Xapian::Enquire enq2(Xapian::Remote::open("127.0.0.1", port));
+    enq2.set_query(query);
+    TEST(enq2.get_mset(0, 10) == mset);
+
+    // Let the connections exceed the idle timeout.
+    sleep(2);
+    TEST_EXCEPTION_BASE_CLASS(Xapian::NetworkError, enq2.get_mset(0, 10));
+
+    // The server should still accept new connections.
+    Xapian::Enquire enq3(Xapian::Remote::open("127.0.0.1", port));
+    enq3.set_query(query);
+    TEST(enq3.get_mset(0, 10) == mset);
+#endif
+}
+
+static void
+make_remotecompression1_db(Xapian::WritableDatabase& db, const string&)
+{
+    for (int d = 0; d != 3; ++d) {
+        Xapian::Document doc;
+        string data;
+        for (int i = 0; i != 20000; ++i) {
+            data += "line ";
+            data += str(i * (d + 1));
+            data += '\n';
+        }
+        doc.set_data(data);
+        for (Xapian::termpos i = 1; i != 5000; ++i) {
+            doc.add_posting("term" + str(i % 2000) + "x" + str(d), i);
+        }
+        db.add_document(doc);
+    }
+}
+
+/// Test xapian-tcpsrv --compression.
+DEFINE_TESTCASE(remotecompression1, remotetcp) {
+    Xapian::Database db = get_database("remotecompression1",
+                                       make_remotecompression1_db);
+    int port = start_remote_server("remotecompression1", "--compression zlib");
+    Xapian::Database cdb = Xapian::Remote::open("127.0.0.1", port);
+    TEST_EQUAL(cdb.get_doccount(), db.get_doccount());
+
+    for (Xapian::docid did = 1; did <= db.get_lastdocid(); ++did) {
+        Xapian::Document doc = db.get_document(did);
+        Xapian::Document cdoc = cdb.get_document(did);
+        TEST_REL(cdoc.get_data().size(), >, 100000);
+        TEST(cdoc.get_data() == doc.get_data());
+        TEST_EQUAL(cdb.get_doclength(did), db.get_doclength(did));
+
+        Xapian::TermIterator t = db.termlist_begin(did);
+        Xapian::TermIterator ct = cdb.termlist_begin(did);
+        Xapian::termcount n = 0;
+        while (t != db.termlist_end(did)) {
+            TEST(ct != cdb.termlist_end(did));
+            TEST_EQUAL(*ct, *t);
+            TEST_EQUAL(ct.get_wdf(), t.get_wdf());
+            TEST_EQUAL(ct.get_termfreq(), t.get_termfreq());
+            ++t;
+            ++ct;
+            ++n;
+        }
+        TEST(ct == cdb.termlist_end(did));
+        TEST_EQUAL(n, 2000);
+    }
+
+    // Check a query which needs a large MSet to be sent back too.
+    Xapian::Enquire enq(db);
+    Xapian::Enquire cenq(cdb);
+    Xapian::Query query(Xapian::Query::OP_OR,
+                        db.allterms_begin("term"), db.allterms_end("term"));
+    enq.set_query(query);
+    cenq.set_query(query);
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), 3);
+    TEST(cenq.get_mset(0, 10) == mset);
+}
+
+/// Test xapian-tcpsrv --result-cache.
+DEFINE_TESTCASE(remoteresultcache2, remotetcp) {
+#if !defined HAVE_STD_THREAD || defined __WIN32__ || \
+    !(defined HAVE_SYS_EPOLL_H || defined HAVE_POLL)
+    SKIP_TEST("Threaded server mode not supported on this platform");
+#else
+    // To see if results come from the cache, we make two databases with the
+    // same UUID and revision, and the same statistics, but with the matching
+    // document at a different docid.  Then we swap one for the other while
+    // the server is running.
+    string path = ".remoteresultcache2";
+    string other_path = path + "-other";
+    rm_rf(path);
+    rm_rf(other_path);
+    Xapian::WritableDatabase(path, Xapian::DB_CREATE|Xapian::DB_BACKEND_GLASS);
+    cp_R(path, other_path);
+    Xapian::Document doc1, doc2;
+    doc1.add_term("cached");
+    doc2.add_term("other");
+    {
+        Xapian::WritableDatabase db(path, Xapian::DB_OPEN);
+        db.add_document(doc1);
+        db.add_document(doc2);
+        db.commit();
+    }
+    {
+        Xapian::WritableDatabase db(other_path, Xapian::DB_OPEN);
+        db.add_document(doc2);
+        db.add_document(doc1);
+        db.commit();
+    }
+
+    int port = start_remote_server_for_path(path,
+                                            "--threads 2 --result-cache 1");
+    Xapian::Query query("cached");
+    Xapian::Enquire enq1(Xapian::Remote::open("127.0.0.1", port));
+    enq1.set_query(query);
+    Xapian::MSet mset = enq1.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), 1);
+    TEST_EQUAL(*mset.begin(), 1);
+
+    // Keep the first connection open so the server can't reuse its database
+    // handle for the next connection.
+    rm_rf(path + "-old");
+    TEST(rename(path.c_str(), (path + "-old").c_str()) == 0);
+    TEST(rename(other_path.c_str(), path.c_str()) == 0);
+
+    // A repeat of the query should be answered from the cache, so give the
+    // docid from the original database.
+    Xapian::Enquire enq2(Xapian::Remote::open("127.0.0.1", port));
+    enq2.set_query(query);
+    mset = enq2.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), 1);
+    TEST_EQUAL(*mset.begin(), 1);
+
+    // A new revision should invalidate the cache.
+    {
+        Xapian::WritableDatabase db(path, Xapian::DB_OPEN);
+        db.add_document(doc2);
+        db.commit();
+    }
+    Xapian::Enquire enq3(Xapian::Remote::open("127.0.0.1", port));
+    enq3.set_query(query);
+    mset = enq3.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), 1);
+    TEST_EQUAL(*mset.begin(), 2);
+#endif
+}
+
+/// Test Enquire::set_remote_partial_results().
+DEFINE_TESTCASE(remotepartial1, remote) {
+    Xapian::Database db = get_database("etext");
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query(Xapian::Query::OP_OR,
+                                Xapian::Query("king"),
+                                Xapian::Query("queen")));
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    TEST(!mset.empty());
+
+    // Without a deadline, we should only stop early when the top results
+    // can't change.
+    enq.set_remote_partial_results(true);
+    Xapian::MSet mset2 = enq.get_mset(0, 10);
+    TEST(mset_range_is_same(mset, 0, mset2, 0, mset.size()));
+    mset2 = enq.get_mset(3, 5);
+    TEST(mset_range_is_same(mset, 3, mset2, 0, 5));
+
+    // With a deadline which has already passed we may get fewer results, but
+    // they should still be in descending weight order, and the database
+    // should still be usable afterwards.
+    enq.set_remote_partial_results(true, 1e-9);
+    mset2 = enq.get_mset(0, 10);
+    TEST_REL(mset2.size(), <=, mset.size());
+    double last_weight = HUGE_VAL;
+    for (auto i = mset2.begin(); i != mset2.end(); ++i) {
+        TEST_REL(i.get_weight(), <=, last_weight);
+        last_weight = i.get_weight();
+    }
+
+    enq.set_remote_partial_results(false);
+    TEST(mset_range_is_same(mset, 0, enq.get_mset(0, 10), 0, mset.size()));
+}
+
+#if defined HAVE_STD_THREAD && defined HAVE_POLL && !defined __WIN32__
+/** Proxy TCP connections to a server on localhost.
+ *
+ *  Calling stall() stops replies from the server being passed on, so the
+ *  server appears to have stopped responding.
+ */
+class StallingProxy {
+    int listen_fd;
+
+    int port;
+
+    int server_port;
+
+    std::atomic<bool> stalled{false};
+
+    std::atomic<bool> stopping{false};
+
+    std::thread thread;
+
+    /// Copy any data available from @a from to @a to.
+    static bool forward(int from, int to) {
+        char buf[4096];
+        ssize_t n = read(from, buf, sizeof(buf));
+        if (n <= 0) return false;
+        const char* p = buf;
+        while (n > 0) {
+            ssize_t w = write(to, p, n);
+            if (w <= 0) return false;
+            p += w;
+            n -= w;
+        }
+        return true;
+    }
+
+    /// Pass data between a client and the server until either closes.
+    void relay(int client_fd) {
+        int server_fd = socket(PF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(server_port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (server_fd >= 0 &&
+            connect(server_fd, reinterpret_cast<sockaddr*>(&addr),
+                    sizeof(addr)) == 0) {
+            pollfd fds[2];
+            fds[0].fd = client_fd;
+            fds[0].events = POLLIN;
+            fds[1].fd = server_fd;
+            fds[1].events = POLLIN;
+            while (!stopping) {
+                // While stalled, leave the replies unread.
+                bool stall = stalled;
+                fds[1].revents = 0;
+                if (poll(fds, stall ? 1 : 2, 100) < 0) break;
+                if (fds[0].revents && !forward(client_fd, server_fd)) break;
+                if (fds[1].revents && !forward(server_fd, client_fd)) break;
+            }
+        }
+        if (server_fd >= 0) close(server_fd);
+        close(client_fd);
+    }
+
+    void run() {
+        std::vector<std::thread> relays;
+        pollfd fds[1];
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        while (!stopping) {
+            if (poll(fds, 1, 100) <= 0) continue;
+            int client_fd = accept(listen_fd, NULL, NULL);
+            if (client_fd >= 0) {
+                relays.emplace_back(&StallingProxy::relay, this, client_fd);
+            }
+        }
+        for (auto&& relay_thread : relays) {
+            relay_thread.join();
+        }
+    }
+
+  public:
+    explicit StallingProxy(int server_port_) : server_port(server_port_) {
+        listen_fd = socket(PF_INET, SOCK_STREAM, 0);
+        if (listen_fd < 0) FAIL_TEST("socket() failed");
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), len) < 0 ||
+            listen(listen_fd, 5) < 0 ||
+            getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr),
+                        &len) < 0) {
+            close(listen_fd);
+            FAIL_TEST("Failed to set up listening socket");
+        }
+        port = ntohs(addr.sin_port);
+        thread = std::thread(&StallingProxy::run, this);
+    }
+
+    ~StallingProxy() {
+        stopping = true;
+        thread.join();
+        close(listen_fd);
+    }
+
+    int get_port() const { return port; }
+
+    void stall() { stalled = true; }
+};
+#endif
+
+/// Test hedged requests and failing over between live replicas.
+DEFINE_TESTCASE(remotereplicas2, remotetcp) {
+#if !defined HAVE_STD_THREAD || !defined HAVE_POLL || defined __WIN32__
+    SKIP_TEST("Test not supported on this platform");
+#else
+    Xapian::Query query(Xapian::Query::OP_OR,
+                        Xapian::Query("king"), Xapian::Query("queen"));
+    Xapian::Enquire enq(get_database("etext"));
+    enq.set_query(query);
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    TEST(!mset.empty());
+
+    // The first replica is reached via a proxy which we can make stall.
+    StallingProxy proxy(start_remote_server("etext"));
+    int port2 = start_remote_server("etext");
+    int port3 = start_remote_server("etext");
+    string replicas = "127.0.0.1:" + str(proxy.get_port());
+    replicas += " 127.0.0.1:" + str(port2);
+    replicas += " 127.0.0.1:" + str(port3);
+
+    // Only hedge once a query is slower than any recent one.
+    Xapian::Database db = Xapian::Remote::open_replicas(replicas,
+                                                        10000, 10000, 100);
+    auto using_port = [&db](int port) {
+        string context = "(127.0.0.1:" + str(port) + ")";
+        return db.get_description().find(context) != string::npos;
+    };
+    TEST(using_port(proxy.get_port()));
+
+    // Latencies are recorded for the process, so we can run enough queries
+    // to allow hedging using a connection which won't hedge, so which
+    // replica each query is run on doesn't depend on timing.
+    {
+        Xapian::Enquire warm_up(Xapian::Remote::open_replicas(replicas,
+                                                              10000, 10000,
+                                                              0));
+        warm_up.set_query(query);
+        for (int i = 0; i != 10; ++i) {
+            TEST(warm_up.get_mset(0, 10) == mset);
+        }
+    }
+
+    Xapian::Enquire renq(db);
+    renq.set_query(query);
+
+    // With the first replica not responding, the query should be sent to the
+    // next replica.
+    proxy.stall();
+    TEST(renq.get_mset(0, 10) == mset);
+    TEST(using_port(port2));
+
+    // If the replica we're using dies, we should fail over to another.
+    kill_remote_server(port2);
+    TEST(renq.get_mset(0, 10) == mset);
+    TEST(using_port(port3));
+#endif
+}
+
 // Test exception for check() on remote via stub.
 DEFINE_TESTCASE(unsupportedcheck1, path) {
     mkdir(".stub", 0755);
@@ -2074,3 +2784,121 @@ DEFINE_TESTCASE(corruptglass1, glass) {
                        Xapian::Database::check(db_path));
     }
 }
+
+static string
+multilevelindex_term(unsigned n)
+{
+    string term = "XTERM" + str(n);
+    // Pad so terms sort numerically.
+    term.insert(5, 6 - (term.size() - 5), '0');
+    return term;
+}
+
+/// Test a table big enough that honey uses a multi-level index.
+DEFINE_TESTCASE(multilevelindex1, honey) {
+    const unsigned N_DOCS = 100;
+    const unsigned TERMS_PER_DOC = 1000;
+    const unsigned N_TERMS = N_DOCS * TERMS_PER_DOC;
+    Xapian::Database db = get_database("multilevelindex1",
+                                       [](Xapian::WritableDatabase& wdb,
+                                          const string&) {
+                                           unsigned n = 0;
+                                           for (unsigned d = 0; d < N_DOCS;
+                                                ++d) {
+                                               Xapian::Document doc;
+                                               for (unsigned t = 0;
+                                                    t < TERMS_PER_DOC;
+                                                    ++t) {
+                                                   auto term =
+                                                       multilevelindex_term(n++);
+                                                   doc.add_term(term);
+                                               }
+                                               wdb.add_document(doc);
+                                           }
+                                       });
+    TEST_EQUAL(db.get_doccount(), N_DOCS);
+
+    for (unsigned n = 0; n < N_TERMS; ++n) {
+        string term = multilevelindex_term(n);
+        TEST_EQUAL(db.get_termfreq(term), 1);
+        if (n % 997 == 0) {
+            // Check the term is in the right document.
+            Xapian::PostingIterator p = db.postlist_begin(term);
+            TEST(p != db.postlist_end(term));
+            TEST_EQUAL(*p, n / TERMS_PER_DOC + 1);
+        }
+    }
+    // Terms which sort before, between and after the existing ones.
+    TEST(!db.term_exists("A"));
+    TEST(!db.term_exists("XTERM"));
+    TEST(!db.term_exists("XTERM0123450"));
+    TEST(!db.term_exists("XTERN"));
+    TEST(!db.term_exists("Z"));
+
+    Xapian::TermIterator t = db.allterms_begin("XTERM");
+    unsigned count = 0;
+    while (t != db.allterms_end("XTERM")) {
+        TEST_EQUAL(*t, multilevelindex_term(count));
+        ++count;
+        ++t;
+    }
+    TEST_EQUAL(count, N_TERMS);
+
+    // Test skipping forwards by different distances, which exercises both
+    // scanning and using the index for a cursor which is already positioned.
+    t = db.allterms_begin();
+    for (unsigned n = 2; n < N_TERMS - 1; n += n / 2) {
+        string term = multilevelindex_term(n);
+        t.skip_to(term);
+        TEST(t != db.allterms_end());
+        TEST_EQUAL(*t, term);
+        t.skip_to(term + "0");
+        TEST(t != db.allterms_end());
+        TEST_EQUAL(*t, multilevelindex_term(n + 1));
+    }
+    t.skip_to("XTERN");
+    TEST(t == db.allterms_end());
+}
+
+/// Feature test for Xapian::DB_CACHE_DOCLENGTHS.
+DEFINE_TESTCASE(cachedoclengths1, path) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    const string& db_path = get_database_path("apitest_simpledata");
+    Xapian::Database db_cached(db_path, Xapian::DB_CACHE_DOCLENGTHS);
+
+    Xapian::docid last = db.get_lastdocid();
+    for (Xapian::docid did = 1; did <= last; ++did) {
+        TEST_EQUAL(db_cached.get_doclength(did), db.get_doclength(did));
+    }
+    TEST_EXCEPTION(Xapian::DocNotFoundError,
+                   db_cached.get_doclength(last + 1));
+    // Check the message matches the one without the cache.
+    string msg, msg_cached;
+    try {
+        (void)db.get_doclength(last + 1);
+    } catch (const Xapian::DocNotFoundError& e) {
+        msg = e.get_msg();
+    }
+    try {
+        (void)db_cached.get_doclength(last + 1);
+    } catch (const Xapian::DocNotFoundError& e) {
+        msg_cached = e.get_msg();
+    }
+    TEST(!msg.empty());
+    TEST_EQUAL(msg_cached, msg);
+
+    Xapian::Query query(Xapian::Query::OP_OR,
+                        Xapian::Query("this"), Xapian::Query("word"));
+    Xapian::Enquire enq(db);
+    enq.set_query(query);
+    Xapian::Enquire enq_cached(db_cached);
+    enq_cached.set_query(query);
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    Xapian::MSet mset_cached = enq_cached.get_mset(0, 10);
+    TEST(!mset.empty());
+    TEST_EQUAL(mset.size(), mset_cached.size());
+    TEST(mset_range_is_same(mset, 0, mset_cached, 0, mset.size()));
+
+    db_cached.close();
+    TEST_EXCEPTION(Xapian::DatabaseClosedError, db_cached.get_doclength(1));
+}
@@ -1,7 +1,7 @@
 /** @file
  * @brief Tests of Database::compact()
  */
-/* Copyright (C) 2009,2010,2011,2012,2013,2015,2016,2017,2018,2019 Olly Betts
+/* Copyright (C) 2009,2010,2011,2012,2013,2015,2016,2017,2018,2019,2026 Olly Betts
  * Copyright (C) 2010 Richard Boulton
  *
  * This program is free software; you can redistribute it and/or
@@ -26,6 +26,7 @@
 #include <xapian.h>
 
 #include "apitest.h"
+#include "backends/honey/honey_defs.h"
 #include "dbcheck.h"
 #include "filetests.h"
 #include "msvcignoreinvalidparam.h"
@@ -34,8 +35,11 @@
 #include "testutils.h"
 
 #include <cerrno>
+#include <cmath>
 #include <cstdlib>
 #include <fstream>
+#include <functional>
+#include <map>
 
 #include <sys/types.h>
 #include "safesysstat.h"
@@ -586,6 +590,52 @@ DEFINE_TESTCASE(compactmultipass1, compact) {
     dbcheck(outdb, 29, 1041);
 }
 
+/// Test compacting using multiple threads.
+DEFINE_TESTCASE(compactthreads1, compact) {
+    string outdbpath = get_compaction_output_path("compactthreads1");
+    rm_rf(outdbpath);
+
+    string a = get_database_path("compactnorenumber1a", make_sparse_db,
+                                 "5-7 24 76 987 1023-1027 9999 !9999");
+    string b = get_database_path("compactnorenumber1b", make_sparse_db,
+                                 "1027-1030");
+    string c = get_database_path("compactnorenumber1c", make_sparse_db,
+                                 "1028-1040");
+    string d = get_database_path("compactnorenumber1d", make_sparse_db,
+                                 "3000 999999 !999999");
+
+    class CountingCompactor : public Xapian::Compactor {
+      public:
+        unsigned done = 0;
+
+        void set_status(const string&, const string& status) override {
+            if (!status.empty()) ++done;
+        }
+    } compactor;
+    TEST_EQUAL(compactor.get_threads(), 1);
+    compactor.set_threads(4);
+    TEST_EQUAL(compactor.get_threads(), 4);
+
+    {
+        Xapian::Database db;
+        db.add_database(Xapian::Database(a));
+        db.add_database(Xapian::Database(b));
+        db.add_database(Xapian::Database(c));
+        db.add_database(Xapian::Database(d));
+        unsigned flags = Xapian::DBCOMPACT_MULTIPASS;
+        if (startswith(get_dbtype(), "singlefile_")) {
+            flags |= Xapian::DBCOMPACT_SINGLE_FILE;
+        }
+        db.compact(outdbpath, flags, 0, compactor);
+    }
+    // Each of the six tables should have reported a final status.
+    TEST_REL(compactor.done, >=, 6);
+
+    Xapian::Database outdb(outdbpath);
+    dbcheck(outdb, 29, 1041);
+    TEST_EQUAL(Xapian::Database::check(outdbpath, 0, &tout), 0);
+}
+
 // Test compacting to an fd.
 DEFINE_TESTCASE(compacttofd1, compact) {
     Xapian::Database indb(get_database("apitest_simpledata"));
@@ -753,3 +803,745 @@ DEFINE_TESTCASE(compact2, compact) {
 
     TEST_EQUAL(Xapian::Database(output).get_doccount(), db_size);
 }
+
+/** Test compacting to honey with a format option.
+ *
+ *  Compacts @a db to honey with @a flags, then (if @a convertible) compacts
+ *  that again without and with @a flags, to check converting from the format
+ *  back to the default and to itself.  Each output is checked with
+ *  Database::check() and then passed to @a checker along with its path.
+ *
+ *  If @a convertible is false, compacting the output is instead expected to
+ *  fail.
+ */
+static void
+check_honey_format(Xapian::Database db, const string& name, int flags,
+                   const function<void(const string&,
+                                       const Xapian::Database&)>& checker,
+                   bool convertible = true)
+{
+    string out = get_compaction_output_path(name);
+    string plain = get_compaction_output_path(name + "-plain");
+    string again = get_compaction_output_path(name + "-again");
+    rm_rf(out);
+    rm_rf(plain);
+    rm_rf(again);
+
+    flags |= Xapian::DB_BACKEND_HONEY;
+    db.compact(out, flags);
+    if (!convertible) {
+        TEST_EXCEPTION(Xapian::InvalidOperationError,
+                       Xapian::Database(out).compact(plain,
+                                                     Xapian::DB_BACKEND_HONEY));
+        TEST_EXCEPTION(Xapian::InvalidOperationError,
+                       Xapian::Database(out).compact(again, flags));
+        TEST_EQUAL(Xapian::Database::check(out, 0, &tout), 0);
+        checker(out, Xapian::Database(out));
+        return;
+    }
+
+    Xapian::Database(out).compact(plain, Xapian::DB_BACKEND_HONEY);
+    Xapian::Database(out).compact(again, flags);
+    for (const string& path : { out, plain, again }) {
+        TEST_EQUAL(Xapian::Database::check(path, 0, &tout), 0);
+        checker(path, Xapian::Database(path));
+    }
+}
+
+/// Test compacting to honey with postings stored in blocks.
+DEFINE_TESTCASE(compactblockpostings1, glass) {
+    Xapian::Database db = get_database("compactblockpostings1",
+                                       [](Xapian::WritableDatabase& wdb,
+                                          const string&) {
+                                           for (unsigned i = 1; i < 5000; ++i) {
+                                               Xapian::Document doc;
+                                               doc.add_term("all", i % 7 + 1);
+                                               doc.add_term("flat");
+                                               if (i % 3 == 0)
+                                                   doc.add_term("third", i);
+                                               if (i % 1000 == 0)
+                                                   doc.add_term("rare");
+                                               if (i == 42)
+                                                   doc.add_term("once");
+                                               wdb.add_document(doc);
+                                           }
+                                       });
+
+    auto checker = [&](const string& path, const Xapian::Database& out) {
+        for (const char* term : { "all", "flat", "third", "rare", "once" }) {
+            tout << path << ": " << term << '\n';
+            TEST_EQUAL(out.get_termfreq(term), db.get_termfreq(term));
+            TEST_EQUAL(out.get_collection_freq(term),
+                       db.get_collection_freq(term));
+            auto p = out.postlist_begin(term);
+            for (auto q = db.postlist_begin(term);
+                 q != db.postlist_end(term); ++q) {
+                TEST(p != out.postlist_end(term));
+                TEST_EQUAL(*p, *q);
+                TEST_EQUAL(p.get_wdf(), q.get_wdf());
+                ++p;
+            }
+            TEST(p == out.postlist_end(term));
+
+            // Check skip_to() within and across blocks.
+            for (Xapian::docid did : { 1, 2, 100, 127, 128, 129, 700, 3001,
+                                       4999, 5000 }) {
+                p = out.postlist_begin(term);
+                auto q = db.postlist_begin(term);
+                p.skip_to(did);
+                q.skip_to(did);
+                if (q == db.postlist_end(term)) {
+                    TEST(p == out.postlist_end(term));
+                    continue;
+                }
+                TEST(p != out.postlist_end(term));
+                TEST_EQUAL(*p, *q);
+                TEST_EQUAL(p.get_wdf(), q.get_wdf());
+                // And a second skip_to() from the current position.
+                p.skip_to(did + 300);
+                q.skip_to(did + 300);
+                if (q == db.postlist_end(term)) {
+                    TEST(p == out.postlist_end(term));
+                } else {
+                    TEST(p != out.postlist_end(term));
+                    TEST_EQUAL(*p, *q);
+                }
+            }
+        }
+    };
+    check_honey_format(db, "compactblockpostings1",
+                       Xapian::DBCOMPACT_BLOCK_POSTINGS, checker);
+}
+
+/** Regression test for HoneyPostList::skip_to() bugs.
+ *
+ *  The reader for the initial chunk was given the last docid of the whole
+ *  postlist rather than of that chunk, so skip_to() the last docid in the
+ *  initial chunk could return the wrong wdf.  Also skip_to() from the initial
+ *  chunk into a later chunk could misdecode the later chunk's header when the
+ *  wdf is the same for every entry (apart from maybe the first).
+ */
+DEFINE_TESTCASE(honeyskipto1, glass) {
+    Xapian::Database db = get_database("honeyskipto1",
+                                       [](Xapian::WritableDatabase& wdb,
+                                          const string&) {
+                                           for (unsigned i = 1; i < 3000; ++i) {
+                                               Xapian::Document doc;
+                                               doc.add_term("all", i % 7 + 1);
+                                               doc.add_term("flat", 2);
+                                               doc.add_term("flatbut1",
+                                                            i == 1 ? 5 : 3);
+                                               wdb.add_document(doc);
+                                           }
+                                       });
+
+    string out_path = get_compaction_output_path("honeyskipto1");
+    rm_rf(out_path);
+    db.compact(out_path, Xapian::DB_BACKEND_HONEY);
+    Xapian::Database out(out_path);
+
+    for (const char* term : { "all", "flat", "flatbut1" }) {
+        tout << term << '\n';
+        for (Xapian::docid did = 1; did < 3000; ++did) {
+            auto p = out.postlist_begin(term);
+            p.skip_to(did);
+            TEST(p != out.postlist_end(term));
+            TEST_EQUAL(*p, did);
+            auto q = db.postlist_begin(term);
+            q.skip_to(did);
+            TEST_EQUAL(p.get_wdf(), q.get_wdf());
+        }
+    }
+}
+
+/// Test compacting to honey with Bloom filters.
+DEFINE_TESTCASE(compactbloomfilters1, glass) {
+    Xapian::Database db = get_database("apitest_simpledata");
+
+    string out_dir = get_compaction_output_path("compactbloomfilters1");
+    string out_file = get_compaction_output_path("compactbloomfilters1-s");
+    string out_copy = get_compaction_output_path("compactbloomfilters1-c");
+    rm_rf(out_dir);
+    rm_rf(out_file);
+    rm_rf(out_copy);
+
+    int flags = Xapian::DB_BACKEND_HONEY | Xapian::DBCOMPACT_BLOOM_FILTERS;
+    db.compact(out_dir, flags);
+    db.compact(out_file, flags | Xapian::DBCOMPACT_SINGLE_FILE);
+    // Compacting from honey with Bloom filters without the flag should give
+    // a database without them.
+    Xapian::Database(out_dir).compact(out_copy, Xapian::DB_BACKEND_HONEY);
+
+    for (const string& path : { out_dir, out_file, out_copy }) {
+        tout << path << '\n';
+        Xapian::Database out(path);
+        TEST_EQUAL(out.get_doccount(), db.get_doccount());
+        // Every term should be found.
+        Xapian::termcount n_terms = 0;
+        for (auto t = db.allterms_begin(); t != db.allterms_end(); ++t) {
+            const string& term = *t;
+            TEST(out.term_exists(term));
+            TEST_EQUAL(out.get_termfreq(term), t.get_termfreq());
+            TEST_EQUAL(out.get_collection_freq(term),
+                       db.get_collection_freq(term));
+            TEST(out.postlist_begin(term) != out.postlist_end(term));
+            ++n_terms;
+        }
+        TEST_REL(n_terms, >, 50);
+        // Terms which don't exist shouldn't be.
+        for (int i = 0; i < 1000; ++i) {
+            string term = "Qnonexistent" + str(i);
+            TEST(!out.term_exists(term));
+            TEST_EQUAL(out.get_termfreq(term), 0);
+            TEST(out.postlist_begin(term) == out.postlist_end(term));
+        }
+        for (Xapian::docid did = 1; did <= db.get_doccount(); ++did) {
+            TEST_EQUAL(out.get_document(did).termlist_count(),
+                       db.get_document(did).termlist_count());
+        }
+        TEST_EXCEPTION(Xapian::DocNotFoundError,
+                       out.termlist_begin(db.get_doccount() + 1));
+    }
+}
+
+/// Test reading honey tables which are mapped into memory.
+DEFINE_TESTCASE(compacthoneymmap1, glass) {
+    Xapian::Database db = get_database("etext");
+
+    string out_dir = get_compaction_output_path("compacthoneymmap1");
+    string out_file = get_compaction_output_path("compacthoneymmap1-s");
+    string out_embedded = get_compaction_output_path("compacthoneymmap1-e");
+    rm_rf(out_dir);
+    rm_rf(out_file);
+    rm_rf(out_embedded);
+
+    int flags = Xapian::DB_BACKEND_HONEY | Xapian::DBCOMPACT_BLOOM_FILTERS;
+    db.compact(out_dir, flags);
+    db.compact(out_file, flags | Xapian::DBCOMPACT_SINGLE_FILE);
+
+    // Embed a single file database at an offset which isn't a multiple of
+    // the page size, with some junk after it.
+    off_t offset = 1234;
+    {
+        int fd = open(out_embedded.c_str(), O_CREAT|O_RDWR|O_BINARY, 0666);
+        TEST(fd != -1);
+        TEST(lseek(fd, offset, SEEK_SET) == offset);
+        db.compact(fd, flags);
+        ofstream out(out_embedded, fstream::app|fstream::binary);
+        out << string(5000, 'y');
+    }
+
+    auto check = [&](const Xapian::Database& out) {
+        TEST_EQUAL(out.get_doccount(), db.get_doccount());
+        // Checking every term is slow, so check a sample.
+        unsigned n = 0;
+        for (auto t = db.allterms_begin(); t != db.allterms_end(); ++t) {
+            if (n++ % 16) continue;
+            TEST_EQUAL(postlist_to_string(out, *t), postlist_to_string(db, *t));
+        }
+        for (Xapian::docid did = 1; did <= db.get_lastdocid(); ++did) {
+            TEST_EQUAL(out.get_document(did).get_data(),
+                       db.get_document(did).get_data());
+            TEST_EQUAL(docterms_to_string(out, did),
+                       docterms_to_string(db, did));
+        }
+        TEST(!out.term_exists("Qnonexistent"));
+    };
+
+    for (const string& path : { out_dir, out_file }) {
+        tout << path << '\n';
+        check(Xapian::Database(path));
+    }
+
+    tout << out_embedded << '\n';
+    int fd = open(out_embedded.c_str(), O_RDONLY|O_BINARY);
+    TEST(fd != -1);
+    TEST(lseek(fd, offset, SEEK_SET) == offset);
+    check(Xapian::Database(fd));
+}
+
+/// Test compacting to honey with positions stored in blocks.
+DEFINE_TESTCASE(compactblockpositions1, glass) {
+    Xapian::Database db = get_database("compactblockpositions1",
+                                       [](Xapian::WritableDatabase& wdb,
+                                          const string&) {
+                                           Xapian::Document doc;
+                                           // Long lists with a mix of gaps.
+                                           for (unsigned i = 1; i < 3000; ++i) {
+                                               doc.add_posting("all", i);
+                                               if (i % 3 == 0)
+                                                   doc.add_posting("third", i);
+                                               if (i % 500 == 1)
+                                                   doc.add_posting("sparse",
+                                                                   i * 1000);
+                                           }
+                                           // Exactly one block.
+                                           for (unsigned i = 0; i < 128; ++i)
+                                               doc.add_posting("block",
+                                                               i * 2 + 5);
+                                           doc.add_posting("two", 7);
+                                           doc.add_posting("two", 8);
+                                           doc.add_posting("one", 1);
+                                           wdb.add_document(doc);
+                                           doc.clear_terms();
+                                           doc.add_posting("all", 2);
+                                           doc.add_posting("third", 3);
+                                           wdb.add_document(doc);
+                                       });
+
+    auto checker = [&](const string& path, const Xapian::Database& out) {
+        for (Xapian::docid did : { 1, 2 }) {
+            for (const char* term : { "all", "third", "sparse", "block", "two",
+                                      "one" }) {
+                tout << path << ": " << did << ' ' << term << '\n';
+                auto t_out = out.termlist_begin(did);
+                auto t_db = db.termlist_begin(did);
+                t_out.skip_to(term);
+                t_db.skip_to(term);
+                if (t_db != db.termlist_end(did) && *t_db == term) {
+                    TEST(t_out != out.termlist_end(did));
+                    TEST_EQUAL(*t_out, term);
+                    TEST_EQUAL(t_out.positionlist_count(),
+                               t_db.positionlist_count());
+                }
+                auto p = out.positionlist_begin(did, term);
+                for (auto q = db.positionlist_begin(did, term);
+                     q != db.positionlist_end(did, term); ++q) {
+                    TEST(p != out.positionlist_end(did, term));
+                    TEST_EQUAL(*p, *q);
+                    ++p;
+                }
+                TEST(p == out.positionlist_end(did, term));
+
+                // Check skip_to() within and across blocks.
+                for (Xapian::termpos pos : { 1, 2, 127, 128, 129, 200, 261,
+                                             262, 999, 2999, 3000, 2001000 }) {
+                    p = out.positionlist_begin(did, term);
+                    auto q = db.positionlist_begin(did, term);
+                    p.skip_to(pos);
+                    q.skip_to(pos);
+                    if (q == db.positionlist_end(did, term)) {
+                        TEST(p == out.positionlist_end(did, term));
+                        continue;
+                    }
+                    TEST(p != out.positionlist_end(did, term));
+                    TEST_EQUAL(*p, *q);
+                    // And a second skip_to() from the current position.
+                    p.skip_to(pos + 300);
+                    q.skip_to(pos + 300);
+                    if (q == db.positionlist_end(did, term)) {
+                        TEST(p == out.positionlist_end(did, term));
+                    } else {
+                        TEST(p != out.positionlist_end(did, term));
+                        TEST_EQUAL(*p, *q);
+                    }
+                }
+            }
+        }
+
+        Xapian::Enquire enq(out);
+        enq.set_query(Xapian::Query(Xapian::Query::OP_PHRASE,
+                                    Xapian::Query("third"),
+                                    Xapian::Query("all")));
+        TEST_EQUAL(enq.get_mset(0, 10).size(), 1);
+        enq.set_query(Xapian::Query(Xapian::Query::OP_PHRASE,
+                                    Xapian::Query("sparse"),
+                                    Xapian::Query("all")));
+        TEST_EQUAL(enq.get_mset(0, 10).size(), 1);
+        enq.set_query(Xapian::Query(Xapian::Query::OP_PHRASE,
+                                    Xapian::Query("sparse"),
+                                    Xapian::Query("third")));
+        TEST_EQUAL(enq.get_mset(0, 10).size(), 0);
+    };
+    check_honey_format(db, "compactblockpositions1",
+                       Xapian::DBCOMPACT_BLOCK_POSITIONS, checker);
+}
+
+static void
+make_value_columns_db(Xapian::WritableDatabase& db, const string&)
+{
+    for (unsigned i = 1; i < 3000; ++i) {
+        Xapian::Document doc;
+        doc.add_term("all");
+        // Dense with few distinct values.
+        doc.add_value(0, "cat" + str(i % 5));
+        // Dense numbers with some gaps.
+        if (i % 7 != 0)
+            doc.add_value(1, Xapian::sortable_serialise(i * 1.5));
+        // Sparse.
+        if (i % 50 == 0)
+            doc.add_value(2, str(i));
+        // Many distinct values and the odd long one.
+        if (i % 400 == 0)
+            doc.add_value(3, string(200, 'z'));
+        else
+            doc.add_value(3, str(i % 300));
+        db.add_document(doc);
+    }
+}
+
+/// Test compacting to honey with value slots stored as columns.
+DEFINE_TESTCASE(compactvaluecolumns1, glass) {
+    Xapian::Database db = get_database("compactvaluecolumns1",
+                                       make_value_columns_db);
+
+    auto checker = [&](const string& path, const Xapian::Database& out) {
+        for (Xapian::valueno slot = 0; slot != 5; ++slot) {
+            tout << path << ": slot " << slot << '\n';
+            TEST_EQUAL(out.get_value_freq(slot), db.get_value_freq(slot));
+            auto v = out.valuestream_begin(slot);
+            for (auto w = db.valuestream_begin(slot);
+                 w != db.valuestream_end(slot); ++w) {
+                TEST(v != out.valuestream_end(slot));
+                TEST_EQUAL(v.get_docid(), w.get_docid());
+                TEST_EQUAL(*v, *w);
+                ++v;
+            }
+            TEST(v == out.valuestream_end(slot));
+
+            // Check skip_to() within and across chunks.
+            for (Xapian::docid did : { 1, 2, 7, 8, 49, 50, 51, 400, 699,
+                                       1400, 2800, 2999 }) {
+                TEST_EQUAL(out.get_document(did).get_value(slot),
+                           db.get_document(did).get_value(slot));
+                v = out.valuestream_begin(slot);
+                auto w = db.valuestream_begin(slot);
+                v.skip_to(did);
+                w.skip_to(did);
+                if (w == db.valuestream_end(slot)) {
+                    TEST(v == out.valuestream_end(slot));
+                    continue;
+                }
+                TEST(v != out.valuestream_end(slot));
+                TEST_EQUAL(v.get_docid(), w.get_docid());
+                TEST_EQUAL(*v, *w);
+                // And a second skip_to() from the current position.
+                v.skip_to(did + 300);
+                w.skip_to(did + 300);
+                if (w == db.valuestream_end(slot)) {
+                    TEST(v == out.valuestream_end(slot));
+                } else {
+                    TEST(v != out.valuestream_end(slot));
+                    TEST_EQUAL(v.get_docid(), w.get_docid());
+                    TEST_EQUAL(*v, *w);
+                }
+            }
+        }
+
+        // Sorting by value should give the same order.
+        Xapian::Enquire enq_out(out);
+        Xapian::Enquire enq_db(db);
+        enq_out.set_query(Xapian::Query("all"));
+        enq_db.set_query(Xapian::Query("all"));
+        enq_out.set_sort_by_value(1, true);
+        enq_db.set_sort_by_value(1, true);
+        Xapian::MSet mset_out = enq_out.get_mset(0, 20);
+        Xapian::MSet mset_db = enq_db.get_mset(0, 20);
+        TEST_EQUAL(mset_out.size(), 20);
+        TEST(mset_range_is_same(mset_out, 0, mset_db, 0, 20));
+    };
+    check_honey_format(db, "compactvaluecolumns1",
+                       Xapian::DBCOMPACT_VALUE_COLUMNS, checker);
+
+    // Check that a column encoding was actually picked for some chunks, not
+    // just that the flag was set.  The value stream encoding with the extra
+    // encoding byte per chunk would make the postlist table bigger, not
+    // smaller.
+    string columns = get_compaction_output_path("compactvaluecolumns1");
+    string streams = get_compaction_output_path("compactvaluecolumns1-plain");
+    TEST(honey_format_flags(columns, Honey::POSTLIST) &
+         Honey::FORMAT_VALUE_COLUMNS);
+    TEST(!(honey_format_flags(streams, Honey::POSTLIST) &
+           Honey::FORMAT_VALUE_COLUMNS));
+    auto columns_size = file_size(columns + "/postlist.honey");
+    auto streams_size = file_size(streams + "/postlist.honey");
+    tout << "postlist.honey: " << columns_size << " with columns, "
+         << streams_size << " without\n";
+    TEST_REL(columns_size, <, streams_size);
+}
+
+/// Test building a honey database with HoneyBuilder.
+DEFINE_TESTCASE(honeybuilder1, glass) {
+    string ref_path = get_named_writable_database_path("honeybuilder1-ref");
+    string out = get_compaction_output_path("honeybuilder1");
+    rm_rf(out);
+    rm_rf(out + ".tmp");
+
+    auto make_doc = [](unsigned i) {
+        Xapian::Document doc;
+        doc.set_data("doc " + str(i));
+        doc.add_value(0, str(i % 13));
+        if (i % 5 == 0) doc.add_value(3, "five");
+        for (unsigned j = 1; j <= 10; ++j) {
+            if (i % j == 0) doc.add_posting("T" + str(j), i % 17 + j);
+        }
+        doc.add_term("Q" + str(i));
+        doc.add_boolean_term(i & 1 ? "Kodd" : "Keven");
+        return doc;
+    };
+
+    const unsigned N = 200;
+    {
+        Xapian::WritableDatabase ref(ref_path, Xapian::DB_CREATE_OR_OVERWRITE);
+        // Use a small batch size so that runs get merged before the end.
+        Xapian::HoneyBuilder builder(out, 0, 3);
+        for (unsigned i = 1; i <= N; ++i) {
+            Xapian::Document doc = make_doc(i);
+            TEST_EQUAL(builder.add_document(doc), i);
+            ref.add_document(doc);
+            if (i == 4) {
+                // The first batch should have been converted to a honey run
+                // and the glass database it was written to removed.
+                TEST(!dir_exists(out + ".tmp/0"));
+                TEST(file_exists(out + ".tmp/1/iamhoney"));
+            }
+            if (i == 50) {
+                builder.set_metadata("foo", "first");
+                builder.add_spelling("hello", 2);
+                builder.add_synonym("hello", "hi");
+            }
+        }
+        builder.set_metadata("foo", "bar");
+        builder.set_metadata("gone", "soon");
+        builder.set_metadata("gone", "");
+        builder.add_spelling("hello");
+        builder.add_spelling("world");
+        builder.add_synonym("hello", "howdy");
+        TEST(dir_exists(out + ".tmp"));
+        builder.finish();
+        TEST(!dir_exists(out + ".tmp"));
+        TEST_EXCEPTION(Xapian::InvalidOperationError,
+                       builder.add_document(Xapian::Document()));
+        TEST_EXCEPTION(Xapian::InvalidOperationError, builder.finish());
+        ref.commit();
+    }
+
+    Xapian::Database ref(ref_path);
+    Xapian::Database db(out);
+    TEST_EQUAL(Xapian::Database::check(out, 0, &tout), 0);
+    TEST_EQUAL(db.get_doccount(), N);
+    TEST_EQUAL(db.get_lastdocid(), N);
+    TEST_EQUAL(db.get_total_length(), ref.get_total_length());
+    TEST_EQUAL(db.get_metadata("foo"), "bar");
+    TEST_EQUAL(db.get_metadata("gone"), "");
+    TEST_EQUAL(db.get_spelling_suggestion("hellp"), "hello");
+    auto s = db.spellings_begin();
+    TEST(s != db.spellings_end());
+    TEST_EQUAL(*s, "hello");
+    TEST_EQUAL(s.get_termfreq(), 3);
+    ++s;
+    TEST(s != db.spellings_end());
+    TEST_EQUAL(*s, "world");
+    ++s;
+    TEST(s == db.spellings_end());
+    string synonyms;
+    for (auto t = db.synonyms_begin("hello"); t != db.synonyms_end("hello");
+         ++t) {
+        synonyms += *t;
+        synonyms += ' ';
+    }
+    TEST_EQUAL(synonyms, "hi howdy ");
+
+    for (Xapian::docid did = 1; did <= N; ++did) {
+        Xapian::Document doc = db.get_document(did);
+        Xapian::Document ref_doc = ref.get_document(did);
+        TEST_EQUAL(doc.get_data(), ref_doc.get_data());
+        TEST_EQUAL(doc.get_value(0), ref_doc.get_value(0));
+        TEST_EQUAL(doc.get_value(3), ref_doc.get_value(3));
+        TEST_EQUAL(db.get_doclength(did), ref.get_doclength(did));
+        auto t = db.termlist_begin(did);
+        for (auto r = ref.termlist_begin(did); r != ref.termlist_end(did);
+             ++r) {
+            TEST(t != db.termlist_end(did));
+            TEST_EQUAL(*t, *r);
+            TEST_EQUAL(t.get_wdf(), r.get_wdf());
+            TEST_EQUAL(db.get_termfreq(*t), ref.get_termfreq(*r));
+            string pos, ref_pos;
+            for (auto p = db.positionlist_begin(did, *t);
+                 p != db.positionlist_end(did, *t); ++p) {
+                pos += str(*p);
+                pos += ' ';
+            }
+            for (auto p = ref.positionlist_begin(did, *r);
+                 p != ref.positionlist_end(did, *r); ++p) {
+                ref_pos += str(*p);
+                ref_pos += ' ';
+            }
+            TEST_EQUAL(pos, ref_pos);
+            ++t;
+        }
+        TEST(t == db.termlist_end(did));
+    }
+    TEST_EQUAL(db.get_value_freq(3), ref.get_value_freq(3));
+    TEST_EQUAL(db.get_value_lower_bound(0), ref.get_value_lower_bound(0));
+    TEST_EQUAL(db.get_value_upper_bound(0), ref.get_value_upper_bound(0));
+}
+
+/// Return BM25Weight's weight for a term with its default parameters.
+static double
+bm25_termweight(Xapian::doccount doccount, Xapian::doccount tf)
+{
+    double tw = (doccount - tf + 0.5) / (tf + 0.5);
+    if (tw < 2) tw = tw * 0.5 + 1;
+    return log(tw) * 2;
+}
+
+/// Test compacting to honey with impacts stored instead of wdf.
+DEFINE_TESTCASE(compactimpacts1, glass) {
+    Xapian::Database db = get_database("etext");
+
+    auto checker = [&](const string& path, const Xapian::Database& out) {
+        TEST_EQUAL(out.get_doccount(), db.get_doccount());
+        TEST_EQUAL(out.get_total_length(), db.get_total_length());
+
+        Xapian::termcount impact_min = 255;
+        Xapian::termcount impact_max_all = 0;
+        for (const char* term : { "robinson", "the", "sleep", "ship" }) {
+            tout << path << ": " << term << '\n';
+            TEST_EQUAL(out.get_termfreq(term), db.get_termfreq(term));
+
+            // The postings are the same, but with impacts as the wdf.
+            Xapian::termcount impact_max = 0;
+            auto p = out.postlist_begin(term);
+            for (auto q = db.postlist_begin(term);
+                 q != db.postlist_end(term); ++q) {
+                TEST(p != out.postlist_end(term));
+                TEST_EQUAL(*p, *q);
+                TEST_EQUAL(p.get_doclength(), q.get_doclength());
+                Xapian::termcount impact = p.get_wdf();
+                TEST_REL(impact, >=, 1);
+                TEST_REL(impact, <=, 255);
+                impact_max = max(impact_max, impact);
+                impact_min = min(impact_min, impact);
+                ++p;
+            }
+            TEST(p == out.postlist_end(term));
+            // The bound on the wdf is the exact maximum impact.
+            TEST_EQUAL(out.get_wdf_upper_bound(term), impact_max);
+            impact_max_all = max(impact_max_all, impact_max);
+
+            // The weights should be within the quantisation error of those
+            // from BM25Weight with its default parameters.
+            Xapian::Enquire enq_db(db);
+            enq_db.set_query(Xapian::Query(term));
+            Xapian::Enquire enq_out(out);
+            enq_out.set_query(Xapian::Query(term));
+            enq_out.set_weighting_scheme(Xapian::ImpactWeight());
+            auto n = db.get_termfreq(term);
+            Xapian::MSet mset_db = enq_db.get_mset(0, n);
+            Xapian::MSet mset_out = enq_out.get_mset(0, n);
+            TEST_EQUAL(mset_out.size(), n);
+            // The bound on the weight is exact.
+            TEST_EQUAL_DOUBLE(mset_out.get_max_possible(),
+                              mset_out.get_max_attained());
+            map<Xapian::docid, double> impact_weights;
+            for (auto i = mset_out.begin(); i != mset_out.end(); ++i) {
+                impact_weights[*i] = i.get_weight();
+            }
+            double tolerance = bm25_termweight(db.get_doccount(), n) / 255;
+            for (auto i = mset_db.begin(); i != mset_db.end(); ++i) {
+                TEST_REL(fabs(impact_weights[*i] - i.get_weight()), <=,
+                         tolerance);
+            }
+        }
+        // The impacts should use a good part of the range available.
+        TEST_REL(impact_max_all - impact_min, >=, 100);
+    };
+    // The wdfs can't be recovered from the impacts, so the output can't be
+    // compacted again.
+    check_honey_format(db, "compactimpacts1",
+                       Xapian::DBCOMPACT_IMPACTS, checker, false);
+    check_honey_format(db, "compactimpacts1-b",
+                       Xapian::DBCOMPACT_IMPACTS |
+                       Xapian::DBCOMPACT_BLOCK_POSTINGS, checker, false);
+}
+
+static void
+make_impacts_shard(Xapian::WritableDatabase& db, const string& arg)
+{
+    // The shards differ in size and in how many documents each term indexes,
+    // but every document has length 12, so the average length is the same.
+    bool a = (arg == "a");
+    for (unsigned i = 1; i <= (a ? 40 : 100); ++i) {
+        Xapian::Document doc;
+        Xapian::termcount len = i % 4 + 1;
+        doc.add_term("common", len);
+        if (a ? i % 2 == 0 : i % 10 == 0) {
+            doc.add_term("skewed", i % 3 + 1);
+            len += i % 3 + 1;
+        }
+        if (!a && i % 3 == 0) {
+            doc.add_term("bonly", 2);
+            len += 2;
+        }
+        doc.add_term("pad", 12 - len);
+        db.add_document(doc);
+    }
+}
+
+/// Check impacts from shards compacted separately rank like a single database.
+DEFINE_TESTCASE(compactimpacts2, glass) {
+    Xapian::Database a = get_database("compactimpacts2a", make_impacts_shard,
+                                      "a");
+    Xapian::Database b = get_database("compactimpacts2b", make_impacts_shard,
+                                      "b");
+    Xapian::Database both = a;
+    both.add_database(b);
+
+    int flags = Xapian::DB_BACKEND_HONEY | Xapian::DBCOMPACT_IMPACTS;
+    string a_path = get_compaction_output_path("compactimpacts2-a");
+    string b_path = get_compaction_output_path("compactimpacts2-b");
+    string all_path = get_compaction_output_path("compactimpacts2");
+    rm_rf(a_path);
+    rm_rf(b_path);
+    rm_rf(all_path);
+    a.compact(a_path, flags);
+    b.compact(b_path, flags);
+    both.compact(all_path, flags);
+
+    Xapian::Database sharded(a_path);
+    sharded.add_database(Xapian::Database(b_path));
+    Xapian::Database unsharded(all_path);
+
+    static const char* const terms[] = { "common", "skewed", "bonly" };
+    Xapian::Query query(Xapian::Query::OP_OR, begin(terms), end(terms));
+    auto get_weights = [&](const Xapian::Database& search_db,
+                           const Xapian::Weight& weight) {
+        Xapian::Enquire enq(search_db);
+        enq.set_query(query);
+        enq.set_weighting_scheme(weight);
+        Xapian::MSet mset = enq.get_mset(0, search_db.get_doccount());
+        map<Xapian::docid, double> weights;
+        for (auto i = mset.begin(); i != mset.end(); ++i) {
+            weights[*i] = i.get_weight();
+        }
+        return weights;
+    };
+    auto sharded_weights = get_weights(sharded, Xapian::ImpactWeight());
+    auto unsharded_weights = get_weights(unsharded, Xapian::ImpactWeight());
+    // BM25Weight uses the statistics for both shards.
+    auto bm25_weights = get_weights(both, Xapian::BM25Weight());
+    Xapian::doccount n_a = a.get_doccount();
+    Xapian::doccount n = both.get_doccount();
+    TEST_EQUAL(sharded_weights.size(), n);
+    TEST_EQUAL(unsharded_weights.size(), n);
+    TEST_EQUAL(bm25_weights.size(), n);
+
+    // The total quantisation error is at most 1/255 of the sum of the term
+    // weights.
+    double tolerance = 0;
+    for (auto term : terms) {
+        tolerance += bm25_termweight(n, both.get_termfreq(term)) / 255;
+    }
+
+    for (Xapian::docid did = 1; did <= n; ++did) {
+        // Document did of the single database is document did of shard a or
+        // document did - n_a of shard b, which are interleaved in sharded.
+        Xapian::docid d = did <= n_a ? 2 * did - 1 : 2 * (did - n_a);
+        tout << "did " << did << " sharded docid " << d << '\n';
+        // The impacts and the statistics used are the same, so the weights
+        // should be too.
+        TEST_EQUAL_DOUBLE(sharded_weights[d], unsharded_weights[did]);
+        TEST_REL(fabs(sharded_weights[d] - bm25_weights[d]), <=, tolerance);
+    }
+}
@@ -257,3 +257,53 @@ DEFINE_TESTCASE(modtermwdf1, writable) {
     TEST_EQUAL(db.get_avlength(), 0);
     TEST_EQUAL(db.get_lastdocid(), 1);
 }
+
+/// Test buffered changes made in descending docid order.
+DEFINE_TESTCASE(replacedescending1, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+    for (Xapian::termpos i = 1; i <= 6; ++i) {
+        Xapian::Document doc;
+        doc.add_posting("foo", i);
+        doc.add_term("bar", i);
+        db.add_document(doc);
+    }
+    db.commit();
+
+    // Replace in descending docid order, and replace some documents twice,
+    // so that the changes aren't buffered in order.
+    for (Xapian::docid did = 6; did >= 1; --did) {
+        Xapian::Document doc;
+        doc.add_posting("foo", did * 10);
+        doc.add_posting("foo", did * 10 + 1);
+        if (did % 2) doc.add_term("baz");
+        db.replace_document(did, doc);
+        if (did == 3) {
+            // Replace a document already replaced.
+            Xapian::Document doc5;
+            doc5.add_posting("foo", 5);
+            doc5.add_term("baz", 2);
+            db.replace_document(5, doc5);
+        }
+    }
+    db.delete_document(4);
+
+    for (int commit = 0; commit != 2; ++commit) {
+        TEST_EQUAL(db.get_doclength(1), 3);
+        TEST_EQUAL(db.get_doclength(5), 3);
+        TEST_EXCEPTION(Xapian::DocNotFoundError, db.get_doclength(4));
+        TEST_EQUAL(postlist_to_string(db, "bar"), "");
+        TEST_EQUAL(postlist_to_string(db, "baz"),
+                   "(1, doclen=3, wdf=1), "
+                   "(3, doclen=3, wdf=1), "
+                   "(5, doclen=3, wdf=2)");
+        TEST_EQUAL(postlist_to_string(db, "foo"),
+                   "(1, doclen=3, wdf=2, pos=[10, 11]), "
+                   "(2, doclen=2, wdf=2, pos=[20, 21]), "
+                   "(3, doclen=3, wdf=2, pos=[30, 31]), "
+                   "(5, doclen=3, wdf=1, pos=[5]), "
+                   "(6, doclen=2, wdf=2, pos=[60, 61])");
+        TEST_EQUAL(termstats_to_string(db, "baz"), "tf=3,cf=4");
+        db.commit();
+    }
+    TEST_EQUAL(db.get_doccount(), 5);
+}
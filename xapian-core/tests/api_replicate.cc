@@ -2,7 +2,7 @@
  * @brief tests of replication functionality
  */
 /* Copyright 2008 Lemur Consulting Ltd
- * Copyright 2009-2022 Olly Betts
+ * Copyright 2009-2022,2026 Olly Betts
  * Copyright 2010 Richard Boulton
  * Copyright 2011 Dan Colish
  *
@@ -899,3 +899,75 @@ DEFINE_TESTCASE(replicate7, replicas) {
     rmtmpdir(tempdir);
 #endif
 }
+
+/// Test replication with compression (new in 2.1.0).
+DEFINE_TESTCASE(replicate8, replicas) {
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+    UNSET_MAX_CHANGESETS_AFTERWARDS;
+    string tempdir = ".replicatmp";
+    mktmpdir(tempdir);
+    string masterpath = get_named_writable_database_path("master");
+
+    set_max_changesets(10);
+
+    Xapian::WritableDatabase orig(get_named_writable_database("master"));
+    Xapian::DatabaseMaster master(masterpath);
+    master.set_compression(Compression::ZLIB);
+    string replicapath = tempdir + "/replica";
+    string changesetpath = tempdir + "/changeset";
+    {
+        Xapian::DatabaseReplica replica(replicapath);
+
+        Xapian::Document doc;
+        doc.set_data(string(100, 'x'));
+        doc.add_term("foo");
+        for (int i = 0; i < 1000; ++i) {
+            orig.add_document(doc);
+        }
+        orig.commit();
+
+        // The full copy should be sent compressed.
+        get_changeset(changesetpath, master, replica, 0, 1, true);
+        auto compressed_size = file_size(changesetpath);
+        Xapian::DatabaseMaster uncompressed_master(masterpath);
+        get_changeset(changesetpath, uncompressed_master, replica, 0, 1, true);
+        TEST_REL(compressed_size, <, file_size(changesetpath));
+
+        int count = replicate(master, replica, tempdir, 0, 1, true);
+        TEST_EQUAL(count, 1);
+        check_equal_dbs(masterpath, replicapath);
+
+        // Changesets should be applied correctly too.
+        orig.add_document(doc);
+        orig.commit();
+        orig.add_document(doc);
+        orig.commit();
+        count = replicate(master, replica, tempdir, 2, 0, true);
+        TEST_EQUAL(count, 3);
+        check_equal_dbs(masterpath, replicapath);
+
+        // Check that a full copy with a bad checksum is rejected.  The
+        // checksum is at the end of the last file, which is followed by the
+        // footer (3 bytes) and the end of changes message (2 bytes).
+        get_changeset(changesetpath, master, replica, 0, 1, true, true);
+        {
+            FD fd(open(changesetpath.c_str(), O_RDWR | O_BINARY));
+            TEST(fd != -1);
+            off_t offset = file_size(changesetpath) - 6;
+            char ch;
+            TEST_EQUAL(lseek(fd, offset, SEEK_SET), offset);
+            TEST_EQUAL(do_read(fd, &ch, 1), 1);
+            ch ^= 1;
+            TEST_EQUAL(lseek(fd, offset, SEEK_SET), offset);
+            do_write(fd, &ch, 1);
+        }
+        TEST_EXCEPTION(Xapian::NetworkError,
+                       apply_changeset(changesetpath, replica, 0, 1, true));
+
+        // We need this inner scope to we close the replica before we remove
+        // the temporary directory on Windows.
+    }
+
+    rmtmpdir(tempdir);
+#endif
+}
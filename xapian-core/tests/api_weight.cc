@@ -1,7 +1,7 @@
 /** @file
  * @brief tests of Xapian::Weight subclasses
  */
-/* Copyright (C) 2004-2024 Olly Betts
+/* Copyright (C) 2004-2026 Olly Betts
  * Copyright (C) 2013 Aarsh Shah
  * Copyright (C) 2016 Vivek Pal
  *
@@ -124,6 +124,7 @@ DEFINE_TESTCASE(weightserialisation1, !backend) {
     TEST_WEIGHT_CLASS_NO_PARAMS(Xapian::DLHWeight, "dlh");
     TEST_WEIGHT_CLASS_NO_PARAMS(Xapian::DPHWeight, "dph");
     TEST_WEIGHT_CLASS_NO_PARAMS(Xapian::DiceWeight, "dice");
+    TEST_WEIGHT_CLASS_NO_PARAMS(Xapian::ImpactWeight, "impact");
 
     // Parameterised weighting schemes.
     TEST_WEIGHT_CLASS(Xapian::TradWeight, "bm25", (1.0), (2.0));
@@ -222,6 +223,7 @@ DEFINE_TESTCASE(weight1, backend) {
     TEST_WEIGHTING_SCHEME(Xapian::DLHWeight);
     TEST_WEIGHTING_SCHEME(Xapian::DPHWeight);
     TEST_WEIGHTING_SCHEME(Xapian::DiceWeight);
+    TEST_WEIGHTING_SCHEME(Xapian::ImpactWeight);
     TEST_WEIGHTING_SCHEME(Xapian::TradWeight);
     TEST_WEIGHTING_SCHEME(Xapian::BM25Weight);
     TEST_WEIGHTING_SCHEME(Xapian::BM25PlusWeight);
@@ -3,7 +3,7 @@
  */
 /* Copyright 1999,2000,2001 BrightStation PLC
  * Copyright 2002 Ananova Ltd
- * Copyright 2003,2004,2006,2007,2008,2009,2018 Olly Betts
+ * Copyright 2003,2004,2006,2007,2008,2009,2018,2026 Olly Betts
  * Copyright 2008 Lemur Consulting Ltd
  *
  * This program is free software; you can redistribute it and/or
@@ -116,6 +116,26 @@ get_remote_database(const string& dbname,
     return backendmanager->get_remote_database(dbnames, timeout, port_ptr);
 }
 
+int
+start_remote_server(const string& dbname, const string& args)
+{
+    vector<string> dbnames;
+    dbnames.push_back(dbname);
+    return backendmanager->start_remote_server(dbnames, args);
+}
+
+int
+start_remote_server_for_path(const string& path, const string& args)
+{
+    return backendmanager->start_remote_server_for_path(path, args);
+}
+
+void
+kill_remote_server(int port)
+{
+    backendmanager->kill_remote_server(port);
+}
+
 void
 kill_remote(const Xapian::Database& db)
 {
@@ -1,7 +1,7 @@
 /** @file
  * @brief test functionality of the Xapian API
  */
-/* Copyright (C) 2007,2009,2011,2018 Olly Betts
+/* Copyright (C) 2007,2009,2011,2018,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -55,6 +55,28 @@ Xapian::Database get_remote_database(const std::string& db,
                                      unsigned timeout,
                                      int* port_ptr = nullptr);
 
+/** Start a remote server for @a db which serves any number of connections.
+ *
+ *  Currently only supported for remotetcp.  The server is killed after the
+ *  test, or by calling kill_remote_server().
+ *
+ *  @param args     Extra arguments to pass to xapian-tcpsrv.
+ *
+ *  @return The port the server is listening on.
+ */
+int start_remote_server(const std::string& db,
+                        const std::string& args = std::string());
+
+/** Start a remote server for the database at @a path.
+ *
+ *  Like start_remote_server(), but for a database the test has created.
+ */
+int start_remote_server_for_path(const std::string& path,
+                                 const std::string& args = std::string());
+
+/// Kill a server started by start_remote_server().
+void kill_remote_server(int port);
+
 /** Kill the server associated with remote database @a db.
  *
  *  Currently only supported for remotetcp and only for a database with a
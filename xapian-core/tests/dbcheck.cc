@@ -2,7 +2,7 @@
  * @brief test database contents and consistency.
  */
 /* Copyright 2009 Richard Boulton
- * Copyright 2010,2015 Olly Betts
+ * Copyright 2010,2015,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -23,6 +23,11 @@
 
 #include "dbcheck.h"
 
+#include <fstream>
+#include <sstream>
+
+#include "backends/honey/honey_defs.h"
+#include "pack.h"
 #include "str.h"
 #include "testsuite.h"
 
@@ -320,3 +325,36 @@ dbcheck(const Xapian::Database & db,
                           db.get_avlength());
     }
 }
+
+unsigned
+honey_format_flags(const string& path, unsigned table)
+{
+    ifstream in(path + "/iamhoney", ios::binary);
+    TEST(in.good());
+    ostringstream ss;
+    ss << in.rdbuf();
+    string data = ss.str();
+
+    // Skip the magic, format version and UUID.
+    TEST_REL(data.size(), >, 32);
+    const char* p = data.data() + 32;
+    const char* end = data.data() + data.size();
+    unsigned long long rev;
+    TEST(unpack_uint(&p, end, &rev));
+    for (unsigned t = 0; ; ++t) {
+        unsigned long long offset, root, filter;
+        unsigned format_flags, num_entries, blocksize, compress_min;
+        string fl_serialised;
+        TEST(unpack_uint(&p, end, &offset));
+        TEST(unpack_uint(&p, end, &root));
+        TEST(unpack_uint(&p, end, &format_flags));
+        if (t == table) return format_flags;
+        TEST(unpack_uint(&p, end, &num_entries));
+        TEST(unpack_uint(&p, end, &blocksize));
+        TEST(unpack_uint(&p, end, &compress_min));
+        TEST(unpack_string(&p, end, fl_serialised));
+        if (format_flags & Honey::FORMAT_BLOOM_FILTER) {
+            TEST(unpack_uint(&p, end, &filter));
+        }
+    }
+}
@@ -67,4 +67,14 @@ dbcheck(const Xapian::Database & db,
         Xapian::doccount expected_doccount,
         Xapian::docid expected_lastdocid);
 
+/** Read the format flags for a table from a honey database's version file.
+ *
+ *  @param path   The honey database directory.
+ *  @param table  The table number (a Honey::table_type value).
+ *
+ *  @return The table's Honey::FORMAT_* flags.
+ */
+unsigned
+honey_format_flags(const std::string& path, unsigned table);
+
 #endif /* XAPIAN_INCLUDED_DBCHECK_H */
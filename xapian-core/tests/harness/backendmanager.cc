@@ -3,7 +3,7 @@
  */
 /* Copyright 1999,2000,2001 BrightStation PLC
  * Copyright 2002 Ananova Ltd
- * Copyright 2002,2003,2004,2005,2006,2007,2008,2009,2010,2011,2012,2013,2016,2017,2018 Olly Betts
+ * Copyright 2002,2003,2004,2005,2006,2007,2008,2009,2010,2011,2012,2013,2016,2017,2018,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -307,6 +307,27 @@ BackendManager::kill_remote(const Xapian::Database&)
                                         "remotetcp databases");
 }
 
+int
+BackendManager::start_remote_server(const vector<string>&, const string&)
+{
+    throw Xapian::InvalidOperationError("start_remote_server() only "
+                                        "supported for remotetcp databases");
+}
+
+int
+BackendManager::start_remote_server_for_path(const string&, const string&)
+{
+    throw Xapian::InvalidOperationError("start_remote_server_for_path() only "
+                                        "supported for remotetcp databases");
+}
+
+void
+BackendManager::kill_remote_server(int)
+{
+    throw Xapian::InvalidOperationError("kill_remote_server() only "
+                                        "supported for remotetcp databases");
+}
+
 const char *
 BackendManager::get_xapian_progsrv_command()
 {
@@ -2,7 +2,7 @@
  * @brief Base class for backend handling in test harness
  */
 /* Copyright 1999,2000,2001 BrightStation PLC
- * Copyright 2002,2003,2004,2005,2006,2007,2008,2009,2010,2011,2017,2018 Olly Betts
+ * Copyright 2002,2003,2004,2005,2006,2007,2008,2009,2010,2011,2017,2018,2026 Olly Betts
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License as
@@ -171,6 +171,30 @@ class BackendManager {
      */
     virtual void clean_up();
 
+    /** Start a remote server which serves any number of connections.
+     *
+     *  Unlike the servers used by get_remote_database(), this server isn't
+     *  started with --one-shot, so it keeps running until kill_remote_server()
+     *  or clean_up() is called.
+     *
+     *  @param files    The database to serve.
+     *  @param args     Extra arguments to pass to the server.
+     *
+     *  @return The port the server is listening on.
+     */
+    virtual int start_remote_server(const std::vector<std::string>& files,
+                                    const std::string& args);
+
+    /** Start a remote server for the database at @a path.
+     *
+     *  Like start_remote_server(), but the caller creates the database.
+     */
+    virtual int start_remote_server_for_path(const std::string& path,
+                                             const std::string& args);
+
+    /// Kill a server started by start_remote_server().
+    virtual void kill_remote_server(int port);
+
     /** Kill the remote server associated with @a db.
      *
      *  Intended to allow testing handling of a remote server failing.
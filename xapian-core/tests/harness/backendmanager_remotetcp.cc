@@ -1,7 +1,7 @@
 /** @file
  * @brief BackendManager subclass for remotetcp databases.
  */
-/* Copyright (C) 2006,2007,2008,2009,2013,2015,2023 Olly Betts
+/* Copyright (C) 2006,2007,2008,2009,2013,2015,2023,2026 Olly Betts
  * Copyright (C) 2008 Lemur Consulting Ltd
  *
  * This program is free software; you can redistribute it and/or
@@ -95,17 +95,50 @@ class ServerData {
      */
     const void* db_internal;
 
+    /// The port the server is listening on.
+    int port;
+
+    /** Was the server started with --one-shot?
+     *
+     *  If not, it won't exit by itself so clean_up() has to kill it.
+     */
+    bool one_shot;
+
+    /// Kill the server process.
+    void kill_server() {
+#ifdef HAVE_FORK
+        // Kill the process group that we put the server in so that we kill
+        // the server itself and not just the /bin/sh that launched it.
+        if (kill(-pid, SIGKILL) < 0) {
+            throw Xapian::DatabaseError("Couldn't kill remote server",
+                                        errno);
+        }
+#elif defined __WIN32__
+        // We want to kill the whole process group so we need to use
+        // GenerateConsoleCtrlEvent() - TerminateProcess() can only
+        // terminate one process given its handle.
+        if (!GenerateConsoleCtrlEvent(CTRL_BREAK_EVENT, pid)) {
+            throw Xapian::DatabaseError("Couldn't kill remote server",
+                                        -int(GetLastError()));
+        }
+#endif
+    }
+
   public:
 #ifndef __WIN32__
-    void init(pid_type pid_) {
+    void init(pid_type pid_, int port_, bool one_shot_) {
         pid = pid_;
         db_internal = nullptr;
+        port = port_;
+        one_shot = one_shot_;
     }
 #else
-    void init(pid_type pid_, HANDLE handle_) {
+    void init(pid_type pid_, HANDLE handle_, int port_, bool one_shot_) {
         pid = pid_;
         handle = handle_;
         db_internal = nullptr;
+        port = port_;
+        one_shot = one_shot_;
     }
 #endif
 
@@ -113,6 +146,7 @@ class ServerData {
 
     void clean_up() {
         if (pid == DEAD_PID) return;
+        if (!one_shot) kill_server();
 #ifdef HAVE_FORK
         int status;
         while (waitpid(pid, &status, 0) == -1 && errno == EINTR) { }
@@ -128,22 +162,15 @@ class ServerData {
 
     bool kill_remote(const void* dbi) {
         if (pid == DEAD_PID || dbi != db_internal) return false;
-#ifdef HAVE_FORK
-        // Kill the process group that we put the server in so that we kill
-        // the server itself and not just the /bin/sh that launched it.
-        if (kill(-pid, SIGKILL) < 0) {
-            throw Xapian::DatabaseError("Couldn't kill remote server",
-                                        errno);
-        }
-#elif defined __WIN32__
-        // We want to kill the whole process group so we need to use
-        // GenerateConsoleCtrlEvent() - TerminateProcess() can only
-        // terminate one process given its handle.
-        if (!GenerateConsoleCtrlEvent(CTRL_BREAK_EVENT, pid)) {
-            throw Xapian::DatabaseError("Couldn't kill remote server",
-                                        -int(GetLastError()));
-        }
-#endif
+        if (one_shot) kill_server();
+        clean_up();
+        pid = DEAD_PID;
+        return true;
+    }
+
+    bool kill_remote(int port_) {
+        if (pid == DEAD_PID || port_ != port) return false;
+        if (one_shot) kill_server();
         clean_up();
         pid = DEAD_PID;
         return true;
@@ -167,18 +194,25 @@ static unsigned first_unused_server_data = 0;
 #ifdef HAVE_FORK
 
 static std::pair<int, ServerData&>
-launch_xapian_tcpsrv(const string & args)
+launch_xapian_tcpsrv(const string & args, bool one_shot = true)
 {
     int port = DEFAULT_PORT;
 
 try_next_port:
-    string cmd = XAPIAN_TCPSRV " --one-shot --interface " LOCALHOST " --port ";
+    string cmd = XAPIAN_TCPSRV;
+    if (one_shot) cmd += " --one-shot";
+    cmd += " --interface " LOCALHOST " --port ";
     cmd += str(port);
     cmd += " ";
     cmd += args;
 #ifdef HAVE_VALGRIND
     if (RUNNING_ON_VALGRIND) cmd = "./runsrv " + cmd;
 #endif
+    // Have /bin/sh exec the server, as otherwise the server ends up in a
+    // different process group to /bin/sh (xapian-tcpsrv puts itself in its
+    // own process group when it forks for each connection), so killing the
+    // process group wouldn't kill a server not started with --one-shot.
+    cmd = "exec " + cmd;
     int fds[2];
     if (socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, PF_UNSPEC, fds) < 0) {
         string msg("Couldn't create socketpair: ");
@@ -273,7 +307,7 @@ try_next_port:
     }
 
     auto& data = server_data[first_unused_server_data++];
-    data.init(child);
+    data.init(child, port, one_shot);
     return {port, data};
 }
 
@@ -303,12 +337,14 @@ static void win32_throw_error_string(const char * str)
 // This implementation uses the WIN32 API to start xapian-tcpsrv as a child
 // process and read its output using a pipe.
 static std::pair<int, ServerData&>
-launch_xapian_tcpsrv(const string & args)
+launch_xapian_tcpsrv(const string & args, bool one_shot = true)
 {
     int port = DEFAULT_PORT;
 
 try_next_port:
-    string cmd = XAPIAN_TCPSRV " --one-shot --interface " LOCALHOST " --port ";
+    string cmd = XAPIAN_TCPSRV;
+    if (one_shot) cmd += " --one-shot";
+    cmd += " --interface " LOCALHOST " --port ";
     cmd += str(port);
     cmd += " ";
     cmd += args;
@@ -381,7 +417,7 @@ try_next_port:
     }
 
     auto& data = server_data[first_unused_server_data++];
-    data.init(procinfo.dwProcessId, procinfo.hProcess);
+    data.init(procinfo.dwProcessId, procinfo.hProcess, port, one_shot);
     return {port, data};
 }
 
@@ -454,6 +490,37 @@ BackendManagerRemoteTcp::get_writable_database_again()
     return get_remotetcp_writable_db(get_writable_database_again_args());
 }
 
+int
+BackendManagerRemoteTcp::start_remote_server(const vector<string>& files,
+                                             const string& args)
+{
+    // Put the extra arguments last so they can override the timeout.
+    string server_args = get_remote_database_args(files, 300000);
+    server_args += ' ';
+    server_args += args;
+    return launch_xapian_tcpsrv(server_args, false).first;
+}
+
+int
+BackendManagerRemoteTcp::start_remote_server_for_path(const string& path,
+                                                      const string& args)
+{
+    string server_args = get_remote_database_args(path, 300000);
+    server_args += ' ';
+    server_args += args;
+    return launch_xapian_tcpsrv(server_args, false).first;
+}
+
+void
+BackendManagerRemoteTcp::kill_remote_server(int port)
+{
+    for (unsigned i = 0; i != first_unused_server_data; ++i) {
+        if (server_data[i].kill_remote(port))
+            return;
+    }
+    throw Xapian::DatabaseError("No known server on port " + str(port));
+}
+
 void
 BackendManagerRemoteTcp::kill_remote(const Xapian::Database& db)
 {
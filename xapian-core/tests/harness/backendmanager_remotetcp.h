@@ -1,7 +1,7 @@
 /** @file
  * @brief BackendManager subclass for remotetcp databases.
  */
-/* Copyright (C) 2007,2009,2011 Olly Betts
+/* Copyright (C) 2007,2009,2011,2026 Olly Betts
  * Copyright (C) 2008 Lemur Consulting Ltd
  *
  * This program is free software; you can redistribute it and/or
@@ -67,6 +67,17 @@ class BackendManagerRemoteTcp : public BackendManagerRemote {
     /// Create a WritableDatabase object for the last opened WritableDatabase.
     Xapian::WritableDatabase get_writable_database_again();
 
+    /// Start a remote server which serves any number of connections.
+    int start_remote_server(const std::vector<std::string>& files,
+                            const std::string& args);
+
+    /// Start a remote server for the database at @a path.
+    int start_remote_server_for_path(const std::string& path,
+                                     const std::string& args);
+
+    /// Kill a server started by start_remote_server().
+    void kill_remote_server(int port);
+
     void kill_remote(const Xapian::Database& db);
 
     /// Called after each test, to perform any necessary cleanup.
@@ -19,6 +19,7 @@ noinst_HEADERS += perftest/perftest.h
 
 collated_perftest_sources = \
  perftest/perftest_matchdecider.cc \
+ perftest/perftest_positions.cc \
  perftest/perftest_randomidx.cc
 
 # FIXME: Need more work before being released: perftest/perftest_diversify.cc
@@ -0,0 +1,148 @@
+/** @file
+ * @brief performance tests for decoding positional data
+ */
+/* Copyright 2026 Olly Betts
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "perftest/perftest_positions.h"
+
+#include <cstdlib>
+#include <xapian.h>
+
+#include "backendmanager.h"
+#include "perftest.h"
+#include "str.h"
+#include "testrunner.h"
+#include "testsuite.h"
+#include "testutils.h"
+
+using namespace std;
+
+static void
+builddb_positions1(Xapian::WritableDatabase &db, const string & dbname)
+{
+    logger.testcase_begin(dbname);
+    unsigned int runsize = 20000;
+    unsigned int doclen = 2000;
+
+    std::map<std::string, std::string> params;
+    params["runsize"] = str(runsize);
+    params["doclen"] = str(doclen);
+    logger.indexing_begin(dbname, params);
+    srand(42);
+    for (unsigned int i = 0; i < runsize; ++i) {
+        // Use a Zipf-like distribution of 100 words, so we get position lists
+        // of a range of lengths, and the common words appear in phrases.
+        Xapian::Document doc;
+        doc.set_data("positions document " + str(i));
+        for (Xapian::termpos pos = 1; pos <= doclen; ++pos) {
+            unsigned word = 100 / (1 + rand() % 100);
+            doc.add_posting("w" + str(word), pos);
+        }
+        db.add_document(doc);
+        logger.indexing_add();
+    }
+    db.commit();
+    logger.indexing_end();
+    logger.testcase_end();
+}
+
+// Test the speed of iterating through position lists.
+DEFINE_TESTCASE(positionlist1, writable && !remote && !inmemory) {
+    Xapian::Database db;
+    db = backendmanager->get_database("positions1", builddb_positions1,
+                                      "positions1");
+
+    logger.testcase_begin("positionlist1");
+
+    logger.searching_start("Iterate all position lists");
+    logger.search_start();
+    Xapian::termpos total = 0;
+    for (Xapian::docid did = 1; did <= db.get_lastdocid(); ++did) {
+        for (auto t = db.termlist_begin(did); t != db.termlist_end(did); ++t) {
+            for (auto p = t.positionlist_begin(); p != t.positionlist_end();
+                 ++p) {
+                total += *p;
+            }
+        }
+    }
+    logger.search_end(Xapian::Query(), Xapian::MSet());
+    TEST(total != 0);
+    logger.searching_end();
+
+    logger.searching_start("Skip through position lists");
+    logger.search_start();
+    total = 0;
+    for (Xapian::docid did = 1; did <= db.get_lastdocid(); ++did) {
+        for (auto t = db.termlist_begin(did); t != db.termlist_end(did); ++t) {
+            auto p = t.positionlist_begin();
+            for (Xapian::termpos pos = 1; p != t.positionlist_end();
+                 pos = *p + 50) {
+                p.skip_to(pos);
+                if (p == t.positionlist_end()) break;
+                total += *p;
+            }
+        }
+    }
+    logger.search_end(Xapian::Query(), Xapian::MSet());
+    TEST(total != 0);
+    logger.searching_end();
+
+    logger.testcase_end();
+}
+
+// Test the speed of phrase searches, which spend much of their time decoding
+// position lists.
+DEFINE_TESTCASE(phrase1, writable && !remote && !inmemory) {
+    Xapian::Database db;
+    db = backendmanager->get_database("positions1", builddb_positions1,
+                                      "positions1");
+
+    logger.testcase_begin("phrase1");
+    Xapian::Enquire enquire(db);
+
+    static const char* const phrases[][3] = {
+        { "w1", "w2", NULL },
+        { "w1", "w1", "w3" },
+        { "w5", "w1", NULL },
+        { "w2", "w4", "w8" },
+        { "w1", "w50", NULL }
+    };
+    for (auto& phrase : phrases) {
+        vector<Xapian::Query> subqs;
+        string desc = "Phrase:";
+        for (const char* term : phrase) {
+            if (!term) break;
+            subqs.emplace_back(term);
+            desc += ' ';
+            desc += term;
+        }
+        for (auto op : { Xapian::Query::OP_PHRASE, Xapian::Query::OP_NEAR }) {
+            Xapian::Query query(op, subqs.begin(), subqs.end(), subqs.size());
+            logger.searching_start(desc);
+            logger.search_start();
+            enquire.set_query(query);
+            Xapian::MSet mset = enquire.get_mset(0, 10, db.get_doccount());
+            logger.search_end(query, mset);
+            logger.searching_end();
+        }
+    }
+
+    logger.testcase_end();
+}
@@ -21,17 +21,20 @@
 
 #include <config.h>
 
+#include <atomic>
 #include <cctype>
 #include <cerrno>
 #include <cfloat>
 #include <climits>
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <limits>
 #include <memory>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 #include "safeunistd.h"
 
@@ -74,16 +77,19 @@ static const char * unittest_assertion_failed = NULL;
 
 // Code we're unit testing:
 #include "../backends/uuids.cc"
+#include "../common/bitstream.cc"
 #include "../common/closefrom.cc"
 #include "../common/errno_to_string.cc"
 #include "../common/io_utils.cc"
 #include "../common/fileutils.cc"
 #include "../common/overflow.h"
 #include "../common/pack.cc"
+#include "../common/parallel.cc"
 #include "../common/parseint.h"
 #include "../common/posixy_wrapper.cc"
 #include "../common/serialise-double.cc"
 #include "../common/str.cc"
+#include "../net/remoteresultcache.cc"
 #include "../net/serialise-error.cc"
 #include "../api/error.cc"
 #include "../api/smallvector.cc"
@@ -1040,6 +1046,173 @@ DEFINE_TESTCASE(vecdeleter1) {
     }
 }
 
+DEFINE_TESTCASE(runparallel1) {
+    for (unsigned threads = 0; threads <= 4; ++threads) {
+        vector<int> results(20);
+        vector<function<void()>> tasks;
+        for (int i = 0; i < 20; ++i) {
+            tasks.push_back([&results, i]() { results[i] = i * i; });
+        }
+        run_parallel(tasks, threads);
+        for (int i = 0; i < 20; ++i) {
+            TEST_EQUAL(results[i], i * i);
+        }
+
+        // Check all tasks get run even if some throw, and that the exception
+        // from the first task which failed is the one rethrown.
+        vector<function<void()>> failing_tasks = {
+            [&results]() { results[0] = -1; },
+            []() { throw 1; },
+            [&results]() { results[2] = -1; },
+            []() { throw 3; },
+            [&results]() { results[4] = -1; }
+        };
+        try {
+            run_parallel(failing_tasks, threads);
+            FAIL_TEST("Expected exception not thrown");
+        } catch (int e) {
+            TEST_EQUAL(e, 1);
+        }
+        TEST_EQUAL(results[0], -1);
+        TEST_EQUAL(results[2], -1);
+        TEST_EQUAL(results[4], -1);
+
+        // No tasks is OK.
+        run_parallel({}, threads);
+    }
+
+    // Check nested calls share the outer call's limit on threads.
+    atomic<int> running{0};
+    atomic<int> most_running{0};
+    auto task = [&]() {
+        int n = ++running;
+        int most = most_running;
+        while (n > most && !most_running.compare_exchange_weak(most, n)) { }
+        --running;
+    };
+    vector<function<void()>> tasks;
+    for (int i = 0; i < 4; ++i) {
+        tasks.push_back([&]() {
+            run_parallel(vector<function<void()>>(8, task), 3);
+        });
+    }
+    run_parallel(tasks, 3);
+    TEST_REL(most_running, <=, 3);
+}
+
+// Check bulk interpolative decoding gives the same results as on-demand.
+DEFINE_TESTCASE(bitstream1) {
+    srand(42);
+    for (int n = 2; n < 2000; n = n * 3 / 2 + 1) {
+        for (int type = 0; type != 4; ++type) {
+            Xapian::VecCOW<Xapian::termpos> pos;
+            Xapian::termpos p = rand() % 10 + 1;
+            for (int i = 0; i != n; ++i) {
+                pos.push_back(p);
+                switch (type) {
+                    case 0:
+                        // Consecutive.
+                        ++p;
+                        break;
+                    case 1:
+                        // Small gaps, with runs of consecutive entries.
+                        p += (rand() % 4 ? 1 : rand() % 10 + 2);
+                        break;
+                    case 2:
+                        // Varied gaps.
+                        p += rand() % 1000 + 1;
+                        break;
+                    case 3:
+                        // Some very large gaps.
+                        p += (rand() % 8 ? rand() % 50 + 1 : 0x400000);
+                        break;
+                }
+            }
+
+            // Encode with a header like the position list tables use.
+            BitWriter wr("x");
+            wr.encode(pos[0], pos.back());
+            wr.encode(n - 2, pos.back() - pos[0]);
+            wr.encode_interpolative(pos, 0, n - 1);
+            const string& data = wr.freeze();
+            const char* start = data.data() + 1;
+            const char* end = data.data() + data.size();
+
+            BitReader rd(start, end);
+            TEST_EQUAL(rd.decode(pos.back()), pos[0]);
+            TEST_EQUAL(rd.decode(pos.back() - pos[0]) + 2, Xapian::termpos(n));
+            rd.decode_interpolative(0, n - 1, pos[0], pos.back());
+            for (int i = 1; i < n - 1; ++i) {
+                TEST_EQUAL(rd.decode_interpolative_next(), pos[i]);
+            }
+            TEST_EQUAL(rd.decode_interpolative_next(), pos.back());
+            TEST(rd.check_all_gone());
+
+            BitReader rd2(start, end);
+            TEST_EQUAL(rd2.decode(pos.back()), pos[0]);
+            TEST_EQUAL(rd2.decode(pos.back() - pos[0]) + 2, Xapian::termpos(n));
+            vector<Xapian::termpos> out(n);
+            out[0] = pos[0];
+            out[n - 1] = pos.back();
+            rd2.decode_interpolative(out.data(), 0, n - 1);
+            for (int i = 0; i != n; ++i) {
+                TEST_EQUAL(out[i], pos[i]);
+            }
+            TEST(rd2.check_all_gone());
+        }
+    }
+}
+
+DEFINE_TESTCASE(remoteresultcache1) {
+    // Room for three entries with a 2 byte key and 10 byte value.
+    RemoteResultCache cache(3 * (ENTRY_OVERHEAD + 2 + 10));
+    const string uuid = "00000000-0000-0000-0000-000000000001";
+    string value;
+    TEST(!cache.get(uuid, 1, "k1", value));
+    cache.set(uuid, 1, "k1", "0123456789");
+    cache.set(uuid, 1, "k2", "abcdefghij");
+    cache.set(uuid, 1, "k3", "ABCDEFGHIJ");
+    TEST(cache.get(uuid, 1, "k1", value));
+    TEST_EQUAL(value, "0123456789");
+
+    // k2 is now the least recently used so should get evicted.
+    cache.set(uuid, 1, "k4", "9876543210");
+    TEST(!cache.get(uuid, 1, "k2", value));
+    TEST(cache.get(uuid, 1, "k3", value));
+    TEST_EQUAL(value, "ABCDEFGHIJ");
+    TEST(cache.get(uuid, 1, "k4", value));
+    TEST(cache.get(uuid, 1, "k1", value));
+    TEST_EQUAL(value, "0123456789");
+
+    // An entry too large for the cache shouldn't be added, and shouldn't
+    // cause other entries to be evicted.
+    cache.set(uuid, 1, "k5", string(3 * ENTRY_OVERHEAD, 'x'));
+    TEST(!cache.get(uuid, 1, "k5", value));
+    TEST(cache.get(uuid, 1, "k1", value));
+
+    // Entries for an older revision shouldn't be returned or discard the
+    // cache.
+    TEST(!cache.get(uuid, 0, "k1", value));
+    cache.set(uuid, 0, "k0", "0000000000");
+    TEST(!cache.get(uuid, 0, "k0", value));
+    TEST(cache.get(uuid, 1, "k1", value));
+
+    // A newer revision should discard all the entries.
+    TEST(!cache.get(uuid, 2, "k1", value));
+    TEST(!cache.get(uuid, 1, "k1", value));
+    cache.set(uuid, 2, "k1", "abcdefghij");
+    TEST(cache.get(uuid, 2, "k1", value));
+    TEST_EQUAL(value, "abcdefghij");
+
+    // As should a different database.
+    const string uuid2 = "00000000-0000-0000-0000-000000000002";
+    TEST(!cache.get(uuid2, 2, "k1", value));
+
+    cache.set(uuid2, 2, "k1", "abcdefghij");
+    cache.clear();
+    TEST(!cache.get(uuid2, 2, "k1", value));
+}
+
 static const test_desc tests[] = {
     TESTCASE(simple_exceptions_work1),
     TESTCASE(class_exceptions_work1),
@@ -1066,6 +1239,9 @@ static const test_desc tests[] = {
     TESTCASE(ioblock1),
     TESTCASE(vec1),
     TESTCASE(vecdeleter1),
+    TESTCASE(runparallel1),
+    TESTCASE(bitstream1),
+    TESTCASE(remoteresultcache1),
     END_OF_TESTCASES
 };
 
@@ -18,6 +18,7 @@ lib_src +=\
 	weight/dlhweight.cc\
 	weight/dphweight.cc\
 	weight/ifb2weight.cc\
+	weight/impactweight.cc\
 	weight/ineb2weight.cc\
 	weight/inl2weight.cc\
 	weight/lmweight.cc\
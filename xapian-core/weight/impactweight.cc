@@ -0,0 +1,98 @@
+/** @file
+ * @brief Xapian::ImpactWeight class - weighting using precomputed impacts
+ */
+/* Copyright (C) 2026 Olly Betts
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "xapian/weight.h"
+
+#include "xapian/error.h"
+
+#include <cmath>
+
+using namespace std;
+
+namespace Xapian {
+
+ImpactWeight*
+ImpactWeight::clone() const
+{
+    return new ImpactWeight;
+}
+
+void
+ImpactWeight::init(double factor_)
+{
+    // The impacts are the part of the BM25 weight which depends on the wdf
+    // and document length, scaled by 255.  Multiply by the term weight,
+    // calculated as BM25Weight::init() does without an RSet, and with the
+    // (k1 + 1) factor from BM25Weight::get_sumpart() for the default k1 of 1.
+    Xapian::doccount tf = get_termfreq();
+    double tw = (get_collection_size() - tf + 0.5) / (tf + 0.5);
+    if (tw < 2) tw = tw * 0.5 + 1;
+    factor = factor_ * log(tw) * 2 / 255;
+    // Adjust for the wqf in the same way as BM25Weight with its default
+    // value of k3 (which is 1).
+    double wqf_double = get_wqf();
+    factor *= 2 * wqf_double / (1 + wqf_double);
+}
+
+string
+ImpactWeight::name() const
+{
+    return "impact";
+}
+
+string
+ImpactWeight::serialise() const
+{
+    // No parameters to serialise.
+    return string();
+}
+
+ImpactWeight*
+ImpactWeight::unserialise(const string& s) const
+{
+    if (rare(!s.empty()))
+        throw Xapian::SerialisationError("Extra data in ImpactWeight::unserialise()");
+    return new ImpactWeight;
+}
+
+double
+ImpactWeight::get_sumpart(Xapian::termcount wdf, Xapian::termcount,
+                          Xapian::termcount, Xapian::termcount) const
+{
+    return wdf * factor;
+}
+
+double
+ImpactWeight::get_maxpart() const
+{
+    return get_wdf_upper_bound() * factor;
+}
+
+ImpactWeight*
+ImpactWeight::create_from_parameters(const char* p) const
+{
+    if (*p != '\0')
+        throw InvalidArgumentError("No parameters are required for ImpactWeight");
+    return new Xapian::ImpactWeight();
+}
+
+}